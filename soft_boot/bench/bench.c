@@ -0,0 +1,330 @@
+#include "bench.h"
+#include "uart.h"
+#include "config.h"
+#include "memops.h"
+#include "boot.h"
+#include "cache.h"
+#include "loop_stats.h"
+#include "robot_leon.h"
+#include "fxp.h"
+#include "hwmath.h"
+#include "speed_pid.h"
+
+#ifndef BUILD_FLAVOUR
+#define BUILD_FLAVOUR "?"
+#endif
+
+/* routines de main.c */
+extern char input_buf[];
+int convert_input_buf_to_hexint ();
+
+#define BENCH_N       64
+#define BENCH_BUF_SZ  512
+
+#define CYCLES_PER_US ( CPU_FREQUENCY / 1000000 )
+
+uint32_t bench_src[BENCH_BUF_SZ/4];
+uint32_t bench_dst[BENCH_BUF_SZ/4];
+
+/* puits pour que l'optimiseur ne supprime pas les calculs */
+volatile uint32_t bench_sink;
+
+static uint32_t bench_now ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  return robot_reg[R_ROBOT_TIMER];
+}
+
+/* corps de la boucle de controle sans effet de bord : pas control_task(),
+   qui ecrirait les moteurs et mettrait des lectures I2C en file. On mesure
+   le calcul de l'asservissement (speed_pid_step, etat sauve et restaure
+   par l'appelant) et les statistiques de boucle (remises a zero ensuite) */
+static speed_pid_t bench_pid_save;
+
+static void bench_body ( uint32_t now, int i )
+{
+  speed_pid_step ( i << 3, -( i << 3 ), 1000, -1000 );
+  loop_stats_update ( now, now, bench_now (), now + SPID_PERIOD_DEF );
+}
+
+/* temps de la boucle vide (us pour BENCH_N tours) */
+static uint32_t bench_overhead;
+
+static void bench_report ( char *name, uint32_t t_us, int n )
+{
+  if (t_us > bench_overhead)
+    t_us -= bench_overhead;
+  else
+    t_us = 0;
+
+  uart_putstring ( name );
+  uart_printint ( t_us );
+  uart_putstring ( "us " );
+  uart_printint ( (t_us*CYCLES_PER_US)/n );
+  uart_putstring ( "cyc/op" );
+  uart_putchar ( 0xa );
+  uart_flush ();
+}
+
+/* routines de virgule fixe (math/fxp.c) */
+static void bench_fxp ()
+{
+  uint32_t t0, t1;
+  q16_16_t a, b;
+  q1_30_t s, c;
+  int i;
+
+  a = Q16_16 ( 1.2345 );
+  b = Q16_16 ( 0.9876 );
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    a = fxp_mul ( a, b ) + i;
+    bench_sink = a;
+  }
+  t1 = bench_now ();
+  bench_report ( "  fxp_mul    ", t1 - t0, BENCH_N );
+
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_sink = fxp_div ( Q16_16 ( 1000.0 ), b + i );
+  }
+  t1 = bench_now ();
+  bench_report ( "  fxp_div    ", t1 - t0, BENCH_N );
+
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_sink = fxp_add_sat ( a, b + i );
+  }
+  t1 = bench_now ();
+  bench_report ( "  fxp_addsat ", t1 - t0, BENCH_N );
+
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_sink = fxp_sqrt ( b + (i<<16) );
+  }
+  t1 = bench_now ();
+  bench_report ( "  fxp_sqrt   ", t1 - t0, BENCH_N );
+
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    fxp_sincos ( b * i, &s, &c );
+    bench_sink = s + c;
+  }
+  t1 = bench_now ();
+  bench_report ( "  fxp_sincos ", t1 - t0, BENCH_N );
+
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_sink = fxp_atan2 ( b - (i<<12), a );
+  }
+  t1 = bench_now ();
+  bench_report ( "  fxp_atan2  ", t1 - t0, BENCH_N );
+}
+
+/* accelerateurs Q15.48 (drivers/hwmath.c) contre le calcul logiciel */
+static void bench_hwmath ()
+{
+  uint32_t t0, t1;
+  q15_48_t a, b, s, c;
+  int h[HWMATH_QUEUE_LEN];
+  int i, k, n;
+
+  a = 0x0001234500000000LL;
+  b = 0x0000fcd600000000LL;
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_sink = ( uint32_t ) ( fxp_mul_q48 ( a, b + i ) >> 16 );
+  }
+  t1 = bench_now ();
+  bench_report ( "  mul64 sw   ", t1 - t0, BENCH_N );
+
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_sink = ( uint32_t ) ( hwmath_mul ( a, b + i ) >> 16 );
+  }
+  t1 = bench_now ();
+  bench_report ( (hwmath_present () & HWMATH_HW_MUL64) ? "  mul64 hw   " :
+                 "  mul64 (sw) ", t1 - t0, BENCH_N );
+
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    fxp_sincos_q48 ( b * i, &s, &c );
+    bench_sink = ( uint32_t ) ( (s + c) >> 16 );
+  }
+  t1 = bench_now ();
+  bench_report ( "  sincos sw  ", t1 - t0, BENCH_N );
+
+  /* une operation a la fois : latence */
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    hwmath_sincos ( b * i, &s, &c );
+    bench_sink = ( uint32_t ) ( (s + c) >> 16 );
+  }
+  t1 = bench_now ();
+  bench_report ( (hwmath_present () & HWMATH_HW_SINCOS) ? "  sincos hw  " :
+                 "  sincos (sw)", t1 - t0, BENCH_N );
+
+  /* file pleine, resultats releves apres hwmath_poll : debit */
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i+=HWMATH_QUEUE_LEN) {
+    for (k=0; k<HWMATH_QUEUE_LEN; k++)
+      h[k] = hwmath_submit_sincos ( b * (i+k) );
+    for (k=0; k<HWMATH_QUEUE_LEN; k++) {
+      if (h[k] < 0)
+        continue;
+      for (n=0; (n<64) && !hwmath_done ( h[k] ); n++)
+        hwmath_poll ();
+      hwmath_get_sincos ( h[k], &s, &c );
+      bench_sink = ( uint32_t ) ( (s + c) >> 16 );
+    }
+  }
+  t1 = bench_now ();
+  bench_report ( "  sincos file", t1 - t0, BENCH_N );
+
+  uart_putstring ( "  hwmath hw/sw/full: " );
+  uart_printint ( hwmath_stats.hw_ops );
+  uart_putchar ( ' ' );
+  uart_printint ( hwmath_stats.sw_ops );
+  uart_putchar ( ' ' );
+  uart_printint ( hwmath_stats.full );
+  uart_putchar ( 0xa );
+  uart_flush ();
+}
+
+/* corps de boucle et memcpy, caches desactives puis actives */
+static void bench_cache ()
+{
+  uint32_t ctrl_save, t0, t1;
+  int pass, i;
+
+  ctrl_save = cache_get_ctrl ();
+
+  for (pass=0; pass<2; pass++) {
+    if (pass==0)
+      cache_disable ();
+    else
+      cache_enable ( CACHE_ALL );
+
+    bench_pid_save = speed_pid;
+    t0 = bench_now ();
+    for (i=0; i<BENCH_N; i++) {
+      bench_body ( t0, i );
+      bench_sink = i;
+    }
+    t1 = bench_now ();
+    speed_pid = bench_pid_save;
+    bench_report ( (pass==0) ? "  body nc    " : "  body cache ", t1 - t0, BENCH_N );
+
+    t0 = bench_now ();
+    for (i=0; i<8; i++) {
+      memcpy ( bench_dst, bench_src, BENCH_BUF_SZ );
+      bench_sink = bench_dst[i];
+    }
+    t1 = bench_now ();
+    bench_report ( (pass==0) ? "  memcpy nc  " : "  memcpy cache", t1 - t0, 8 );
+  }
+  loop_stats_reset ();
+
+  /* retour a la configuration de boot */
+  cache_flush ();
+  cache_set_ctrl ( ctrl_save );
+}
+
+void bench_run ()
+{
+  uint32_t t0, t1, a, b;
+  int i;
+
+  uart_flush ();
+
+  uart_putstring ( "BENCH flavour: " );
+  uart_putstring ( BUILD_FLAVOUR );
+  uart_putstring ( " data init: " );
+  uart_putstring ( data_init_check () ? "OK" : "KO" );
+  uart_putchar ( 0xa );
+  uart_flush ();
+
+  /* boucle vide */
+  bench_overhead = 0;
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_sink = i;
+  }
+  t1 = bench_now ();
+  bench_overhead = t1 - t0;
+  bench_report ( "  loop       ", t1 - t0, BENCH_N );
+
+  /* impression : seulement le remplissage de la fifo TX (16*8 octets) */
+  t0 = bench_now ();
+  for (i=0; i<16; i++) {
+    uart_printhex ( i );
+    bench_sink = i;
+  }
+  t1 = bench_now ();
+  uart_putchar ( 0xa );
+  uart_flush ();
+  bench_report ( "  printhex   ", t1 - t0, 16 );
+
+  /* analyse hexa du buffer d'edition */
+  memcpy ( input_buf, "80008000________", 16 );
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_sink = convert_input_buf_to_hexint ();
+  }
+  t1 = bench_now ();
+  bench_report ( "  hex parse  ", t1 - t0, BENCH_N );
+
+  /* corps de la boucle de controle (calcul seulement, cf bench_body) */
+  bench_pid_save = speed_pid;
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_body ( t0, i );
+    bench_sink = i;
+  }
+  t1 = bench_now ();
+  speed_pid = bench_pid_save;
+  loop_stats_reset ();
+  bench_report ( "  loop body  ", t1 - t0, BENCH_N );
+
+  /* mul/div 32 bits (instructions v8) */
+  a = 0x12345678;
+  b = 1;
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    b = b * a + i;
+    bench_sink = b;
+  }
+  t1 = bench_now ();
+  bench_report ( "  mul32      ", t1 - t0, BENCH_N );
+
+  b = 0xffffffff;
+  t0 = bench_now ();
+  for (i=0; i<BENCH_N; i++) {
+    bench_sink = b / ( uint32_t ) ( i + 3 );
+  }
+  t1 = bench_now ();
+  bench_report ( "  div32      ", t1 - t0, BENCH_N );
+
+  /* memcpy / memset (BENCH_BUF_SZ octets) */
+  t0 = bench_now ();
+  for (i=0; i<8; i++) {
+    memcpy ( bench_dst, bench_src, BENCH_BUF_SZ );
+    bench_sink = bench_dst[i];
+  }
+  t1 = bench_now ();
+  bench_report ( "  memcpy 512 ", t1 - t0, 8 );
+
+  t0 = bench_now ();
+  for (i=0; i<8; i++) {
+    memset ( bench_dst, i, BENCH_BUF_SZ );
+    bench_sink = bench_dst[i];
+  }
+  t1 = bench_now ();
+  bench_report ( "  memset 512 ", t1 - t0, 8 );
+
+  bench_fxp ();
+  bench_hwmath ();
+
+  bench_cache ();
+}
@@ -1,14 +1,6 @@
 #include "leon.h"
-
-/* Cache Control Register */
-#define CCR_DCS_DIS ( 0x0 << 2 )
-#define CCR_DCS_FRZ ( 0x1 << 2 )
-#define CCR_DCS_ENA ( 0x3 << 2 )
-#define CCR_ICS_DIS 0x0
-#define CCR_ICS_FRZ 0x1
-#define CCR_ICS_ENA 0x3
-#define CCR_IB ( 1<<16 )
-#define CCR_DS ( 1<<23 )
+#include "boot.h"
+#include "cache.h"
 
 #define MCFG1_WDTH_MSK ( 0x3 << 8 )
 #define MCFG1_WR_MSK ( 0xf << 4 )
@@ -68,8 +60,13 @@
 
 void _init_peripherals () {
     struct lregs *hw = ( struct lregs * )( PREGS );
-    /* FIXME : DEBUG */
-    //hw->cachectrl = CCR_DS|CCR_IB|CCR_DCS_ENA|CCR_ICS_ENA;
+#ifdef NO_CACHE
+    /* make SIMULATION=-DNO_CACHE : execution sans cache */
+    cache_disable ();
+#else
+    /* icache + dcache (write-through), burst fetch ; cf cache_selftest() */
+    cache_enable ( CACHE_ALL );
+#endif
 
 #if 0 /* FIXME : DEBUG */
     /* Don't know what this piece of code does */
@@ -156,24 +153,83 @@ void _init_peripherals () {
     hw->istat2 =  0;
 }
 
-extern unsigned char _rom_rodata_end;
+extern unsigned char _rom_data_load;
 extern unsigned char _rom_data_start;
 extern unsigned char _rom_data_end;
 extern unsigned char _rom_bss_start;
 extern unsigned char _rom_bss_end;
 
+/* temoins de l'init .data/.bss, verifies par data_init_check() */
+unsigned int _data_init_magic = DATA_INIT_MAGIC;
+unsigned int _bss_init_magic;
+
 void _init_rom_data_bss () {
+    /* les bornes sont alignees sur 4 par mk_ld.sh : copie/raz par mots,
+       deroulee x4 ; la boucle octet ne sert que si l'alignement est casse */
     {
         /* Copy ROM data section into RAM */
-        unsigned char *src = &_rom_rodata_end;
+        unsigned char *src = &_rom_data_load;
         unsigned char *dst = &_rom_data_start;
-        while ( dst < &_rom_data_end ) {
-            *dst++ = *src++;
+        if ( ((( unsigned int ) src | ( unsigned int ) dst |
+               ( unsigned int ) &_rom_data_end ) & 3 ) == 0 ) {
+            unsigned int *wsrc = ( unsigned int * ) src;
+            unsigned int *wdst = ( unsigned int * ) dst;
+            unsigned int *wend = ( unsigned int * ) &_rom_data_end;
+            while ( wdst + 4 <= wend ) {
+                wdst[0] = wsrc[0];
+                wdst[1] = wsrc[1];
+                wdst[2] = wsrc[2];
+                wdst[3] = wsrc[3];
+                wdst += 4;
+                wsrc += 4;
+            }
+            while ( wdst < wend ) {
+                *wdst++ = *wsrc++;
+            }
+        } else {
+            while ( dst < &_rom_data_end ) {
+                *dst++ = *src++;
+            }
         }
     }
 
-    /* Clear ROM bss */
-    for ( unsigned char *dst = &_rom_bss_start; dst < &_rom_bss_end; dst++) {
-        *dst = 0;
+    {
+        /* Clear ROM bss */
+        unsigned char *dst = &_rom_bss_start;
+        if (((( unsigned int ) dst | ( unsigned int ) &_rom_bss_end ) & 3 ) == 0 ) {
+            unsigned int *wdst = ( unsigned int * ) dst;
+            unsigned int *wend = ( unsigned int * ) &_rom_bss_end;
+            while ( wdst + 4 <= wend ) {
+                wdst[0] = 0;
+                wdst[1] = 0;
+                wdst[2] = 0;
+                wdst[3] = 0;
+                wdst += 4;
+            }
+            while ( wdst < wend ) {
+                *wdst++ = 0;
+            }
+        } else {
+            for ( ; dst < &_rom_bss_end; dst++) {
+                *dst = 0;
+            }
+        }
     }
 }
+
+int data_init_check () {
+    return ( _data_init_magic == DATA_INIT_MAGIC ) && ( _bss_init_magic == 0 );
+}
+
+/* mot de demarrage a chaud : hors .data/.bss (au dessus de _stack_top, cf
+   mk_ld.sh), donc conserve par un reset du LEON mais remis a 0 par la
+   configuration du FPGA */
+extern volatile unsigned int _boot_warm_flag;
+
+int boot_is_warm () {
+    return ( _boot_warm_flag == BOOT_WARM_MAGIC );
+}
+
+void boot_set_warm ( int warm ) {
+    _boot_warm_flag = warm ? BOOT_WARM_MAGIC : 0;
+}
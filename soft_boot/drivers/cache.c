@@ -0,0 +1,110 @@
+#include "cache.h"
+#include "leon.h"
+
+static void cache_wait_flush ()
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+
+  while ( hw->cachectrl & ( CCR_IP | CCR_DP )) {
+  }
+}
+
+void cache_flush_i ()
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+
+  hw->cachectrl |= CCR_FI;
+  cache_wait_flush ();
+}
+
+void cache_flush_d ()
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+
+  hw->cachectrl |= CCR_FD;
+  cache_wait_flush ();
+}
+
+void cache_flush ()
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+
+  hw->cachectrl |= CCR_FI | CCR_FD;
+  cache_wait_flush ();
+}
+
+void cache_enable ( int flags )
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+  uint32_t ctrl = 0;
+
+  if ( flags & CACHE_I )     ctrl |= CCR_ICS_ENA;
+  if ( flags & CACHE_D )     ctrl |= CCR_DCS_ENA;
+  if ( flags & CACHE_BURST ) ctrl |= CCR_IB;
+  if ( flags & CACHE_SNOOP ) ctrl |= CCR_DS;
+
+  cache_flush ();
+  hw->cachectrl = ctrl;
+}
+
+void cache_disable ()
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+
+  hw->cachectrl = CCR_ICS_DIS | CCR_DCS_DIS;
+  cache_flush ();
+}
+
+uint32_t cache_get_ctrl ()
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+
+  return hw->cachectrl;
+}
+
+void cache_set_ctrl ( uint32_t ctrl )
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+
+  hw->cachectrl = ctrl & ~( CCR_IP | CCR_DP | CCR_FI | CCR_FD );
+}
+
+#define CACHE_TEST_WORDS 32
+
+uint32_t cache_test_buf[CACHE_TEST_WORDS];
+
+int cache_selftest ()
+{
+  uint32_t ctrl, i, pattern;
+  int err = 0;
+
+  ctrl = cache_get_ctrl ();
+
+  /* 1 : le dcache est bien actif */
+  if (( ctrl & CCR_DCS_MSK ) != CCR_DCS_ENA)
+    err |= 0x1;
+
+  /* 2 : ecriture (write-through) puis relecture cache / hors cache */
+  for (i=0; i<CACHE_TEST_WORDS; i++)
+    cache_test_buf[i] = 0xa5a50000 ^ ( i * 0x01010101 );
+  for (i=0; i<CACHE_TEST_WORDS; i++) {
+    pattern = 0xa5a50000 ^ ( i * 0x01010101 );
+    if (cache_test_buf[i] != pattern)
+      err |= 0x2;
+    if (load_nocache ( &cache_test_buf[i] ) != pattern)
+      err |= 0x4;
+  }
+
+  /* 3 : apres un flush, les donnees relues viennent de la RAM */
+  cache_flush_d ();
+  for (i=0; i<CACHE_TEST_WORDS; i++) {
+    if (cache_test_buf[i] != ( 0xa5a50000 ^ ( i * 0x01010101 )))
+      err |= 0x8;
+  }
+
+  /* 4 : le flush se termine (bits IP/DP retombes) */
+  if (cache_get_ctrl () & ( CCR_IP | CCR_DP ))
+    err |= 0x10;
+
+  return err;
+}
@@ -0,0 +1,248 @@
+#include "hwmath.h"
+#include "robot_leon.h"
+
+#define HWMATH_FREE        0
+#define HWMATH_WAIT        1 /* dans la file */
+#define HWMATH_RUN         2 /* calcul en cours dans le bloc */
+#define HWMATH_DONE        3
+
+/* ~40 cycles de calcul, une lecture APB en prend plusieurs : au dela, le
+   bloc est considere comme absent (ou bloque) */
+#define HWMATH_WAIT_POLLS  256
+
+typedef struct {
+  int state;
+  uint32_t seq;      /* ordre d'arrivee dans la file */
+  q15_48_t angle;
+  q15_48_t s;
+  q15_48_t c;
+} hwmath_op_t;
+
+hwmath_stats_t hwmath_stats;
+
+static hwmath_op_t hwmath_ops[HWMATH_QUEUE_LEN];
+static uint32_t hwmath_seq;
+static int hwmath_running; /* operation dans le bloc, -1 : bloc libre */
+static int hwmath_hw;
+
+static void hwmath_write64 ( int reg, q15_48_t v )
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  robot_reg[reg]   = ( uint32_t ) ( v >> 32 );
+  robot_reg[reg+1] = ( uint32_t ) v;
+}
+
+static q15_48_t hwmath_read64 ( int reg )
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+  uint32_t hi, lo;
+
+  hi = robot_reg[reg];
+  lo = robot_reg[reg+1];
+  return ( q15_48_t ) ((( uint64_t ) hi << 32 ) | lo );
+}
+
+static int hwmath_sincos_ready ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  return ( robot_reg[R_ROBOT_SINCOS_CS] & SINCOS_STATUS_DONE ) != 0;
+}
+
+static void hwmath_start ( int h )
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  hwmath_write64 ( R_ROBOT_SINCOS_ANGLE_H, hwmath_ops[h].angle );
+  robot_reg[R_ROBOT_SINCOS_CS] = SINCOS_CMD_START;
+  hwmath_ops[h].state = HWMATH_RUN;
+  hwmath_running = h;
+}
+
+static void hwmath_finish ( int h )
+{
+  hwmath_ops[h].s = hwmath_read64 ( R_ROBOT_SINCOS_SIN_H );
+  hwmath_ops[h].c = hwmath_read64 ( R_ROBOT_SINCOS_COS_H );
+  hwmath_ops[h].state = HWMATH_DONE;
+  hwmath_running = -1;
+  hwmath_stats.hw_ops++;
+}
+
+static void hwmath_soft ( int h )
+{
+  fxp_sincos_q48 ( hwmath_ops[h].angle, &hwmath_ops[h].s, &hwmath_ops[h].c );
+  hwmath_ops[h].state = HWMATH_DONE;
+  hwmath_stats.sw_ops++;
+}
+
+/* attente de fin du calcul en cours ; bloc bloque : passage en logiciel */
+static void hwmath_wait ()
+{
+  int h = hwmath_running;
+  int n;
+
+  for (n=0; n<HWMATH_WAIT_POLLS; n++) {
+    if (hwmath_sincos_ready ()) {
+      hwmath_finish ( h );
+      return;
+    }
+  }
+  hwmath_hw &= ~HWMATH_HW_SINCOS;
+  hwmath_running = -1;
+  hwmath_soft ( h );
+}
+
+/* plus ancienne operation en attente, -1 si aucune */
+static int hwmath_oldest ()
+{
+  int h, best = -1;
+
+  for (h=0; h<HWMATH_QUEUE_LEN; h++) {
+    if ((hwmath_ops[h].state == HWMATH_WAIT) &&
+        ((best < 0) || ((int)(hwmath_ops[h].seq - hwmath_ops[best].seq) < 0)))
+      best = h;
+  }
+  return best;
+}
+
+int hwmath_init ()
+{
+  q15_48_t c;
+  int h, n;
+
+  /* pas d'initialiseurs statiques (cf bug d'init de la section .data) */
+  for (h=0; h<HWMATH_QUEUE_LEN; h++)
+    hwmath_ops[h].state = HWMATH_FREE;
+  hwmath_seq = 0;
+  hwmath_running = -1;
+  hwmath_stats.hw_ops = 0;
+  hwmath_stats.sw_ops = 0;
+  hwmath_stats.full = 0;
+  hwmath_hw = 0;
+
+  /* multiplieur : 3.0 * -0.5 */
+  hwmath_write64 ( R_ROBOT_MUL64_OP1_H, 0x0003000000000000LL );
+  hwmath_write64 ( R_ROBOT_MUL64_OP2_H, -0x0000800000000000LL );
+  if (hwmath_read64 ( R_ROBOT_MUL64_RES_H ) == -0x0001800000000000LL)
+    hwmath_hw |= HWMATH_HW_MUL64;
+
+  /* sin/cos : cos(0) = 1.0 (les registres lisent 0 sans le bloc) */
+  hwmath_write64 ( R_ROBOT_SINCOS_ANGLE_H, 0 );
+  (( volatile uint32_t* ) ROBOT_BASE_ADDR)[R_ROBOT_SINCOS_CS] = SINCOS_CMD_START;
+  for (n=0; n<HWMATH_WAIT_POLLS; n++) {
+    if (hwmath_sincos_ready ()) {
+      c = hwmath_read64 ( R_ROBOT_SINCOS_COS_H ) - 0x0001000000000000LL;
+      if ((c > -0x1000000LL) && (c < 0x1000000LL))
+        hwmath_hw |= HWMATH_HW_SINCOS;
+      break;
+    }
+  }
+
+  return hwmath_hw;
+}
+
+int hwmath_present ()
+{
+  return hwmath_hw;
+}
+
+int hwmath_submit_sincos ( q15_48_t angle )
+{
+  int h;
+
+  for (h=0; h<HWMATH_QUEUE_LEN; h++) {
+    if (hwmath_ops[h].state == HWMATH_FREE)
+      break;
+  }
+  if (h == HWMATH_QUEUE_LEN) {
+    hwmath_stats.full++;
+    return -1;
+  }
+
+  hwmath_ops[h].angle = angle;
+  hwmath_ops[h].seq = hwmath_seq++;
+  hwmath_ops[h].state = HWMATH_WAIT;
+
+  if ((hwmath_hw & HWMATH_HW_SINCOS) == 0)
+    hwmath_soft ( h );
+  else if (hwmath_running < 0)
+    hwmath_start ( h );
+  return h;
+}
+
+void hwmath_poll ()
+{
+  int h;
+
+  if (hwmath_running >= 0) {
+    if (!hwmath_sincos_ready ())
+      return;
+    hwmath_finish ( hwmath_running );
+  }
+  h = hwmath_oldest ();
+  if (h >= 0) {
+    if (hwmath_hw & HWMATH_HW_SINCOS)
+      hwmath_start ( h );
+    else
+      hwmath_soft ( h );
+  }
+}
+
+int hwmath_done ( int h )
+{
+  if ((h == hwmath_running) && hwmath_sincos_ready ())
+    hwmath_finish ( h );
+  return hwmath_ops[h].state == HWMATH_DONE;
+}
+
+void hwmath_get_sincos ( int h, q15_48_t *s, q15_48_t *c )
+{
+  switch (hwmath_ops[h].state) {
+  case HWMATH_RUN:
+    hwmath_wait ();
+    break;
+  case HWMATH_WAIT:
+    /* bloc libre : ~40 cycles, moins que le calcul logiciel */
+    if ((hwmath_running < 0) && (hwmath_hw & HWMATH_HW_SINCOS)) {
+      hwmath_start ( h );
+      hwmath_wait ();
+    } else {
+      hwmath_soft ( h );
+    }
+    break;
+  default:
+    break;
+  }
+
+  if (s != NULL) *s = hwmath_ops[h].s;
+  if (c != NULL) *c = hwmath_ops[h].c;
+  hwmath_ops[h].state = HWMATH_FREE;
+}
+
+void hwmath_sincos ( q15_48_t angle, q15_48_t *s, q15_48_t *c )
+{
+  int h = hwmath_submit_sincos ( angle );
+
+  if (h < 0) {
+    fxp_sincos_q48 ( angle, s, c );
+    hwmath_stats.sw_ops++;
+    return;
+  }
+  hwmath_get_sincos ( h, s, c );
+}
+
+q15_48_t hwmath_mul ( q15_48_t a, q15_48_t b )
+{
+  if ((hwmath_hw & HWMATH_HW_MUL64) == 0) {
+    hwmath_stats.sw_ops++;
+    return fxp_mul_q48 ( a, b );
+  }
+
+  /* produit registre un cycle apres l'ecriture de op2 : deja pret a la
+     lecture APB suivante */
+  hwmath_write64 ( R_ROBOT_MUL64_OP1_H, a );
+  hwmath_write64 ( R_ROBOT_MUL64_OP2_H, b );
+  hwmath_stats.hw_ops++;
+  return hwmath_read64 ( R_ROBOT_MUL64_RES_H );
+}
@@ -0,0 +1,103 @@
+#include "loop_stats.h"
+#include "robot_leon.h"
+
+loop_stats_t loop_stats;
+
+void loop_stats_reset ()
+{
+  int i;
+
+  /* pas d'initialiseurs statiques (cf bug d'init de la section .data) */
+  loop_stats.count      = 0;
+  loop_stats.overruns   = 0;
+  loop_stats.exec_min   = 0xffffffff;
+  loop_stats.exec_max   = 0;
+  loop_stats.exec_mean  = 0;
+  loop_stats.slack_min  = 0x7fffffff;
+  loop_stats.slack_mean = 0;
+  loop_stats.late_max   = 0;
+  for (i=0; i<LOOP_STATS_NBINS; i++) {
+    loop_stats.exec_hist[i]  = 0;
+    loop_stats.slack_hist[i] = 0;
+  }
+  loop_stats.win_n     = 0;
+  loop_stats.win_exec  = 0;
+  loop_stats.win_slack = 0;
+}
+
+int loop_stats_bin ( uint32_t val )
+{
+  int bin = 0;
+
+  while ((val != 0) && (bin < LOOP_STATS_NBINS-1)) {
+    val = val >> 1;
+    bin++;
+  }
+  return bin;
+}
+
+void loop_stats_update ( uint32_t release, uint32_t start, uint32_t end,
+                         uint32_t deadline )
+{
+  uint32_t exec, late;
+  int slack;
+
+  /* differences signees : pas de probleme au rebouclage du timer */
+  exec  = end - start;
+  slack = (int)(deadline - end);
+  late  = ((int)(start - release) > 0) ? (start - release) : 0;
+
+  loop_stats.count++;
+  if (slack <= 0)
+    loop_stats.overruns++;
+
+  if (exec < loop_stats.exec_min) loop_stats.exec_min = exec;
+  if (exec > loop_stats.exec_max) loop_stats.exec_max = exec;
+  if (slack < loop_stats.slack_min) loop_stats.slack_min = slack;
+  if (late > loop_stats.late_max) loop_stats.late_max = late;
+
+  loop_stats.exec_hist[loop_stats_bin ( exec )]++;
+  if (slack <= 0)
+    loop_stats.slack_hist[0]++;
+  else
+    loop_stats.slack_hist[loop_stats_bin ( slack )]++;
+
+  /* moyennes par fenetre : pas de division 64 bits (pas de libgcc) */
+  loop_stats.win_exec  += exec;
+  loop_stats.win_slack += slack;
+  loop_stats.win_n++;
+  if (loop_stats.win_n == LOOP_STATS_WIN) {
+    loop_stats.exec_mean  = loop_stats.win_exec / LOOP_STATS_WIN;
+    loop_stats.slack_mean = loop_stats.win_slack / LOOP_STATS_WIN;
+    loop_stats.win_n     = 0;
+    loop_stats.win_exec  = 0;
+    loop_stats.win_slack = 0;
+  }
+
+  if ((loop_stats.count & (LOOP_STATS_PUBLISH-1)) == 0)
+    loop_stats_publish ();
+}
+
+void loop_stats_publish ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+  uint32_t h0, h1;
+  int i;
+
+  robot_reg[R_ROBOT_LOOP_COUNT]      = loop_stats.count;
+  robot_reg[R_ROBOT_LOOP_OVERRUNS]   = loop_stats.overruns;
+  robot_reg[R_ROBOT_LOOP_EXEC_MIN]   = loop_stats.exec_min;
+  robot_reg[R_ROBOT_LOOP_EXEC_MAX]   = loop_stats.exec_max;
+  robot_reg[R_ROBOT_LOOP_EXEC_MEAN]  = loop_stats.exec_mean;
+  robot_reg[R_ROBOT_LOOP_SLACK_MIN]  = loop_stats.slack_min;
+  robot_reg[R_ROBOT_LOOP_SLACK_MEAN] = loop_stats.slack_mean;
+  robot_reg[R_ROBOT_LOOP_LATE_MAX]   = loop_stats.late_max;
+
+  for (i=0; i<LOOP_STATS_NBINS/2; i++) {
+    h0 = loop_stats.exec_hist[2*i];
+    h1 = loop_stats.exec_hist[2*i+1];
+    if (h0 > 0xffff) h0 = 0xffff;
+    if (h1 > 0xffff) h1 = 0xffff;
+    robot_reg[R_ROBOT_LOOP_EXEC_HIST+i] = (h1<<16) | h0;
+  }
+}
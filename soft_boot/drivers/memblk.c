@@ -0,0 +1,214 @@
+#include "memblk.h"
+#include "uart.h"
+
+/* crc32 par quartets : 64 octets de table au lieu de 1 ko (ROM de 16 ko) */
+static const uint32_t crc32_tab[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+  0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+  0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+uint32_t crc32_update ( uint32_t crc, const uint8_t *buf, uint32_t len )
+{
+  crc = ~crc;
+  while (len--) {
+    crc ^= *buf++;
+    crc = crc32_tab[crc & 0x0f] ^ (crc >> 4);
+    crc = crc32_tab[crc & 0x0f] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+/* envoi avec checksum */
+static uint8_t memblk_csum;
+
+static void memblk_putchar ( uint8_t b )
+{
+  memblk_csum += b;
+  uart_putchar ( b );
+}
+
+static void memblk_putword ( uint32_t w )
+{
+  memblk_putchar ( (w>>24) & 0xff );
+  memblk_putchar ( (w>>16) & 0xff );
+  memblk_putchar ( (w>>8) & 0xff );
+  memblk_putchar ( w & 0xff );
+}
+
+static void memblk_send_header ( uint8_t op, uint8_t status, uint32_t n )
+{
+  uart_putchar ( MEMBLK_SYNC0 );
+  uart_putchar ( MEMBLK_SYNC1 );
+  memblk_csum = 0;
+  memblk_putchar ( op );
+  memblk_putchar ( status );
+  memblk_putword ( n );
+}
+
+void memblk_send_error ( uint8_t op, uint8_t status )
+{
+  uart_set_tx_blocking ( 1 );
+  memblk_send_header ( op, status, 0 );
+  uart_putchar ( memblk_csum );
+  uart_set_tx_blocking ( 0 );
+}
+
+/* RLE par mots : chaque mot n'est lu qu'une fois (registres APB a effet de
+   bord, ex : fifo de trace), les litteraux sont bufferises */
+#define MEMBLK_LIT_MAX  32
+#define MEMBLK_RUN_MAX  128
+
+static void memblk_flush_lit ( uint32_t *lit, int *nlit )
+{
+  int i;
+
+  if (*nlit==0) return;
+  memblk_putchar ( *nlit - 1 );
+  for (i=0; i<*nlit; i++)
+    memblk_putword ( lit[i] );
+  *nlit = 0;
+}
+
+static void memblk_send_rle ( volatile uint32_t *addr, uint32_t nwords )
+{
+  uint32_t lit[MEMBLK_LIT_MAX];
+  int nlit = 0;
+  uint32_t prev = 0;
+  uint32_t run = 0;
+  uint32_t w;
+  uint32_t i;
+
+  for (i=0; i<nwords; i++) {
+    w = addr[i];
+    if ((run!=0) && (w==prev)) {
+      run++;
+      if (run==MEMBLK_RUN_MAX) {
+        memblk_flush_lit ( lit, &nlit );
+        memblk_putchar ( 0x80 | (run-1) );
+        memblk_putword ( prev );
+        run = 0;
+      }
+      continue;
+    }
+    if (run>=2) {
+      memblk_flush_lit ( lit, &nlit );
+      memblk_putchar ( 0x80 | (run-1) );
+      memblk_putword ( prev );
+    } else if (run==1) {
+      lit[nlit++] = prev;
+      if (nlit==MEMBLK_LIT_MAX)
+        memblk_flush_lit ( lit, &nlit );
+    }
+    prev = w;
+    run = 1;
+  }
+
+  if (run>=2) {
+    memblk_flush_lit ( lit, &nlit );
+    memblk_putchar ( 0x80 | (run-1) );
+    memblk_putword ( prev );
+  } else if (run==1) {
+    lit[nlit++] = prev;
+  }
+  memblk_flush_lit ( lit, &nlit );
+}
+
+static uint32_t memblk_get_word ( uint8_t *p )
+{
+  return (p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3];
+}
+
+void memblk_cmd ( uint8_t *req )
+{
+  uint8_t op = req[0];
+  uint32_t addr = memblk_get_word ( req+1 );
+  uint32_t n    = memblk_get_word ( req+5 );
+  uint32_t arg  = memblk_get_word ( req+9 );
+  volatile uint32_t *src = ( volatile uint32_t * ) addr;
+  volatile uint32_t *dst = ( volatile uint32_t * ) arg;
+  uint8_t csum = 0;
+  uint32_t i;
+  int k;
+
+  for (k=0; k<MEMBLK_REQ_SZ-1; k++)
+    csum += req[k];
+  if (csum != req[MEMBLK_REQ_SZ-1]) {
+    memblk_send_error ( op, MEMBLK_ERR_CSUM );
+    return;
+  }
+
+  if ((addr & 3) || (n > MEMBLK_MAX_WORDS) ||
+      (((op==MEMBLK_OP_COPY) || (op==MEMBLK_OP_COMPARE)) && (arg & 3))) {
+    memblk_send_error ( op, MEMBLK_ERR_RANGE );
+    return;
+  }
+
+  uart_set_tx_blocking ( 1 );
+
+  switch (op) {
+  case MEMBLK_OP_DUMP:
+    memblk_send_header ( op, MEMBLK_OK, n );
+    memblk_send_rle ( src, n );
+    break;
+
+  case MEMBLK_OP_FILL:
+    for (i=0; i<n; i++)
+      src[i] = arg;
+    memblk_send_header ( op, MEMBLK_OK, 0 );
+    break;
+
+  case MEMBLK_OP_COPY:
+    /* addr -> arg, comme memmove */
+    if (dst < src) {
+      for (i=0; i<n; i++)
+        dst[i] = src[i];
+    } else if (dst > src) {
+      for (i=n; i>0; i--)
+        dst[i-1] = src[i-1];
+    }
+    memblk_send_header ( op, MEMBLK_OK, 0 );
+    break;
+
+  case MEMBLK_OP_CRC32:
+    {
+      uint32_t crc = 0;
+      uint8_t b[4];
+      for (i=0; i<n; i++) {
+        uint32_t w = src[i];
+        b[0] = w>>24;
+        b[1] = w>>16;
+        b[2] = w>>8;
+        b[3] = w;
+        crc = crc32_update ( crc, b, 4 );
+      }
+      memblk_send_header ( op, MEMBLK_OK, 1 );
+      memblk_putword ( crc );
+    }
+    break;
+
+  case MEMBLK_OP_COMPARE:
+    {
+      uint32_t ndiff = 0;
+      uint32_t first = 0xffffffff;
+      for (i=0; i<n; i++) {
+        if (src[i] != dst[i]) {
+          if (ndiff==0) first = i;
+          ndiff++;
+        }
+      }
+      memblk_send_header ( op, MEMBLK_OK, 2 );
+      memblk_putword ( ndiff );
+      memblk_putword ( first );
+    }
+    break;
+
+  default:
+    memblk_send_header ( op, MEMBLK_ERR_OP, 0 );
+    break;
+  }
+
+  uart_putchar ( memblk_csum );
+  uart_set_tx_blocking ( 0 );
+}
@@ -0,0 +1,61 @@
+#include "memops.h"
+
+void *memcpy ( void *dst, const void *src, size_t n )
+{
+  uint8_t *d = ( uint8_t * ) dst;
+  const uint8_t *s = ( const uint8_t * ) src;
+
+  if (((( uint32_t ) d | ( uint32_t ) s ) & 3 ) == 0) {
+    uint32_t *dw = ( uint32_t * ) d;
+    const uint32_t *sw = ( const uint32_t * ) s;
+
+    while (n >= 16) {
+      dw[0] = sw[0];
+      dw[1] = sw[1];
+      dw[2] = sw[2];
+      dw[3] = sw[3];
+      dw += 4;
+      sw += 4;
+      n -= 16;
+    }
+    while (n >= 4) {
+      *dw++ = *sw++;
+      n -= 4;
+    }
+    d = ( uint8_t * ) dw;
+    s = ( const uint8_t * ) sw;
+  }
+
+  while (n > 0) {
+    *d++ = *s++;
+    n--;
+  }
+
+  return dst;
+}
+
+void *memset ( void *dst, int c, size_t n )
+{
+  uint8_t *d = ( uint8_t * ) dst;
+  uint32_t w;
+
+  if ((( uint32_t ) d & 3 ) == 0) {
+    uint32_t *dw = ( uint32_t * ) d;
+
+    w = c & 0xff;
+    w |= w << 8;
+    w |= w << 16;
+    while (n >= 4) {
+      *dw++ = w;
+      n -= 4;
+    }
+    d = ( uint8_t * ) dw;
+  }
+
+  while (n > 0) {
+    *d++ = c;
+    n--;
+  }
+
+  return dst;
+}
@@ -0,0 +1,270 @@
+#include "msi2c.h"
+#include "config.h"
+#include "leon.h"
+
+msi2c_engine_t msi2c_eng;
+msi2c_stats_t msi2c_stats;
+
+/* prochaine transaction dont le callback reste a appeler : les places de
+   la file ne sont rendues qu'apres le callback */
+static uint32_t msi2c_done_idx;
+
+/* surveillance du bus fige (msi2c_poll) */
+static uint32_t *msi2c_last_step;
+static uint32_t msi2c_last_t;
+
+typedef struct {
+  msi2c_xfer_t xfer;
+  uint8_t reg;
+  uint32_t period;     /* ticks, 0 = suspendu */
+  uint32_t count;      /* ticks avant la prochaine lecture */
+} msi2c_sample_t;
+
+static msi2c_sample_t msi2c_samples[MSI2C_SAMPLE_MAX];
+static int msi2c_nsamples;
+
+/* IT masquees (PIL 15) le temps de toucher a la file */
+static uint32_t msi2c_lock ()
+{
+  uint32_t psr;
+
+  asm volatile ( "mov %%psr, %0" : "=r" ( psr ));
+  asm volatile ( "mov %0, %%psr; nop; nop; nop"
+                 : : "r" ( psr | PSR_ICC_PIL ) : "memory", "cc" );
+  return psr;
+}
+
+static void msi2c_unlock ( uint32_t psr )
+{
+  uint32_t cur;
+
+  asm volatile ( "mov %%psr, %0" : "=r" ( cur ));
+  cur = ( cur & ~PSR_ICC_PIL ) | ( psr & PSR_ICC_PIL );
+  asm volatile ( "mov %0, %%psr; nop; nop; nop"
+                 : : "r" ( cur ) : "memory", "cc" );
+}
+
+/* lance la transaction suivante de la file (IT masquees, bus au repos) :
+   meme chose que la fin de msi2c_irq_handler */
+static void msi2c_start_next ()
+{
+  volatile uint32_t* i2c_reg = ( volatile uint32_t* ) MSI2C_BASE_ADDR;
+  msi2c_xfer_t *x;
+  uint32_t s;
+
+  if (msi2c_eng.head == msi2c_eng.tail) {
+    msi2c_eng.step = 0;
+    return;
+  }
+  x = msi2c_eng.queue[msi2c_eng.head];
+  msi2c_eng.head = ( msi2c_eng.head + 1 ) & ( MSI2C_QUEUE_LEN - 1 );
+  msi2c_eng.cur  = x;
+  msi2c_eng.rx   = x->rbuf;
+  msi2c_eng.step = &x->steps[0];
+  x->status = MSI2C_RUN;
+
+  s = x->steps[0];
+  i2c_reg[R_MSI2C_TXR] = ( s & MSI2C_STEP_TX ) >> MSI2C_STEP_TX_SHIFT;
+  i2c_reg[R_MSI2C_CR]  = ( s & MSI2C_STEP_CR ) | MSI2C_CR_IACK;
+}
+
+void msi2c_init ( uint32_t scl_khz )
+{
+  volatile uint32_t* i2c_reg = ( volatile uint32_t* ) MSI2C_BASE_ADDR;
+  uint32_t prer;
+  int i;
+
+  /* pas d'initialiseurs statiques (cf bug d'init de la section .data) */
+  msi2c_eng.step = 0;
+  msi2c_eng.rx   = 0;
+  msi2c_eng.cur  = 0;
+  msi2c_eng.head = 0;
+  msi2c_eng.tail = 0;
+  msi2c_eng.irq  = 0;
+  for (i=0; i<MSI2C_QUEUE_LEN; i++)
+    msi2c_eng.queue[i] = 0;
+  msi2c_done_idx  = 0;
+  msi2c_last_step = 0;
+  msi2c_last_t    = 0;
+  msi2c_nsamples  = 0;
+
+  msi2c_stats.xfers   = 0;
+  msi2c_stats.nack    = 0;
+  msi2c_stats.al      = 0;
+  msi2c_stats.timeout = 0;
+  msi2c_stats.full    = 0;
+  msi2c_stats.skipped = 0;
+
+  if (scl_khz == 0) scl_khz = 100;
+  prer = CPU_FREQUENCY / ( 5 * 1000 * scl_khz ) - 1;
+
+  /* le prediviseur ne s'ecrit que coeur arrete */
+  i2c_reg[R_MSI2C_CTR]     = 0;
+  i2c_reg[R_MSI2C_PRER_LO] = prer & 0xff;
+  i2c_reg[R_MSI2C_PRER_HI] = ( prer >> 8 ) & 0xff;
+  i2c_reg[R_MSI2C_CTR]     = MSI2C_CTR_EN | MSI2C_CTR_IEN;
+  i2c_reg[R_MSI2C_CR]      = MSI2C_CR_IACK;
+}
+
+int msi2c_xfer_init ( msi2c_xfer_t *xfer, uint8_t addr,
+                      const uint8_t *wbuf, int wlen,
+                      uint8_t *rbuf, int rlen,
+                      msi2c_cb_t cb, void *arg )
+{
+  uint32_t *s = xfer->steps;
+  int i;
+
+  if ((wlen < 0) || (rlen < 0) || (wlen + rlen > MSI2C_MAX_DATA))
+    return -1;
+
+  xfer->status = MSI2C_DONE;
+  xfer->queued = 0;
+  xfer->rbuf   = rbuf;
+  xfer->addr   = addr;
+  xfer->wlen   = wlen;
+  xfer->rlen   = rlen;
+  xfer->cb     = cb;
+  xfer->arg    = arg;
+
+  /* ecriture (ou simple test de presence si rien a lire) */
+  if ((wlen > 0) || (rlen == 0)) {
+    *s++ = MSI2C_CR_STA | MSI2C_CR_WR | MSI2C_STEP_CHKACK |
+      (( addr << 1 ) << MSI2C_STEP_TX_SHIFT ) |
+      ((( wlen == 0 ) && ( rlen == 0 )) ? MSI2C_CR_STO : 0 );
+    for (i=0; i<wlen; i++)
+      *s++ = MSI2C_CR_WR | MSI2C_STEP_CHKACK |
+        ( wbuf[i] << MSI2C_STEP_TX_SHIFT ) |
+        ((( i == wlen - 1 ) && ( rlen == 0 )) ? MSI2C_CR_STO : 0 );
+  }
+
+  /* lecture, apres un START repete si on vient d'ecrire */
+  if (rlen > 0) {
+    *s++ = MSI2C_CR_STA | MSI2C_CR_WR | MSI2C_STEP_CHKACK |
+      ((( addr << 1 ) | 1 ) << MSI2C_STEP_TX_SHIFT );
+    for (i=0; i<rlen; i++)
+      *s++ = MSI2C_CR_RD | MSI2C_STEP_RX |
+        (( i == rlen - 1 ) ? ( MSI2C_CR_NACK | MSI2C_CR_STO ) : 0 );
+  }
+
+  *s = 0;
+  return 0;
+}
+
+int msi2c_submit ( msi2c_xfer_t *xfer )
+{
+  uint32_t psr;
+
+  if (xfer->queued)
+    return -1;
+  if ((( msi2c_eng.tail + 1 ) & ( MSI2C_QUEUE_LEN - 1 )) == msi2c_done_idx) {
+    msi2c_stats.full++;
+    return -1;
+  }
+
+  xfer->queued = 1;
+  xfer->status = MSI2C_QUEUED;
+
+  psr = msi2c_lock ();
+  msi2c_eng.queue[msi2c_eng.tail] = xfer;
+  msi2c_eng.tail = ( msi2c_eng.tail + 1 ) & ( MSI2C_QUEUE_LEN - 1 );
+  if (msi2c_eng.step == 0)
+    msi2c_start_next ();
+  msi2c_unlock ( psr );
+
+  return 0;
+}
+
+int msi2c_done ( msi2c_xfer_t *xfer )
+{
+  return xfer->status <= 0;
+}
+
+void msi2c_poll ( uint32_t now )
+{
+  volatile uint32_t* i2c_reg = ( volatile uint32_t* ) MSI2C_BASE_ADDR;
+  msi2c_xfer_t *x;
+  uint32_t psr;
+
+  /* bus fige (esclave qui tient SCL, IT perdue) : on arrete le coeur et
+     on passe a la suite
+     FIXME : TODO : 9 coups d'horloge pour liberer un esclave qui tient SDA */
+  if (msi2c_eng.step != msi2c_last_step) {
+    msi2c_last_step = msi2c_eng.step;
+    msi2c_last_t    = now;
+  } else if ((msi2c_last_step != 0) &&
+             (now - msi2c_last_t > MSI2C_TIMEOUT_US)) {
+    psr = msi2c_lock ();
+    if (msi2c_eng.step == msi2c_last_step) {
+      i2c_reg[R_MSI2C_CTR] = 0;
+      i2c_reg[R_MSI2C_CTR] = MSI2C_CTR_EN | MSI2C_CTR_IEN;
+      msi2c_eng.cur->status = MSI2C_ERR_TIMEOUT;
+      msi2c_start_next ();
+    }
+    msi2c_unlock ( psr );
+    msi2c_last_step = msi2c_eng.step;
+    msi2c_last_t    = now;
+  }
+
+  /* callbacks, dans l'ordre de la file */
+  while (msi2c_done_idx != msi2c_eng.head) {
+    x = msi2c_eng.queue[msi2c_done_idx];
+    if (x->status > 0)
+      break;
+
+    switch (x->status) {
+    case MSI2C_DONE:        msi2c_stats.xfers++;   break;
+    case MSI2C_ERR_NACK:    msi2c_stats.nack++;    break;
+    case MSI2C_ERR_AL:      msi2c_stats.al++;      break;
+    case MSI2C_ERR_TIMEOUT: msi2c_stats.timeout++; break;
+    }
+
+    msi2c_done_idx = ( msi2c_done_idx + 1 ) & ( MSI2C_QUEUE_LEN - 1 );
+    x->queued = 0;
+    if (x->cb)
+      x->cb ( x );
+  }
+}
+
+int msi2c_sample_add ( uint8_t addr, uint8_t reg, uint8_t *rbuf, int rlen,
+                       uint32_t period, msi2c_cb_t cb, void *arg )
+{
+  msi2c_sample_t *p;
+
+  if (msi2c_nsamples >= MSI2C_SAMPLE_MAX)
+    return -1;
+
+  p = &msi2c_samples[msi2c_nsamples];
+  p->reg = reg;
+  if (msi2c_xfer_init ( &p->xfer, addr, &p->reg, 1, rbuf, rlen, cb, arg ) < 0)
+    return -1;
+  p->period = period;
+  p->count  = period;
+
+  return msi2c_nsamples++;
+}
+
+void msi2c_sample_set_period ( int id, uint32_t period )
+{
+  if ((id < 0) || (id >= msi2c_nsamples))
+    return;
+  msi2c_samples[id].period = period;
+  msi2c_samples[id].count  = period;
+}
+
+void msi2c_sample_tick ()
+{
+  msi2c_sample_t *p;
+  int i;
+
+  for (i=0; i<msi2c_nsamples; i++) {
+    p = &msi2c_samples[i];
+    if ((p->period == 0) || (--p->count != 0))
+      continue;
+    p->count = p->period;
+
+    /* lecture precedente pas finie (ou callback pas encore appele) : on
+       saute celle-ci plutot que d'attendre */
+    if (p->xfer.queued || (msi2c_submit ( &p->xfer ) < 0))
+      msi2c_stats.skipped++;
+  }
+}
@@ -0,0 +1,126 @@
+#include "sched.h"
+#include "robot_leon.h"
+
+sched_task_t sched_tasks[SCHED_MAX_TASKS];
+int sched_ntasks;
+
+/* prochaine tache de fond a executer (tourniquet) */
+static int sched_bg_idx;
+
+static uint32_t sched_now ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  return robot_reg[R_ROBOT_TIMER];
+}
+
+void sched_init ()
+{
+  /* pas d'initialiseurs statiques (cf bug d'init de la section .data) */
+  sched_ntasks = 0;
+  sched_bg_idx = 0;
+}
+
+static int sched_new ( sched_task_fn_t fn, uint32_t period_us, int prio, int bg )
+{
+  sched_task_t *t;
+
+  if (sched_ntasks >= SCHED_MAX_TASKS)
+    return -1;
+
+  t = &sched_tasks[sched_ntasks];
+  t->fn       = fn;
+  t->period   = period_us;
+  t->next     = sched_now () + period_us;
+  t->runs     = 0;
+  t->overruns = 0;
+  t->missed   = 0;
+  t->prio     = prio;
+  t->bg       = bg;
+
+  return sched_ntasks++;
+}
+
+int sched_add ( sched_task_fn_t fn, uint32_t period_us, int prio )
+{
+  return sched_new ( fn, period_us, prio, 0 );
+}
+
+int sched_add_bg ( sched_task_fn_t fn )
+{
+  return sched_new ( fn, 0, 0, 1 );
+}
+
+void sched_set_period ( int id, uint32_t period_us )
+{
+  if ((id < 0) || (id >= sched_ntasks) || sched_tasks[id].bg)
+    return;
+  sched_tasks[id].period = period_us;
+  sched_tasks[id].next   = sched_now () + period_us;
+}
+
+void sched_start ( uint32_t now )
+{
+  int i;
+
+  for (i=0; i<sched_ntasks; i++)
+    sched_tasks[i].next = now + sched_tasks[i].period;
+}
+
+int sched_step ()
+{
+  int i, n;
+  uint32_t now, end, late;
+  sched_task_t *t;
+
+  now = sched_now ();
+
+  /* tache periodique prete la plus prioritaire */
+  t = 0;
+  for (i=0; i<sched_ntasks; i++) {
+    if (sched_tasks[i].bg || (sched_tasks[i].period == 0))
+      continue; /* tache de fond ou suspendue */
+    if ((int)(now - sched_tasks[i].next) < 0)
+      continue;
+    if ((t == 0) || (sched_tasks[i].prio < t->prio))
+      t = &sched_tasks[i];
+  }
+
+  if (t != 0) {
+    t->fn ( now );
+    t->runs++;
+
+    t->next += t->period;
+    end = sched_now ();
+    if ((int)(end - t->next) >= 0) {
+      /* depassement : on saute les activations manquees */
+      late = end - t->next;
+      n = late / t->period + 1;
+      t->overruns++;
+      t->missed += n;
+      t->next += n * t->period;
+    }
+    return 1;
+  }
+
+  /* temps libre : une tache de fond, a tour de role */
+  for (i=0; i<sched_ntasks; i++) {
+    if (sched_bg_idx >= sched_ntasks)
+      sched_bg_idx = 0;
+    t = &sched_tasks[sched_bg_idx++];
+    if (t->bg) {
+      t->fn ( now );
+      t->runs++;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+void sched_run ()
+{
+  for (;;) {
+    sched_step ();
+  }
+}
@@ -0,0 +1,215 @@
+#include "speed_pid.h"
+#include "config.h"
+#include "robot_leon.h"
+#include "trace.h"
+
+speed_pid_t speed_pid;
+
+static int32_t speed_pid_sat ( int64_t v )
+{
+  if (v > FXP_MAX) return FXP_MAX;
+  if (v < FXP_MIN) return FXP_MIN;
+  return ( int32_t ) v;
+}
+
+static uint32_t speed_pid_pack16 ( int32_t hi, int32_t lo )
+{
+  if (hi > 0x7fff) hi = 0x7fff;
+  if (hi < -0x8000) hi = -0x8000;
+  if (lo > 0x7fff) lo = 0x7fff;
+  if (lo < -0x8000) lo = -0x8000;
+  return (( uint32_t ) hi << 16 ) | (( uint32_t ) lo & 0xffff );
+}
+
+static void speed_pid_reset ()
+{
+  int i;
+
+  for (i=0; i<2; i++) {
+    speed_pid.w[i].integ = 0;
+    speed_pid.w[i].speed = 0;
+    speed_pid.w[i].err   = 0;
+    speed_pid.w[i].cmd   = 0;
+  }
+  speed_pid.primed = 0;
+}
+
+void speed_pid_init ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  /* pas d'initialiseurs statiques (cf bug d'init de la section .data) */
+  speed_pid.ctrl       = 0;
+  speed_pid.period     = SPID_PERIOD_DEF;
+  speed_pid.hz         = 1000000 / SPID_PERIOD_DEF;
+  speed_pid.kp         = 0;
+  speed_pid.ki_dt      = 0;
+  speed_pid.kd_hz      = 0;
+  speed_pid.kff        = 0;
+  speed_pid.out_max    = SPID_OUT_MAX;
+  speed_pid.ticks      = 0;
+  speed_pid.sat        = 0;
+  speed_pid.trace_drop = 0;
+  speed_pid_reset ();
+
+  robot_reg[R_ROBOT_SPID_CTRL]    = 0;
+  robot_reg[R_ROBOT_SPID_PERIOD]  = SPID_PERIOD_DEF;
+  robot_reg[R_ROBOT_SPID_KP]      = 0;
+  robot_reg[R_ROBOT_SPID_KI]      = 0;
+  robot_reg[R_ROBOT_SPID_KD]      = 0;
+  robot_reg[R_ROBOT_SPID_KFF]     = 0;
+  robot_reg[R_ROBOT_SPID_OUT_MAX] = SPID_OUT_MAX;
+  robot_reg[R_ROBOT_SPID_SP_1]    = 0;
+  robot_reg[R_ROBOT_SPID_SP_2]    = 0;
+  robot_reg[R_ROBOT_SPID_ERR]     = 0;
+  robot_reg[R_ROBOT_SPID_CMD]     = 0;
+  robot_reg[R_ROBOT_SPID_TICKS]   = 0;
+  robot_reg[R_ROBOT_SPID_SAT]     = 0;
+  robot_reg[R_ROBOT_SPID_TRACE_DROP] = 0;
+  robot_reg[R_ROBOT_SPID_STATUS]  = 0;
+}
+
+uint32_t speed_pid_config ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+  uint32_t ctrl, period, ret = 0;
+  int32_t out_max;
+
+  ctrl = robot_reg[R_ROBOT_SPID_CTRL];
+  if (ctrl == speed_pid.ctrl)
+    return 0;
+
+  period = robot_reg[R_ROBOT_SPID_PERIOD];
+  if (period < SPID_PERIOD_MIN) period = SPID_PERIOD_MIN;
+  if (period > SPID_PERIOD_MAX) period = SPID_PERIOD_MAX;
+  if (period != speed_pid.period) {
+    speed_pid.period = period;
+    speed_pid.hz = 1000000 / period;
+    ret = period;
+  }
+
+  out_max = robot_reg[R_ROBOT_SPID_OUT_MAX];
+  if ((out_max <= 0) || (out_max > SPID_OUT_MAX))
+    out_max = SPID_OUT_MAX;
+  speed_pid.out_max = out_max;
+
+  speed_pid.kp  = robot_reg[R_ROBOT_SPID_KP];
+  speed_pid.kff = robot_reg[R_ROBOT_SPID_KFF];
+  /* ki * T : Q16.16 x T en s Q.31 (2^31/10^6 = 2147.484) -> Q8.24 */
+  speed_pid.ki_dt = speed_pid_sat (
+    fxp_smul64 ( robot_reg[R_ROBOT_SPID_KI],
+                 period * 2147 + ( period * 121 ) / 250 ) >> 23 );
+  speed_pid.kd_hz = speed_pid_sat (
+    fxp_smul64 ( robot_reg[R_ROBOT_SPID_KD], speed_pid.hz ));
+
+  /* marche/arret : integrales a zero, moteurs arretes */
+  if ((ctrl ^ speed_pid.ctrl) & SPID_CTRL_ENABLE) {
+    speed_pid_reset ();
+    robot_reg[R_ROBOT_MOTOR_1] = 0;
+    robot_reg[R_ROBOT_MOTOR_2] = 0;
+  }
+
+  speed_pid.ctrl = ctrl;
+  robot_reg[R_ROBOT_SPID_STATUS] = ctrl;
+  return ret;
+}
+
+static void speed_pid_wheel ( speed_pid_wheel_t *w, int32_t speed, int32_t sp )
+{
+  int32_t dmeas, err, lim;
+  q16_16_t u, di, integ;
+
+  dmeas = fxp_sub_sat ( speed, w->speed );
+  err = fxp_sub_sat ( sp, speed );
+  w->speed = speed;
+  w->err = err;
+
+  /* anticipation + P - D (sur la mesure : pas de pic aux changements de
+     consigne), en pwm Q16.16 */
+  u = speed_pid_sat ( fxp_smul64 ( speed_pid.kff, sp ));
+  u = fxp_add_sat ( u, speed_pid_sat ( fxp_smul64 ( speed_pid.kp, err )));
+  u = fxp_sub_sat ( u, speed_pid_sat ( fxp_smul64 ( speed_pid.kd_hz, dmeas )));
+
+  /* I : Q8.24 x increments/s -> Q16.16, bornee a la commande max */
+  lim = speed_pid.out_max << 16;
+  di = speed_pid_sat ( fxp_smul64 ( speed_pid.ki_dt, err ) >> 8 );
+  integ = fxp_add_sat ( w->integ, di );
+  if (integ > lim) integ = lim;
+  if (integ < -lim) integ = -lim;
+
+  /* saturation : l'integrale ne continue pas dans le sens de la butee */
+  u = fxp_add_sat ( u, integ );
+  if (u > lim) {
+    u = lim;
+    if (di > 0) integ = w->integ;
+    speed_pid.sat++;
+  } else if (u < -lim) {
+    u = -lim;
+    if (di < 0) integ = w->integ;
+    speed_pid.sat++;
+  }
+  w->integ = integ;
+  w->cmd = ( u + 0x8000 ) >> 16;
+}
+
+void speed_pid_step ( int32_t speed1, int32_t speed2, int32_t sp1, int32_t sp2 )
+{
+  speed_pid_wheel ( &speed_pid.w[0], speed1, sp1 );
+  speed_pid_wheel ( &speed_pid.w[1], speed2, sp2 );
+}
+
+/* vitesse du compteur (fronts par fenetre, Q16.16) -> increments/s */
+static int32_t speed_pid_read ( int reg, uint32_t win_hz )
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  return speed_pid_sat ( fxp_smul64 ( robot_reg[reg], win_hz ) >> 16 );
+}
+
+void speed_pid_update ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+  int32_t speed1, speed2;
+  uint32_t win_hz, err, cmd, dec;
+  uint32_t rec[3];
+
+  if ((speed_pid.ctrl & SPID_CTRL_ENABLE) == 0)
+    return;
+
+  win_hz = CPU_FREQUENCY / ( robot_reg[R_ROBOT_RC_SAMPLING] + 1 );
+  speed1 = speed_pid_read ( R_ROBOT_RC_SPEED_1, win_hz );
+  speed2 = speed_pid_read ( R_ROBOT_RC_SPEED_2, win_hz );
+  if (!speed_pid.primed) {
+    /* pas de derivee sur la premiere mesure */
+    speed_pid.w[0].speed = speed1;
+    speed_pid.w[1].speed = speed2;
+    speed_pid.primed = 1;
+    return;
+  }
+
+  speed_pid_step ( speed1, speed2,
+                   robot_reg[R_ROBOT_SPID_SP_1], robot_reg[R_ROBOT_SPID_SP_2] );
+  robot_reg[R_ROBOT_MOTOR_1] = speed_pid.w[0].cmd;
+  robot_reg[R_ROBOT_MOTOR_2] = speed_pid.w[1].cmd;
+  speed_pid.ticks++;
+
+  err = speed_pid_pack16 ( speed_pid.w[0].err, speed_pid.w[1].err );
+  cmd = speed_pid_pack16 ( speed_pid.w[0].cmd, speed_pid.w[1].cmd );
+  if (speed_pid.ctrl & SPID_CTRL_TRACE) {
+    dec = ( speed_pid.ctrl & SPID_CTRL_TRACE_DEC ) >> SPID_CTRL_TRACE_DEC_SHIFT;
+    if ((speed_pid.ticks & (( 1 << dec ) - 1 )) == 0) {
+      /* enregistrement entier ou rien : l'hote reste aligne */
+      rec[0] = speed_pid.ticks;
+      rec[1] = err;
+      rec[2] = cmd;
+      if (trace_push_record ( rec, 3 ) < 0)
+        speed_pid.trace_drop++;
+    }
+  }
+
+  robot_reg[R_ROBOT_SPID_ERR]   = err;
+  robot_reg[R_ROBOT_SPID_CMD]   = cmd;
+  robot_reg[R_ROBOT_SPID_TICKS] = speed_pid.ticks;
+  robot_reg[R_ROBOT_SPID_SAT]   = speed_pid.sat;
+  robot_reg[R_ROBOT_SPID_TRACE_DROP] = speed_pid.trace_drop;
+}
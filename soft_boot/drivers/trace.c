@@ -0,0 +1,92 @@
+#include "trace.h"
+#include "robot_leon.h"
+
+trace_stats_t trace_stats;
+
+volatile uint32_t trace_irq_count;
+
+/* I2C_TRACE_CTRL_IRQ_LEON si demandee par trace_config() */
+static uint32_t trace_irq_leon;
+
+void trace_init ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  /* pas d'initialiseurs statiques (cf bug d'init de la section .data) */
+  trace_stats.words    = 0;
+  trace_stats.drop     = 0;
+  trace_stats.records  = 0;
+  trace_stats.rec_drop = 0;
+  trace_irq_count      = 0;
+  trace_irq_leon       = 0;
+
+  robot_reg[R_ROBOT_I2C_TRACE_CTRL] = 0;
+  robot_reg[R_ROBOT_I2C_TRACE_OVF]  = 0;
+}
+
+void trace_config ( uint32_t watermark, uint32_t irq )
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  if (watermark > I2C_TRACE_DEPTH) watermark = I2C_TRACE_DEPTH;
+  trace_irq_leon = irq & I2C_TRACE_CTRL_IRQ_LEON;
+  robot_reg[R_ROBOT_I2C_TRACE_CTRL] =
+    ( watermark & I2C_TRACE_CTRL_WM ) |
+    ( irq & ( I2C_TRACE_CTRL_IRQ_LEON | I2C_TRACE_CTRL_IRQ_HOST ));
+}
+
+uint32_t trace_level ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  return ( robot_reg[R_ROBOT_I2C_TRACE_CS] & I2C_TRACE_LEVEL ) >>
+    I2C_TRACE_LEVEL_SHIFT;
+}
+
+int trace_push ( uint32_t word )
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+
+  if (robot_reg[R_ROBOT_I2C_TRACE_CS] & I2C_TRACE_FULL) {
+    trace_stats.drop++;
+    return -1;
+  }
+  robot_reg[R_ROBOT_I2C_TRACE_D] = word;
+  trace_stats.words++;
+  return 0;
+}
+
+int trace_push_record ( const uint32_t *words, int n )
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+  int i;
+
+  /* seul le LEON remplit la fifo, l'hote ne fait que la vider : la place
+     libre lue ici ne peut que grandir pendant l'ecriture */
+  if ((n <= 0) || (trace_level () + n > I2C_TRACE_DEPTH)) {
+    trace_stats.drop += n;
+    trace_stats.rec_drop++;
+    return -1;
+  }
+
+  for (i=0; i<n; i++)
+    robot_reg[R_ROBOT_I2C_TRACE_D] = words[i];
+  trace_stats.words += n;
+  trace_stats.records++;
+  return 0;
+}
+
+int trace_irq_rearm ()
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+  uint32_t ctrl;
+
+  if (!trace_irq_leon)
+    return 0;
+  ctrl = robot_reg[R_ROBOT_I2C_TRACE_CTRL];
+  if ((ctrl & I2C_TRACE_CTRL_IRQ_LEON) ||
+      (robot_reg[R_ROBOT_I2C_TRACE_CS] & I2C_TRACE_WM))
+    return 0;
+  robot_reg[R_ROBOT_I2C_TRACE_CTRL] = ctrl | I2C_TRACE_CTRL_IRQ_LEON;
+  return 1;
+}
@@ -0,0 +1,87 @@
+#include "ultrasound.h"
+#include "robot_leon.h"
+
+us_sensor_t us_sensors[US_NB_SENSORS];
+uint32_t us_state;
+uint32_t us_obstacle_count;
+
+static const int us_dist_reg[US_NB_SENSORS] = {
+  R_ROBOT_US1_DIST, R_ROBOT_US2_DIST, R_ROBOT_US3_DIST
+};
+
+static const int us_stamp_reg[US_NB_SENSORS] = {
+  R_ROBOT_US1_STAMP, R_ROBOT_US2_STAMP, R_ROBOT_US3_STAMP
+};
+
+void us_init ( uint32_t enable )
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+  int i;
+
+  /* pas d'initialiseurs statiques (cf bug d'init de la section .data) */
+  for (i=0; i<US_NB_SENSORS; i++) {
+    us_sensors[i].dist   = US_NO_ECHO;
+    us_sensors[i].age    = 0xffffffff;
+    us_sensors[i].thresh = US_MM_TO_CYCLES ( US_THRESH_DEF );
+  }
+  us_state          = 0;
+  us_obstacle_count = 0;
+
+  robot_reg[R_ROBOT_US_TIMEOUT] = US_TIMEOUT_DEF;
+  robot_reg[R_ROBOT_US_GUARD]   = US_GUARD_DEF;
+  robot_reg[R_ROBOT_US_CTRL]    = enable & US_CTRL_ENABLE;
+}
+
+void us_set_threshold ( int sensor, uint32_t mm )
+{
+  if ((sensor < 0) || (sensor >= US_NB_SENSORS))
+    return;
+  us_sensors[sensor].thresh = US_MM_TO_CYCLES ( mm );
+}
+
+uint32_t us_update ( uint32_t now )
+{
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+  uint32_t enable, state, stamp;
+  us_sensor_t *s;
+  int i;
+
+  enable = robot_reg[R_ROBOT_US_CTRL] & US_CTRL_ENABLE;
+  state = 0;
+
+  for (i=0; i<US_NB_SENSORS; i++) {
+    if (!(enable & ( 1 << i )))
+      continue;
+    s = &us_sensors[i];
+
+    /* date avant distance : une mesure qui arrive entre les deux lectures
+       parait juste un peu plus vieille */
+    stamp   = robot_reg[us_stamp_reg[i]];
+    s->dist = robot_reg[us_dist_reg[i]];
+    s->age  = now - stamp;
+
+    if ((stamp == 0) || ((int)s->age < 0) || (s->age > US_MAX_AGE_US))
+      state |= 1 << ( i + US_STATE_STALE_SHIFT );
+    else if ((s->thresh != 0) && (s->dist <= s->thresh))
+      state |= 1 << i;
+  }
+
+  if ((state & US_STATE_OBSTACLE) && !(us_state & US_STATE_OBSTACLE))
+    us_obstacle_count++;
+  us_state = state;
+
+  return state & US_STATE_OBSTACLE;
+}
+
+int32_t us_dist_mm ( int sensor )
+{
+  uint32_t d;
+
+  if ((sensor < 0) || (sensor >= US_NB_SENSORS))
+    return -1;
+  d = us_sensors[sensor].dist;
+  if (d == US_NO_ECHO)
+    return -1;
+  /* cycles / 145.77 */
+  return ( d / 25 ) * 1715 / 10000;
+}
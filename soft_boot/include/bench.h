@@ -0,0 +1,12 @@
+#ifndef __ROBOT_BENCH_H
+#define __ROBOT_BENCH_H
+
+/* Mesure des routines critiques avec R_ROBOT_TIMER (1 us) : impression
+   UART, analyse hexa, corps de la boucle de controle, mul/div,
+   memcpy/memset, virgule fixe (fxp.h), accelerateurs Q15.48 contre
+   logiciel (hwmath.h), puis corps de boucle et memcpy sans et avec caches.
+   Le rapport (us et cycles par appel) est envoye sur l'UART ; compile
+   seulement avec BENCH=1 (commande 'B' du moniteur). */
+void bench_run ();
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef __ROBOT_BOOT_H
+#define __ROBOT_BOOT_H
+
+/* valeur du temoin de .data (cf boot/init.c) */
+#define DATA_INIT_MAGIC 0x600d0da7
+
+/* verifie que .data a ete copiee depuis la ROM et .bss mise a zero
+
+   @return 1 si l'init est correcte, 0 sinon */
+int data_init_check ();
+
+/* valeur du mot de demarrage a chaud (cf boot/init.c) */
+#define BOOT_WARM_MAGIC 0xb0075a4e
+
+/* @return 1 si le mot de demarrage a chaud est arme (reset apres un
+   deverrouillage, ex : brown-out pendant un match), 0 sinon */
+int boot_is_warm ();
+
+/* arme (1) ou desarme (0) le demarrage a chaud */
+void boot_set_warm ( int warm );
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef __ROBOT_BOOTLDR_H
+#define __ROBOT_BOOTLDR_H
+
+#include "types.h"
+
+/* Chargeur binaire par l'UART (commande 'L' du moniteur, cf main.c).
+
+   L'image (ROM complete, 16 ko max) est recue dans la RAM libre au dela
+   des 8 ko utilises par le soft (cf mk_ld.sh, la RAM fait 32 ko), verifiee
+   par un crc32 global, puis recopiee en ROM (rom32k, inscriptible) par une
+   routine executee depuis la RAM, et lancee au vecteur de reset.
+
+   Trames (les deux sens, big endian) :
+     [0]       0xa5
+     [1]       0x5c
+     [2]       type (BOOTLDR_T_xxx)
+     [3]       numero de sequence
+     [4..5]    longueur des donnees (<= BOOTLDR_MAX_PAYLOAD)
+     [6..]     donnees
+     [fin-3..] crc32 des octets [2..fin-4] (cf crc32_update())
+
+   Hote -> LEON :
+     'H'  hello (pas de donnees) ; reponse 'H' :
+          version, fenetre, taille max des donnees (2), adresse de la zone
+          de reception (4), taille max de l'image (4), scaler de l'UART (4)
+     'B'  changement de debit : [0] = enum uart_baudrate_t (BAUTOBAUD :
+          l'hote envoie des 0x55 au nouveau debit, mesures par le bloc
+          autobaud de l'UART), [1..4] = debit vise (indicatif, ignore par
+          le LEON). Acquitte ('A') a l'ancien debit, puis
+          l'hote doit envoyer une trame valide (ex : 'P') au nouveau debit
+          dans les BOOTLDR_BAUD_TIMEOUT us, sinon retour a 115200.
+     'P'  ping : reponse 'P' avec les memes donnees
+     'D'  donnees : [0..3] = offset dans l'image (multiple de 4), puis les
+          octets. Fenetre glissante "go-back-N" : l'hote peut envoyer
+          BOOTLDR_WINDOW trames sans attendre, chaque trame acceptee est
+          acquittee ('A', seq), une trame manquante ou corrompue provoque un
+          'N' avec la sequence attendue, et l'hote reprend a partir de la.
+     'V'  verification : [0..3] = taille de l'image, [4..7] = crc32 ;
+          reponse 'A' (crc calcule en donnees) ou 'N'
+     'G'  lancement (seulement apres un 'V' correct) : 'A' puis saut
+     'Q'  retour au moniteur (a 115200)
+
+   LEON -> hote : 'A' (acquittement), 'N' (refus, [0] = BOOTLDR_E_xxx)
+   et les reponses 'H' et 'P'. */
+
+#define BOOTLDR_SYNC0         0xa5
+#define BOOTLDR_SYNC1         0x5c
+#define BOOTLDR_VERSION       1
+
+#define BOOTLDR_T_HELLO       'H'
+#define BOOTLDR_T_BAUD        'B'
+#define BOOTLDR_T_PING        'P'
+#define BOOTLDR_T_DATA        'D'
+#define BOOTLDR_T_VERIFY      'V'
+#define BOOTLDR_T_GO          'G'
+#define BOOTLDR_T_QUIT        'Q'
+#define BOOTLDR_T_ACK         'A'
+#define BOOTLDR_T_NAK         'N'
+
+#define BOOTLDR_E_CRC         1 /* trame corrompue */
+#define BOOTLDR_E_SEQ         2 /* trame perdue : reprendre a seq */
+#define BOOTLDR_E_RANGE       3 /* offset/taille hors de l'image */
+#define BOOTLDR_E_VERIFY      4 /* crc de l'image faux */
+#define BOOTLDR_E_STATE       5 /* 'G' sans 'V' correct */
+#define BOOTLDR_E_TYPE        6 /* type inconnu */
+#define BOOTLDR_E_BAUD        7 /* autobaud non verrouille */
+
+#define BOOTLDR_MAX_PAYLOAD   (4+256)
+#define BOOTLDR_WINDOW        4
+
+#define BOOTLDR_STAGE_ADDR    0x40002000 /* __RAM_END du soft */
+#define BOOTLDR_STAGE_SIZE    0x4000     /* ROM de 16 ko */
+#define BOOTLDR_ROM_ADDR      0x00000000
+
+#define BOOTLDR_BAUD_TIMEOUT  2000000  /* us */
+#define BOOTLDR_IDLE_TIMEOUT  30000000 /* us sans trame valide : retour */
+
+/* boucle du chargeur : ne rend la main qu'apres 'Q' ou
+   BOOTLDR_IDLE_TIMEOUT, l'UART etant remise a 115200 ; ne revient pas
+   apres 'G' */
+void bootldr_run ();
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef __ROBOT_CACHE_H
+#define __ROBOT_CACHE_H
+
+#include "types.h"
+
+/* Cache Control Register */
+#define CCR_DCS_DIS ( 0x0 << 2 )
+#define CCR_DCS_FRZ ( 0x1 << 2 )
+#define CCR_DCS_ENA ( 0x3 << 2 )
+#define CCR_DCS_MSK ( 0x3 << 2 )
+#define CCR_ICS_DIS 0x0
+#define CCR_ICS_FRZ 0x1
+#define CCR_ICS_ENA 0x3
+#define CCR_ICS_MSK 0x3
+#define CCR_IF ( 1<<4 )  /* icache freeze on interrupt */
+#define CCR_DF ( 1<<5 )  /* dcache freeze on interrupt */
+#define CCR_DP ( 1<<14 ) /* dcache flush pending */
+#define CCR_IP ( 1<<15 ) /* icache flush pending */
+#define CCR_IB ( 1<<16 ) /* instruction burst fetch */
+#define CCR_FI ( 1<<21 ) /* flush icache */
+#define CCR_FD ( 1<<22 ) /* flush dcache */
+#define CCR_DS ( 1<<23 ) /* dcache snooping */
+
+/* ASI "forced cache miss" : lecture qui ne passe pas par le dcache */
+#define ASI_NOCACHE 0x1
+
+/* options de cache_enable() */
+#define CACHE_I     0x1
+#define CACHE_D     0x2
+#define CACHE_BURST 0x4 /* CCR_IB */
+#define CACHE_SNOOP 0x8 /* CCR_DS : sans effet si le dcache est synthetise
+                           sans snooping (dsnoop => none, leon_device.vhd) */
+#define CACHE_ALL   ( CACHE_I | CACHE_D | CACHE_BURST | CACHE_SNOOP )
+
+/* activer les caches (apres un flush)
+
+   @param[in] flags = combinaison de CACHE_xxx */
+void cache_enable ( int flags );
+
+/* desactiver les deux caches (le contenu est invalide) */
+void cache_disable ();
+
+/* invalider icache et dcache, attendre la fin du flush. A appeler avant
+   d'executer du code qui vient d'etre ecrit en RAM */
+void cache_flush ();
+void cache_flush_i ();
+void cache_flush_d ();
+
+/* valeur du Cache Control Register */
+uint32_t cache_get_ctrl ();
+
+/* restaurer une valeur lue par cache_get_ctrl() (les bits de flush sont
+   ignores) */
+void cache_set_ctrl ( uint32_t ctrl );
+
+/* verification au boot : ecriture/relecture d'un motif en RAM avec le
+   dcache actif, comparaison avec une relecture hors cache, puis controle
+   du flush
+
+   @return 0 si OK, sinon masque des tests en echec */
+int cache_selftest ();
+
+/* lecture 32 bits hors cache (ASI_NOCACHE). La fenetre APB (0x80000000)
+   n'est pas cachable sur le LEON2 : ces acces servent pour la RAM partagee
+   avec un autre maitre ou pour verifier le contenu reel de la memoire */
+static inline uint32_t load_nocache ( volatile uint32_t *addr )
+{
+  uint32_t val;
+
+  asm volatile ( "lda [%1] 1, %0" : "=r" ( val ) : "r" ( addr ) );
+  return val;
+}
+
+/* ecriture 32 bits : le dcache est en write-through, un st simple suffit,
+   la barriere empeche le compilateur de la deplacer */
+static inline void store_nocache ( volatile uint32_t *addr, uint32_t val )
+{
+  asm volatile ( "st %0, [%1]" : : "r" ( val ), "r" ( addr ) : "memory" );
+}
+
+#endif
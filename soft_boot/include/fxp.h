@@ -0,0 +1,168 @@
+#ifndef __ROBOT_FXP_H
+#define __ROBOT_FXP_H
+
+#include "types.h"
+
+/* Calcul en virgule fixe (pas de FPU, et -msoft-float sans libgcc : pas de
+   float ni de mul/div 64 bits en C dans le soft).
+
+   Formats (entiers signes, Qm.n = m bits entiers dont le signe, n bits de
+   fraction) :
+     q16_16_t   usage general (mm, mm/s, rad, gains), 1.0 = 0x00010000
+     q1_30_t    sin/cos, vecteurs unitaires, 1.0 = 0x40000000
+     q15_48_t   registres 64 bits du GPS (robot_gps_odo.vhd) et du bloc
+                sin_cos_cheby.vhd, cf tools/math/conv_double_to_q15_48.c
+     fxp_bam_t  angle binaire : 2^32 = 2 pi, le modulo est gratuit
+
+   Les produits passent par smul (32x32 -> 64, instruction v8) et les
+   quotients par sdiv (64/32, sature), sans appel a libgcc. Sans
+   saturation explicite (fxp_add_sat...), un depassement boucle comme en C.
+   Les cycles par routine sont mesures par la commande 'B' (BENCH=1). */
+
+typedef int32_t  q16_16_t;
+typedef int32_t  q1_30_t;
+typedef int64_t  q15_48_t;
+typedef uint32_t fxp_bam_t;
+
+#define Q16_16_ONE   0x00010000
+#define Q1_30_ONE    0x40000000
+#define FXP_MAX      0x7fffffff
+#define FXP_MIN      ( -0x7fffffff - 1 )
+
+#define Q16_16_PI    0x0003243f /* 3.14159 */
+#define Q16_16_PI_2  0x0001921f /* pi/2 */
+
+/* constantes seulement (calcul a la compilation) : Q16_16 ( 0.25 ) */
+#define Q16_16(x)    (( q16_16_t ) ((x) * 65536.0 + (((x) >= 0) ? 0.5 : -0.5)))
+#define Q1_30(x)     (( q1_30_t ) ((x) * 1073741824.0 + (((x) >= 0) ? 0.5 : -0.5)))
+
+/* produits 32x32 -> 64 */
+static inline int64_t fxp_smul64 ( int32_t a, int32_t b )
+{
+#ifdef __sparc__
+  int64_t r;
+
+  asm ( "smul %1, %2, %L0\n\trd %%y, %H0" : "=r" ( r ) : "r" ( a ), "r" ( b ));
+  return r;
+#else
+  return ( int64_t ) a * b;
+#endif
+}
+
+static inline uint64_t fxp_umul64 ( uint32_t a, uint32_t b )
+{
+#ifdef __sparc__
+  uint64_t r;
+
+  asm ( "umul %1, %2, %L0\n\trd %%y, %H0" : "=r" ( r ) : "r" ( a ), "r" ( b ));
+  return r;
+#else
+  return ( uint64_t ) a * b;
+#endif
+}
+
+/* produit de deux Qm.q, arrondi au plus pres, resultat dans le meme format
+   (les bits de poids fort au dela de 32 sont perdus)
+
+   @param[in] q = nombre de bits de fraction (constante, 1..31) */
+static inline int32_t fxp_mul_q ( int32_t a, int32_t b, int q )
+{
+#ifdef __sparc__
+  uint32_t lo;
+  int32_t hi;
+
+  asm ( "smul %2, %3, %0\n\t"
+        "rd %%y, %1\n\t"
+        "addcc %0, %4, %0\n\t"
+        "addx %1, 0, %1"
+        : "=&r" ( lo ), "=&r" ( hi )
+        : "r" ( a ), "r" ( b ), "r" ( 1 << (q-1) ) : "cc" );
+  return ( int32_t ) (( ( uint32_t ) hi << (32-q) ) | ( lo >> q ));
+#else
+  return ( int32_t ) (( ( int64_t ) a * b + ( 1LL << (q-1) )) >> q );
+#endif
+}
+
+#define fxp_mul(a, b)    fxp_mul_q ( (a), (b), 16 ) /* Q16.16 */
+
+/* Q1.30, ou Qm.n x Q1.30 -> Qm.n (ex : distance * cos) */
+#define fxp_mul30(a, b)  fxp_mul_q ( (a), (b), 30 )
+
+/* addition/soustraction saturees a FXP_MIN/FXP_MAX (tous formats 32 bits) */
+static inline int32_t fxp_add_sat ( int32_t a, int32_t b )
+{
+  int32_t s = ( int32_t ) (( uint32_t ) a + ( uint32_t ) b );
+
+  if ((( a ^ s ) & ( b ^ s )) < 0)
+    return ( a < 0 ) ? FXP_MIN : FXP_MAX;
+  return s;
+}
+
+static inline int32_t fxp_sub_sat ( int32_t a, int32_t b )
+{
+  int32_t s = ( int32_t ) (( uint32_t ) a - ( uint32_t ) b );
+
+  if ((( a ^ b ) & ( a ^ s )) < 0)
+    return ( a < 0 ) ? FXP_MIN : FXP_MAX;
+  return s;
+}
+
+/* conversions avec les registres 64 bits (arrondi, sans saturation) */
+static inline q16_16_t q15_48_to_q16_16 ( q15_48_t v )
+{
+  return ( q16_16_t ) (( v + 0x80000000LL ) >> 32 );
+}
+
+static inline q15_48_t q16_16_to_q15_48 ( q16_16_t v )
+{
+  return (( q15_48_t ) v ) << 32;
+}
+
+/* produit Q15.48, bit a bit comme le multiplieur du robot_apb (bits
+   111..48 du produit signe 128 bits, tronque) */
+q15_48_t fxp_mul_q48 ( q15_48_t a, q15_48_t b );
+
+/* division a/b de deux Qm.q, tronquee vers 0, saturee a FXP_MIN/FXP_MAX
+   (y compris b = 0, sans trap)
+
+   @param[in] q = nombre de bits de fraction (1..31) */
+int32_t fxp_div_q ( int32_t a, int32_t b, int q );
+
+#define fxp_div(a, b)    fxp_div_q ( (a), (b), 16 ) /* Q16.16 */
+
+/* racine carree Q16.16 (0 si x <= 0), erreur <= 1 lsb */
+q16_16_t fxp_sqrt ( q16_16_t x );
+
+/* angles : radians Q16.16 <-> angle binaire */
+fxp_bam_t fxp_rad_to_bam ( q16_16_t rad );
+
+/* @return angle dans [-pi, pi] */
+q16_16_t fxp_bam_to_rad ( fxp_bam_t bam );
+
+/* ramene un angle dans [-pi, pi] */
+q16_16_t fxp_angle_norm ( q16_16_t rad );
+
+/* sin et cos en Q1.30 (Chebyshev, memes coefficients que
+   sin_cos_cheby.vhd), erreur < 3e-8 (< 1e-7 depuis des radians Q16.16
+   de module < 100)
+
+   @param[in] bam = angle binaire
+   @param[out] s, c = sinus et cosinus (un des deux peut etre NULL) */
+void fxp_sincos_bam ( fxp_bam_t bam, q1_30_t *s, q1_30_t *c );
+
+/* @param[in] rad = angle en radians Q16.16, quelconque */
+void fxp_sincos ( q16_16_t rad, q1_30_t *s, q1_30_t *c );
+q1_30_t fxp_sin ( q16_16_t rad );
+q1_30_t fxp_cos ( q16_16_t rad );
+
+/* sin et cos d'un angle Q15.48 en radians, resultats en Q15.48 (meme
+   reduction que sin_cos_cheby.vhd, mais precision du calcul en Q1.30) */
+void fxp_sincos_q48 ( q15_48_t rad, q15_48_t *s, q15_48_t *c );
+
+/* atan2 par CORDIC (y et x dans le meme format, quelconque), erreur
+   < 1 lsb
+
+   @return angle en radians Q16.16 dans [-pi, pi], 0 pour (0, 0) */
+q16_16_t fxp_atan2 ( int32_t y, int32_t x );
+
+#endif
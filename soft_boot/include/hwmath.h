@@ -0,0 +1,68 @@
+#ifndef __ROBOT_HWMATH_H
+#define __ROBOT_HWMATH_H
+
+#include "types.h"
+#include "fxp.h"
+
+/* Accelerateurs de calcul du robot_apb (blocs de 2016) : multiplieur
+   Q15.48 (1 cycle, registres 0xb0..0xb5) et sin/cos Q15.48
+   (sin_cos_cheby.vhd, ~40 cycles, registres 0xb8..0xbd).
+
+   Les sin/cos passent par une file de HWMATH_QUEUE_LEN operations pour ne
+   pas attendre le bloc : hwmath_submit_sincos() rend la main aussitot,
+   hwmath_poll() (boucle principale) recupere le resultat du bloc et lance
+   l'operation suivante, hwmath_get() rend le resultat. Une operation
+   encore en attente derriere le bloc au moment du hwmath_get() est
+   calculee en logiciel (fxp.h), comme tout le reste quand les blocs sont
+   absents (bitstream sans accelerateurs : les registres lisent 0).
+
+   Le multiplieur est bit a bit identique a fxp_mul_q48() ; le sin/cos
+   logiciel est calcule en Q1.30 (ecart < 3e-8 avec le bloc). */
+
+#define HWMATH_QUEUE_LEN   8
+
+/* blocs presents (retour de hwmath_init) */
+#define HWMATH_HW_MUL64    0x00000001
+#define HWMATH_HW_SINCOS   0x00000002
+
+typedef struct {
+  uint32_t hw_ops;   /* operations calculees par les blocs */
+  uint32_t sw_ops;   /* operations calculees en logiciel */
+  uint32_t full;     /* hwmath_submit_sincos() refuses, file pleine */
+} hwmath_stats_t;
+
+extern hwmath_stats_t hwmath_stats;
+
+/* detection des blocs et remise a zero de la file
+
+   @return masque HWMATH_HW_xxx */
+int hwmath_init ();
+
+/* @return masque HWMATH_HW_xxx des blocs detectes par hwmath_init */
+int hwmath_present ();
+
+/* met un sin/cos dans la file, le lance si le bloc est libre
+
+   @param[in] angle = radians, quelconque
+   @return numero de l'operation (0..HWMATH_QUEUE_LEN-1), -1 si file pleine */
+int hwmath_submit_sincos ( q15_48_t angle );
+
+/* fin d'un calcul en cours, lancement du suivant (non bloquant) */
+void hwmath_poll ();
+
+/* @return 1 si le resultat de l'operation h est disponible sans calcul */
+int hwmath_done ( int h );
+
+/* resultat de l'operation h (libere l'entree) : attend le bloc si le
+   calcul est en cours, calcule en logiciel s'il n'est pas lance
+
+   @param[out] s, c = sinus et cosinus Q15.48 (un des deux peut etre NULL) */
+void hwmath_get_sincos ( int h, q15_48_t *s, q15_48_t *c );
+
+/* sin/cos immediat (bloc s'il est libre, logiciel sinon) */
+void hwmath_sincos ( q15_48_t angle, q15_48_t *s, q15_48_t *c );
+
+/* produit Q15.48 (bloc s'il est present, fxp_mul_q48 sinon) */
+q15_48_t hwmath_mul ( q15_48_t a, q15_48_t b );
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __ROBOT_LOOP_STATS_H
+#define __ROBOT_LOOP_STATS_H
+
+#include "types.h"
+
+/* Mesure de la boucle de controle : temps d'execution, marge (slack) avant
+   l'echeance suivante et retard de demarrage de chaque iteration, a partir
+   de R_ROBOT_TIMER (us). Les resultats sont publies dans les registres
+   R_ROBOT_LOOP_xxx (lisibles par SPI/I2C) et par la commande 'T' du
+   moniteur. */
+
+#define LOOP_STATS_NBINS   16
+#define LOOP_STATS_WIN     256 /* iterations par moyenne (puissance de 2) */
+#define LOOP_STATS_PUBLISH 16  /* iterations entre deux publications */
+
+typedef struct {
+  uint32_t count;
+  uint32_t overruns;
+  uint32_t exec_min;
+  uint32_t exec_max;
+  uint32_t exec_mean;
+  int slack_min;
+  int slack_mean;
+  uint32_t late_max;
+  uint32_t exec_hist[LOOP_STATS_NBINS];
+  uint32_t slack_hist[LOOP_STATS_NBINS]; /* classe 0 : slack <= 0 */
+
+  /* accumulateurs de la fenetre en cours */
+  uint32_t win_n;
+  uint32_t win_exec;
+  int win_slack;
+} loop_stats_t;
+
+extern loop_stats_t loop_stats;
+
+/* remise a zero */
+void loop_stats_reset ();
+
+/* fin d'une iteration
+
+   @param[in] release = date d'activation prevue
+   @param[in] start = date de debut effectif
+   @param[in] end = date de fin
+   @param[in] deadline = echeance (activation suivante) */
+void loop_stats_update ( uint32_t release, uint32_t start, uint32_t end,
+                         uint32_t deadline );
+
+/* recopie des statistiques dans les registres R_ROBOT_LOOP_xxx */
+void loop_stats_publish ();
+
+/* classe log2 d'une duree : 0 pour 0, k pour [2^(k-1), 2^k[ */
+int loop_stats_bin ( uint32_t val );
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __ROBOT_MEMBLK_H
+#define __ROBOT_MEMBLK_H
+
+#include "types.h"
+
+/* Commandes memoire par blocs du moniteur ('M', cf main.c) : dump, fill,
+   copy, crc32 et compare sur des mots de 32 bits.
+
+   Requete (binaire, big endian), apres le caractere 'M' :
+     [0]      operation (MEMBLK_OP_xxx)
+     [1..4]   adresse
+     [5..8]   nombre de mots
+     [9..12]  argument (valeur pour fill, 2eme adresse pour copy/compare)
+     [13]     checksum (somme des octets [0..12])
+
+   Reponse :
+     [0]      0xa5
+     [1]      0x5b
+     [2]      operation
+     [3]      statut (MEMBLK_OK, MEMBLK_ERR_xxx)
+     [4..7]   n : nombre de mots decrits par les donnees
+     [8..]    donnees
+     [fin]    checksum (somme des octets [2..fin-1])
+
+   Donnees selon l'operation :
+     dump     n mots codes en RLE (cf memblk_send_rle)
+     crc32    n=1 : crc32 (IEEE 802.3, comme zlib) des octets de la zone
+     compare  n=2 : nombre de mots differents, index du premier (ou
+              0xffffffff)
+     fill     n=0
+     copy     n=0 (recouvrement autorise)
+
+   RLE : suite d'enregistrements dont l'entete h vaut
+     h & 0x80 : (h & 0x7f)+1 repetitions du mot qui suit (4 octets)
+     sinon    : h+1 mots litteraux suivent
+*/
+
+#define MEMBLK_SYNC0       0xa5
+#define MEMBLK_SYNC1       0x5b
+#define MEMBLK_REQ_SZ      14
+
+#define MEMBLK_OP_DUMP     'd'
+#define MEMBLK_OP_FILL     'f'
+#define MEMBLK_OP_COPY     'c'
+#define MEMBLK_OP_CRC32    'k'
+#define MEMBLK_OP_COMPARE  'm'
+
+#define MEMBLK_OK          0
+#define MEMBLK_ERR_CSUM    1
+#define MEMBLK_ERR_OP      2
+#define MEMBLK_ERR_RANGE   3
+#define MEMBLK_ERR_TIMEOUT 4
+
+#define MEMBLK_MAX_WORDS   0x4000 /* 64k octets */
+
+/* crc32 (polynome reflechi 0xedb88320, table de 16 entrees)
+
+   @param[in] crc = crc precedent (0 pour commencer)
+   @param[in] buf = donnees
+   @param[in] len = nombre d'octets
+   @return crc mis a jour */
+uint32_t crc32_update ( uint32_t crc, const uint8_t *buf, uint32_t len );
+
+/* execute une requete et envoie la reponse sur l'UART, en mode bloquant
+   (un dump de plusieurs ko occupe l'UART pendant des centaines de ms) ; le
+   mode non bloquant de la boucle robot est retabli a la fin
+
+   @param[in] req = requete de MEMBLK_REQ_SZ octets */
+void memblk_cmd ( uint8_t *req );
+
+/* envoie une reponse vide avec un statut d'erreur
+
+   @param[in] op = operation
+   @param[in] status = MEMBLK_ERR_xxx */
+void memblk_send_error ( uint8_t op, uint8_t status );
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef __ROBOT_MEMOPS_H
+#define __ROBOT_MEMOPS_H
+
+#include "types.h"
+
+/* memcpy/memset minimalistes (-nostdlib) : gcc peut les appeler pour les
+   copies de structures, meme sans appel explicite dans le code */
+
+/* copie par mots de 32 bits si src et dst sont alignes, octet par octet
+   sinon */
+void *memcpy ( void *dst, const void *src, size_t n );
+
+void *memset ( void *dst, int c, size_t n );
+
+#endif
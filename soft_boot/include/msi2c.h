@@ -0,0 +1,184 @@
+#ifndef __ROBOT_MSI2C_H
+#define __ROBOT_MSI2C_H
+
+/* Maitre I2C msi2c (src/msi2c, i2c_master_top_apb : coeur OpenCores sur
+   l'APB, un octet par mot) pilote sous IT : la boucle n'attend jamais le
+   bus.
+
+   - msi2c_xfer_init() prepare une transaction : ecriture de wlen octets
+     puis lecture de rlen octets apres un START repete (l'un ou l'autre
+     peut etre vide), traduite en une suite d'etapes (commande + octet)
+   - msi2c_submit() la met dans la file (MSI2C_QUEUE_LEN transactions) et
+     rend la main aussitot
+   - msi2c_irq_handler (msi2c_it.S, IT niveau 11, trap 0x1b) enchaine les
+     etapes a chaque octet, puis les transactions de la file, sans passer
+     par la boucle
+   - msi2c_poll() (tache de fond) appelle les callbacks des transactions
+     terminees, dans l'ordre de la file, et debloque le bus si une
+     transaction reste figee plus de MSI2C_TIMEOUT_US
+
+   Les callbacks ne sont pas appeles sous IT : le handler tourne dans la
+   fenetre du trap, qui peut etre la fenetre invalide (WIM), avec ses seuls
+   %l et sans pile. Appeler du C demanderait un prologue qui teste WIM,
+   vide une fenetre comme le handler de debordement de trap.S, prend une
+   pile et reactive les traps (ET) ; on garde le sequencement des octets
+   en assembleur et les callbacks dans msi2c_poll().
+
+   Liste d'echantillonnage : msi2c_sample_add() declare une lecture de
+   capteur (registre + rlen octets) refaite tous les N ticks de la boucle
+   de controle par msi2c_sample_tick(), qui ne fait que mettre en file
+   (commande 'I' du moniteur, cf main.c). */
+
+/* i2c0 : apbo(22) (cf apbmst.vhd) */
+#define MSI2C_BASE_ADDR    0x80004380
+
+/* registres (octets de poids faible des mots) */
+#define R_MSI2C_PRER_LO    0x00 /* prediviseur : clk/(5*SCL) - 1 */
+#define R_MSI2C_PRER_HI    0x01
+#define R_MSI2C_CTR        0x02
+#define R_MSI2C_TXR        0x03 /* W */
+#define R_MSI2C_RXR        0x03 /* R */
+#define R_MSI2C_CR         0x04 /* W */
+#define R_MSI2C_SR         0x04 /* R */
+
+#define MSI2C_CTR_EN       0x80
+#define MSI2C_CTR_IEN      0x40
+
+#define MSI2C_CR_STA       0x80
+#define MSI2C_CR_STO       0x40
+#define MSI2C_CR_RD        0x20
+#define MSI2C_CR_WR        0x10
+#define MSI2C_CR_NACK      0x08 /* bit ACK : NACK apres l'octet lu */
+#define MSI2C_CR_IACK      0x01
+
+#define MSI2C_SR_RXACK     0x80 /* NACK recu */
+#define MSI2C_SR_BUSY      0x40
+#define MSI2C_SR_AL        0x20
+#define MSI2C_SR_TIP       0x02
+#define MSI2C_SR_IF        0x01
+
+/* etapes : commande CR, octet TXR, et quoi faire a la fin de l'etape
+   (0 : fin de la transaction) */
+#define MSI2C_STEP_CR        0x000000ff
+#define MSI2C_STEP_TX        0x0000ff00
+#define MSI2C_STEP_TX_SHIFT  8
+#define MSI2C_STEP_RX        0x00010000 /* ranger RXR */
+#define MSI2C_STEP_CHKACK    0x00020000 /* NACK de l'esclave : STOP, erreur */
+
+/* etat d'une transaction */
+#define MSI2C_DONE         0
+#define MSI2C_QUEUED       1
+#define MSI2C_RUN          2
+#define MSI2C_ERR_NACK     -1
+#define MSI2C_ERR_AL       -2 /* arbitrage perdu */
+#define MSI2C_ERR_TIMEOUT  -3
+
+#define MSI2C_QUEUE_LEN    16 /* puissance de 2 */
+#define MSI2C_MAX_DATA     16 /* octets ecrits + lus par transaction */
+#define MSI2C_MAX_STEPS    (MSI2C_MAX_DATA + 3)
+
+#define MSI2C_SAMPLE_MAX   8
+
+#define MSI2C_TIMEOUT_US   10000
+
+/* champs utilises par msi2c_it.S */
+#define MSI2C_XFER_STATUS  0
+#define MSI2C_XFER_RBUF    4
+#define MSI2C_XFER_STEPS   8
+
+#define MSI2C_ENG_STEP     0
+#define MSI2C_ENG_RX       4
+#define MSI2C_ENG_CUR      8
+#define MSI2C_ENG_HEAD     12
+#define MSI2C_ENG_TAIL     16
+#define MSI2C_ENG_IRQ      20
+#define MSI2C_ENG_QUEUE    24
+
+#ifndef __ASSEMBLER__
+
+#include "types.h"
+
+struct msi2c_xfer_s;
+
+typedef void ( *msi2c_cb_t ) ( struct msi2c_xfer_s *xfer );
+
+typedef struct msi2c_xfer_s {
+  volatile int32_t status;        /* MSI2C_xxx */
+  uint8_t *rbuf;                  /* octets lus */
+  uint32_t steps[MSI2C_MAX_STEPS];
+  uint8_t addr;                   /* adresse 7 bits */
+  uint8_t wlen;
+  uint8_t rlen;
+  uint8_t queued;                 /* dans la file, callback pas appele */
+  msi2c_cb_t cb;                  /* appele par msi2c_poll(), ou 0 */
+  void *arg;
+} msi2c_xfer_t;
+
+/* partage avec msi2c_irq_handler : ne pas changer l'ordre des champs */
+typedef struct {
+  uint32_t *step;                 /* etape en cours, 0 : au repos */
+  uint8_t *rx;                    /* prochain octet lu */
+  msi2c_xfer_t *cur;              /* transaction en cours */
+  uint32_t head;                  /* prochaine transaction a lancer */
+  uint32_t tail;                  /* prochaine place libre */
+  volatile uint32_t irq;          /* IT recues */
+  msi2c_xfer_t *queue[MSI2C_QUEUE_LEN];
+} msi2c_engine_t;
+
+extern msi2c_engine_t msi2c_eng;
+
+typedef struct {
+  uint32_t xfers;     /* transactions terminees */
+  uint32_t nack;
+  uint32_t al;
+  uint32_t timeout;
+  uint32_t full;      /* msi2c_submit() refuses, file pleine */
+  uint32_t skipped;   /* echantillons sautes, lecture precedente en cours */
+} msi2c_stats_t;
+
+extern msi2c_stats_t msi2c_stats;
+
+/* remise a zero de la file et de la liste d'echantillonnage, horloge SCL
+   et IT du coeur
+
+   @param[in] scl_khz = frequence SCL (100, 400) */
+void msi2c_init ( uint32_t scl_khz );
+
+/* prepare une transaction : START, adresse, wlen octets de wbuf (copies
+   dans les etapes), puis si rlen > 0 START repete, adresse, rlen octets
+   lus dans rbuf (NACK sur le dernier), STOP
+
+   @return 0, -1 si wlen + rlen > MSI2C_MAX_DATA */
+int msi2c_xfer_init ( msi2c_xfer_t *xfer, uint8_t addr,
+                      const uint8_t *wbuf, int wlen,
+                      uint8_t *rbuf, int rlen,
+                      msi2c_cb_t cb, void *arg );
+
+/* met une transaction preparee dans la file et la lance si le bus est
+   libre. La transaction ne doit pas etre modifiee avant son callback.
+
+   @return 0, -1 si la file est pleine ou la transaction deja en file */
+int msi2c_submit ( msi2c_xfer_t *xfer );
+
+/* @return 1 si la transaction est terminee (status <= 0) */
+int msi2c_done ( msi2c_xfer_t *xfer );
+
+/* callbacks des transactions terminees, deblocage du bus (tache de fond) */
+void msi2c_poll ( uint32_t now );
+
+/* ajoute une lecture periodique : registre reg puis rlen octets dans rbuf,
+   tous les period ticks (appels de msi2c_sample_tick)
+
+   @return numero de l'echantillon, -1 si la liste est pleine */
+int msi2c_sample_add ( uint8_t addr, uint8_t reg, uint8_t *rbuf, int rlen,
+                       uint32_t period, msi2c_cb_t cb, void *arg );
+
+/* change la periode d'un echantillon (0 : suspendu) */
+void msi2c_sample_set_period ( int id, uint32_t period );
+
+/* un tick de la boucle de controle : met en file les lectures echues */
+void msi2c_sample_tick ();
+
+#endif /* __ASSEMBLER__ */
+
+#endif
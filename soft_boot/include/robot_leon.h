@@ -18,11 +18,43 @@
 #define R_ROBOT_TIMER        0x00
 #define A_ROBOT_TIMER        0x0x80008000
 
-#define R_ROBOT_RESET        0x01
+#define R_ROBOT_RESET        0x01 /* W */
 #define A_ROBOT_RESET        0x80008004
 
+/* dip switches (meme adresse que R_ROBOT_RESET, en lecture) */
+#define R_ROBOT_GPIO         0x01 /* R: [3:0] DIP_SW_3..0 */
+#define A_ROBOT_GPIO         0x80008004
+
+#define ROBOT_GPIO_FAST_BOOT 0x00000001 /* DIP_SW_0 : pas de mot de passe */
+
+
+/* stepper (mode position, cf stepper_pololu.vhd) */
+#define R_ROBOT_STEPPER_CS     0x04 /* W: ctrl, R: status */
+#define A_ROBOT_STEPPER_CS     0x80008010
+
+#define R_ROBOT_STEPPER_TARGET 0x05
+#define A_ROBOT_STEPPER_TARGET 0x80008014
+
+#define R_ROBOT_STEPPER_PERIOD 0x06 /* [31:16] depart, [15:0] croisiere (us) */
+#define A_ROBOT_STEPPER_PERIOD 0x80008018
+
+#define R_ROBOT_STEPPER_ACCEL  0x07 /* us/pas */
+#define A_ROBOT_STEPPER_ACCEL  0x8000801c
+
+#define STEPPER_CTRL_ENABLE    0x00000001
+#define STEPPER_CTRL_RAZ       0x00000002
+
+#define STEPPER_STATUS_DONE    0x80000000
+#define STEPPER_STATUS_POS     0x0000ffff
+
 
 /* i2c slave interface */
+#define R_ROBOT_I2C_TRACE_CTRL 0x08 /* cf I2C_TRACE_CTRL_xxx */
+#define A_ROBOT_I2C_TRACE_CTRL 0x80008020
+
+#define R_ROBOT_I2C_TRACE_OVF  0x09 /* R: mots ecrits fifo pleine, W: raz */
+#define A_ROBOT_I2C_TRACE_OVF  0x80008024
+
 #define R_ROBOT_I2C_TRACE_CS 0x0c
 #define A_ROBOT_I2C_TRACE_CS 0x80008030
 
@@ -36,6 +68,71 @@
 #define A_ROBOT_I2C_BSTR_D   0x8000803c
 
 
+/* instantane de la pose et des compteurs 64 bits (Q15.48) : une ecriture
+   de SNAP_CS fige 0x11..0x1f ensemble (apres l'integration en cours de
+   robot_gps_odo), qui se relisent ensuite mot par mot sans valeur
+   dechiree */
+#define R_ROBOT_SNAP_CS        0x10 /* W: declenche, R: cf SNAP_STATUS_xxx */
+#define A_ROBOT_SNAP_CS        0x80008040
+
+#define R_ROBOT_SNAP_TIMER     0x11 /* R_ROBOT_TIMER a l'instant fige */
+#define A_ROBOT_SNAP_TIMER     0x80008044
+
+#define R_ROBOT_SNAP_X_H       0x12 /* mm */
+#define A_ROBOT_SNAP_X_H       0x80008048
+
+#define R_ROBOT_SNAP_X_L       0x13
+#define A_ROBOT_SNAP_X_L       0x8000804c
+
+#define R_ROBOT_SNAP_Y_H       0x14 /* mm */
+#define A_ROBOT_SNAP_Y_H       0x80008050
+
+#define R_ROBOT_SNAP_Y_L       0x15
+#define A_ROBOT_SNAP_Y_L       0x80008054
+
+#define R_ROBOT_SNAP_THETA_H   0x16 /* rad */
+#define A_ROBOT_SNAP_THETA_H   0x80008058
+
+#define R_ROBOT_SNAP_THETA_L   0x17
+#define A_ROBOT_SNAP_THETA_L   0x8000805c
+
+#define R_ROBOT_SNAP_CNT_TH_R_H 0x18 /* compteurs QuadratureCounter */
+#define A_ROBOT_SNAP_CNT_TH_R_H 0x80008060
+
+#define R_ROBOT_SNAP_CNT_R_R_H 0x1a
+#define A_ROBOT_SNAP_CNT_R_R_H 0x80008068
+
+#define R_ROBOT_SNAP_CNT_TH_L_H 0x1c
+#define A_ROBOT_SNAP_CNT_TH_L_H 0x80008070
+
+#define R_ROBOT_SNAP_CNT_R_L_H 0x1e
+#define A_ROBOT_SNAP_CNT_R_L_H 0x80008078
+
+#define SNAP_STATUS_SEQ        0x0000ffff /* instantanes pris */
+#define SNAP_STATUS_PENDING    0x80000000 /* integration en cours, attente */
+
+
+/* instantane capteurs (trame 's'/'S' du moniteur) : une ecriture de
+   SENS_CS fige 0x21..0x25 au meme cycle */
+#define R_ROBOT_SENS_CS        0x20 /* W: declenche, R: [15:0] instantanes pris */
+#define A_ROBOT_SENS_CS        0x80008080
+
+#define R_ROBOT_SENS_TIMER     0x21 /* R_ROBOT_TIMER */
+#define A_ROBOT_SENS_TIMER     0x80008084
+
+#define R_ROBOT_SENS_VAL_1     0x22 /* R_ROBOT_RC_VAL_1 */
+#define A_ROBOT_SENS_VAL_1     0x80008088
+
+#define R_ROBOT_SENS_VAL_2     0x23 /* R_ROBOT_RC_VAL_2 */
+#define A_ROBOT_SENS_VAL_2     0x8000808c
+
+#define R_ROBOT_SENS_SPEED_1   0x24 /* R_ROBOT_RC_SPEED_1 */
+#define A_ROBOT_SENS_SPEED_1   0x80008090
+
+#define R_ROBOT_SENS_SPEED_2   0x25 /* R_ROBOT_RC_SPEED_2 */
+#define A_ROBOT_SENS_SPEED_2   0x80008094
+
+
 /* main motors */
 #define R_ROBOT_MOTOR_1      0x40
 #define A_ROBOT_MOTOR_1      0x80008100
@@ -44,16 +141,27 @@
 #define A_ROBOT_MOTOR_2      0x80008120
 
 
-/* odometry */
+/* odometry : compteurs et pose a 0 si robot_apb est synthetise sans
+   ODOMETRY (carte 2018, pas de codeurs) */
 #define R_ROBOT_RC_VAL_1     0x81
 #define A_ROBOT_RC_VAL_1     0x80008204
 
 #define R_ROBOT_RC_ODO_1_INC 0x83
 #define A_ROBOT_RC_ODO_1_INC 0x8000820c
 
+/* vitesse estimee par le compteur (melange periode entre fronts /
+   comptage, cf QuadratureCounter.vhd) : fronts par fenetre de
+   R_ROBOT_RC_SAMPLING+1 cycles, Q16.16 signe */
 #define R_ROBOT_RC_SPEED_1   0x84
 #define A_ROBOT_RC_SPEED_1   0x80008210
 
+/* age du dernier front : RC_EDGE_TIMER - RC_LAST_EDGE, cycles a 25 MHz */
+#define R_ROBOT_RC_LAST_EDGE_1  0x85
+#define A_ROBOT_RC_LAST_EDGE_1  0x80008214
+
+#define R_ROBOT_RC_EDGE_TIMER_1 0x86
+#define A_ROBOT_RC_EDGE_TIMER_1 0x80008218
+
 #define R_ROBOT_RC_SAMPLING  0x87
 #define A_ROBOT_RC_SAMPLING  0x8000821c
 
@@ -66,5 +174,316 @@
 #define R_ROBOT_RC_SPEED_2   0x8c
 #define A_ROBOT_RC_SPEED_2   0x80008230
 
+#define R_ROBOT_RC_LAST_EDGE_2  0x8d
+#define A_ROBOT_RC_LAST_EDGE_2  0x80008234
+
+#define R_ROBOT_RC_EDGE_TIMER_2 0x8e
+#define A_ROBOT_RC_EDGE_TIMER_2 0x80008238
+
+
+/* odometrie integree (robot_gps_odo) : pose lue dans l'instantane 0x10.. */
+#define R_ROBOT_GPS_CS         0x90 /* W: GPS_CTRL_xxx, R: + GPS_STATUS_BUSY */
+#define A_ROBOT_GPS_CS         0x80008240
+
+#define R_ROBOT_GPS_SAMPLING   0xd7 /* periode en cycles pclk - 1, 24999 = 1 ms */
+#define A_ROBOT_GPS_SAMPLING   0x8000835c
+
+#define R_ROBOT_GPS_X_INIT_H   0x92 /* Q15.48, mm */
+#define A_ROBOT_GPS_X_INIT_H   0x80008248
+
+#define R_ROBOT_GPS_X_INIT_L   0x93
+#define A_ROBOT_GPS_X_INIT_L   0x8000824c
+
+#define R_ROBOT_GPS_Y_INIT_H   0x94 /* Q15.48, mm */
+#define A_ROBOT_GPS_Y_INIT_H   0x80008250
+
+#define R_ROBOT_GPS_Y_INIT_L   0x95
+#define A_ROBOT_GPS_Y_INIT_L   0x80008254
+
+#define R_ROBOT_GPS_TH_INIT_H  0x96 /* Q15.48, rad */
+#define A_ROBOT_GPS_TH_INIT_H  0x80008258
+
+#define R_ROBOT_GPS_TH_INIT_L  0x97
+#define A_ROBOT_GPS_TH_INIT_L  0x8000825c
+
+#define R_ROBOT_QUAD_INC_TH_1_H 0x98 /* Q15.48 par front, droite */
+#define A_ROBOT_QUAD_INC_TH_1_H 0x80008260
+
+#define R_ROBOT_QUAD_INC_TH_1_L 0x99
+#define A_ROBOT_QUAD_INC_TH_1_L 0x80008264
+
+#define R_ROBOT_QUAD_INC_R_1_H 0x9a
+#define A_ROBOT_QUAD_INC_R_1_H 0x80008268
+
+#define R_ROBOT_QUAD_INC_R_1_L 0x9b
+#define A_ROBOT_QUAD_INC_R_1_L 0x8000826c
+
+#define R_ROBOT_QUAD_INC_TH_2_H 0x9c /* gauche */
+#define A_ROBOT_QUAD_INC_TH_2_H 0x80008270
+
+#define R_ROBOT_QUAD_INC_TH_2_L 0x9d
+#define A_ROBOT_QUAD_INC_TH_2_L 0x80008274
+
+#define R_ROBOT_QUAD_INC_R_2_H 0x9e
+#define A_ROBOT_QUAD_INC_R_2_H 0x80008278
+
+#define R_ROBOT_QUAD_INC_R_2_L 0x9f
+#define A_ROBOT_QUAD_INC_R_2_L 0x8000827c
+
+#define GPS_CTRL_ENABLE        0x00000001
+#define GPS_CTRL_SETUP         0x00000002 /* charge les *_INIT */
+#define GPS_STATUS_BUSY        0x00000100
+
+
+/* accelerateurs de calcul Q15.48 (cf drivers/hwmath.c) */
+#define R_ROBOT_MUL64_OP1_H   0xb0
+#define A_ROBOT_MUL64_OP1_H   0x800082c0
+
+#define R_ROBOT_MUL64_OP1_L   0xb1
+#define A_ROBOT_MUL64_OP1_L   0x800082c4
+
+#define R_ROBOT_MUL64_OP2_H   0xb2
+#define A_ROBOT_MUL64_OP2_H   0x800082c8
+
+#define R_ROBOT_MUL64_OP2_L   0xb3
+#define A_ROBOT_MUL64_OP2_L   0x800082cc
+
+#define R_ROBOT_MUL64_RES_H   0xb4 /* R, bits 111..48 du produit */
+#define A_ROBOT_MUL64_RES_H   0x800082d0
+
+#define R_ROBOT_MUL64_RES_L   0xb5 /* R */
+#define A_ROBOT_MUL64_RES_L   0x800082d4
+
+#define R_ROBOT_SINCOS_CS     0xb8 /* W: cmd, R: status */
+#define A_ROBOT_SINCOS_CS     0x800082e0
+
+#define R_ROBOT_SINCOS_ANGLE_H 0xba /* W: angle (rad), R: sin */
+#define A_ROBOT_SINCOS_ANGLE_H 0x800082e8
+
+#define R_ROBOT_SINCOS_ANGLE_L 0xbb
+#define A_ROBOT_SINCOS_ANGLE_L 0x800082ec
+
+#define R_ROBOT_SINCOS_SIN_H  0xba /* R */
+#define R_ROBOT_SINCOS_SIN_L  0xbb /* R */
+
+#define R_ROBOT_SINCOS_COS_H  0xbc /* R */
+#define A_ROBOT_SINCOS_COS_H  0x800082f0
+
+#define R_ROBOT_SINCOS_COS_L  0xbd /* R */
+#define A_ROBOT_SINCOS_COS_L  0x800082f4
+
+#define SINCOS_CMD_START      0x00000001
+#define SINCOS_STATUS_DONE    0x00000001
+
+
+/* ultrasons HC-SR04 : largeur du dernier echo en cycles pclk (25 MHz),
+   US_NO_ECHO si rien avant le timeout */
+#define R_ROBOT_US1_DIST     0xc0 /* R */
+#define A_ROBOT_US1_DIST     0x80008300
+
+#define R_ROBOT_US2_DIST     0xc1 /* R */
+#define A_ROBOT_US2_DIST     0x80008304
+
+#define R_ROBOT_US3_DIST     0xc2 /* R */
+#define A_ROBOT_US3_DIST     0x80008308
+
+/* date (R_ROBOT_TIMER, us) de la derniere mesure de chaque capteur */
+#define R_ROBOT_US1_STAMP    0xd0 /* R */
+#define A_ROBOT_US1_STAMP    0x80008340
+
+#define R_ROBOT_US2_STAMP    0xd1 /* R */
+#define A_ROBOT_US2_STAMP    0x80008344
+
+#define R_ROBOT_US3_STAMP    0xd2 /* R */
+#define A_ROBOT_US3_STAMP    0x80008348
+
+/* ordonnanceur : un capteur a la fois, a tour de role parmi les actifs */
+#define R_ROBOT_US_CTRL      0xd3 /* W: capteurs actifs, R: cf US_CTRL_xxx */
+#define A_ROBOT_US_CTRL      0x8000834c
+
+#define R_ROBOT_US_TIMEOUT   0xd4 /* cycles apres le declenchement */
+#define A_ROBOT_US_TIMEOUT   0x80008350
+
+#define R_ROBOT_US_GUARD     0xd5 /* cycles entre deux mesures (24 bits) */
+#define A_ROBOT_US_GUARD     0x80008354
+
+#define US_CTRL_ENABLE       0x00000007 /* bit i : capteur i+1 actif */
+#define US_CTRL_CUR          0x00000030 /* R: capteur en cours (0..2) */
+#define US_CTRL_CUR_SHIFT    4
+#define US_CTRL_BUSY         0x00000100 /* R: mesure en vol */
+#define US_NO_ECHO           0xffffffff
+
+/* servos et pompes (servo.vhd, pump.vhd) : periode et largeur en cycles
+   pclk. Les registres xxx_PW sont des ombres : R_ROBOT_ACT_COMMIT les
+   applique ensemble au meme front (mouvement coordonne en une ecriture),
+   sauf pour les voies de R_ROBOT_ACT_AUTO (application immediate, defaut).
+   Depuis l'hote, ombres et commit passent en une transaction : rafale I2C
+   (registre 0x06 de robot_i2c_slave.vhd) ou trames SPI chainees.
+   Chaque servo rejoint sa cible par pas de R_ROBOT_SERVOx_SLEW au plus par
+   periode (0 : pas de rampe ; PW = 0 coupe le servo tout de suite) */
+#define R_ROBOT_SERVO1_PERIOD 0xc4
+#define A_ROBOT_SERVO1_PERIOD 0x80008310
+
+#define R_ROBOT_SERVO1_PW     0xc5
+#define A_ROBOT_SERVO1_PW     0x80008314
+
+#define R_ROBOT_SERVO2_PERIOD 0xc6
+#define A_ROBOT_SERVO2_PERIOD 0x80008318
+
+#define R_ROBOT_SERVO2_PW     0xc7
+#define A_ROBOT_SERVO2_PW     0x8000831c
+
+#define R_ROBOT_SERVO3_PERIOD 0xc8
+#define A_ROBOT_SERVO3_PERIOD 0x80008320
+
+#define R_ROBOT_SERVO3_PW     0xc9
+#define A_ROBOT_SERVO3_PW     0x80008324
+
+#define R_ROBOT_ACT_COMMIT    0xca /* W: ACT_xxx a appliquer, R: cf ACT_STATUS_xxx */
+#define A_ROBOT_ACT_COMMIT    0x80008328
+
+#define R_ROBOT_ACT_AUTO      0xcb /* ACT_xxx appliques a l'ecriture */
+#define A_ROBOT_ACT_AUTO      0x8000832c
+
+#define R_ROBOT_PUMP1_PERIOD  0xcc
+#define A_ROBOT_PUMP1_PERIOD  0x80008330
+
+#define R_ROBOT_PUMP1_PW      0xcd /* 0x3ff au plus */
+#define A_ROBOT_PUMP1_PW      0x80008334
+
+#define R_ROBOT_PUMP2_PERIOD  0xce
+#define A_ROBOT_PUMP2_PERIOD  0x80008338
+
+#define R_ROBOT_PUMP2_PW      0xcf /* 0x3ff au plus */
+#define A_ROBOT_PUMP2_PW      0x8000833c
+
+#define R_ROBOT_SERVO1_SLEW   0xda /* cycles par periode, 16 bits */
+#define A_ROBOT_SERVO1_SLEW   0x80008368
+
+#define R_ROBOT_SERVO2_SLEW   0xdb
+#define A_ROBOT_SERVO2_SLEW   0x8000836c
+
+#define R_ROBOT_SERVO3_SLEW   0xdc
+#define A_ROBOT_SERVO3_SLEW   0x80008370
+
+#define R_ROBOT_SERVO1_CUR_PW 0xdd /* R: largeur generee (rampe) */
+#define A_ROBOT_SERVO1_CUR_PW 0x80008374
+
+#define R_ROBOT_SERVO2_CUR_PW 0xde /* R */
+#define A_ROBOT_SERVO2_CUR_PW 0x80008378
+
+#define R_ROBOT_SERVO3_CUR_PW 0xdf /* R */
+#define A_ROBOT_SERVO3_CUR_PW 0x8000837c
+
+#define ACT_SERVO1            0x00000001
+#define ACT_SERVO2            0x00000002
+#define ACT_SERVO3            0x00000004
+#define ACT_PUMP1             0x00000008
+#define ACT_PUMP2             0x00000010
+#define ACT_ALL               0x0000001f
+
+#define ACT_STATUS_PENDING    0x0000001f /* ombre pas encore appliquee */
+#define ACT_STATUS_RAMP       0x00000700 /* bit 8+i : servo i+1 en rampe */
+#define ACT_STATUS_RAMP_SHIFT 8
+
+/* mesure de la boucle de controle (cf drivers/loop_stats.c) : boite aux
+   lettres 0xe0..0xef, ecrite par le LEON, lue par SPI ou I2C */
+#define R_ROBOT_LOOP_COUNT     0xe0 /* iterations */
+#define A_ROBOT_LOOP_COUNT     0x80008380
+
+#define R_ROBOT_LOOP_OVERRUNS  0xe1 /* iterations finies apres l'echeance */
+#define A_ROBOT_LOOP_OVERRUNS  0x80008384
+
+#define R_ROBOT_LOOP_EXEC_MIN  0xe2 /* us */
+#define A_ROBOT_LOOP_EXEC_MIN  0x80008388
+
+#define R_ROBOT_LOOP_EXEC_MAX  0xe3 /* us */
+#define A_ROBOT_LOOP_EXEC_MAX  0x8000838c
+
+#define R_ROBOT_LOOP_EXEC_MEAN 0xe4 /* us, moyenne sur LOOP_STATS_WIN iterations */
+#define A_ROBOT_LOOP_EXEC_MEAN 0x80008390
+
+#define R_ROBOT_LOOP_SLACK_MIN 0xe5 /* us, signe (<0 : depassement) */
+#define A_ROBOT_LOOP_SLACK_MIN 0x80008394
+
+#define R_ROBOT_LOOP_SLACK_MEAN 0xe6 /* us, signe */
+#define A_ROBOT_LOOP_SLACK_MEAN 0x80008398
+
+#define R_ROBOT_LOOP_LATE_MAX  0xe7 /* us, retard max du debut d'iteration */
+#define A_ROBOT_LOOP_LATE_MAX  0x8000839c
+
+/* histogramme log2 du temps d'execution : 16 classes de 16 bits,
+   2 classes par registre (classe 2k en [15:0], 2k+1 en [31:16]) */
+#define R_ROBOT_LOOP_EXEC_HIST 0xe8 /* 0xe8..0xef */
+#define A_ROBOT_LOOP_EXEC_HIST 0x800083a0
+
+/* asservissement de vitesse des roues (cf drivers/speed_pid.c) : boite aux
+   lettres 0xf0..0xff. La config (0xf0..0xf6) est ecrite par I2C/SPI et
+   prise en compte quand la generation de SPID_CTRL change ; les consignes
+   sont relues a chaque periode ; 0xf9..0xfe sont ecrits par le LEON */
+#define R_ROBOT_SPID_CTRL      0xf0 /* [31:16] generation, cf SPID_CTRL_xxx */
+#define A_ROBOT_SPID_CTRL      0x800083c0
+
+#define R_ROBOT_SPID_PERIOD    0xf1 /* us, SPID_PERIOD_MIN..SPID_PERIOD_MAX */
+#define A_ROBOT_SPID_PERIOD    0x800083c4
+
+#define R_ROBOT_SPID_KP        0xf2 /* Q16.16, pwm par increment/s */
+#define A_ROBOT_SPID_KP        0x800083c8
+
+#define R_ROBOT_SPID_KI        0xf3 /* Q16.16, pwm par increment */
+#define A_ROBOT_SPID_KI        0x800083cc
+
+#define R_ROBOT_SPID_KD        0xf4 /* Q16.16, pwm par increment/s^2 */
+#define A_ROBOT_SPID_KD        0x800083d0
+
+#define R_ROBOT_SPID_KFF       0xf5 /* Q16.16, pwm par increment/s de consigne */
+#define A_ROBOT_SPID_KFF       0x800083d4
+
+#define R_ROBOT_SPID_OUT_MAX   0xf6 /* pwm (commande moteur), <= 0x2f0 */
+#define A_ROBOT_SPID_OUT_MAX   0x800083d8
+
+#define R_ROBOT_SPID_SP_1      0xf7 /* consigne roue 1, increments/s */
+#define A_ROBOT_SPID_SP_1      0x800083dc
+
+#define R_ROBOT_SPID_SP_2      0xf8 /* consigne roue 2, increments/s */
+#define A_ROBOT_SPID_SP_2      0x800083e0
+
+#define R_ROBOT_SPID_ERR       0xf9 /* [31:16] erreur roue 1, [15:0] roue 2 */
+#define A_ROBOT_SPID_ERR       0x800083e4
+
+#define R_ROBOT_SPID_CMD       0xfa /* [31:16] commande roue 1, [15:0] roue 2 */
+#define A_ROBOT_SPID_CMD       0x800083e8
+
+#define R_ROBOT_SPID_TICKS     0xfb /* periodes executees */
+#define A_ROBOT_SPID_TICKS     0x800083ec
+
+#define R_ROBOT_SPID_SAT       0xfc /* commandes saturees (roues x periodes) */
+#define A_ROBOT_SPID_SAT       0x800083f0
+
+#define R_ROBOT_SPID_TRACE_DROP 0xfd /* mots de trace perdus (fifo pleine) */
+#define A_ROBOT_SPID_TRACE_DROP 0x800083f4
+
+#define R_ROBOT_SPID_STATUS    0xfe /* [31:16] generation appliquee, [15:0] cf SPID_CTRL_xxx */
+#define A_ROBOT_SPID_STATUS    0x800083f8
+
+#define SPID_CTRL_ENABLE       0x00000001
+#define SPID_CTRL_TRACE        0x00000002 /* erreurs dans la fifo de trace I2C */
+#define SPID_CTRL_TRACE_DEC    0x000000f0 /* une trace toutes les 2^n periodes */
+#define SPID_CTRL_TRACE_DEC_SHIFT 4
+#define SPID_CTRL_GEN_SHIFT    16
+
+/* fifo de trace I2C (R_ROBOT_I2C_TRACE_CS en lecture) */
+#define I2C_TRACE_FULL         0x00000001
+#define I2C_TRACE_EMPTY        0x00000002
+#define I2C_TRACE_WM           0x00000004 /* niveau >= seuil */
+#define I2C_TRACE_LEVEL        0x01ff0000 /* mots dans la fifo */
+#define I2C_TRACE_LEVEL_SHIFT  16
+#define I2C_TRACE_DEPTH        256
+
+/* seuil haut de la fifo de trace (R_ROBOT_I2C_TRACE_CTRL) */
+#define I2C_TRACE_CTRL_WM       0x000001ff /* seuil en mots, 0 : inactif */
+#define I2C_TRACE_CTRL_IRQ_LEON 0x00010000 /* IT niveau 10 (trap 0x1a) */
+#define I2C_TRACE_CTRL_IRQ_HOST 0x00020000 /* broche HOST_IRQ (ex GPIO_120) */
+
 
 #endif /* _ROBOT_LEON_H_ */
@@ -0,0 +1,65 @@
+#ifndef __ROBOT_SCHED_H
+#define __ROBOT_SCHED_H
+
+#include "types.h"
+
+/* Ordonnanceur cooperatif a echeances pour la boucle robot.
+
+   - taches periodiques (sched_add) : executees jusqu'au bout quand leur
+     echeance (R_ROBOT_TIMER, en us) est atteinte, la plus prioritaire
+     d'abord (0 = la plus prioritaire) ; une periode 0 suspend la tache
+   - taches de fond (sched_add_bg) : executees a tour de role dans le
+     temps libre, seulement si aucune tache periodique n'est prete
+   - depassement : une tache periodique qui finit apres sa prochaine
+     echeance compte un overrun et les activations manquees sont sautees
+
+   Toutes les comparaisons de dates sont faites sur la difference signee,
+   ce qui supporte le rebouclage du timer 32 bits. */
+
+#define SCHED_MAX_TASKS 8
+
+typedef void ( *sched_task_fn_t ) ( uint32_t now );
+
+typedef struct {
+  sched_task_fn_t fn;
+  uint32_t period;     /* us, 0 = suspendue (tache periodique) */
+  uint32_t next;       /* prochaine echeance */
+  uint32_t runs;
+  uint32_t overruns;
+  uint32_t missed;     /* activations sautees */
+  int prio;
+  int bg;              /* tache de fond (creee par sched_add_bg) */
+} sched_task_t;
+
+extern sched_task_t sched_tasks[SCHED_MAX_TASKS];
+extern int sched_ntasks;
+
+/* vider la table des taches */
+void sched_init ();
+
+/* ajouter une tache periodique (periode en us, 0 = creee suspendue)
+
+   @return identifiant de la tache, -1 si la table est pleine */
+int sched_add ( sched_task_fn_t fn, uint32_t period_us, int prio );
+
+/* ajouter une tache de fond
+
+   @return identifiant de la tache, -1 si la table est pleine */
+int sched_add_bg ( sched_task_fn_t fn );
+
+/* changer la periode d'une tache periodique (0 = suspendue), sans effet
+   sur une tache de fond */
+void sched_set_period ( int id, uint32_t period_us );
+
+/* (re)caler toutes les echeances sur la date now (apres un reset du timer) */
+void sched_start ( uint32_t now );
+
+/* executer au plus une tache (periodique prete, sinon une tache de fond)
+
+   @return 1 si une tache a ete executee */
+int sched_step ();
+
+/* boucle principale : sched_step() a l'infini */
+void sched_run ();
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef __ROBOT_SPEED_PID_H
+#define __ROBOT_SPEED_PID_H
+
+#include "types.h"
+#include "fxp.h"
+
+/* Asservissement de vitesse des deux roues dans la tache de controle :
+   vitesse estimee par les compteurs d'odometrie (R_ROBOT_RC_SPEED_x,
+   periode entre fronts a basse vitesse, ramenee en increments/s), PID
+   en virgule fixe Q16.16 avec anticipation (feed-forward) sur la
+   consigne, derivee sur la mesure et anti-emballement de l'integrale
+   (integration gelee quand la commande sature dans le meme sens),
+   commande dans R_ROBOT_MOTOR_x.
+
+   Les gains et la periode (1 kHz au plus) sont dans la boite aux lettres
+   R_ROBOT_SPID_xxx, ecrits par I2C/SPI ; les gains sont exprimes en
+   secondes, ils ne dependent pas de la periode. Les erreurs de suivi et
+   les commandes peuvent etre envoyees dans la fifo de trace I2C, par
+   enregistrements de 3 mots : ticks, erreurs, commandes (2 x int16). */
+
+#define SPID_PERIOD_MIN    1000   /* us : 1 kHz */
+#define SPID_PERIOD_MAX    100000 /* us */
+#define SPID_PERIOD_DEF    10000  /* us, ROBOT_SAMPLING_INT */
+#define SPID_OUT_MAX       0x2f0  /* SECURE_PWM_MAX de brushless_motor.vhd */
+
+typedef struct {
+  q16_16_t integ;    /* terme integral, pwm Q16.16 */
+  int32_t  speed;    /* increments/s */
+  int32_t  err;
+  int32_t  cmd;      /* pwm */
+} speed_pid_wheel_t;
+
+typedef struct {
+  uint32_t ctrl;     /* derniere valeur de R_ROBOT_SPID_CTRL appliquee */
+  uint32_t period;   /* us */
+  uint32_t hz;
+  q16_16_t kp;
+  int32_t  ki_dt;    /* ki * periode, Q8.24 */
+  q16_16_t kd_hz;    /* kd / periode */
+  q16_16_t kff;
+  int32_t  out_max;
+  int      primed;   /* vitesses lues au moins une fois */
+  uint32_t ticks;
+  uint32_t sat;
+  uint32_t trace_drop;
+  speed_pid_wheel_t w[2];
+} speed_pid_t;
+
+extern speed_pid_t speed_pid;
+
+/* valeurs par defaut (desactive, gains nuls) dans l'etat et la boite aux
+   lettres */
+void speed_pid_init ();
+
+/* prise en compte d'une nouvelle config (tache de fond)
+
+   @return nouvelle periode en us si elle a change, 0 sinon */
+uint32_t speed_pid_config ();
+
+/* une periode d'asservissement (tache de controle) */
+void speed_pid_update ();
+
+/* calcul des deux roues, vitesses en increments/s (etat speed_pid
+   seulement, aucun acces aux registres ni a la trace) : utilise par
+   speed_pid_update() et le benchmark */
+void speed_pid_step ( int32_t speed1, int32_t speed2, int32_t sp1, int32_t sp2 );
+
+#endif
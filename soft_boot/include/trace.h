@@ -0,0 +1,54 @@
+#ifndef __ROBOT_TRACE_H
+#define __ROBOT_TRACE_H
+
+#include "types.h"
+
+/* Fifo de trace I2C (256 mots, lue par l'hote par la commande 0x01 de
+   l'esclave I2C ou par SPI) : ecriture de mots isoles ou d'enregistrements
+   de plusieurs mots, ecrits en entier ou pas du tout (jamais coupes par
+   une fifo pleine).
+
+   Un seuil haut (R_ROBOT_I2C_TRACE_CTRL) leve la broche HOST_IRQ pour que
+   l'hote vide la fifo avant qu'elle deborde, et/ou l'IT niveau 10 du LEON
+   (trace_irq_handler, trace_it.S) qui se masque elle-meme : cf
+   trace_irq_rearm(). Les mots ecrits fifo pleine par un autre master sont
+   comptes par le materiel (R_ROBOT_I2C_TRACE_OVF). */
+
+typedef struct {
+  uint32_t words;     /* mots ecrits */
+  uint32_t drop;      /* mots perdus (fifo pleine) */
+  uint32_t records;   /* enregistrements ecrits */
+  uint32_t rec_drop;  /* enregistrements perdus (pas la place) */
+} trace_stats_t;
+
+extern trace_stats_t trace_stats;
+
+/* nombre d'IT seuil haut recues (incremente par trace_irq_handler) */
+extern volatile uint32_t trace_irq_count;
+
+/* statistiques a zero, seuil inactif, compteur materiel a zero */
+void trace_init ();
+
+/* seuil haut en mots (0 : inactif) et IT (I2C_TRACE_CTRL_IRQ_xxx) */
+void trace_config ( uint32_t watermark, uint32_t irq );
+
+/* @return nombre de mots dans la fifo */
+uint32_t trace_level ();
+
+/* un mot
+
+   @return 0, -1 si la fifo est pleine (mot perdu) */
+int trace_push ( uint32_t word );
+
+/* n mots consecutifs : tous si la place est libre, aucun sinon
+
+   @return 0, -1 si l'enregistrement est perdu */
+int trace_push_record ( const uint32_t *words, int n );
+
+/* reactive l'IT LEON masquee par le handler, si la fifo est redescendue
+   sous le seuil et si trace_config() l'a demandee (tache de controle)
+
+   @return 1 si reactivee, 0 sinon */
+int trace_irq_rearm ();
+
+#endif
@@ -18,6 +18,16 @@ typedef unsigned char      uint8_t;
 typedef unsigned short int uint16_t;
 typedef unsigned int       uint32_t;
 
+#ifdef EMBEDDED
+typedef unsigned long long uint64_t;
+typedef signed char        int8_t;
+typedef short int          int16_t;
+typedef int                int32_t;
+typedef long long          int64_t;
+#else
+#include <stdint.h>
+#endif
+
 #ifndef NULL
 #define NULL (( void* ) 0 )
 #endif
@@ -68,8 +68,12 @@ uint32_t uart_get_scaler ( enum uart_baudrate_t bd );
    @param[in] scaler = new scaler value */
 void uart_set_scaler ( enum uart_baudrate_t bd, uint32_t scaler );
 
-/* calibrate autobaud, i.e. compute scaler value for BAUTOBAUD baudrate */
-void uart_calibrate ();
+/* calibrate autobaud, i.e. compute scaler value for BAUTOBAUD baudrate
+   from the sync characters (0x55) sent by the host; the UART is left
+   disabled, call uart_init ( BAUTOBAUD ) afterwards
+   @param[in] max_polls = give up after this many status polls (0 = never)
+   @return 0 if the autobaud block locked, -1 otherwise */
+int uart_calibrate ( uint32_t max_polls );
 
 /* get current parity */
 enum uart_parity_t uart_get_parity ();
@@ -82,12 +86,31 @@ void uart_set_parity ( enum uart_parity_t parity );
 /* enable UART at given baudrate */
 void uart_init ( enum uart_baudrate_t bd );
 
-/* send byte on UART (UART must be enabled before)
+/* queue byte for transmission on UART (UART must be enabled before)
+
+   the byte is put in the TX fifo, drained by uart_tx_poll() (or by the
+   TX interrupt if UART_TX_IT is defined). If the fifo is full, waits in
+   blocking mode, otherwise drops the byte and increments uart_tx_dropped.
 
    @param[in] byte = byte to send */
 void uart_putchar ( uint8_t byte );
 
-/* flush output buffer */
+/* select blocking (1, default after uart_init) or non blocking (0)
+   behaviour of uart_putchar() when the TX fifo is full */
+void uart_set_tx_blocking ( int blocking );
+
+/* number of bytes that can be queued without waiting/dropping */
+int uart_tx_room ();
+
+/* move the next byte of the TX fifo to the transmitter if it is free
+   (never waits) */
+void uart_tx_poll ();
+
+/* number of bytes dropped because the TX fifo was full */
+extern uint32_t uart_tx_dropped;
+
+/* flush output buffer (waits until the TX fifo and the transmitter are
+   empty) */
 void uart_flush ();
 
 /* wait for a byte on UART and get it (UART must be enabled before)
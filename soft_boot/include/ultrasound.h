@@ -0,0 +1,61 @@
+#ifndef __ROBOT_ULTRASOUND_H
+#define __ROBOT_ULTRASOUND_H
+
+#include "types.h"
+
+/* Ultrasons HC-SR04 (3 capteurs, ULTRASOUND_HCSR04 dans robot_apb) : le
+   materiel les declenche a tour de role et publie pour chacun la largeur
+   du dernier echo et sa date (R_ROBOT_USx_DIST / R_ROBOT_USx_STAMP).
+
+   us_update(), appelee a chaque tick de la boucle de controle, compare
+   les mesures fraiches aux seuils et tient le masque d'obstacles, envoye
+   dans la trame d'etat (snapshot) : la reaction ne depend pas de l'hote.
+   Une mesure plus vieille que US_MAX_AGE_US (capteur absent ou muet) ne
+   signale pas d'obstacle mais est marquee perimee. */
+
+#define US_NB_SENSORS      3
+
+#define US_TIMEOUT_DEF     600000 /* cycles : 24 ms, ~4 m */
+#define US_GUARD_DEF       250000 /* cycles : 10 ms */
+#define US_THRESH_DEF      200    /* mm */
+#define US_MAX_AGE_US      200000
+
+/* mm <-> largeur d'echo en cycles a 25 MHz (aller-retour a 343 m/s :
+   145.77 cycles/mm) */
+#define US_MM_TO_CYCLES(mm)  (( mm ) * 14577 / 100)
+
+/* masque d'etat (us_state) */
+#define US_STATE_OBSTACLE  0x00000007 /* bit i : obstacle capteur i+1 */
+#define US_STATE_STALE     0x00000700 /* bit 8+i : mesure perimee */
+#define US_STATE_STALE_SHIFT 8
+
+typedef struct {
+  uint32_t dist;       /* largeur d'echo, cycles (US_NO_ECHO : rien) */
+  uint32_t age;        /* us depuis la mesure */
+  uint32_t thresh;     /* seuil, cycles */
+} us_sensor_t;
+
+extern us_sensor_t us_sensors[US_NB_SENSORS];
+
+/* US_STATE_xxx, mis a jour par us_update() */
+extern uint32_t us_state;
+
+/* nombre de passages sans obstacle -> avec obstacle */
+extern uint32_t us_obstacle_count;
+
+/* capteurs actifs (masque, bit i = capteur i+1), timeout et garde par
+   defaut, seuils a US_THRESH_DEF */
+void us_init ( uint32_t enable );
+
+/* seuil d'obstacle d'un capteur en mm (0 : jamais d'obstacle) */
+void us_set_threshold ( int sensor, uint32_t mm );
+
+/* lecture des mesures, masque d'obstacles (boucle de controle)
+
+   @return masque US_STATE_OBSTACLE */
+uint32_t us_update ( uint32_t now );
+
+/* @return distance en mm de la derniere mesure, -1 si pas d'echo */
+int32_t us_dist_mm ( int sensor );
+
+#endif
@@ -0,0 +1,379 @@
+#include "bootldr.h"
+#include "memblk.h"
+#include "uart.h"
+#include "cache.h"
+#include "leon.h"
+#include "robot_leon.h"
+#include "msi2c.h"
+
+/* ~1 s d'attente des 0x55 de l'hote pour l'autobaud */
+#define BOOTLDR_CALIB_POLLS   5000000
+
+/* deux tampons de reception, dans la RAM libre apres la zone de l'image :
+   une trame est recue dans l'un pendant que la precedente est recopiee
+   dans l'image par mots, entre deux octets (pas de fifo de reception, un
+   octet toutes les 10 us a 1 Mbaud) */
+#define BOOTLDR_BUF_ADDR      (BOOTLDR_STAGE_ADDR + BOOTLDR_STAGE_SIZE)
+
+#define RX_SYNC0    0
+#define RX_SYNC1    1
+#define RX_HEADER   2
+#define RX_PAYLOAD  3
+#define RX_CRC      4
+
+static int rx_state;
+static int rx_cnt;
+static int rx_err;
+static uint8_t rx_hdr[4];
+static uint32_t rx_len;
+static uint32_t rx_crc;
+static uint32_t rx_crc_in;
+static uint32_t tx_crc;
+static uint8_t *rx_buf;
+static int rx_cur;
+
+static uint8_t rx_next;     /* prochaine trame 'D' attendue */
+static int nak_sent;        /* un seul 'N' par perte */
+static uint32_t verified;   /* taille de l'image verifiee par 'V', 0 sinon */
+
+/* recopie differee d'une trame 'D' dans l'image */
+static uint32_t *commit_src;
+static uint32_t *commit_dst;
+static uint32_t commit_n;
+
+static void bootldr_put ( uint8_t b )
+{
+  tx_crc = crc32_update ( tx_crc, &b, 1 );
+  uart_putchar ( b );
+}
+
+static void bootldr_send ( uint8_t type, uint8_t seq, uint8_t *data, int len )
+{
+  int i;
+
+  uart_putchar ( BOOTLDR_SYNC0 );
+  uart_putchar ( BOOTLDR_SYNC1 );
+  tx_crc = 0;
+  bootldr_put ( type );
+  bootldr_put ( seq );
+  bootldr_put ( (len>>8) & 0xff );
+  bootldr_put ( len & 0xff );
+  for (i=0; i<len; i++)
+    bootldr_put ( data[i] );
+  uart_putchar ( (tx_crc>>24) & 0xff );
+  uart_putchar ( (tx_crc>>16) & 0xff );
+  uart_putchar ( (tx_crc>>8) & 0xff );
+  uart_putchar ( tx_crc & 0xff );
+}
+
+static void bootldr_nak ( uint8_t seq, uint8_t err )
+{
+  bootldr_send ( BOOTLDR_T_NAK, seq, &err, 1 );
+}
+
+static void put_word ( uint8_t *p, uint32_t w )
+{
+  p[0] = (w>>24) & 0xff;
+  p[1] = (w>>16) & 0xff;
+  p[2] = (w>>8) & 0xff;
+  p[3] = w & 0xff;
+}
+
+static uint32_t get_word ( uint8_t *p )
+{
+  return (p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3];
+}
+
+static void commit_finish ()
+{
+  while (commit_n) {
+    *commit_dst++ = *commit_src++;
+    commit_n--;
+  }
+}
+
+/* recopie de l'image en ROM et saut au vecteur de reset. Executee depuis
+   la RAM (section .data, recopiee par _init_rom_data_bss()) puisqu'elle
+   ecrase la ROM : n'appelle aucune fonction. La table des traps est en
+   ROM : traps coupes (ET=0, comme au reset) avant la recopie */
+static void __attribute__ (( section ( ".data.bootldr" ), noinline, noreturn ))
+bootldr_exec ( volatile uint32_t *dst, volatile uint32_t *src, uint32_t nwords )
+{
+  volatile uint32_t *entry = dst;
+  uint32_t psr;
+
+  asm volatile ( "mov %%psr, %0" : "=r" ( psr ));
+  asm volatile ( "mov %0, %%psr; nop; nop; nop"
+                 : : "r" (( psr & ~PSR_ICC_ET ) | PSR_ICC_PIL )
+                 : "memory", "cc" );
+
+  while (nwords--)
+    *dst++ = *src++;
+
+  asm volatile ( "jmp %0\n\tnop" : : "r" ( entry ));
+  for (;;);
+}
+
+/* traitement d'une trame complete (crc ok)
+
+   @return 1 pour quitter le chargeur */
+static int bootldr_frame ( uint8_t type, uint8_t seq, uint8_t *data,
+                           uint32_t len )
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+  volatile uint32_t* robot_reg = ( volatile uint32_t* ) ROBOT_BASE_ADDR;
+  volatile uint32_t* i2c_reg = ( volatile uint32_t* ) MSI2C_BASE_ADDR;
+  uint8_t reply[16];
+  uint32_t off, size, crc;
+
+  switch (type) {
+  case BOOTLDR_T_DATA:
+    if (seq != rx_next) {
+      if (!nak_sent) {
+        bootldr_nak ( rx_next, BOOTLDR_E_SEQ );
+        nak_sent = 1;
+      }
+      break;
+    }
+    if (len < 4) {
+      bootldr_nak ( rx_next, BOOTLDR_E_RANGE );
+      nak_sent = 1;
+      break;
+    }
+    off = get_word ( data );
+    len -= 4;
+    if ((off & 3) || (len & 3) || (off + len > BOOTLDR_STAGE_SIZE)) {
+      bootldr_nak ( rx_next, BOOTLDR_E_RANGE );
+      nak_sent = 1;
+      break;
+    }
+    commit_finish ();
+    commit_src = ( uint32_t * ) ( data + 4 );
+    commit_dst = ( uint32_t * ) ( BOOTLDR_STAGE_ADDR + off );
+    commit_n = len >> 2;
+    rx_cur ^= 1;
+    verified = 0;
+    nak_sent = 0;
+    bootldr_send ( BOOTLDR_T_ACK, seq, 0, 0 );
+    rx_next++;
+    break;
+
+  case BOOTLDR_T_HELLO:
+    reply[0] = BOOTLDR_VERSION;
+    reply[1] = BOOTLDR_WINDOW;
+    reply[2] = (BOOTLDR_MAX_PAYLOAD>>8) & 0xff;
+    reply[3] = BOOTLDR_MAX_PAYLOAD & 0xff;
+    put_word ( reply+4, BOOTLDR_STAGE_ADDR );
+    put_word ( reply+8, BOOTLDR_STAGE_SIZE );
+    put_word ( reply+12, hw->uartscaler1 );
+    rx_next = 0;
+    nak_sent = 0;
+    bootldr_send ( BOOTLDR_T_HELLO, seq, reply, 16 );
+    break;
+
+  case BOOTLDR_T_PING:
+    bootldr_send ( BOOTLDR_T_PING, seq, data, len );
+    break;
+
+  case BOOTLDR_T_VERIFY:
+    commit_finish ();
+    size = get_word ( data );
+    if ((len < 8) || (size & 3) || (size > BOOTLDR_STAGE_SIZE)) {
+      bootldr_nak ( seq, BOOTLDR_E_RANGE );
+      break;
+    }
+    crc = crc32_update ( 0, ( uint8_t * ) BOOTLDR_STAGE_ADDR, size );
+    put_word ( reply, crc );
+    if (crc == get_word ( data+4 )) {
+      verified = size;
+      bootldr_send ( BOOTLDR_T_ACK, seq, reply, 4 );
+    } else {
+      verified = 0;
+      reply[4] = BOOTLDR_E_VERIFY;
+      bootldr_send ( BOOTLDR_T_NAK, seq, reply+4, 1 );
+    }
+    break;
+
+  case BOOTLDR_T_GO:
+    if (verified == 0) {
+      bootldr_nak ( seq, BOOTLDR_E_STATE );
+      break;
+    }
+    bootldr_send ( BOOTLDR_T_ACK, seq, 0, 0 );
+    uart_flush ();
+    /* plus d'IT : UART (TX par IT), fifo de trace (niveau 10), maitre
+       I2C (niveau 11) ; la nouvelle image refait ses init */
+    robot_reg[R_ROBOT_I2C_TRACE_CTRL] = 0;
+    i2c_reg[R_MSI2C_CTR] = 0;
+    hw->uartctrl1 &= ~UART_CONTROL_TI;
+    hw->irqmask = 0;
+    hw->irqclear = -1;
+    cache_disable ();
+    bootldr_exec (( volatile uint32_t * ) BOOTLDR_ROM_ADDR,
+                  ( volatile uint32_t * ) BOOTLDR_STAGE_ADDR, verified >> 2 );
+    break;
+
+  case BOOTLDR_T_QUIT:
+    bootldr_send ( BOOTLDR_T_ACK, seq, 0, 0 );
+    return 1;
+
+  default:
+    bootldr_nak ( seq, BOOTLDR_E_TYPE );
+    break;
+  }
+
+  return 0;
+}
+
+/* reception d'un octet
+
+   @return 1 si une trame complete est disponible (rx_err : crc faux) */
+static int bootldr_rx_byte ( uint8_t b )
+{
+  switch (rx_state) {
+  case RX_SYNC0:
+    if (b == BOOTLDR_SYNC0) rx_state = RX_SYNC1;
+    break;
+  case RX_SYNC1:
+    if (b == BOOTLDR_SYNC1) {
+      rx_state = RX_HEADER;
+      rx_cnt = 0;
+      rx_crc = 0;
+      rx_err = 0;
+    } else if (b != BOOTLDR_SYNC0) {
+      rx_state = RX_SYNC0;
+    }
+    break;
+  case RX_HEADER:
+    rx_hdr[rx_cnt++] = b;
+    rx_crc = crc32_update ( rx_crc, &b, 1 );
+    if (rx_cnt == 4) {
+      rx_len = (rx_hdr[2]<<8) | rx_hdr[3];
+      rx_buf = ( uint8_t * ) BOOTLDR_BUF_ADDR + rx_cur*BOOTLDR_MAX_PAYLOAD;
+      rx_cnt = 0;
+      if (rx_len > BOOTLDR_MAX_PAYLOAD) {
+        /* entete corrompue : on attend la trame suivante */
+        rx_state = RX_SYNC0;
+        rx_err = 1;
+        return 1;
+      }
+      rx_state = (rx_len != 0) ? RX_PAYLOAD : RX_CRC;
+    }
+    break;
+  case RX_PAYLOAD:
+    rx_buf[rx_cnt++] = b;
+    rx_crc = crc32_update ( rx_crc, &b, 1 );
+    if (rx_cnt == rx_len) {
+      rx_state = RX_CRC;
+      rx_cnt = 0;
+    }
+    break;
+  case RX_CRC:
+    rx_crc_in = (rx_crc_in<<8) | b;
+    if (++rx_cnt == 4) {
+      rx_state = RX_SYNC0;
+      if (rx_crc_in != rx_crc) rx_err = 1;
+      return 1;
+    }
+    break;
+  }
+  return 0;
+}
+
+void bootldr_run ()
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+  volatile uint32_t* robot_reg = ( volatile int* ) ROBOT_BASE_ADDR;
+  uint32_t last_rx = robot_reg[R_ROBOT_TIMER];
+  int probation = 0;
+  uint32_t status;
+  uint8_t b;
+
+  rx_state = RX_SYNC0;
+  rx_cur = 0;
+  rx_next = 0;
+  nak_sent = 0;
+  verified = 0;
+  commit_n = 0;
+
+  /* les acquittements ne doivent pas etre perdus (une fenetre de trames
+     ne represente que quelques dizaines d'octets de reponse) */
+  uart_set_tx_blocking ( 1 );
+
+  for (;;) {
+    uart_tx_poll ();
+
+    status = hw->uartstatus1;
+    if (status & UART_STATUS_DR) {
+      b = hw->uartdata1;
+      if (status & (UART_STATUS_OV | UART_STATUS_PE | UART_STATUS_FE)) {
+        /* octet perdu ou faux : la trame en cours sera refusee */
+        hw->uartstatus1 = 0;
+        rx_err = 1;
+      }
+      if (!bootldr_rx_byte ( b )) continue;
+
+      if (rx_err) {
+        if (!nak_sent) {
+          bootldr_nak ( rx_next, BOOTLDR_E_CRC );
+          nak_sent = 1;
+        }
+        continue;
+      }
+
+      last_rx = robot_reg[R_ROBOT_TIMER];
+      probation = 0;
+
+      if (rx_hdr[0] == BOOTLDR_T_BAUD) {
+        if ((rx_len < 1) || (rx_buf[0] > BAUTOBAUD)) {
+          bootldr_nak ( rx_hdr[1], BOOTLDR_E_RANGE );
+          continue;
+        }
+        bootldr_send ( BOOTLDR_T_ACK, rx_hdr[1], 0, 0 );
+        uart_flush ();
+        if (rx_buf[0] == BAUTOBAUD) {
+          if (uart_calibrate ( BOOTLDR_CALIB_POLLS ) == 0) {
+            uart_init ( BAUTOBAUD );
+          } else {
+            uart_init ( B115200 );
+            bootldr_nak ( rx_hdr[1], BOOTLDR_E_BAUD );
+            continue;
+          }
+        } else {
+          uart_init ( rx_buf[0] );
+        }
+        rx_state = RX_SYNC0;
+        probation = 1;
+        last_rx = robot_reg[R_ROBOT_TIMER];
+        continue;
+      }
+
+      if (bootldr_frame ( rx_hdr[0], rx_hdr[1], rx_buf, rx_len ))
+        break;
+      continue;
+    }
+
+    /* temps libre entre deux octets : recopie d'un mot dans l'image */
+    if (commit_n) {
+      *commit_dst++ = *commit_src++;
+      commit_n--;
+      continue;
+    }
+
+    if (probation &&
+        ((robot_reg[R_ROBOT_TIMER] - last_rx) > BOOTLDR_BAUD_TIMEOUT)) {
+      /* l'hote n'a pas suivi le changement de debit */
+      uart_init ( B115200 );
+      probation = 0;
+      rx_state = RX_SYNC0;
+      last_rx = robot_reg[R_ROBOT_TIMER];
+    }
+
+    if ((robot_reg[R_ROBOT_TIMER] - last_rx) > BOOTLDR_IDLE_TIMEOUT)
+      break;
+  }
+
+  commit_finish ();
+  uart_flush ();
+  uart_init ( B115200 );
+}
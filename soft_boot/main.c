@@ -3,6 +3,20 @@
 #include "uart.h"
 #include "leds.h"
 #include "sleep.h"
+#include "sched.h"
+#include "loop_stats.h"
+#include "boot.h"
+#include "cache.h"
+#include "memblk.h"
+#include "bootldr.h"
+#include "hwmath.h"
+#include "speed_pid.h"
+#include "trace.h"
+#include "msi2c.h"
+#include "ultrasound.h"
+#ifdef BENCH
+#include "bench.h"
+#endif
 #include "leon.h"
 
 #include "robot_leon.h"
@@ -42,6 +56,9 @@ int ib_index = 0;
 #define IS_WAIT_CMD  1
 #define IS_EDIT_BUF  2
 
+int input_state;       /* IS_xxx */
+uint8_t input_cmd;     /* commande qui attend la ligne saisie */
+
 void print_input_buf()
 {
   int i;
@@ -117,15 +134,69 @@ int convert_input_buf_to_hexint()
   return result_val;
 }
 
-void edit_input_buf ()
+/* saisie d'une ligne dans input_buf, un octet par appel (pas d'attente :
+   le moniteur est une tache de fond)
+
+   @return 1 quand la ligne est terminee ('>', fin de ligne ou tampon
+   plein) */
+int edit_input_buf ( uint8_t byte )
 {
-  struct lregs *hw = ( struct lregs * )( PREGS );
-  volatile int* leds_reg = ( volatile int* ) LEDS_BASE_ADDR;
-  unsigned int my_uartstatus1;
-  unsigned int my_uartdata1;
-  unsigned int mask = 0xff;
-  unsigned int leds = mask;
+  unsigned int word_shift, byte_shift;
+  unsigned int actual_val, local_mask, uart_val;
   uint32_t *my_p;
+
+  if ((byte=='>') || (byte==0x0a) || (byte==0x0d)) {
+    uart_putchar ( '>' );
+    uart_putchar ( 0xa );
+    return 1;
+  }
+
+  //input_buf[ib_index++] = byte;
+
+  uart_putchar ( byte );
+  uart_val = byte;
+
+  word_shift = (ib_index>>2)<<2;
+  byte_shift = ib_index - word_shift;
+  switch (byte_shift) {
+  case 0:
+    local_mask = 0x00ffffff;
+    uart_val = uart_val<<24;
+    break;
+  case 1:
+    local_mask = 0xff00ffff;
+    uart_val = uart_val<<16;
+    break;
+  case 2:
+    local_mask = 0xffff00ff;
+    uart_val = uart_val<<8;
+    break;
+  case 3:
+    local_mask = 0xffffff00;
+    uart_val = uart_val<<0;
+    break;
+  default:
+    local_mask = 0x00ffffff;
+    uart_val = uart_val<<24;
+  } /* switch (byte_shift) */
+
+  my_p = ((uint32_t *)((char *)input_buf+word_shift));
+  actual_val = *my_p;
+  *my_p = (actual_val&local_mask) | uart_val;
+
+  ib_index++;
+  if (ib_index >= INPUT_BUF_SZ) {
+    uart_putchar ( '>' );
+    uart_putchar ( 0xa );
+    return 1;
+  }
+
+  return 0;
+}
+
+/* debut de saisie pour la commande cmd (cf monitor_input_done()) */
+void edit_input_start ( uint8_t cmd )
+{
   int i;
 
   for (i=0;i<INPUT_BUF_SZ;i++) {
@@ -133,108 +204,544 @@ void edit_input_buf ()
   }
 
   ib_index=0;
+  input_cmd = cmd;
+  input_state = IS_EDIT_BUF;
+}
 
-  for (;;) {
+/* reception de n octets binaires (commandes par blocs)
 
-    my_uartstatus1 = hw->uartstatus1;
-    if ( my_uartstatus1 & UART_STATUS_DR ) {
-      my_uartdata1 = hw->uartdata1;
-      uart_byte = my_uartdata1;
+   @return 0 si ok, -1 si le delai (us, depuis le dernier octet) expire */
+int recv_bin_buf ( uint8_t *buf, int n, uint32_t timeout_us )
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+  volatile uint32_t* robot_reg = ( volatile int* ) ROBOT_BASE_ADDR;
+  uint32_t t0 = robot_reg[R_ROBOT_TIMER];
+  int i = 0;
+
+  while (i<n) {
+    uart_tx_poll ();
+    if ( hw->uartstatus1 & UART_STATUS_DR ) {
+      buf[i++] = hw->uartdata1;
+      t0 = robot_reg[R_ROBOT_TIMER];
+    } else if ((robot_reg[R_ROBOT_TIMER] - t0) > timeout_us) {
+      return -1;
+    }
+  }
 
-      if ((uart_byte=='>') || (uart_byte==0x0a) || (uart_byte==0x0d)) {
-	uart_putchar ( '>' );
-	uart_putchar ( 0xa );
-	return;
-      } else {
-	unsigned int word_shift, byte_shift;
-	unsigned int actual_val, local_mask, uart_val;
+  return 0;
+}
 
-	//input_buf[ib_index++] = uart_byte;
+/* Snapshot capteurs : trame binaire (big endian), valeurs figees au
+ * meme cycle par l'instantane R_ROBOT_SENS_xxx
+ *   [0]    0xa5
+ *   [1]    0x5a
+ *   [2]    longueur des donnees (24)
+ *   [3]    numero de sequence
+ *   [4]    R_ROBOT_TIMER
+ *   [8]    R_ROBOT_RC_VAL_1
+ *   [12]   R_ROBOT_RC_VAL_2
+ *   [16]   R_ROBOT_RC_SPEED_1
+ *   [20]   R_ROBOT_RC_SPEED_2
+ *   [24]   ultrasons : obstacles et mesures perimees (US_STATE_xxx)
+ *   [28]   checksum (somme des octets [2..27])
+ */
+#define SNAPSHOT_SYNC0     0xa5
+#define SNAPSHOT_SYNC1     0x5a
+#define SNAPSHOT_NWORDS    6
+
+uint8_t snapshot_seq = 0;
+
+void send_snapshot ()
+{
+  volatile uint32_t* robot_reg = ( volatile int* ) ROBOT_BASE_ADDR;
+  uint32_t snap[SNAPSHOT_NWORDS];
+  uint8_t csum;
+  uint8_t b;
+  int i, j;
+
+  robot_reg[R_ROBOT_SENS_CS] = 1;
+  snap[0] = robot_reg[R_ROBOT_SENS_TIMER];
+  snap[1] = robot_reg[R_ROBOT_SENS_VAL_1];
+  snap[2] = robot_reg[R_ROBOT_SENS_VAL_2];
+  snap[3] = robot_reg[R_ROBOT_SENS_SPEED_1];
+  snap[4] = robot_reg[R_ROBOT_SENS_SPEED_2];
+  snap[5] = us_state;
+
+  /* pas de trame tronquee : si la fifo TX est trop pleine on saute la
+     trame (le trou dans les numeros de sequence la signale a l'hote) */
+  if (uart_tx_room() < SNAPSHOT_NWORDS*4+5) {
+    snapshot_seq++;
+    return;
+  }
 
-	uart_putchar ( uart_byte );
-	uart_val = uart_byte;
+  uart_putchar ( SNAPSHOT_SYNC0 );
+  uart_putchar ( SNAPSHOT_SYNC1 );
+  csum = SNAPSHOT_NWORDS*4;
+  uart_putchar ( SNAPSHOT_NWORDS*4 );
+  csum += snapshot_seq;
+  uart_putchar ( snapshot_seq );
+  snapshot_seq++;
+  for (i=0; i<SNAPSHOT_NWORDS; i++) {
+    for (j=24; j>=0; j-=8) {
+      b = (snap[i]>>j) & 0xff;
+      csum += b;
+      uart_putchar ( b );
+    }
+  }
+  uart_putchar ( csum );
+}
 
-	word_shift = (ib_index>>2)<<2;
-	byte_shift = ib_index - word_shift;
-	switch (byte_shift) {
-	case 0:
-	  local_mask = 0x00ffffff;
-	  uart_val = uart_val<<24;
-	  break;
-	case 1:
-	  local_mask = 0xff00ffff;
-	  uart_val = uart_val<<16;
-	  break;
-	case 2:
-	  local_mask = 0xffff00ff;
-	  uart_val = uart_val<<8;
-	  break;
-	case 3:
-	  local_mask = 0xffffff00;
-	  uart_val = uart_val<<0;
-	  break;
-	default:
-	  local_mask = 0x00ffffff;
-	  uart_val = uart_val<<24;
-	} /* switch (byte_shift) */
-
-	my_p = ((uint32_t *)((char *)input_buf+word_shift));
-	actual_val = *my_p;
-	*my_p = (actual_val&local_mask) | uart_val;
-
-	ib_index++;
-	if (ib_index >= INPUT_BUF_SZ) {
-	  uart_putchar ( '>' );
-	  uart_putchar ( 0xa );
-	  return;
-	}
+#define ROBOT_SAMPLING_INT  10000 /* in microseconds */
+#define TRACE_WATERMARK     ( I2C_TRACE_DEPTH*3/4 ) /* mots */
+
+unsigned int leds;
+uint32_t loop_cnt;
+uint32_t robot_timer_val;
+uint32_t robot_timer_val_ms;
+uint32_t snapshot_period;
+uint32_t mem_test_addr;
+uint32_t mem_test_data;
+
+int control_task_id;
+int snapshot_task_id;
+
+/* temps de demarrage, en us depuis le reset (R_ROBOT_TIMER repart de 0 au
+   reset de l'APB, puis au reset robot fait juste avant le lancement de la
+   boucle : boot_t_robot_reset sert a recaler boot_t_first_tick) */
+uint32_t boot_t_main;
+uint32_t boot_t_unlock;
+uint32_t boot_t_robot_reset;
+uint32_t boot_t_first_tick;
+int boot_fast;
+
+/* affichage d'un histogramme log2 (classes non vides seulement) */
+void print_loop_hist ( char *name, uint32_t *hist )
+{
+  int i;
 
-      } /* if ((uart_byte=='>') || (uart_byte==0x0a) || (uart_byte==0x0d)) */
+  uart_putstring ( name );
+  uart_putchar ( 0xa );
+  for (i=0; i<LOOP_STATS_NBINS; i++) {
+    if (hist[i]==0) continue;
+    uart_putstring ( "  <2^" );
+    uart_putchar ( (i<10) ? ('0'+i) : ('a'+i-10) );
+    uart_putstring ( " : " );
+    uart_printhex ( hist[i] );
+    uart_putchar ( 0xa );
+  }
+}
 
-    } /* for (;;) */
+/* lectures I2C periodiques declarees au moniteur ('I'), 4 octets au plus :
+   dernier mot lu sans erreur, affiche par '?' */
+uint8_t msi2c_mon_buf[MSI2C_SAMPLE_MAX][4];
+uint32_t msi2c_mon_val[MSI2C_SAMPLE_MAX];
+int msi2c_mon_n;
 
-    sleep ( 50 );
+void msi2c_mon_cb ( msi2c_xfer_t *xfer )
+{
+  uint32_t v = 0;
+  int i;
 
-    asm ( "nop" );
-    *leds_reg = leds & 0xff;
-    asm ( "nop" );
-    leds ^= mask;
-    asm ( "nop" );
+  if (xfer->status != MSI2C_DONE)
+    return;
+  for (i=0; i<xfer->rlen; i++)
+    v = ( v << 8 ) | xfer->rbuf[i];
+  *( uint32_t * ) xfer->arg = v;
+}
 
+/* "AARRLLPP" (hexa) : adresse 7 bits, registre, octets lus (1..4),
+   periode en ticks de la boucle de controle */
+void msi2c_mon_add ( uint32_t spec )
+{
+  int rlen = ( spec >> 8 ) & 0xff;
+  int n = msi2c_mon_n;
+
+  if ((rlen < 1) || (rlen > 4) || (( spec & 0xff ) == 0) ||
+      (n >= MSI2C_SAMPLE_MAX) ||
+      (msi2c_sample_add (( spec >> 24 ) & 0x7f, ( spec >> 16 ) & 0xff,
+                         msi2c_mon_buf[n], rlen, spec & 0xff,
+                         msi2c_mon_cb, &msi2c_mon_val[n] ) < 0)) {
+    uart_putstring ( " refuse" );
+    return;
   }
+  msi2c_mon_val[n] = 0;
+  msi2c_mon_n++;
+}
 
-  uart_putchar ( '!' );
+/* fin de saisie d'une ligne ('@', '$', 'S', 'I') */
+void monitor_input_done ()
+{
+  input_state = IS_IDDLE;
+
+  switch (input_cmd) {
+  case '@':
+    mem_test_addr = convert_input_buf_to_hexint();
+    break;
+  case '$':
+    mem_test_data = convert_input_buf_to_hexint();
+    break;
+  case 'I':
+    msi2c_mon_add ( convert_input_buf_to_hexint() );
+    break;
+  case 'S':
+    snapshot_period = convert_input_buf_to_int();
+    if ((int)snapshot_period < 0) snapshot_period = 0;
+    snapshot_period = snapshot_period*1000;
+    sched_set_period ( snapshot_task_id, snapshot_period );
+    break;
+  }
   uart_putchar ( 0xa );
-  return;
 }
 
-#define ROBOT_SAMPLING_INT  10000 /* in microseconds */
+/* commandes du moniteur : tache de fond (un octet par activation, y
+   compris pendant la saisie d'une ligne) */
+void monitor_task ( uint32_t now )
+{
+  struct lregs *hw = ( struct lregs * )( PREGS );
+  volatile uint32_t* robot_reg = ( volatile int* ) ROBOT_BASE_ADDR;
+  uint32_t my_val32;
+
+  unsigned int my_uartstatus1 = hw->uartstatus1;
+  if ( my_uartstatus1 & UART_STATUS_DR ) {
+    unsigned int my_uartdata1 = hw->uartdata1;
+
+    uart_byte = my_uartdata1;
+
+    if (input_state == IS_EDIT_BUF) {
+      if (edit_input_buf ( uart_byte ))
+        monitor_input_done ();
+      return;
+    }
+
+    if ((uart_byte=='?') || (uart_byte=='w') || (uart_byte=='r')) {
+      /* debug i2c (slave) */
+      unsigned int i2c_val;
+      int i2c_idx;
+      uart_putstring ( "DEBUG I2C: " );
+      uart_putchar ( 0xa );
+      if ((uart_byte=='r')) {
+	uart_putstring ( " bstr data: " );
+	i2c_test_data = robot_reg[R_ROBOT_I2C_BSTR_D];
+	uart_printhex ( i2c_test_data );
+	uart_putchar ( 0xa );
+      }
+      if ((uart_byte=='w')) {
+	// robot_reg[R_ROBOT_I2C_TRACE_D] = robot_timer_val;
+	uart_putstring ( " write to trace: " );
+	uart_printhex ( i2c_test_data );
+	uart_putchar ( 0xa );
+	robot_reg[R_ROBOT_I2C_TRACE_D] = i2c_test_data;
+      }
+      uart_putstring ( " trace status: " );
+      i2c_val = robot_reg[R_ROBOT_I2C_TRACE_CS];
+      uart_printhex ( i2c_val );
+      uart_putchar ( 0xa );
+      uart_putstring ( " trace data dbg: " );
+      i2c_val = robot_reg[R_ROBOT_I2C_TRACE_D];
+      uart_printhex ( i2c_val );
+      uart_putchar ( 0xa );
+      uart_putstring ( " bstr status: " );
+      i2c_val = robot_reg[R_ROBOT_I2C_BSTR_CS];
+      uart_printhex ( i2c_val );
+      uart_putchar ( 0xa );
+      uart_putstring ( " uart tx dropped: " );
+      uart_printhex ( uart_tx_dropped );
+      uart_putchar ( 0xa );
+      uart_putstring ( " trace ctrl/ovf/it: " );
+      uart_printhex ( robot_reg[R_ROBOT_I2C_TRACE_CTRL] );
+      uart_putchar ( ' ' );
+      uart_printhex ( robot_reg[R_ROBOT_I2C_TRACE_OVF] );
+      uart_putchar ( ' ' );
+      uart_printhex ( trace_irq_count );
+      uart_putchar ( 0xa );
+      uart_putstring ( " msi2c it/ok/nack/al/tmo: " );
+      uart_printhex ( msi2c_eng.irq );
+      uart_putchar ( ' ' );
+      uart_printhex ( msi2c_stats.xfers );
+      uart_putchar ( ' ' );
+      uart_printhex ( msi2c_stats.nack );
+      uart_putchar ( ' ' );
+      uart_printhex ( msi2c_stats.al );
+      uart_putchar ( ' ' );
+      uart_printhex ( msi2c_stats.timeout );
+      uart_putchar ( 0xa );
+      for (i2c_idx=0; i2c_idx<msi2c_mon_n; i2c_idx++) {
+        uart_putstring ( " msi2c lecture: " );
+        uart_printhex ( msi2c_mon_val[i2c_idx] );
+        uart_putchar ( 0xa );
+      }
+      uart_putstring ( " us dist1/2/3 state: " );
+      uart_printhex ( us_sensors[0].dist );
+      uart_putchar ( ' ' );
+      uart_printhex ( us_sensors[1].dist );
+      uart_putchar ( ' ' );
+      uart_printhex ( us_sensors[2].dist );
+      uart_putchar ( ' ' );
+      uart_printhex ( us_state );
+      uart_putchar ( 0xa );
+    }
+
+    if (uart_byte=='@') {
+      uart_putstring ( "@ : " );
+      edit_input_start ( '@' );
+    }
+
+    if (uart_byte=='$') {
+      uart_putstring ( "$ : " );
+      edit_input_start ( '$' );
+    }
+
+    if (uart_byte=='R') {
+      my_val32 = read_test_32b((uint32_t *) mem_test_addr);
+      uart_putstring ( "@0x" );
+      uart_printhex ( mem_test_addr );
+      uart_putstring ( " : 0x" );
+      uart_printhex ( my_val32 );
+      uart_putchar ( 0xa );
+    }
+
+    if (uart_byte=='W') {
+      write_test_32b((uint32_t *) mem_test_addr, mem_test_data);
+      uart_putstring ( "0x" );
+      uart_printhex ( mem_test_data );
+      uart_putstring ( "=> @0x" );
+      uart_printhex ( mem_test_addr );
+      uart_putchar ( 0xa );
+    }
+
+    if (uart_byte=='M') { /* commande memoire par blocs (binaire) */
+      uint8_t req[MEMBLK_REQ_SZ];
+      req[0] = 0;
+      if (recv_bin_buf ( req, MEMBLK_REQ_SZ, 100000 ) == 0)
+        memblk_cmd ( req );
+      else
+        memblk_send_error ( req[0], MEMBLK_ERR_TIMEOUT );
+    }
+
+    if (uart_byte=='+') {
+      mem_test_addr = 0x80008008;
+      my_val32 = read_test_32b((uint32_t *) mem_test_addr);
+      my_val32++;
+      write_test_32b((uint32_t *) mem_test_addr, my_val32);
+      uart_putstring ( "0x" );
+      uart_printhex ( my_val32 );
+      uart_putchar ( 0xa );
+    }
+
+    if (uart_byte=='-') {
+      mem_test_addr = 0x80008008;
+      my_val32 = read_test_32b((uint32_t *) mem_test_addr);
+      my_val32--;
+      write_test_32b((uint32_t *) mem_test_addr, my_val32);
+      uart_putstring ( "0x" );
+      uart_printhex ( my_val32 );
+      uart_putchar ( 0xa );
+    }
+
+    if ((uart_byte=='!')) { /* load new soft */
+      uart_putchar ( '!' );
+      uart_putchar ( 0xa );
+      uart_flush ();
+      cache_flush ();
+      asm ( "call 0x10000000" ); /* call load_bitstream */
+    }
+
+    if (uart_byte=='L') { /* chargeur binaire UART (bloquant) */
+      /* plus d'asservissement pendant le chargement : moteurs arretes,
+         speed_pid_config() fera le reset au retour */
+      robot_reg[R_ROBOT_SPID_CTRL] &= ~SPID_CTRL_ENABLE;
+      robot_reg[R_ROBOT_MOTOR_1] = 0;
+      robot_reg[R_ROBOT_MOTOR_2] = 0;
+      uart_putstring ( "L" );
+      uart_putchar ( 0xa );
+      uart_flush ();
+      bootldr_run ();
+      /* retour a 115200 apres 'Q' ou inactivite */
+      uart_set_tx_blocking ( 0 );
+      sched_start ( robot_reg[R_ROBOT_TIMER] );
+    }
+
+    if (uart_byte=='I') { /* lecture I2C periodique */
+      uart_putstring ( "I : " );
+      edit_input_start ( 'I' );
+    }
+
+    if (uart_byte=='s') { /* snapshot capteurs */
+      send_snapshot ();
+    }
+
+    if (uart_byte=='S') { /* flux de snapshots */
+      uart_putstring ( "S : " );
+      edit_input_start ( 'S' );
+    }
+
+    if (uart_byte=='T') { /* mesure de la boucle de controle */
+      uart_putstring ( "LOOP count: " );
+      uart_printhex ( loop_stats.count );
+      uart_putstring ( " overruns: " );
+      uart_printhex ( loop_stats.overruns );
+      uart_putchar ( 0xa );
+      uart_putstring ( " exec min/mean/max: " );
+      uart_printhex ( loop_stats.exec_min );
+      uart_putchar ( ' ' );
+      uart_printhex ( loop_stats.exec_mean );
+      uart_putchar ( ' ' );
+      uart_printhex ( loop_stats.exec_max );
+      uart_putchar ( 0xa );
+      uart_putstring ( " slack min/mean: " );
+      uart_printhex ( loop_stats.slack_min );
+      uart_putchar ( ' ' );
+      uart_printhex ( loop_stats.slack_mean );
+      uart_putstring ( " late max: " );
+      uart_printhex ( loop_stats.late_max );
+      uart_putchar ( 0xa );
+      print_loop_hist ( " exec hist:", loop_stats.exec_hist );
+      print_loop_hist ( " slack hist:", loop_stats.slack_hist );
+      uart_putstring ( "BOOT main/unlock/tick (us): " );
+      uart_printhex ( boot_t_main );
+      uart_putchar ( ' ' );
+      uart_printhex ( boot_t_unlock );
+      uart_putchar ( ' ' );
+      uart_printhex ( boot_t_first_tick );
+      uart_putstring ( boot_fast ? " rapide" : " mdp" );
+      uart_putchar ( 0xa );
+    }
+
+    if (uart_byte=='t') { /* raz mesure de la boucle */
+      loop_stats_reset ();
+      loop_stats_publish ();
+      uart_putstring ( "LOOP RAZ" );
+      uart_putchar ( 0xa );
+    }
+
+#ifdef BENCH
+    if (uart_byte=='B') { /* benchmark (bloquant) */
+      bench_run ();
+      sched_start ( robot_reg[R_ROBOT_TIMER] );
+    }
+#endif
+
+    if (uart_byte=='Z') { /* fin de match */
+      boot_set_warm ( 0 );
+      uart_putstring ( "DEMARRAGE A CHAUD desarme" );
+      uart_putchar ( 0xa );
+    }
+
+    if ((uart_byte=='%')) { /* robot reset */
+      uart_putstring ( "RESET" );
+      uart_putchar ( 0xa );
+      robot_reg[R_ROBOT_RESET] = 1;
+      robot_reg[R_ROBOT_RESET] = 0;
+
+      /* le timer repart de 0 : on recale les echeances */
+      sched_start ( robot_reg[R_ROBOT_TIMER] );
+    }
+  }
+
+}
+
+/* envoi periodique des snapshots ('S') */
+void snapshot_task ( uint32_t now )
+{
+  send_snapshot ();
+}
+
+/* vidage de la fifo TX de l'UART */
+void uart_tx_task ( uint32_t now )
+{
+  uart_tx_poll ();
+}
+
+/* config de l'asservissement de vitesse (ecrite par I2C/SPI) : la periode
+   de la tache de controle suit celle de l'asservissement */
+void speed_pid_task ( uint32_t now )
+{
+  uint32_t period = speed_pid_config ();
+
+  if (period != 0)
+    sched_set_period ( control_task_id, period );
+}
+
+/* file des accelerateurs sin/cos (cf drivers/hwmath.c) */
+void hwmath_task ( uint32_t now )
+{
+  hwmath_poll ();
+}
+
+/* maitre I2C : callbacks des transactions terminees (cf drivers/msi2c.c) */
+void msi2c_task ( uint32_t now )
+{
+  msi2c_poll ( now );
+}
+
+/* asservissement / echantillonnage robot */
+void control_task ( uint32_t now )
+{
+  volatile int* leds_reg = ( volatile int* ) LEDS_BASE_ADDR;
+  volatile uint32_t* robot_reg = ( volatile int* ) ROBOT_BASE_ADDR;
+  uint32_t release = sched_tasks[control_task_id].next;
+
+  robot_timer_val = now;
+  robot_timer_val_ms = robot_timer_val/1000;
+
+  /* en premier : gigue minimale entre lecture des compteurs et commande */
+  speed_pid_update ();
+
+  asm ( "nop" );
+  *leds_reg = leds & 0xff;
+  asm ( "nop" );
+  leds ^= 0xff;
+  asm ( "nop" );
+
+  loop_cnt++;
+
+  /* obstacles vus par les ultrasons (trame d'etat) */
+  us_update ( now );
+
+  /* capteurs I2C : mise en file seulement, jamais d'attente du bus */
+  msi2c_sample_tick ();
+
+  /* fifo de trace : IT seuil haut masquee par trace_irq_handler */
+  trace_irq_rearm ();
+
+  if (boot_t_first_tick==0)
+    boot_t_first_tick = boot_t_robot_reset + now;
+
+  loop_stats_update ( release, now, robot_reg[R_ROBOT_TIMER],
+                      release + sched_tasks[control_task_id].period );
+}
 
 int main () {
     struct lregs *hw = ( struct lregs * )( PREGS );
     volatile int* leds_reg = ( volatile int* ) LEDS_BASE_ADDR;
     unsigned int mask = 0xff;
-    unsigned int leds = mask;
-    uint32_t loop_cnt=0;
     volatile uint32_t* robot_reg = ( volatile int* ) ROBOT_BASE_ADDR;
-    uint32_t robot_timer_val=0;
-    uint32_t robot_timer_val_ms=0;
-    uint32_t robot_sync_barrier=0;
     int pwd_state;
+    int boot_warm;
+    int cache_err;
+    int hwmath_mask;
 
-    uint32_t my_val32;
-    uint32_t mem_test_addr;
-    uint32_t mem_test_data;
 
+    boot_t_main = robot_reg[R_ROBOT_TIMER];
 
     i2c_test_data = 0;
+    snapshot_period = 0;
 
     uart_init ( B115200 );
 
+    /* demarrage rapide (pas de mot de passe) : DIP_SW_0, ou reset a chaud
+       apres un deverrouillage (brown-out en match) ; le mot de demarrage a
+       chaud reste arme pour tout le match (plusieurs brown-outs possibles),
+       il n'est desarme que par la commande 'Z' (fin de match) ou par la
+       configuration du FPGA */
+    boot_warm = boot_is_warm ();
+    boot_fast = ((robot_reg[R_ROBOT_GPIO] & ROBOT_GPIO_FAST_BOOT) != 0) ||
+      boot_warm;
+
 #if 1 /* FIXME : DEBUG */
     leds = 0xaa;
-    pwd_state = 0;
-    for (;;) {
+    pwd_state = boot_fast ? 5 : 0;
+    while (pwd_state != 5) {
       asm ( "nop" );
       *leds_reg = leds & 0xff;
       asm ( "nop" );
@@ -268,13 +775,43 @@ int main () {
 	}
       }
 
-      if (pwd_state == 5) break;
     }
 #endif
+    /* arme par un vrai deverrouillage, re-arme apres un demarrage a chaud
+       (pas par DIP_SW_0 seul) */
+    if (!boot_fast || boot_warm)
+      boot_set_warm ( 1 );
+    boot_t_unlock = robot_reg[R_ROBOT_TIMER];
 
     uart_putchar ( 0xa );
     uart_putstring ( "Robot GOLDO - TEST INTEGRATION carte_log_gr_v1 (18042018)" );
     uart_putchar ( 0xa );
+    if (!data_init_check ()) {
+      uart_putstring ( "ATTENTION : init .data/.bss KO" );
+      uart_putchar ( 0xa );
+    }
+    if (boot_fast) {
+      uart_putstring ( "BOOT rapide" );
+      uart_putchar ( 0xa );
+    }
+    uart_putstring ( "CACHE : ctrl=0x" );
+    uart_printhex ( cache_get_ctrl () );
+    if ((cache_get_ctrl () & CCR_DCS_MSK) == CCR_DCS_ENA) {
+      cache_err = cache_selftest ();
+      uart_putstring ( (cache_err==0) ? " test OK" : " test KO 0x" );
+      if (cache_err!=0)
+        uart_printhex ( cache_err );
+    }
+    uart_putchar ( 0xa );
+    uart_putstring ( "HWMATH :" );
+    hwmath_mask = hwmath_init ();
+    if (hwmath_mask & HWMATH_HW_MUL64)
+      uart_putstring ( " mul64" );
+    if (hwmath_mask & HWMATH_HW_SINCOS)
+      uart_putstring ( " sincos" );
+    if (hwmath_mask != HWMATH_HW_MUL64 + HWMATH_HW_SINCOS)
+      uart_putstring ( " (logiciel sinon)" );
+    uart_putchar ( 0xa );
     uart_putstring ( "Fonctions OK :" );
     uart_putchar ( 0xa );
     uart_putstring ( "   @ : adresse de test AHB/APB" );
@@ -285,6 +822,8 @@ int main () {
     uart_putchar ( 0xa );
     uart_putstring ( "   W : test ecriture 32b AHB/APB" );
     uart_putchar ( 0xa );
+    uart_putstring ( "   M : dump/fill/copy/crc32/compare (binaire)" );
+    uart_putchar ( 0xa );
     uart_putstring ( "   + : increment debug reg" );
     uart_putchar ( 0xa );
     uart_putstring ( "   - : decrement debug reg" );
@@ -297,145 +836,66 @@ int main () {
     uart_putchar ( 0xa );
     uart_putstring ( "   ! : charger nouveau soft" );
     uart_putchar ( 0xa );
+    uart_putstring ( "   L : charger nouveau soft (UART binaire)" );
+    uart_putchar ( 0xa );
     uart_putstring ( "   % : robot reset" );
     uart_putchar ( 0xa );
+    uart_putstring ( "   Z : fin de match (reset suivant avec mot de passe)" );
+    uart_putchar ( 0xa );
+    uart_putstring ( "   I : lecture I2C periodique (AARRLLPP hexa)" );
+    uart_putchar ( 0xa );
+    uart_putstring ( "   s : snapshot capteurs (binaire)" );
+    uart_putchar ( 0xa );
+    uart_putstring ( "   S : flux de snapshots (periode en ms, 0=stop)" );
+    uart_putchar ( 0xa );
+    uart_putstring ( "   T : mesure boucle de controle (t : raz)" );
+    uart_putchar ( 0xa );
+#ifdef BENCH
+    uart_putstring ( "   B : benchmark" );
+    uart_putchar ( 0xa );
+#endif
 
     uart_putchar ( 0xa );
     loop_cnt=0;
 
+    /* dans la boucle robot, les impressions ne doivent jamais attendre
+       l'UART : la fifo TX est videe pendant l'attente de la barriere */
+    uart_set_tx_blocking ( 0 );
+
     /* robot reset */
+    boot_t_robot_reset = robot_reg[R_ROBOT_TIMER];
     robot_reg[R_ROBOT_RESET] = 1;
     robot_reg[R_ROBOT_RESET] = 0;
 
-    for (;;) {
-      robot_timer_val = robot_reg[R_ROBOT_TIMER];
-      robot_sync_barrier = robot_timer_val + ROBOT_SAMPLING_INT;
-
-      asm ( "nop" );
-      *leds_reg = leds & 0xff;
-      asm ( "nop" );
-
-      unsigned int my_uartstatus1 = hw->uartstatus1;
-      if ( my_uartstatus1 & UART_STATUS_DR ) {
-	unsigned int my_uartdata1 = hw->uartdata1;
-
-	uart_byte = my_uartdata1;
-
-	if ((uart_byte=='?') || (uart_byte=='w') || (uart_byte=='r')) {
-	  /* debug i2c (slave) */
-	  unsigned int i2c_val;
-	  uart_putstring ( "DEBUG I2C: " );
-	  uart_putchar ( 0xa );
-	  if ((uart_byte=='r')) {
-	    uart_putstring ( " bstr data: " );
-	    i2c_test_data = robot_reg[R_ROBOT_I2C_BSTR_D];
-	    uart_printhex ( i2c_test_data );
-	    uart_putchar ( 0xa );
-	  }
-	  if ((uart_byte=='w')) {
-	    // robot_reg[R_ROBOT_I2C_TRACE_D] = robot_timer_val;
-	    uart_putstring ( " write to trace: " );
-	    uart_printhex ( i2c_test_data );
-	    uart_putchar ( 0xa );
-	    robot_reg[R_ROBOT_I2C_TRACE_D] = i2c_test_data;
-	  }
-	  uart_putstring ( " trace status: " );
-	  i2c_val = robot_reg[R_ROBOT_I2C_TRACE_CS];
-	  uart_printhex ( i2c_val );
-	  uart_putchar ( 0xa );
-	  uart_putstring ( " trace data dbg: " );
-	  i2c_val = robot_reg[R_ROBOT_I2C_TRACE_D];
-	  uart_printhex ( i2c_val );
-	  uart_putchar ( 0xa );
-	  uart_putstring ( " bstr status: " );
-	  i2c_val = robot_reg[R_ROBOT_I2C_BSTR_CS];
-	  uart_printhex ( i2c_val );
-	  uart_putchar ( 0xa );
-	}
-
-	if (uart_byte=='@') {
-	  uart_putstring ( "@ : " );
-	  edit_input_buf ();
-	  mem_test_addr = convert_input_buf_to_hexint();
-	  uart_putchar ( 0xa );
-	}
-
-	if (uart_byte=='$') {
-	  uart_putstring ( "$ : " );
-	  edit_input_buf ();
-	  mem_test_data = convert_input_buf_to_hexint();
-	  uart_putchar ( 0xa );
-	}
-
-	if (uart_byte=='R') {
-	  my_val32 = read_test_32b((uint32_t *) mem_test_addr);
-	  uart_putstring ( "@0x" );
-	  uart_printhex ( mem_test_addr );
-	  uart_putstring ( " : 0x" );
-	  uart_printhex ( my_val32 );
-	  uart_putchar ( 0xa );
-	}
-
-	if (uart_byte=='W') {
-	  write_test_32b((uint32_t *) mem_test_addr, mem_test_data);
-	  uart_putstring ( "0x" );
-	  uart_printhex ( mem_test_data );
-	  uart_putstring ( "=> @0x" );
-	  uart_printhex ( mem_test_addr );
-	  uart_putchar ( 0xa );
-	}
-
-	if (uart_byte=='+') {
-          mem_test_addr = 0x80008008;
-	  my_val32 = read_test_32b((uint32_t *) mem_test_addr);
-          my_val32++;
-	  write_test_32b((uint32_t *) mem_test_addr, my_val32);
-	  uart_putstring ( "0x" );
-	  uart_printhex ( my_val32 );
-	  uart_putchar ( 0xa );
-	}
-
-	if (uart_byte=='-') {
-          mem_test_addr = 0x80008008;
-	  my_val32 = read_test_32b((uint32_t *) mem_test_addr);
-          my_val32--;
-	  write_test_32b((uint32_t *) mem_test_addr, my_val32);
-	  uart_putstring ( "0x" );
-	  uart_printhex ( my_val32 );
-	  uart_putchar ( 0xa );
-	}
-
-	if ((uart_byte=='!')) { /* load new soft */
-	  uart_putchar ( '!' );
-	  uart_putchar ( 0xa );
-	  asm ( "call 0x10000000" ); /* call load_bitstream */
-	}
-
-	if ((uart_byte=='%')) { /* robot reset */
-	  uart_putstring ( "RESET" );
-	  uart_putchar ( 0xa );
-	  robot_reg[R_ROBOT_RESET] = 1;
-	  robot_reg[R_ROBOT_RESET] = 0;
-
-	  robot_timer_val = robot_reg[R_ROBOT_TIMER];
-	  robot_sync_barrier = robot_timer_val + ROBOT_SAMPLING_INT;
-	}
-      }
-
-      robot_timer_val = robot_reg[R_ROBOT_TIMER];
-      robot_timer_val_ms = robot_timer_val/1000;
-
-
-      asm ( "nop" );
-      leds ^= mask;
-      asm ( "nop" );
-
-      loop_cnt++;
-
-      do {
-	robot_timer_val = robot_reg[R_ROBOT_TIMER];
-      } while (robot_timer_val < robot_sync_barrier);
+    sched_init ();
+    loop_stats_reset ();
+    trace_init ();
+    trace_config ( TRACE_WATERMARK,
+                   I2C_TRACE_CTRL_IRQ_LEON | I2C_TRACE_CTRL_IRQ_HOST );
+    msi2c_init ( 400 );
+    msi2c_mon_n = 0;
+    us_init ( US_CTRL_ENABLE );
+    speed_pid_init ();
+    input_state = IS_IDDLE;
+    control_task_id  = sched_add ( control_task, ROBOT_SAMPLING_INT, 0 );
+    /* flux de snapshots suspendu jusqu'a la commande 'S' */
+    snapshot_task_id = sched_add ( snapshot_task, 0, 1 );
+    if ((control_task_id < 0) || (snapshot_task_id < 0) ||
+        (sched_add_bg ( monitor_task ) < 0) ||
+        (sched_add_bg ( uart_tx_task ) < 0) ||
+        (sched_add_bg ( hwmath_task ) < 0) ||
+        (sched_add_bg ( speed_pid_task ) < 0) ||
+        (sched_add_bg ( msi2c_task ) < 0)) {
+      /* table des taches pleine (SCHED_MAX_TASKS) : pas de boucle robot
+         incomplete */
+      uart_putstring ( "ERREUR : sched_add" );
+      uart_putchar ( 0xa );
+      uart_flush ();
+      for (;;);
     }
+    sched_start ( robot_reg[R_ROBOT_TIMER] );
+
+    sched_run ();
 
     return 0;
 }
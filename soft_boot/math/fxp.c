@@ -0,0 +1,260 @@
+#include "fxp.h"
+
+int32_t fxp_div_q ( int32_t a, int32_t b, int q )
+{
+  if (b == 0)
+    return ( a < 0 ) ? FXP_MIN : FXP_MAX;
+
+#ifdef __sparc__
+  {
+    /* dividende 64 bits a << q dans %y:lo, sdiv sature le quotient */
+    int32_t hi = a >> (32-q);
+    uint32_t lo = ( uint32_t ) a << q;
+    int32_t r;
+
+    asm volatile ( "wr %1, 0, %%y\n\t"
+                   "nop\n\tnop\n\tnop\n\t"
+                   "sdiv %2, %3, %0"
+                   : "=r" ( r ) : "r" ( hi ), "r" ( lo ), "r" ( b ));
+    return r;
+  }
+#else
+  {
+    int64_t r = (( int64_t ) a << q ) / b;
+
+    if (r > FXP_MAX) return FXP_MAX;
+    if (r < FXP_MIN) return FXP_MIN;
+    return ( int32_t ) r;
+  }
+#endif
+}
+
+q15_48_t fxp_mul_q48 ( q15_48_t a, q15_48_t b )
+{
+  uint32_t al = ( uint32_t ) a, ah = ( uint32_t ) ( a >> 32 );
+  uint32_t bl = ( uint32_t ) b, bh = ( uint32_t ) ( b >> 32 );
+  uint64_t p0, p1, p2, mid, hi;
+
+  /* produit non signe 128 bits en 4 umul : w3:w2 = hi, w1 = mid */
+  p0 = fxp_umul64 ( al, bl );
+  p1 = fxp_umul64 ( ah, bl );
+  p2 = fxp_umul64 ( al, bh );
+  mid = ( p0 >> 32 ) + ( uint32_t ) p1;
+  mid += ( uint32_t ) p2;
+  hi = fxp_umul64 ( ah, bh ) + ( p1 >> 32 ) + ( p2 >> 32 ) + ( mid >> 32 );
+
+  /* correction signee : - b.2^64 si a < 0, - a.2^64 si b < 0 */
+  if (a < 0) hi -= ( uint64_t ) b;
+  if (b < 0) hi -= ( uint64_t ) a;
+
+  /* bits 111..48 */
+  return ( q15_48_t ) (( hi << 16 ) | (( uint32_t ) mid >> 16 ));
+}
+
+/* racine bit a bit sur 32 bits (Turkowski, "Fixed Point Square Root") :
+   2 bits du radicande par tour, 16 + 8 tours pour 16 bits de fraction */
+q16_16_t fxp_sqrt ( q16_16_t x )
+{
+  uint32_t root = 0;
+  uint32_t rem_hi = 0;
+  uint32_t rem_lo = ( uint32_t ) x;
+  uint32_t test_div;
+  int count;
+
+  if (x <= 0)
+    return 0;
+
+  for (count=0; count<24; count++) {
+    rem_hi = ( rem_hi << 2 ) | ( rem_lo >> 30 );
+    rem_lo <<= 2;
+    root <<= 1;
+    test_div = ( root << 1 ) + 1;
+    if (rem_hi >= test_div) {
+      rem_hi -= test_div;
+      root++;
+    }
+  }
+  return ( q16_16_t ) root;
+}
+
+/* 2/pi en Q2.30 : rad Q16.16 * 2/pi = quarts de tour Q.46, dont les 32
+   bits sous la virgule binaire 30 forment l'angle binaire */
+#define FXP_2_PI_Q30   0x28be60dc
+/* pi en Q2.29 */
+#define FXP_PI_Q29     0x6487ed51
+
+fxp_bam_t fxp_rad_to_bam ( q16_16_t rad )
+{
+  return ( fxp_bam_t ) fxp_mul_q ( rad, FXP_2_PI_Q30, 16 );
+}
+
+q16_16_t fxp_bam_to_rad ( fxp_bam_t bam )
+{
+  /* (bam / 2^31) * pi, de Q.60 vers Q16.16 */
+  return ( q16_16_t ) (( fxp_smul64 ( ( int32_t ) bam, FXP_PI_Q29 ) +
+                         ( 1LL << 43 )) >> 44 );
+}
+
+q16_16_t fxp_angle_norm ( q16_16_t rad )
+{
+  if ((rad >= -Q16_16_PI) && (rad <= Q16_16_PI))
+    return rad;
+  return fxp_bam_to_rad ( fxp_rad_to_bam ( rad ));
+}
+
+/* Chebyshev de sin(pi/2 x) sur [0, 1], termes impairs : coefficients de
+   sin_cos_cheby.vhd (Q15.48, cf tools/math/cheby_fxp.c) ramenes en Q3.28.
+   Les b_r de Clenshaw restent sous 1.3, 2 x b_r sous 2.6 : Q3.28 suffit */
+#define FXP_CHEBY_N    12
+
+static const int32_t fxp_cheby_sin[FXP_CHEBY_N] = {
+  0, 0x12236c46, 0, -0x02358ac0, 0, 0x001264db,
+  0, -0x000046fd, 0, 0x0000009e, 0, -0x00000001
+};
+
+static int32_t fxp_cheby_eval ( int32_t x )
+{
+  int32_t b_r, b_r1 = 0, b_r2 = 0, x_b_r1;
+  int k;
+
+  for (k=FXP_CHEBY_N-1; k>0; k--) {
+    x_b_r1 = fxp_mul_q ( x, b_r1, 28 );
+    b_r = fxp_cheby_sin[k] + x_b_r1 + x_b_r1 - b_r2;
+    b_r2 = b_r1;
+    b_r1 = b_r;
+  }
+  return fxp_mul_q ( x, b_r1, 28 ) - b_r2 + fxp_cheby_sin[0];
+}
+
+/* Q3.28 -> Q1.30, borne a +/-1 */
+static q1_30_t fxp_cheby_out ( int32_t v, int neg )
+{
+  if (v >= ( Q1_30_ONE >> 2 ))
+    v = Q1_30_ONE;
+  else if (v <= 0)
+    v = 0;
+  else
+    v <<= 2;
+  return neg ? -v : v;
+}
+
+void fxp_sincos_bam ( fxp_bam_t bam, q1_30_t *s, q1_30_t *c )
+{
+  /* quadrant et position dans le quadrant, comme sin_cos_cheby.vhd */
+  uint32_t quad = bam >> 30;
+  int32_t x = ( int32_t ) (( bam & 0x3fffffff ) >> 2 ); /* Q3.28, [0, 1[ */
+  int32_t x_c = ( 1 << 28 ) - x;
+
+  if (s != NULL) {
+    *s = fxp_cheby_out ( fxp_cheby_eval ( (quad & 1) ? x_c : x ),
+                         quad >= 2 );
+  }
+  if (c != NULL) {
+    *c = fxp_cheby_out ( fxp_cheby_eval ( (quad & 1) ? x : x_c ),
+                         (quad == 1) || (quad == 2) );
+  }
+}
+
+void fxp_sincos ( q16_16_t rad, q1_30_t *s, q1_30_t *c )
+{
+  fxp_sincos_bam ( fxp_rad_to_bam ( rad ), s, c );
+}
+
+q1_30_t fxp_sin ( q16_16_t rad )
+{
+  q1_30_t s;
+
+  fxp_sincos_bam ( fxp_rad_to_bam ( rad ), &s, NULL );
+  return s;
+}
+
+q1_30_t fxp_cos ( q16_16_t rad )
+{
+  q1_30_t c;
+
+  fxp_sincos_bam ( fxp_rad_to_bam ( rad ), NULL, &c );
+  return c;
+}
+
+/* 2/pi en Q15.48, comme sin_cos_cheby.vhd */
+#define FXP_2_PI_Q48   0x0000a2f9836e4e44LL
+
+void fxp_sincos_q48 ( q15_48_t rad, q15_48_t *s, q15_48_t *c )
+{
+  q1_30_t s30, c30;
+
+  /* quarts de tour Q15.48 : les bits 49..18 sont l'angle binaire */
+  fxp_sincos_bam (( fxp_bam_t ) ( fxp_mul_q48 ( rad, FXP_2_PI_Q48 ) >> 18 ),
+                  &s30, &c30 );
+  if (s != NULL) *s = (( q15_48_t ) s30 ) << 18;
+  if (c != NULL) *c = (( q15_48_t ) c30 ) << 18;
+}
+
+/* atan(2^-i) en Q2.29 */
+#define FXP_CORDIC_N   20
+
+static const int32_t fxp_cordic_atan[FXP_CORDIC_N] = {
+  0x1921fb54, 0x0ed63383, 0x07d6dd7e, 0x03fab753, 0x01ff55bb, 0x00ffeaae,
+  0x007ffd55, 0x003fffab, 0x001ffff5, 0x000fffff, 0x00080000, 0x00040000,
+  0x00020000, 0x00010000, 0x00008000, 0x00004000, 0x00002000, 0x00001000,
+  0x00000800, 0x00000400
+};
+
+q16_16_t fxp_atan2 ( int32_t y, int32_t x )
+{
+  uint32_t ax, ay, m;
+  int32_t z, t;
+  int i;
+
+  if ((x == 0) && (y == 0))
+    return 0;
+
+  /* normalisation : max(|x|, |y|) dans [2^28, 2^29[, le gain du CORDIC
+     (1.65) et la rotation initiale (sqrt 2) restent sous 2^31 */
+  ax = ( x < 0 ) ? -( uint32_t ) x : ( uint32_t ) x;
+  ay = ( y < 0 ) ? -( uint32_t ) y : ( uint32_t ) y;
+  m = ax | ay;
+  if (m >= ( 1U << 29 )) {
+    i = ( m >= ( 1U << 30 )) ? (( m >= ( 1U << 31 )) ? 3 : 2 ) : 1;
+    x >>= i;
+    y >>= i;
+  } else {
+    while (m < ( 1U << 28 )) {
+      m <<= 1;
+      x <<= 1;
+      y <<= 1;
+    }
+  }
+
+  /* demi-plan droit */
+  z = 0;
+  if (x < 0) {
+    t = x;
+    if (y >= 0) {
+      x = y;
+      y = -t;
+      z = FXP_PI_Q29 >> 1;
+    } else {
+      x = -y;
+      y = t;
+      z = -( FXP_PI_Q29 >> 1 );
+    }
+  }
+
+  /* mode vectoriel : y -> 0, z cumule l'angle */
+  for (i=0; i<FXP_CORDIC_N; i++) {
+    t = x;
+    if (y > 0) {
+      x += y >> i;
+      y -= t >> i;
+      z += fxp_cordic_atan[i];
+    } else {
+      x -= y >> i;
+      y += t >> i;
+      z -= fxp_cordic_atan[i];
+    }
+  }
+
+  /* Q2.29 -> Q16.16 */
+  return ( z + ( 1 << 12 )) >> 13;
+}
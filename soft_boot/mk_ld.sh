@@ -38,6 +38,7 @@ cat <<EOF
 PROVIDE(__RAM_BEGIN = 0x40000000);
 PROVIDE(__RAM_END = __RAM_BEGIN + 8k);
 PROVIDE(_stack_top = __RAM_END - 16);
+PROVIDE(_boot_warm_flag = __RAM_END - 8);
 
 MEMORY {
   rom     : ORIGIN = 0x00000000, LENGTH = 16k
@@ -96,7 +97,10 @@ if [ "$MODE" = exe ]
 then
     echo -n " (NOLOAD)"
 fi
-echo " : AT(ADDR(.rom_rodata) + SIZEOF(.rom_rodata)) {"
+# image de .data en ROM juste apres .rodata : "AT > rom" (et non plus
+# AT(ADDR(.rom_rodata) + SIZEOF(.rom_rodata))) pour que ld verifie que
+# l'image tient dans la ROM (sinon la copie lit au-dela de la ROM)
+echo " : {"
 echo "    _rom_data_start = .;"
 for i in "$@"
 do
@@ -106,8 +110,10 @@ do
     fi
     echo "    $i (*data*)"
 done
+echo "    . = ALIGN(4);"
 echo "    _rom_data_end = .;"
-echo "  } > ram"
+echo "  } > ram AT > rom"
+echo "  _rom_data_load = LOADADDR(.rom_data);"
 
 # bss section of rom code
 echo -n "  .rom_bss BLOCK(0x10)"
@@ -123,9 +129,10 @@ do
     then
        continue
     fi
-    echo "    $i (.bss)"
+    echo "    $i (.bss .bss.*)"
     echo "    $i (COMMON)"
 done
+echo "    . = ALIGN(4);"
 echo "    _rom_bss_end = .;"
 echo "  } > ram"
 
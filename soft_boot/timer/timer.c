@@ -35,12 +35,6 @@ void timer_enable () {
     struct lregs *hw = ( struct lregs * )( PREGS );
     hw->irqmask &= ~( 1<<IRQ_TIMER1 );
 
-/* FIXME : DEBUG + */
-    /* Contournement pour un bug d'init de la section .data */
-    timer_config.prescaler = PRESCALER - 1;
-    timer_config.counter = TIMER_1KHZ*500;
-/* FIXME : DEBUG - */
-
     hw->scalercnt  = timer_config.prescaler;
     hw->scalerload = timer_config.prescaler;
 
@@ -29,12 +29,22 @@
 
 typedef struct {
     uint8_t buffer[256];
-    uint8_t write_idx;
-    uint8_t read_idx;
+    volatile uint8_t write_idx; /* modifies sous IT */
+    volatile uint8_t read_idx;
 } uart_fifo_t;
 
 uart_fifo_t uart1_fifo;
 
+/* Emission bufferisee : uart_putchar() ne fait que remplir uart1_tx_fifo,
+   qui est vide par uart_tx_poll() (appele depuis la boucle robot) et, si
+   UART_TX_IT est defini, par l'IT "transmitter hold register empty"
+   (niveau 3, trap 0x13, uart_it.S).
+   En mode non bloquant, un octet qui ne tient pas dans la fifo est perdu
+   et compte dans uart_tx_dropped. */
+uart_fifo_t uart1_tx_fifo;
+uint32_t uart_tx_dropped;
+static int uart_tx_blocking;
+
 struct baudrate_conv {
     enum uart_baudrate_t bd;
     uint32_t scaler;
@@ -104,17 +114,20 @@ static void uart_init_lowlevel ( int scaler, int ctrl ) {
     hw->irqmask &= ~( 1 << IRQ_UART1 );
 
     hw->uartscaler1 = scaler;
-    hw->uartctrl1   = ctrl | UART_CONTROL_RI;
+    hw->uartctrl1   = ctrl;
     uart1_fifo.read_idx  = 0;
     uart1_fifo.write_idx = 0;
+    uart1_tx_fifo.read_idx  = 0;
+    uart1_tx_fifo.write_idx = 0;
+    uart_tx_dropped  = 0;
+    uart_tx_blocking = 1;
 
     hw->irqmask |= ( 1 << IRQ_UART1 );
 }
 
-#if 0
-void uart_calibrate () {
+int uart_calibrate ( uint32_t max_polls ) {
     struct lregs *hw = ( struct lregs * )( PREGS );
-    hw->irqmask &= ~( 1 << IRQ_UART1 ); // CAUTION: interruptions disabled but never re-enabled! (FF)
+    hw->irqmask &= ~( 1 << IRQ_UART1 ); // re-enabled by uart_init ()
 
     if ( hw->uartctrl1 & UART_CONTROL_TE ) {
         uart_flush ();
@@ -124,10 +137,16 @@ void uart_calibrate () {
     hw->uartstatus1 = 0x80; // reset autobaud
     hw->uartctrl1   = uart_get_parity_control () | UART_CONTROL_RE | UART_CONTROL_EC;
 
-    while ( !( hw->uartstatus1 & UART_STATUS_AL ));
+    while ( !( hw->uartstatus1 & UART_STATUS_AL )) {
+        if (( max_polls != 0 ) && ( --max_polls == 0 )) {
+            hw->uartctrl1 = 0;
+            return -1;
+        }
+    }
     hw->uartctrl1 &= ~UART_CONTROL_EC;
 
-    uint32_t sclr = (( hw->uartctrl1 ) >> 16 ) - 1;
+    /* brate mesure = 1/8 de bit en cycles, le scaler compte brate+1 */
+    uint32_t sclr = ((( hw->uartctrl1 ) >> 16 ) & 0x7fff ) - 1;
     uart_set_scaler ( BAUTOBAUD, sclr );
 
     uint8_t byte = hw->uartdata1;
@@ -138,45 +157,95 @@ void uart_calibrate () {
     ( void ) byte;
 
     hw->uartctrl1 = 0;
+    return 0;
 }
-#endif
 
 void uart_init ( enum uart_baudrate_t bd ) {
-    int ctrl = uart_get_parity_control () | UART_CONTROL_RE | UART_CONTROL_TE | UART_CONTROL_RI;
-
-/* FIXME : DEBUG + */
-    /* Contournement pour un bug d'init de la section .data */
-    uart_baudrate_table[0].bd     = B9600;
-    uart_baudrate_table[0].scaler = BAUDRATE (   9600 );
-    uart_baudrate_table[0].bd     = B19200;
-    uart_baudrate_table[0].scaler = BAUDRATE (  19200 );
-    uart_baudrate_table[0].bd     = B38400;
-    uart_baudrate_table[0].scaler = BAUDRATE (  38400 );
-    uart_baudrate_table[0].bd     = B57600;
-    uart_baudrate_table[0].scaler = BAUDRATE (  57600 );
-    uart_baudrate_table[0].bd     = B115200;
-    uart_baudrate_table[0].scaler = BAUDRATE ( 115200 );
-    uart_baudrate_table[0].bd     = BAUTOBAUD;
-    uart_baudrate_table[0].scaler = BAUDRATE ( 115200 );
-/* FIXME : DEBUG - */
+    /* pas d'IT de reception : la reception est scrutee (UART_STATUS_DR), et
+       l'IT de l'UART est cablee sur l'IU (core.vhd) */
+    int ctrl = uart_get_parity_control () | UART_CONTROL_RE | UART_CONTROL_TE;
 
     uart_init_lowlevel ( uart_get_scaler ( bd ), ctrl );
 }
 
+void uart_set_tx_blocking ( int blocking ) {
+    uart_tx_blocking = blocking;
+}
+
+int uart_tx_room () {
+    return ( uint8_t )( uart1_tx_fifo.read_idx - uart1_tx_fifo.write_idx - 1 );
+}
+
+#ifdef UART_TX_IT
+/* IT masquees (PIL 15) le temps de toucher a la fifo, cf msi2c.c */
+static uint32_t uart_lock () {
+    uint32_t psr;
+
+    asm volatile ( "mov %%psr, %0" : "=r" ( psr ));
+    asm volatile ( "mov %0, %%psr; nop; nop; nop"
+                   : : "r" ( psr | PSR_ICC_PIL ) : "memory", "cc" );
+    return psr;
+}
+
+static void uart_unlock ( uint32_t psr ) {
+    uint32_t cur;
+
+    asm volatile ( "mov %%psr, %0" : "=r" ( cur ));
+    cur = ( cur & ~PSR_ICC_PIL ) | ( psr & PSR_ICC_PIL );
+    asm volatile ( "mov %0, %%psr; nop; nop; nop"
+                   : : "r" ( cur ) : "memory", "cc" );
+}
+#endif
+
+void uart_tx_poll () {
+    struct lregs *hw = ( struct lregs * )( PREGS );
+#ifdef UART_TX_IT
+    uint32_t psr = uart_lock ();
+
+    /* TI est mis avant d'ecrire l'octet : l'IT du passage dans le registre
+       a decalage n'est pas perdue (memorisee dans core.vhd, prise au
+       demasquage) */
+    if ( uart1_tx_fifo.read_idx != uart1_tx_fifo.write_idx ) {
+        hw->uartctrl1 |= UART_CONTROL_TI;
+    } else {
+        hw->uartctrl1 &= ~UART_CONTROL_TI;
+    }
+#endif
+    /* pas de fifo materielle : un octet au plus par appel */
+    if (( uart1_tx_fifo.read_idx != uart1_tx_fifo.write_idx ) &&
+        ( hw->uartstatus1 & UART_STATUS_TH )) {
+        hw->uartdata1 = ( unsigned int ) uart1_tx_fifo.buffer[uart1_tx_fifo.read_idx++];
+    }
+#ifdef UART_TX_IT
+    uart_unlock ( psr );
+#endif
+}
+
 void uart_flush () {
     struct lregs *hw = ( struct lregs * )( PREGS );
 
+    while ( uart1_tx_fifo.read_idx != uart1_tx_fifo.write_idx ) {
+        uart_tx_poll ();
+    }
+
     while (( hw->uartstatus1 & ( UART_STATUS_TS | UART_STATUS_TH )) != ( UART_STATUS_TS | UART_STATUS_TH ));
 }
 
 void uart_putchar ( uint8_t byte ) {
-    struct lregs *hw = ( struct lregs * )( PREGS );
+    uint8_t next_idx = uart1_tx_fifo.write_idx + 1;
 
-    /* wait until transmitter hold register is empty */
-    while ( ! ( hw->uartstatus1 & UART_STATUS_TH )) {
+    while ( next_idx == uart1_tx_fifo.read_idx ) {
+        if ( !uart_tx_blocking ) {
+            uart_tx_dropped++;
+            return;
+        }
+        uart_tx_poll ();
     }
 
-    hw->uartdata1 = ( unsigned int ) byte;
+    uart1_tx_fifo.buffer[uart1_tx_fifo.write_idx] = byte;
+    uart1_tx_fifo.write_idx = next_idx;
+
+    uart_tx_poll ();
 }
 
 int uart_getchar_in_fifo ( uint8_t *byte ) {
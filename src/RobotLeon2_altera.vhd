@@ -69,34 +69,54 @@ entity RobotLeon2_altera is
     ; SPIM1_MISO          : out std_logic
 --    ; GPIO_105            : in std_logic
     ; SPIM1_SCK           : out std_logic
-    ; GPIO_106            : in std_logic
-    ; GPIO_107            : in std_logic
-    ; GPIO_108            : in std_logic
-    ; GPIO_109            : in std_logic
+--    ; GPIO_106            : in std_logic
+    ; US1_TRIG            : out std_logic
+--    ; GPIO_107            : in std_logic
+    ; US1_ECHO            : in std_logic
+--    ; GPIO_108            : in std_logic
+    ; US2_TRIG            : out std_logic
+--    ; GPIO_109            : in std_logic
+    ; US2_ECHO            : in std_logic
     ; GPIO_110            : in std_logic
     ; GPIO_111            : in std_logic
-    ; GPIO_112            : in std_logic
-    ; GPIO_113            : in std_logic
-    ; GPIO_114            : in std_logic
+--    ; GPIO_112            : in std_logic
+    ; US3_TRIG            : out std_logic
+--    ; GPIO_113            : in std_logic
+    ; US3_ECHO            : in std_logic
+--    ; GPIO_114            : in std_logic
+    ; PWM_PUMP1           : out std_logic
     ; SLV_SPI1_SCK        : in std_logic
-    ; GPIO_116            : in std_logic
+--    ; GPIO_116            : in std_logic
+    ; PWM_PUMP2           : out std_logic
     ; SLV_SPI1_MISO       : out std_logic
     ; GPIO_118            : in std_logic
     ; SLV_SPI1_MOSI       : in std_logic
-    ; GPIO_120            : in std_logic
-    ; GPIO_121            : in std_logic
-    ; GPIO_122            : in std_logic
+--    ; GPIO_120            : in std_logic
+    ; HOST_IRQ            : out std_logic
+--    ; GPIO_121            : in std_logic
+    ; PWM_SERVO2          : out std_logic
+--    ; GPIO_122            : in std_logic
+    ; PWM_SERVO3          : out std_logic
     ; GPIO_123            : in std_logic
-    ; GPIO_124            : in std_logic
-    ; GPIO_125            : in std_logic
-    ; GPIO_126            : in std_logic
-    ; GPIO_127            : in std_logic
-    ; GPIO_128            : in std_logic
-    ; GPIO_129            : in std_logic
-    ; GPIO_130            : in std_logic
+--    ; GPIO_124            : in std_logic
+    ; STEPPER_STEP        : out std_logic
+--    ; GPIO_125            : in std_logic
+    ; STEPPER_DIR         : out std_logic
+--    ; GPIO_126            : in std_logic
+    ; STEPPER_N_EN        : out std_logic
+--    ; GPIO_127            : in std_logic
+    ; STEPPER_PH0         : out std_logic
+--    ; GPIO_128            : in std_logic
+    ; STEPPER_PH1         : out std_logic
+--    ; GPIO_129            : in std_logic
+    ; STEPPER_PH2         : out std_logic
+--    ; GPIO_130            : in std_logic
+    ; STEPPER_PH3         : out std_logic
     ; GPIO_131            : in std_logic
-    ; GPIO_132            : in std_logic
-    ; GPIO_133            : in std_logic
+--    ; GPIO_132            : in std_logic
+    ; I2C_MST_SDA         : inout std_logic
+--    ; GPIO_133            : in std_logic
+    ; I2C_MST_SCL         : inout std_logic
 
     ; GPIO_2_IN0          : in std_logic
     ; GPIO_2_IN1          : in std_logic
@@ -175,6 +195,9 @@ component core
     slv_mosi            : in  std_logic;
     slv_miso            : out std_logic;
 
+    -- IT hote
+    host_irq            : out std_logic;
+
     -- ROBOT
     -- hcsr04 interfaces
     us1_trig            : out std_logic;
@@ -191,6 +214,15 @@ component core
     pwm_magnet1         : out std_logic;
     pwm_magnet2         : out std_logic;
 
+    -- stepper interface
+    stepper_step        : out std_logic;
+    stepper_dir         : out std_logic;
+    stepper_n_en        : out std_logic;
+    stepper_phase       : out std_logic_vector(3 downto 0);
+
+    -- dip switches
+    dip_sw              : in std_logic_vector(3 downto 0);
+
     -- LEDS
     leds                : out std_logic_vector(7 downto 0);
 
@@ -235,13 +267,20 @@ signal debug_test       : std_logic_vector(31 downto 0);
 
 signal iSLV_SPI1_MISO   : std_logic;
 
+signal iSTEPPER_PHASE   : std_logic_vector(3 downto 0);
+
 signal iDEBUG_SPI       : std_logic;
 
+signal iDIP_SW          : std_logic_vector(3 downto 0);
+
 begin
 
   -- reset management
   n_reset_i <= N_RESET;
 
+  -- dip switches (DIP_SW_0 : boot rapide, cf soft_boot/main.c)
+  iDIP_SW <= DIP_SW_3 & DIP_SW_2 & DIP_SW_1 & DIP_SW_0;
+
   -- PLL
   my_pll : my_altera_pll
     port map(
@@ -271,19 +310,12 @@ begin
       , dtx         => tx2
 
       -- i2c master
-      -- FIXME : TODO
-      -- , i2c_mst_sda_i  => i2c_mst_sda_i
-      -- , i2c_mst_sda_o  => i2c_mst_sda_o
-      -- , i2c_mst_sda_en => i2c_mst_sda_en
-      -- , i2c_mst_scl_i  => i2c_mst_scl_i
-      -- , i2c_mst_scl_o  => i2c_mst_scl_o
-      -- , i2c_mst_scl_en => i2c_mst_scl_en
-      , i2c_mst_sda_i  => '0'
-      , i2c_mst_sda_o  => open
-      , i2c_mst_sda_en => open
-      , i2c_mst_scl_i  => '0'
-      , i2c_mst_scl_o  => open
-      , i2c_mst_scl_en => open
+      , i2c_mst_sda_i  => i2c_mst_sda_i
+      , i2c_mst_sda_o  => i2c_mst_sda_o
+      , i2c_mst_sda_en => i2c_mst_sda_en
+      , i2c_mst_scl_i  => i2c_mst_scl_i
+      , i2c_mst_scl_o  => i2c_mst_scl_o
+      , i2c_mst_scl_en => i2c_mst_scl_en
 
       -- i2c slave
       -- FIXME : TODO
@@ -315,23 +347,33 @@ begin
       , slv_mosi    => SLV_SPI1_MOSI
       , slv_miso    => iSLV_SPI1_MISO
 
+      -- IT hote (fifo de trace au seuil)
+      , host_irq    => HOST_IRQ
+
       -- ROBOT
-      -- hcsr04 interfaces
-      -- FIXME : TODO
-      , us1_trig => open
-      , us1_echo => '0'
-      , us2_trig => open
-      , us2_echo => '0'
-      , us3_trig => open
-      , us3_echo => '0'
+      -- hcsr04 interfaces (echo en 5V : a ramener en 3.3V)
+      , us1_trig => US1_TRIG
+      , us1_echo => US1_ECHO
+      , us2_trig => US2_TRIG
+      , us2_echo => US2_ECHO
+      , us3_trig => US3_TRIG
+      , us3_echo => US3_ECHO
 
       -- misc actuator interfaces
-      -- FIXME : TODO
       , pwm_servo1   => PWM0
-      , pwm_servo2   => open
-      , pwm_servo3   => open
-      , pwm_magnet1  => open
-      , pwm_magnet2  => open
+      , pwm_servo2   => PWM_SERVO2
+      , pwm_servo3   => PWM_SERVO3
+      , pwm_magnet1  => PWM_PUMP1
+      , pwm_magnet2  => PWM_PUMP2
+
+      -- stepper interface
+      , stepper_step  => STEPPER_STEP
+      , stepper_dir   => STEPPER_DIR
+      , stepper_n_en  => STEPPER_N_EN
+      , stepper_phase => iSTEPPER_PHASE
+
+      -- dip switches
+      , dip_sw      => iDIP_SW
 
       -- LEDS
       , leds        => core_leds
@@ -340,23 +382,15 @@ begin
       , debug_test  => debug_test
       );
 
--- FIXME : TODO ++
--- disble this when I2C master enabled
-  i2c_mst_sda_o <= '0';
-  i2c_mst_sda_en <= '0';
-  i2c_mst_scl_o <= '0';
-  i2c_mst_scl_en <= '0';
--- FIXME : TODO --
+-- ** i2c master ** (drain ouvert, pull-ups externes)
+  I2C_MST_SDA <= i2c_mst_sda_o when (i2c_mst_sda_en = '1') else 'Z';
+  i2c_mst_sda_i <= I2C_MST_SDA;
+
+  I2C_MST_SCL <= i2c_mst_scl_o when (i2c_mst_scl_en = '1') else 'Z';
+  i2c_mst_scl_i <= I2C_MST_SCL;
 
 
 -- FIXME : TODO ++
----- ** i2c master **
---  I2C_SDA_MASTER <= i2c_mst_sda_o when (i2c_mst_sda_en = '1') else 'Z';
---  i2c_mst_sda_i <= I2C_SDA_MASTER;
---
---  I2C_SCL_MASTER <= i2c_mst_scl_o when (i2c_mst_scl_en = '1') else 'Z';
---  i2c_mst_scl_i <= I2C_SCL_MASTER;
---
 ---- ** i2c slave **
 --  I2C_SDA_SLAVE <= i2c_slv_sda_o when (i2c_slv_sda_en = '1') else 'Z';
 --  i2c_slv_sda_i <= I2C_SDA_SLAVE;
@@ -438,34 +472,34 @@ begin
 --                    GPIO_103   when (debug_test = X"80000027") else
 --                    GPIO_104   when (debug_test = X"80000028") else
 --                    GPIO_105   when (debug_test = X"80000029") else
-                    GPIO_106   when (debug_test = X"8000002a") else
-                    GPIO_107   when (debug_test = X"8000002b") else
-                    GPIO_108   when (debug_test = X"8000002c") else
-                    GPIO_109   when (debug_test = X"8000002d") else
+--                  GPIO_106   when (debug_test = X"8000002a") else
+--                  GPIO_107   when (debug_test = X"8000002b") else
+--                  GPIO_108   when (debug_test = X"8000002c") else
+--                  GPIO_109   when (debug_test = X"8000002d") else
                     GPIO_110   when (debug_test = X"8000002e") else
                     GPIO_111   when (debug_test = X"8000002f") else -- FAIL !
-                    GPIO_112   when (debug_test = X"80000030") else
-                    GPIO_113   when (debug_test = X"80000031") else
-                    GPIO_114   when (debug_test = X"80000032") else
+--                  GPIO_112   when (debug_test = X"80000030") else
+--                  GPIO_113   when (debug_test = X"80000031") else
+--                  GPIO_114   when (debug_test = X"80000032") else
 --                    GPIO_115   when (debug_test = X"80000033") else
-                    GPIO_116   when (debug_test = X"80000034") else
+--                  GPIO_116   when (debug_test = X"80000034") else
 --                    GPIO_117   when (debug_test = X"80000035") else
                     GPIO_118   when (debug_test = X"80000036") else
 --                    GPIO_119   when (debug_test = X"80000037") else
-                    GPIO_120   when (debug_test = X"80000038") else
-                    GPIO_121   when (debug_test = X"80000039") else
-                    GPIO_122   when (debug_test = X"8000003a") else
+--                    GPIO_120   when (debug_test = X"80000038") else
+--                  GPIO_121   when (debug_test = X"80000039") else
+--                  GPIO_122   when (debug_test = X"8000003a") else
                     GPIO_123   when (debug_test = X"8000003b") else -- FAIL !
-                    GPIO_124   when (debug_test = X"8000003c") else
-                    GPIO_125   when (debug_test = X"8000003d") else
-                    GPIO_126   when (debug_test = X"8000003e") else
-                    GPIO_127   when (debug_test = X"8000003f") else
-                    GPIO_128   when (debug_test = X"80000040") else
-                    GPIO_129   when (debug_test = X"80000041") else
-                    GPIO_130   when (debug_test = X"80000042") else
+--                  GPIO_124   when (debug_test = X"8000003c") else
+--                  GPIO_125   when (debug_test = X"8000003d") else
+--                  GPIO_126   when (debug_test = X"8000003e") else
+--                  GPIO_127   when (debug_test = X"8000003f") else
+--                  GPIO_128   when (debug_test = X"80000040") else
+--                  GPIO_129   when (debug_test = X"80000041") else
+--                  GPIO_130   when (debug_test = X"80000042") else
                     GPIO_131   when (debug_test = X"80000043") else -- FAIL !
-                    GPIO_132   when (debug_test = X"80000044") else
-                    GPIO_133   when (debug_test = X"80000045") else
+--                  GPIO_132   when (debug_test = X"80000044") else
+--                  GPIO_133   when (debug_test = X"80000045") else
                     GPIO_2_IN0 when (debug_test = X"80000046") else
                     GPIO_2_IN1 when (debug_test = X"80000047") else
                     GPIO_2_IN2 when (debug_test = X"80000048") else
@@ -483,6 +517,11 @@ begin
                     GPIO_212   when (debug_test = X"80000054") else
                     '1';
 
+  STEPPER_PH0 <= iSTEPPER_PHASE(0);
+  STEPPER_PH1 <= iSTEPPER_PHASE(1);
+  STEPPER_PH2 <= iSTEPPER_PHASE(2);
+  STEPPER_PH3 <= iSTEPPER_PHASE(3);
+
   SLV_SPI1_MISO <= iSLV_SPI1_MISO;
   SPIM1_MOSI <= SLV_SPI1_MOSI;
   SPIM1_MISO <= iSLV_SPI1_MISO;
@@ -50,6 +50,9 @@ entity core is
     slv_mosi : in  std_logic;
     slv_miso : out std_logic;
 
+    -- IT hote : fifo de trace au seuil (robot_reg[0x08])
+    host_irq : out std_logic;
+
     -- ROBOT
     -- hcsr04 interfaces
     us1_trig            : out std_logic;
@@ -66,6 +69,15 @@ entity core is
     pwm_magnet1         : out std_logic;
     pwm_magnet2         : out std_logic;
 
+    -- stepper interface
+    stepper_step        : out std_logic;
+    stepper_dir         : out std_logic;
+    stepper_n_en        : out std_logic;
+    stepper_phase       : out std_logic_vector(3 downto 0);
+
+    -- dip switches (lus dans robot_reg[0x01])
+    dip_sw              : in std_logic_vector(3 downto 0);
+
     -- LEDS
     leds        : out std_logic_vector(7 downto 0);
 
@@ -104,6 +116,8 @@ architecture rtl of core is
   -- IRQ
   signal i2c_mst_irq     : std_logic;
   signal spi_irq         : std_logic;
+  signal robot_irq       : std_logic;
+  signal uart1_irq       : std_logic;
 
   -- mem
   signal data_ram    : std_logic_vector(31 downto 0);
@@ -141,6 +155,9 @@ architecture rtl of core is
   end component;
 
   component robot_apb
+    generic (
+      ODOMETRY : boolean := false
+    );
     port(
         pclk                : in  std_logic
       ; presetn             : in  std_logic
@@ -163,6 +180,18 @@ architecture rtl of core is
       ; pwm_servo3          : out std_logic
       ; pwm_magnet1         : out std_logic
       ; pwm_magnet2         : out std_logic
+      -- stepper interface
+      ; stepper_step        : out std_logic
+      ; stepper_dir         : out std_logic
+      ; stepper_n_en        : out std_logic
+      ; stepper_phase       : out std_logic_vector(3 downto 0)
+      -- dip switches
+      ; dip_sw              : in std_logic_vector(3 downto 0)
+      -- codeurs en quadrature
+      ; quad_r_a            : in std_logic
+      ; quad_r_b            : in std_logic
+      ; quad_l_a            : in std_logic
+      ; quad_l_b            : in std_logic
       -- I2C slave signals
       ; sda_in_slv          : in  std_logic
       ; sda_out_slv         : out std_logic
@@ -175,6 +204,9 @@ architecture rtl of core is
       ; spi_clk             : in  std_logic
       ; spi_mosi            : in  std_logic
       ; spi_miso            : out std_logic
+      -- interruptions
+      ; irq_leon            : out std_logic
+      ; irq_host            : out std_logic
       -- debug/test
       ; debug_test          : out std_logic_vector(31 downto 0)
     );
@@ -353,8 +385,28 @@ begin
       uarti => uart1i,
       uarto => uart1o);
 
--- RIP : irq...
-  iui.irl     <= "0000";
+-- RIP : irq... (pas de controleur d'IT) : robot_apb au niveau 10 (trap
+-- 0x1a), maitre I2C au niveau 11 (trap 0x1b), UART au niveau 3 (trap 0x13),
+-- cf soft_boot/boot/trap.S
+  iui.irl     <= "1011" when (i2c_mst_irq = '1') else
+                 "1010" when (robot_irq = '1') else
+                 "0011" when (uart1_irq = '1') else
+                 "0000";
+
+-- l'IT de l'UART est une impulsion d'un cycle : on la memorise jusqu'a la
+-- prise en compte du trap de niveau 3 par l'IU (iuo.intack)
+  uart1_irq_latch : process (clk)
+  begin
+    if rising_edge(clk) then
+      if rst = '0' then
+        uart1_irq <= '0';
+      elsif uart1o.irq = '1' then
+        uart1_irq <= '1';
+      elsif (iuo.intack = '1') and (iuo.irqvec = "0011") then
+        uart1_irq <= '0';
+      end if;
+    end if;
+  end process;
 
 -- RIP : parallel I/O port...
 --  ioport0 : ioport..
@@ -371,30 +423,21 @@ begin
       prdata  => apbo(14).prdata,
       leds    => s_leds);
   
--- FIXME : DEBUG (fsck!) ++
---  i2c0 : i2c_master_top_apb
---    port map (
---      --APB interface
---      clk_i   => clk,
---      rst_i   => rst,
---      apbi    => apbi(22),
---      apbo    => apbo(22),
---      irq     => i2c_mst_irq,
---      --I2C external signals
---      sda_out => s_i2c_mst_sda_o,
---      sda_in  => s_i2c_mst_sda_i,
---      sda_oe  => s_i2c_mst_sda_oe,
---      scl_out => s_i2c_mst_scl_o,
---      scl_in  => s_i2c_mst_scl_i,
---      scl_oe  => s_i2c_mst_scl_oe);
--- FIXME : DEBUG (fsck!) ==
-  apbo(22).prdata <= (others => '0');
-  i2c_mst_irq <= '0';
-  s_i2c_mst_sda_o <= '0';
-  s_i2c_mst_sda_oe <= '0';
-  s_i2c_mst_scl_o <= '0';
-  s_i2c_mst_scl_oe <= '0';
--- FIXME : DEBUG (fsck!) --
+  i2c0 : i2c_master_top_apb
+    port map (
+      --APB interface
+      clk_i   => clk,
+      rst_i   => rst,
+      apbi    => apbi(22),
+      apbo    => apbo(22),
+      irq     => i2c_mst_irq,
+      --I2C external signals
+      sda_out => s_i2c_mst_sda_o,
+      sda_in  => s_i2c_mst_sda_i,
+      sda_oe  => s_i2c_mst_sda_oe,
+      scl_out => s_i2c_mst_scl_o,
+      scl_in  => s_i2c_mst_scl_i,
+      scl_oe  => s_i2c_mst_scl_oe);
 
 -- FIXME : DEBUG (fsck!) ++
 --  spi0 : spi_apb
@@ -416,6 +459,11 @@ begin
 -- FIXME : DEBUG (fsck!) --
 
   robot0 : robot_apb
+    -- FIXME : TODO : pas de codeurs sur la carte 2018, odometrie integree
+    -- non synthetisee (cf entrees quad_xxx a 0)
+    generic map (
+      ODOMETRY => false
+    )
     port map(
       pclk                => clk,
       presetn             => rst,
@@ -438,6 +486,19 @@ begin
       pwm_servo3          => pwm_servo3,
       pwm_magnet1         => pwm_magnet1,
       pwm_magnet2         => pwm_magnet2,
+      -- stepper interface
+      stepper_step        => stepper_step,
+      stepper_dir         => stepper_dir,
+      stepper_n_en        => stepper_n_en,
+      stepper_phase       => stepper_phase,
+      -- dip switches
+      dip_sw              => dip_sw,
+      -- codeurs en quadrature
+      -- FIXME : TODO : pas de codeurs sur la carte 2018, entrees a 0
+      quad_r_a            => '0',
+      quad_r_b            => '0',
+      quad_l_a            => '0',
+      quad_l_b            => '0',
       -- I2C slave signals
       sda_in_slv          => i2c_slv_sda_i,
       sda_out_slv         => i2c_slv_sda_o,
@@ -450,6 +511,9 @@ begin
       spi_clk             => slv_clk,
       spi_mosi            => slv_mosi,
       spi_miso            => slv_miso,
+      -- interruptions
+      irq_leon            => robot_irq,
+      irq_host            => host_irq,
       -- debug/test
       debug_test          => debug_test
       );
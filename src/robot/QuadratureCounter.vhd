@@ -39,7 +39,15 @@ entity QuadratureCounterPorts is
      SetAuxR : in std_logic;
      SetValueAuxR : in std_logic_vector(63 downto 0);
      CounterValueAuxR : buffer std_logic_vector(63 downto 0);
-     SpeedValueAuxR : out std_logic_vector(63 downto 0)
+     SpeedValueAuxR : out std_logic_vector(63 downto 0);
+     -- estimation de vitesse par mesure de periode (cf period_proc)
+     EdgeTimeout : in std_logic_vector(31 downto 0);
+     BlendLow : in std_logic_vector(15 downto 0);
+     EdgeTimerValue : out std_logic_vector(31 downto 0);
+     LastEdgeTime : out std_logic_vector(31 downto 0);
+     PeriodSpeedValue : out std_logic_vector(31 downto 0);
+     CountSpeedValue : out std_logic_vector(31 downto 0);
+     BlendedSpeedValue : out std_logic_vector(31 downto 0)
     );
 end QuadratureCounterPorts;
 
@@ -78,6 +86,38 @@ architecture QuadratureCounter of QuadratureCounterPorts is
   signal CounterValueAuxTh_old  : std_logic_vector(63 downto 0);
   signal CounterValueAuxR_old   : std_logic_vector(63 downto 0);
 
+  -- estimation par periode : vitesses en fronts comptes (un par cycle de
+  -- quadrature) par fenetre de SamplingInterval+1 cycles, Q16.16, signees
+  --  - par comptage : fronts de la derniere fenetre (bon en vitesse haute,
+  --    quantifie a 1 front par fenetre, en retard d'une demi-fenetre)
+  --  - par periode : (SamplingInterval+1) / duree entre les deux derniers
+  --    fronts, recalculee en continu (division sur 48 cycles) ; la duree
+  --    depuis le dernier front la borne (decroissance a l'arret), plus de
+  --    front pendant EdgeTimeout cycles (< 2^31) : vitesse nulle. Fronts
+  --    dates a 32 cycles pres (filtre en entree du decodeur)
+  --  - melange : periode si |fronts par fenetre| <= BlendLow, comptage au
+  --    dela de BlendLow + 2^BLEND_SHIFT, interpolation lineaire entre
+  -- modele C et choix de la fenetre / BlendLow : tools/math/quad_speed_model.c
+  constant BLEND_SHIFT : integer := 3;
+
+  signal EdgeTimer              : std_logic_vector(31 downto 0);
+  signal EdgeTime0              : std_logic_vector(31 downto 0);
+  signal EdgeTime1              : std_logic_vector(31 downto 0);
+  signal EdgeValid              : std_logic_vector(1 downto 0); -- fronts dans le meme sens
+  signal EdgeDir                : std_logic;
+  signal EdgeCount              : std_logic_vector(31 downto 0);
+  signal EdgeCount_old          : std_logic_vector(31 downto 0);
+  signal EdgesPerWindow         : std_logic_vector(31 downto 0);
+  signal iPeriodSpeed           : std_logic_vector(31 downto 0);
+  signal iCountSpeed            : std_logic_vector(31 downto 0);
+  signal DivBusy                : std_logic;
+  signal DivCnt                 : integer range 0 to 47;
+  signal DivNum                 : std_logic_vector(47 downto 0);
+  signal DivDen                 : std_logic_vector(31 downto 0);
+  signal DivRem                 : std_logic_vector(31 downto 0);
+  signal DivQuot                : std_logic_vector(47 downto 0);
+  signal DivNeg                 : std_logic;
+
 -- FIXME : DEBUG ++
   signal iSAMPLING_TIMER        : std_logic_vector(31 downto 0);
   signal in_QuadA               : std_logic;
@@ -253,12 +293,16 @@ begin --architecture QuadratureCounter
       SpeedValueAux1        <= (others => '0');
       SpeedValueAuxTh       <= (others => '0');
       SpeedValueAuxR        <= (others => '0');
+      EdgeCount_old         <= (others => '0');
+      EdgesPerWindow        <= (others => '0');
       counter := 0;
     elsif ( (clock'event) and (clock = '1') ) then
       if ( counter = SamplingInterval ) then
         counter := 0;
         SpeedValue     <= CounterValue     - CounterValue_old;
         CounterValue_old     <= CounterValue;
+        EdgesPerWindow <= EdgeCount - EdgeCount_old;
+        EdgeCount_old  <= EdgeCount;
         if (AsyncReset = '1') or (SetAux1 = '1') then
           SpeedValueAux1 <= (others => '0');
           CounterValueAux1_old <= SetValueAux1;
@@ -297,5 +341,148 @@ begin --architecture QuadratureCounter
       end if;
     end if;
   end process sampling_proc;
+
+  -- dates des fronts (compteur de cycles libre)
+  edge_proc : process( clock, RESET )
+    variable Elapsed : std_logic_vector(32 downto 0);
+  begin
+    if (RESET = '1') then
+      EdgeTimer <= (others => '0');
+      EdgeTime0 <= (others => '0');
+      EdgeTime1 <= (others => '0');
+      EdgeValid <= "00";
+      EdgeDir   <= '0';
+      EdgeCount <= (others => '0');
+    elsif ( (clock'event) and (clock = '1') ) then
+      EdgeTimer <= EdgeTimer + 1;
+      Elapsed := '0' & (EdgeTimer - EdgeTime0);
+      if (CountEnable = '1') then
+        EdgeTime1 <= EdgeTime0;
+        EdgeTime0 <= EdgeTimer;
+        EdgeDir   <= CountDirection;
+        -- inversion : la duree depuis le front precedent ne dit rien
+        if (EdgeValid = "00") or (CountDirection /= EdgeDir) then
+          EdgeValid <= "01";
+        else
+          EdgeValid <= "10";
+        end if;
+        if (CountDirection = '1') then
+          EdgeCount <= EdgeCount + 1;
+        else
+          EdgeCount <= EdgeCount - 1;
+        end if;
+      elsif (Elapsed > ('0' & EdgeTimeout)) then
+        EdgeValid <= "00";
+      end if;
+    end if;
+  end process edge_proc;
+
+  EdgeTimerValue <= EdgeTimer;
+  LastEdgeTime   <= EdgeTime0;
+
+  -- (SamplingInterval+1) << 16 / periode, division restauree 1 bit/cycle,
+  -- relancee des qu'elle finit avec la derniere periode connue
+  period_proc : process( clock, RESET )
+    variable Period  : std_logic_vector(31 downto 0);
+    variable Elapsed : std_logic_vector(31 downto 0);
+    variable Window  : std_logic_vector(31 downto 0);
+    variable NextRem : std_logic_vector(33 downto 0);
+    variable Quot    : std_logic_vector(31 downto 0);
+  begin
+    if (RESET = '1') then
+      DivBusy      <= '0';
+      DivCnt       <= 0;
+      DivNum       <= (others => '0');
+      DivDen       <= (others => '0');
+      DivRem       <= (others => '0');
+      DivQuot      <= (others => '0');
+      DivNeg       <= '0';
+      iPeriodSpeed <= (others => '0');
+    elsif ( (clock'event) and (clock = '1') ) then
+      if (DivBusy = '0') then
+        Period  := EdgeTime0 - EdgeTime1;
+        Elapsed := EdgeTimer - EdgeTime0;
+        if (('0' & Elapsed) > ('0' & Period)) then
+          Period := Elapsed;
+        end if;
+        Window := SamplingInterval + 1;
+        if (EdgeValid /= "10") then
+          -- pas encore deux fronts de suite dans le meme sens, ou arret
+          iPeriodSpeed <= (others => '0');
+        else
+          DivNum  <= "00" & Window(29 downto 0) & X"0000";
+          DivDen  <= Period;
+          DivRem  <= (others => '0');
+          DivNeg  <= not EdgeDir;
+          DivCnt  <= 47;
+          DivBusy <= '1';
+        end if;
+      else
+        NextRem := '0' & DivRem & DivNum(47);
+        DivNum  <= DivNum(46 downto 0) & '0';
+        if (NextRem >= ("00" & DivDen)) then
+          DivRem  <= NextRem(31 downto 0) - DivDen;
+          DivQuot <= DivQuot(46 downto 0) & '1';
+        else
+          DivRem  <= NextRem(31 downto 0);
+          DivQuot <= DivQuot(46 downto 0) & '0';
+        end if;
+        if (DivCnt = 0) then
+          DivBusy <= '0';
+        else
+          DivCnt <= DivCnt - 1;
+        end if;
+      end if;
+      -- resultat : le dernier bit de quotient vient d'etre decale
+      if (DivBusy = '1') and (DivCnt = 0) then
+        if (NextRem >= ("00" & DivDen)) then
+          Quot := DivQuot(30 downto 0) & '1';
+        else
+          Quot := DivQuot(30 downto 0) & '0';
+        end if;
+        if (DivQuot(46 downto 31) /= X"0000") or (Quot(31) = '1') then
+          Quot := X"7FFFFFFF";
+        end if;
+        if (DivNeg = '1') then
+          iPeriodSpeed <= 0 - Quot;
+        else
+          iPeriodSpeed <= Quot;
+        end if;
+      end if;
+    end if;
+  end process period_proc;
+
+  iCountSpeed <= EdgesPerWindow(15 downto 0) & X"0000";
+
+  blend_proc : process( clock, RESET )
+    variable Edges : std_logic_vector(32 downto 0);
+    variable Low   : std_logic_vector(32 downto 0);
+    variable Diff  : std_logic_vector(32 downto 0);
+    variable Prod  : std_logic_vector(32+BLEND_SHIFT+1 downto 0);
+  begin
+    if (RESET = '1') then
+      BlendedSpeedValue <= (others => '0');
+    elsif ( (clock'event) and (clock = '1') ) then
+      if (EdgesPerWindow(31) = '1') then
+        Edges := 0 - (EdgesPerWindow(31) & EdgesPerWindow);
+      else
+        Edges := '0' & EdgesPerWindow;
+      end if;
+      Low := '0' & X"0000" & BlendLow;
+      if (Edges <= Low) then
+        BlendedSpeedValue <= iPeriodSpeed;
+      elsif (Edges >= Low + 2**BLEND_SHIFT) then
+        BlendedSpeedValue <= iCountSpeed;
+      else
+        Diff := (iCountSpeed(31) & iCountSpeed) - (iPeriodSpeed(31) & iPeriodSpeed);
+        Edges := Edges - Low;
+        Prod := Diff * ('0' & Edges(BLEND_SHIFT-1 downto 0));
+        BlendedSpeedValue <= iPeriodSpeed + Prod(31+BLEND_SHIFT downto BLEND_SHIFT);
+      end if;
+    end if;
+  end process blend_proc;
+
+  PeriodSpeedValue <= iPeriodSpeed;
+  CountSpeedValue  <= iCountSpeed;
 		
 end QuadratureCounter;
@@ -50,7 +50,8 @@ ENTITY fifo256x32 IS
 		wrreq		: IN STD_LOGIC ;
 		empty		: OUT STD_LOGIC ;
 		full		: OUT STD_LOGIC ;
-		q		: OUT STD_LOGIC_VECTOR (31 DOWNTO 0)
+		q		: OUT STD_LOGIC_VECTOR (31 DOWNTO 0);
+		usedw		: OUT STD_LOGIC_VECTOR (7 DOWNTO 0)
 	);
 END fifo256x32;
 
@@ -60,6 +61,7 @@ ARCHITECTURE SYN OF fifo256x32 IS
 	SIGNAL sub_wire0	: STD_LOGIC ;
 	SIGNAL sub_wire1	: STD_LOGIC ;
 	SIGNAL sub_wire2	: STD_LOGIC_VECTOR (31 DOWNTO 0);
+	SIGNAL sub_wire3	: STD_LOGIC_VECTOR (7 DOWNTO 0);
 
 
 
@@ -82,6 +84,7 @@ ARCHITECTURE SYN OF fifo256x32 IS
 			empty	: OUT STD_LOGIC ;
 			full	: OUT STD_LOGIC ;
 			q	: OUT STD_LOGIC_VECTOR (31 DOWNTO 0);
+			usedw	: OUT STD_LOGIC_VECTOR (7 DOWNTO 0);
 			wrreq	: IN STD_LOGIC ;
 			aclr	: IN STD_LOGIC ;
 			data	: IN STD_LOGIC_VECTOR (31 DOWNTO 0);
@@ -93,6 +96,7 @@ BEGIN
 	empty    <= sub_wire0;
 	full    <= sub_wire1;
 	q    <= sub_wire2(31 DOWNTO 0);
+	usedw    <= sub_wire3(7 DOWNTO 0);
 
 	scfifo_component : scfifo
 	GENERIC MAP (
@@ -116,7 +120,8 @@ BEGIN
 		rdreq => rdreq,
 		empty => sub_wire0,
 		full => sub_wire1,
-		q => sub_wire2
+		q => sub_wire2,
+		usedw => sub_wire3
 	);
 
 
@@ -144,7 +149,7 @@ END SYN;
 -- Retrieval info: PRIVATE: RAM_BLOCK_TYPE NUMERIC "0"
 -- Retrieval info: PRIVATE: SYNTH_WRAPPER_GEN_POSTFIX STRING "0"
 -- Retrieval info: PRIVATE: UNDERFLOW_CHECKING NUMERIC "0"
--- Retrieval info: PRIVATE: UsedW NUMERIC "0"
+-- Retrieval info: PRIVATE: UsedW NUMERIC "1"
 -- Retrieval info: PRIVATE: Width NUMERIC "32"
 -- Retrieval info: PRIVATE: dc_aclr NUMERIC "0"
 -- Retrieval info: PRIVATE: diff_widths NUMERIC "0"
@@ -157,7 +162,7 @@ END SYN;
 -- Retrieval info: PRIVATE: sc_sclr NUMERIC "1"
 -- Retrieval info: PRIVATE: wsEmpty NUMERIC "0"
 -- Retrieval info: PRIVATE: wsFull NUMERIC "1"
--- Retrieval info: PRIVATE: wsUsedW NUMERIC "0"
+-- Retrieval info: PRIVATE: wsUsedW NUMERIC "1"
 -- Retrieval info: LIBRARY: altera_mf altera_mf.altera_mf_components.all
 -- Retrieval info: CONSTANT: ADD_RAM_OUTPUT_REGISTER STRING "OFF"
 -- Retrieval info: CONSTANT: INTENDED_DEVICE_FAMILY STRING "Cyclone II"
@@ -177,6 +182,7 @@ END SYN;
 -- Retrieval info: USED_PORT: q 0 0 32 0 OUTPUT NODEFVAL "q[31..0]"
 -- Retrieval info: USED_PORT: rdreq 0 0 0 0 INPUT NODEFVAL "rdreq"
 -- Retrieval info: USED_PORT: sclr 0 0 0 0 INPUT NODEFVAL "sclr"
+-- Retrieval info: USED_PORT: usedw 0 0 8 0 OUTPUT NODEFVAL "usedw[7..0]"
 -- Retrieval info: USED_PORT: wrreq 0 0 0 0 INPUT NODEFVAL "wrreq"
 -- Retrieval info: CONNECT: @aclr 0 0 0 0 aclr 0 0 0 0
 -- Retrieval info: CONNECT: @clock 0 0 0 0 clock 0 0 0 0
@@ -187,6 +193,7 @@ END SYN;
 -- Retrieval info: CONNECT: empty 0 0 0 0 @empty 0 0 0 0
 -- Retrieval info: CONNECT: full 0 0 0 0 @full 0 0 0 0
 -- Retrieval info: CONNECT: q 0 0 32 0 @q 0 0 32 0
+-- Retrieval info: CONNECT: usedw 0 0 8 0 @usedw 0 0 8 0
 -- Retrieval info: GEN_FILE: TYPE_NORMAL fifo256x32.vhd TRUE
 -- Retrieval info: GEN_FILE: TYPE_NORMAL fifo256x32.inc FALSE
 -- Retrieval info: GEN_FILE: TYPE_NORMAL fifo256x32.cmp TRUE
@@ -33,7 +33,12 @@ entity I2C_SLAVE_CORE is
   generic
     (
       CLK_FREQ   : natural := 25000000;
-      BAUD       : natural := 400000
+      BAUD       : natural := 400000;
+      -- impulsions rejetees sur SCL/SDA (tSP : 50 ns en Fast-mode/Fm+)
+      FILTER_NS  : natural := 50;
+      -- etirement de SCL (donnee pas prete) : duree max, 0 = pas
+      -- d'etirement (NACK immediat comme avant)
+      STRETCH_US : natural := 0
     );
   port
     ( 
@@ -42,6 +47,10 @@ entity I2C_SLAVE_CORE is
       SYS_RST    : in     std_logic;
       SLV_DIN    : in     std_logic_vector ( 7 downto 0 );
       SLV_NODATA : in     std_logic;
+      -- rien a envoyer et rien en vue (fifo vide...) : NACK sans etirer SCL
+      SLV_NOWAIT : in     std_logic;
+      -- octet ecrit pas encore acceptable : ACK retarde (SCL etire)
+      SLV_NOSPACE: in     std_logic;
 -- /!\ BEWARE : only the bits (6 downto 0) of SLV_ADDR are meaningfull /!\
       SLV_ADDR   : in     std_logic_vector ( 7 downto 0 );
       --OUTPUTS
@@ -73,6 +82,23 @@ constant FULL_BIT  : natural := CLK_FREQ / BAUD;
 constant HALF_BIT  : natural := FULL_BIT / 2;  -- FIXME : TODO : use this!
 constant GAP_WIDTH : natural := FULL_BIT * 2;  -- FIXME : TODO : use this!
 
+-- Le coeur ne depend pas de BAUD : il suit les fronts de SCL. A 25 MHz, en
+-- Fm+ (1 MHz : tLOW 500 ns, tHIGH 260 ns, tSU;DAT 50 ns, tVD;DAT 450 ns) :
+--  - SCL et SDA : resynchro (2 cycles) puis filtre (FILTER_LEN echantillons
+--    identiques, impulsions < 80 ns rejetees), soit 200 ns de latence
+--  - SDA retardee de SDA_DELAY cycles de plus que SCL : un maitre qui change
+--    SDA en meme temps que le front descendant de SCL (tHD;DAT = 0) ne donne
+--    pas de faux START/STOP ; SDA est echantillonnee SDA_DELAY cycles apres
+--    le front montant de SCL vu par le filtre (instant reel du front)
+--  - SDA pilotee 240 a 280 ns apres le front descendant de SCL (< tVD;DAT)
+-- FIXME : TODO : timings calcules, pas encore simules ni mesures (broches
+-- de l'esclave non cablees sur la carte 2018, cf RobotLeon2_altera.vhd)
+constant FILTER_LEN  : natural := (CLK_FREQ/1000000*FILTER_NS + 999)/1000 + 1;
+constant SDA_DELAY   : natural := 2;
+-- ACK pose avant de relacher SCL apres un etirement (tSU;DAT 250 ns, Sm)
+constant SU_DAT_CYC  : natural := (CLK_FREQ/1000000*250 + 999)/1000;
+constant STRETCH_MAX : natural := CLK_FREQ/1000000*STRETCH_US;
+
 
 -- signals related to the external interface (i2c slave interface)
   
@@ -84,7 +110,21 @@ signal i_slv_scl_rise : std_logic;
 signal i_sda_sam      : std_logic_vector( 1 downto 0 );
 signal i_scl_sam      : std_logic_vector( 1 downto 0 );
 
+signal i_scl_flt_cnt  : natural range 0 to FILTER_LEN;
+signal i_sda_flt_cnt  : natural range 0 to FILTER_LEN;
+signal i_scl_flt      : std_logic;
+signal i_sda_flt      : std_logic;
+signal i_scl          : std_logic;
+signal i_scl_old      : std_logic;
+signal i_sda_dly      : std_logic_vector( SDA_DELAY downto 0 );
+signal i_sda          : std_logic;
+signal i_sda_old      : std_logic;
+signal i_scl_rise_dly : std_logic_vector( SDA_DELAY-1 downto 0 );
+signal i_slv_scl_smp  : std_logic;
+
 signal i_sda_slv_en   : std_logic;
+signal i_scl_slv_en   : std_logic;
+signal i_stretch_cnt  : natural range 0 to STRETCH_MAX + SU_DAT_CYC;
 
 
 -- signals related to the internal interface
@@ -108,9 +148,11 @@ type i2c_slave_state is (
   slv_idle ,
   slv_recv_addr ,
   slv_recv_addr_ack ,
+  slv_recv_addr_stretch ,
   slv_recv_addr_ack_hold ,
   slv_recv_data ,
   slv_recv_data_send_ack ,
+  slv_recv_data_stretch ,
   slv_recv_data_send_ack_hold ,
   slv_send_data ,
   slv_send_data_wait_ack ,
@@ -124,8 +166,8 @@ begin
 
 SDA_OUT  <= '0';
 SDA_EN   <= i_sda_slv_en;
-SCL_OUT  <= '1';
-SCL_EN   <= '0';
+SCL_OUT  <= '0';
+SCL_EN   <= i_scl_slv_en;
 
 SLV_WBUSY <= '1' when ((stm_slv = slv_recv_data_send_ack_hold))
              else '0';
@@ -150,15 +192,54 @@ begin
 end process p_synchronisation;
 
 
-i_slv_sda_fall <= not i_sda_sam( 0 ) and i_sda_sam( 1 );
-i_slv_sda_rise <= i_sda_sam( 0 ) and not i_sda_sam( 1 );    
+-- filtre : une entree ne change qu'apres FILTER_LEN echantillons identiques
+p_filter : process( SYS_CLK , SYS_RST )
+begin
+  if ( SYS_RST = '1' ) then
+    i_scl_flt <= '1';
+    i_sda_flt <= '1';
+    i_scl_flt_cnt <= 0;
+    i_sda_flt_cnt <= 0;
+    i_scl_old <= '1';
+    i_sda_dly <= ( others => '1' );
+    i_scl_rise_dly <= ( others => '0' );
+  elsif rising_edge( SYS_CLK ) then
+    if ( to_X01( i_scl_sam( 1 ) ) = i_scl_flt ) then
+      i_scl_flt_cnt <= 0;
+    elsif ( i_scl_flt_cnt = FILTER_LEN - 1 ) then
+      i_scl_flt <= to_X01( i_scl_sam( 1 ) );
+      i_scl_flt_cnt <= 0;
+    else
+      i_scl_flt_cnt <= i_scl_flt_cnt + 1;
+    end if;
+    if ( to_X01( i_sda_sam( 1 ) ) = i_sda_flt ) then
+      i_sda_flt_cnt <= 0;
+    elsif ( i_sda_flt_cnt = FILTER_LEN - 1 ) then
+      i_sda_flt <= to_X01( i_sda_sam( 1 ) );
+      i_sda_flt_cnt <= 0;
+    else
+      i_sda_flt_cnt <= i_sda_flt_cnt + 1;
+    end if;
+    i_scl_old <= i_scl;
+    i_sda_dly <= i_sda_dly( SDA_DELAY-1 downto 0 ) & i_sda_flt;
+    i_scl_rise_dly <= i_scl_rise_dly( SDA_DELAY-2 downto 0 ) & i_slv_scl_rise;
+  end if;
+end process p_filter;
+
+i_scl <= i_scl_flt;
+i_sda <= i_sda_dly( SDA_DELAY-1 );
+i_sda_old <= i_sda_dly( SDA_DELAY );
+
+i_slv_sda_fall <= not i_sda and i_sda_old;
+i_slv_sda_rise <= i_sda and not i_sda_old;
   
-i_slv_scl_fall <= not i_scl_sam( 0 ) and i_scl_sam( 1 );
-i_slv_scl_rise <= i_scl_sam( 0 ) and not i_scl_sam( 1 );
+i_slv_scl_fall <= not i_scl and i_scl_old;
+i_slv_scl_rise <= i_scl and not i_scl_old;
+i_slv_scl_smp  <= i_scl_rise_dly( SDA_DELAY-1 );
 
-i_slv_stop_bit <= '1' when (i_slv_sda_rise='1') and (to_X01(i_scl_sam(0))='1')
+i_slv_stop_bit <= '1' when (i_slv_sda_rise='1') and (i_scl='1')
                   else '0'; 
-i_slv_strt_bit <= '1' when (i_slv_sda_fall='1') and (to_X01(i_scl_sam(0))='1')
+i_slv_strt_bit <= '1' when (i_slv_sda_fall='1') and (i_scl='1')
                   else '0';
 
 
@@ -170,6 +251,8 @@ begin
     i_slv_bit_cnt <= 0;
     i_slv_addr <= ( others => '0' );
     i_sda_slv_en <= '0';
+    i_scl_slv_en <= '0';
+    i_stretch_cnt <= 0;
     i_slv_d_recv <= ( others => '0' );
     i_slv_d_send <= ( others => '0' );
     SLV_READ <= '0';
@@ -184,6 +267,7 @@ begin
         SLV_BUSY <= '0';
         i_reg_addr_flag <= '0';
         i_sda_slv_en <= '0';
+        i_scl_slv_en <= '0';
         i_slv_bit_cnt <= 0;
         if ( i_slv_strt_bit = '1' ) then
           stm_slv <= slv_recv_addr;
@@ -195,12 +279,12 @@ begin
         if ( i_slv_stop_bit = '1' ) then
           stm_slv <= slv_idle;
         else
-          if ( i_slv_scl_rise = '1' ) then
+          if ( i_slv_scl_smp = '1' ) then
             if ( i_slv_bit_cnt < 7 ) then               
-              i_slv_addr <= i_slv_addr( 6 downto 0 ) & i_sda_sam(0);
+              i_slv_addr <= i_slv_addr( 6 downto 0 ) & i_sda;
               i_slv_bit_cnt <= i_slv_bit_cnt + 1;  
             elsif( i_slv_bit_cnt = 7 ) then
-              i_slv_addr <= i_slv_addr( 6 downto 0 ) & i_sda_sam(0);
+              i_slv_addr <= i_slv_addr( 6 downto 0 ) & i_sda;
               i_slv_bit_cnt <= 0; 
               stm_slv <= slv_recv_addr_ack;                 
             end if;
@@ -224,8 +308,12 @@ begin
                 i_sda_slv_en <= '1';
                 stm_slv <= slv_recv_addr_ack_hold;
               end if;
-            else -- nothing to send!..
+            elsif ( STRETCH_MAX = 0 ) or ( SLV_NOWAIT = '1' ) then -- nothing to send!..
               stm_slv <= slv_idle;
+            elsif ( i_slv_scl_fall = '1' ) then -- wait for it (SCL low)
+              i_scl_slv_en <= '1';
+              i_stretch_cnt <= 0;
+              stm_slv <= slv_recv_addr_stretch;
             end if;
           else -- master write (always accept..)
             if ( i_slv_scl_fall = '1' ) then
@@ -237,6 +325,26 @@ begin
           stm_slv <= slv_idle;
         end if;
       ----------------------
+      -- SCL tenu bas jusqu'a la donnee (ou NACK apres STRETCH_US), puis ACK
+      -- pose SU_DAT_CYC cycles avant de relacher SCL
+      when slv_recv_addr_stretch =>
+        if ( i_sda_slv_en = '1' ) then
+          if ( i_stretch_cnt >= SU_DAT_CYC ) then
+            i_scl_slv_en <= '0';
+            stm_slv <= slv_recv_addr_ack_hold;
+          else
+            i_stretch_cnt <= i_stretch_cnt + 1;
+          end if;
+        elsif ( SLV_NODATA = '0' ) then
+          i_sda_slv_en <= '1';
+          i_stretch_cnt <= 0;
+        elsif ( i_stretch_cnt = STRETCH_MAX ) or ( SLV_NOWAIT = '1' ) then
+          i_scl_slv_en <= '0';
+          stm_slv <= slv_idle;
+        else
+          i_stretch_cnt <= i_stretch_cnt + 1;
+        end if;
+      ----------------------
       when slv_recv_addr_ack_hold =>
         if ( i_slv_scl_fall = '1' ) then
           i_sda_slv_en <= '0';
@@ -261,12 +369,12 @@ begin
           i_sda_slv_en <= '0';
           i_slv_bit_cnt <= 0;
         else
-          if ( i_slv_scl_rise = '1' ) then
+          if ( i_slv_scl_smp = '1' ) then
             if ( i_slv_bit_cnt < 7 ) then               
-              i_slv_d_recv <= i_slv_d_recv( 6 downto 0 )& i_sda_sam(0);
+              i_slv_d_recv <= i_slv_d_recv( 6 downto 0 )& i_sda;
               i_slv_bit_cnt <= i_slv_bit_cnt + 1; 
             elsif ( i_slv_bit_cnt = 7 ) then
-              i_slv_d_recv <= i_slv_d_recv( 6 downto 0 )& i_sda_sam(0);
+              i_slv_d_recv <= i_slv_d_recv( 6 downto 0 )& i_sda;
               i_slv_bit_cnt <= 0;
               stm_slv <= slv_recv_data_send_ack;
             end if;       
@@ -283,10 +391,38 @@ begin
           i_sda_slv_en <= '0';
           i_slv_bit_cnt <= 0;
         elsif ( i_slv_scl_fall = '1' ) then
-          i_sda_slv_en <= '1';
-          stm_slv <= slv_recv_data_send_ack_hold;
+          -- l'adresse de registre est toujours acceptee
+          if ( SLV_NOSPACE = '1' ) and ( i_reg_addr_flag = '0' ) and
+            ( STRETCH_MAX /= 0 ) then
+            i_scl_slv_en <= '1';
+            i_stretch_cnt <= 0;
+            stm_slv <= slv_recv_data_stretch;
+          else
+            i_sda_slv_en <= '1';
+            stm_slv <= slv_recv_data_send_ack_hold;
+          end if;
         end if;                  
       ----------------------
+      -- octet recu pas encore acceptable : meme etirement qu'en lecture,
+      -- NACK (octet perdu) apres STRETCH_US
+      when slv_recv_data_stretch =>
+        if ( i_sda_slv_en = '1' ) then
+          if ( i_stretch_cnt >= SU_DAT_CYC ) then
+            i_scl_slv_en <= '0';
+            stm_slv <= slv_recv_data_send_ack_hold;
+          else
+            i_stretch_cnt <= i_stretch_cnt + 1;
+          end if;
+        elsif ( SLV_NOSPACE = '0' ) then
+          i_sda_slv_en <= '1';
+          i_stretch_cnt <= 0;
+        elsif ( i_stretch_cnt = STRETCH_MAX ) then
+          i_scl_slv_en <= '0';
+          stm_slv <= slv_idle;
+        else
+          i_stretch_cnt <= i_stretch_cnt + 1;
+        end if;
+      ----------------------
       when slv_recv_data_send_ack_hold =>
         if ( i_slv_scl_fall = '1' ) then
           i_sda_slv_en <= '0';
@@ -340,8 +476,8 @@ begin
           i_reg_addr_flag <= '0';
           i_sda_slv_en <= '0';
           i_slv_bit_cnt <= 0;
-        elsif ( i_slv_scl_rise = '1' ) then
-          if ( i_sda_sam(0) = '0' ) and ( i_slv_sda_fall = '0' ) then
+        elsif ( i_slv_scl_smp = '1' ) then
+          if ( i_sda = '0' ) and ( i_slv_sda_fall = '0' ) then
             stm_slv <= slv_send_data_wait_ack_hold;
           else
             stm_slv <= slv_idle;
@@ -351,7 +487,7 @@ begin
       when slv_send_data_wait_ack_hold =>
         i_sda_slv_en <= '0';
         if ( i_slv_scl_fall = '1' ) then
-          if ( i_sda_sam(0) = '0' ) and ( i_slv_sda_fall = '0' ) then
+          if ( i_sda = '0' ) and ( i_slv_sda_fall = '0' ) then
             i_sda_slv_en <= '0';
             stm_slv <= slv_send_data;                              
             SLV_READ <= '1';
@@ -10,6 +10,12 @@ use work.amba.all;
 use work.iface.all;
 
 entity robot_apb is
+  generic (
+    -- odometrie integree (compteurs de quadrature, robot_gps_odo et son
+    -- multiplieur 64 bits / sin_cos_cheby dedies) : ~16 multiplieurs 18x18
+    -- de plus, pas de codeurs sur la carte 2018
+    ODOMETRY : boolean := false
+  );
   port(
       pclk                : in  std_logic
     ; presetn             : in  std_logic
@@ -33,6 +39,18 @@ entity robot_apb is
     ; pwm_servo3          : out std_logic
     ; pwm_magnet1         : out std_logic
     ; pwm_magnet2         : out std_logic
+    -- stepper interface
+    ; stepper_step        : out std_logic
+    ; stepper_dir         : out std_logic
+    ; stepper_n_en        : out std_logic
+    ; stepper_phase       : out std_logic_vector(3 downto 0)
+    -- dip switches
+    ; dip_sw              : in std_logic_vector(3 downto 0)
+    -- codeurs en quadrature, roues droite et gauche
+    ; quad_r_a            : in std_logic
+    ; quad_r_b            : in std_logic
+    ; quad_l_a            : in std_logic
+    ; quad_l_b            : in std_logic
     -- I2C slave signals
     ; sda_in_slv          : in  std_logic
     ; sda_out_slv         : out std_logic
@@ -45,6 +63,9 @@ entity robot_apb is
     ; spi_clk             : in std_logic
     ; spi_mosi            : in std_logic
     ; spi_miso            : out std_logic
+    -- interruptions : fifo de trace au seuil (cf robot_reg[0x08])
+    ; irq_leon            : out std_logic
+    ; irq_host            : out std_logic
     -- debug/test
     ; debug_test          : out std_logic_vector(31 downto 0)
   );
@@ -56,7 +77,11 @@ architecture rtl of robot_apb is
     port (
       RESET          : in std_logic;
       CLK            : in std_logic; -- the clock should be @ 25MHz
+      START          : in std_logic;
+      TIMEOUT        : in std_logic_vector (31 downto 0);
       ACTUAL_DIST    : out std_logic_vector (31 downto 0);
+      BUSY           : out std_logic;
+      DONE           : out std_logic;
       US_PULSE       : out std_logic;
       US_RESPONSE    : in std_logic
       );
@@ -68,6 +93,9 @@ architecture rtl of robot_apb is
       CLK                : in std_logic;
       PWM_SERVO_PERIOD   : in std_logic_vector (31 downto 0);
       PWM_SERVO_PW       : in std_logic_vector (31 downto 0);
+      PWM_SERVO_SLEW     : in std_logic_vector (15 downto 0);
+      PWM_SERVO_ACTUAL_PW: out std_logic_vector (31 downto 0);
+      PWM_SERVO_DONE     : out std_logic;
       PWM_SERVO          : out std_logic
       );
   end component;
@@ -82,6 +110,26 @@ architecture rtl of robot_apb is
       );
   end component;
 
+  component STEPPER_POLOLU is
+    port (
+      RESET          : in std_logic;
+      CLK            : in std_logic;
+      CTRL           : in std_logic_vector (15 downto 0);
+      PERIOD         : in std_logic_vector (15 downto 0);
+      START_PERIOD   : in std_logic_vector (15 downto 0);
+      ACCEL          : in std_logic_vector (15 downto 0);
+      NEW_POS        : in std_logic_vector (15 downto 0);
+      ACTUAL_POS     : out std_logic_vector (15 downto 0);
+      DONE           : out std_logic;
+      HIGH_SW        : in std_logic;
+      LOW_SW         : in std_logic;
+      N_ENABLE       : out std_logic;
+      STEP           : out std_logic;
+      DIR            : out std_logic;
+      PHASE          : out std_logic_vector (3 downto 0)
+      );
+  end component;
+
   component robot_i2c_slave is
     port (
       RESET               : in std_logic;
@@ -93,16 +141,23 @@ architecture rtl of robot_apb is
       I2C_SLAVE_DATA      : in std_logic_vector(31 downto 0);
       I2C_SLAVE_ACK       : in std_logic;
       I2C_SLAVE_IRQ       : out std_logic;
+      I2C_MASTER_WAIT     : in std_logic;
       TRACE_FIFO          : in std_logic_vector(31 downto 0);
       TRACE_FIFO_DEBUG    : out std_logic_vector(31 downto 0);
       TRACE_FIFO_WR       : in std_logic;
       TRACE_FIFO_FULL     : out std_logic;
       TRACE_FIFO_EMPTY    : out std_logic;
+      TRACE_FIFO_LEVEL    : out std_logic_vector(8 downto 0);
       BSTR_FIFO           : out std_logic_vector(31 downto 0);
       BSTR_FIFO_DEBUG     : out std_logic_vector(31 downto 0);
       BSTR_FIFO_RD        : in std_logic;
       BSTR_FIFO_FULL      : out std_logic;
       BSTR_FIFO_EMPTY     : out std_logic;
+      TRACE_EXT_RD        : in std_logic;
+      TRACE_EXT_DATA      : out std_logic_vector(31 downto 0);
+      TRACE_EXT_READY     : out std_logic;
+      BSTR_EXT_WR         : in std_logic;
+      BSTR_EXT_DATA       : in std_logic_vector(31 downto 0);
       SDA_IN              : in     std_logic;
       SDA_OUT             : out    std_logic;
       SDA_EN              : out    std_logic;
@@ -123,6 +178,13 @@ architecture rtl of robot_apb is
       SPI_SLAVE_DATA      : in std_logic_vector(31 downto 0);
       SPI_SLAVE_ACK       : in std_logic;
       SPI_SLAVE_IRQ       : out std_logic;
+      SPI_MASTER_WAIT     : in std_logic;
+      TRACE_RD            : out std_logic;
+      TRACE_DATA          : in std_logic_vector(31 downto 0);
+      TRACE_READY         : in std_logic;
+      BSTR_WR             : out std_logic;
+      BSTR_DATA           : out std_logic_vector(31 downto 0);
+      BSTR_EMPTY          : in std_logic;
       DBG_MST_DATA        : out std_logic_vector(31 downto 0);
       DBG_SLV_DATA        : in std_logic_vector(31 downto 0);
       SPI_CS              : in std_logic;
@@ -132,18 +194,110 @@ architecture rtl of robot_apb is
     );
   end component;
 
+  component sin_cos_cheby is
+    port (
+      clock_i             : in std_logic;
+      resetb_i            : in std_logic;
+      COMMAND             : in std_logic_vector(31 downto 0);
+      STATUS              : out std_logic_vector(31 downto 0);
+      DATAIN              : in std_logic_vector(63 downto 0);
+      DATAOUT_SIN         : out std_logic_vector(63 downto 0);
+      DATAOUT_COS         : out std_logic_vector(63 downto 0)
+    );
+  end component;
+
+  component mul_int64 is
+    port (
+      dataa               : in std_logic_vector (63 downto 0);
+      datab               : in std_logic_vector (63 downto 0);
+      result              : out std_logic_vector (127 downto 0)
+    );
+  end component;
+
+  component robot_gps_odo is
+    port (
+      clock_i             : in std_logic;
+      resetb_i            : in std_logic;
+      ENABLE              : in std_logic;
+      SETUP               : in std_logic;
+      GPS_X_INIT          : in std_logic_vector(63 downto 0);
+      GPS_Y_INIT          : in std_logic_vector(63 downto 0);
+      GPS_THETA_INIT      : in std_logic_vector(63 downto 0);
+      QUAD_CNT_TH_R       : in std_logic_vector(63 downto 0);
+      QUAD_CNT_R_R        : in std_logic_vector(63 downto 0);
+      QUAD_CNT_TH_L       : in std_logic_vector(63 downto 0);
+      QUAD_CNT_R_L        : in std_logic_vector(63 downto 0);
+      GPS_SAMPLING_T      : in std_logic_vector(31 downto 0);
+      MUL64_OP1           : out std_logic_vector(63 downto 0);
+      MUL64_OP2           : out std_logic_vector(63 downto 0);
+      MUL64_RES           : in std_logic_vector(63 downto 0);
+      TRIG_ENABLE         : out std_logic;
+      TRIG_ANGLE          : out std_logic_vector(63 downto 0);
+      TRIG_SIN            : in std_logic_vector(63 downto 0);
+      TRIG_COS            : in std_logic_vector(63 downto 0);
+      TRIG_DONE           : in std_logic;
+      GPS_X               : out std_logic_vector(63 downto 0);
+      GPS_Y               : out std_logic_vector(63 downto 0);
+      GPS_THETA           : out std_logic_vector(63 downto 0);
+      BUSY                : out std_logic
+    );
+  end component;
+
+  component QuadratureCounterPorts is
+    port (
+      RESET               : in std_logic;
+      clock               : in std_logic;
+      QuadA               : in std_logic;
+      QuadB               : in std_logic;
+      Increment_4_12      : in std_logic_vector(15 downto 0);
+      SamplingInterval    : in std_logic_vector(31 downto 0);
+      AsyncReset          : in std_logic;
+      CounterValue        : buffer std_logic_vector(31 downto 0);
+      SpeedValue          : out std_logic_vector(31 downto 0);
+      SetAux1             : in std_logic;
+      SetValueAux1        : in std_logic_vector(31 downto 0);
+      CounterValueAux1    : buffer std_logic_vector(31 downto 0);
+      SpeedValueAux1      : out std_logic_vector(31 downto 0);
+      IncrementAuxTh      : in std_logic_vector(63 downto 0);
+      SetAuxTh            : in std_logic;
+      SetValueAuxTh       : in std_logic_vector(63 downto 0);
+      CounterValueAuxTh   : buffer std_logic_vector(63 downto 0);
+      SpeedValueAuxTh     : out std_logic_vector(63 downto 0);
+      IncrementAuxR       : in std_logic_vector(63 downto 0);
+      SetAuxR             : in std_logic;
+      SetValueAuxR        : in std_logic_vector(63 downto 0);
+      CounterValueAuxR    : buffer std_logic_vector(63 downto 0);
+      SpeedValueAuxR      : out std_logic_vector(63 downto 0);
+      EdgeTimeout         : in std_logic_vector(31 downto 0);
+      BlendLow            : in std_logic_vector(15 downto 0);
+      EdgeTimerValue      : out std_logic_vector(31 downto 0);
+      LastEdgeTime        : out std_logic_vector(31 downto 0);
+      PeriodSpeedValue    : out std_logic_vector(31 downto 0);
+      CountSpeedValue     : out std_logic_vector(31 downto 0);
+      BlendedSpeedValue   : out std_logic_vector(31 downto 0)
+    );
+  end component;
+
 
   signal iRESET               : std_logic;
 
   signal iROBOT_TIMER         : std_logic_vector (31 downto 0);
   signal iROBOT_RESET         : std_logic_vector (31 downto 0);
   signal iDEBUG_REG           : std_logic_vector (31 downto 0);
+  signal iDIP_SW_META         : std_logic_vector (3 downto 0);
+  signal iDIP_SW              : std_logic_vector (3 downto 0);
 
   signal iTRACE_FIFO          : std_logic_vector (31 downto 0);
   signal iTRACE_FIFO_DEBUG    : std_logic_vector (31 downto 0);
   signal iTRACE_FIFO_WR       : std_logic;
   signal iTRACE_FIFO_FULL     : std_logic;
   signal iTRACE_FIFO_EMPTY    : std_logic;
+  signal iTRACE_FIFO_LEVEL    : std_logic_vector (8 downto 0);
+  -- seuil haut de la fifo de trace : [8:0] seuil en mots (0 : inactif),
+  -- [16] IT LEON, [17] IT hote ; mots perdus fifo pleine
+  signal iTRACE_CTRL          : std_logic_vector (31 downto 0);
+  signal iTRACE_OVF           : std_logic_vector (31 downto 0);
+  signal iTRACE_WM            : std_logic;
   signal iBSTR_FIFO           : std_logic_vector (31 downto 0);
   signal iBSTR_FIFO_DEBUG     : std_logic_vector (31 downto 0);
   signal iBSTR_FIFO_RD        : std_logic;
@@ -153,6 +307,22 @@ architecture rtl of robot_apb is
   signal iUS1_ACTUAL_DIST     : std_logic_vector (31 downto 0);
   signal iUS2_ACTUAL_DIST     : std_logic_vector (31 downto 0);
   signal iUS3_ACTUAL_DIST     : std_logic_vector (31 downto 0);
+  -- ordonnanceur des ultrasons : [2:0] capteurs actifs ; timeout d'une
+  -- mesure et garde entre deux mesures (24 bits) en cycles ; date
+  -- (R_ROBOT_TIMER) de la derniere mesure de chaque capteur
+  type t_US_SCHED is (us_sched_guard, us_sched_run);
+  signal iUS_SCHED            : t_US_SCHED;
+  signal iUS_CTRL             : std_logic_vector (31 downto 0);
+  signal iUS_TIMEOUT          : std_logic_vector (31 downto 0);
+  signal iUS_GUARD            : std_logic_vector (31 downto 0);
+  signal iUS_GUARD_CNT        : std_logic_vector (23 downto 0);
+  signal iUS_CUR              : integer range 0 to 2;
+  signal iUS_START            : std_logic_vector (2 downto 0);
+  signal iUS_BUSY             : std_logic_vector (2 downto 0);
+  signal iUS_DONE             : std_logic_vector (2 downto 0);
+  signal iUS1_STAMP           : std_logic_vector (31 downto 0);
+  signal iUS2_STAMP           : std_logic_vector (31 downto 0);
+  signal iUS3_STAMP           : std_logic_vector (31 downto 0);
   signal iSERVO1_PWM_PERIOD   : std_logic_vector (31 downto 0);
   signal iSERVO1_PW           : std_logic_vector (31 downto 0);
   signal iSERVO2_PWM_PERIOD   : std_logic_vector (31 downto 0);
@@ -163,11 +333,35 @@ architecture rtl of robot_apb is
   signal iPUMP1_PW            : std_logic_vector (31 downto 0);
   signal iPUMP2_PWM_PERIOD    : std_logic_vector (31 downto 0);
   signal iPUMP2_PW            : std_logic_vector (31 downto 0);
+  -- mise a jour groupee : les registres xxx_PW ci-dessus sont les ombres,
+  -- recopiees dans les cibles par ecriture de robot_reg[0xca]
+  signal iSERVO1_TARGET       : std_logic_vector (31 downto 0);
+  signal iSERVO2_TARGET       : std_logic_vector (31 downto 0);
+  signal iSERVO3_TARGET       : std_logic_vector (31 downto 0);
+  signal iPUMP1_TARGET        : std_logic_vector (31 downto 0);
+  signal iPUMP2_TARGET        : std_logic_vector (31 downto 0);
+  signal iACT_AUTO            : std_logic_vector (4 downto 0);
+  signal iACT_PENDING         : std_logic_vector (4 downto 0);
+  signal iSERVO1_SLEW         : std_logic_vector (15 downto 0);
+  signal iSERVO2_SLEW         : std_logic_vector (15 downto 0);
+  signal iSERVO3_SLEW         : std_logic_vector (15 downto 0);
+  signal iSERVO1_ACTUAL_PW    : std_logic_vector (31 downto 0);
+  signal iSERVO2_ACTUAL_PW    : std_logic_vector (31 downto 0);
+  signal iSERVO3_ACTUAL_PW    : std_logic_vector (31 downto 0);
+  signal iSERVO_DONE          : std_logic_vector (2 downto 0);
+
+  signal iSTEPPER_CTRL        : std_logic_vector (31 downto 0);
+  signal iSTEPPER_TARGET      : std_logic_vector (31 downto 0);
+  signal iSTEPPER_PERIOD      : std_logic_vector (31 downto 0);
+  signal iSTEPPER_ACCEL       : std_logic_vector (31 downto 0);
+  signal iSTEPPER_POS         : std_logic_vector (15 downto 0);
+  signal iSTEPPER_DONE        : std_logic;
 
   signal iI2C_MASTER_RD       : std_logic;
   signal iI2C_MASTER_WR       : std_logic;
   signal iI2C_MASTER_ADDR     : std_logic_vector (31 downto 0);
   signal iI2C_MASTER_DATA     : std_logic_vector (31 downto 0);
+  signal iI2C_MASTER_WAIT     : std_logic;
   signal iI2C_SLAVE_DATA      : std_logic_vector (31 downto 0);
 
   signal iMST_READ            : std_logic;
@@ -180,9 +374,100 @@ architecture rtl of robot_apb is
   signal iSPI_MASTER_WR       : std_logic;
   signal iSPI_MASTER_ADDR     : std_logic_vector (31 downto 0);
   signal iSPI_MASTER_DATA     : std_logic_vector (31 downto 0);
+  signal iSPI_MASTER_WAIT     : std_logic;
   signal iSPI_SLAVE_DATA      : std_logic_vector (31 downto 0);
   signal iSPI_DBG_MST_DATA    : std_logic_vector (31 downto 0);
   signal iSPI_DBG_SLV_DATA    : std_logic_vector (31 downto 0);
+  signal iSPI_TRACE_RD        : std_logic;
+  signal iSPI_TRACE_DATA      : std_logic_vector (31 downto 0);
+  signal iSPI_TRACE_READY     : std_logic;
+  signal iSPI_BSTR_WR         : std_logic;
+  signal iSPI_BSTR_DATA       : std_logic_vector (31 downto 0);
+
+  signal iMUL64_OP1           : std_logic_vector (63 downto 0);
+  signal iMUL64_OP2           : std_logic_vector (63 downto 0);
+  signal iMUL64_PRODUCT       : std_logic_vector (127 downto 0);
+  signal iMUL64_RESULT        : std_logic_vector (63 downto 0);
+  signal iSINCOS_CMD          : std_logic_vector (31 downto 0);
+  signal iSINCOS_STATUS       : std_logic_vector (31 downto 0);
+  signal iSINCOS_ANGLE        : std_logic_vector (63 downto 0);
+  signal iSINCOS_SIN          : std_logic_vector (63 downto 0);
+  signal iSINCOS_COS          : std_logic_vector (63 downto 0);
+
+  signal iGPS_SAMPLING_T      : std_logic_vector (31 downto 0);
+  signal iGPS_X               : std_logic_vector (63 downto 0);
+  signal iGPS_Y               : std_logic_vector (63 downto 0);
+  signal iGPS_THETA           : std_logic_vector (63 downto 0);
+  signal iGPS_BUSY            : std_logic;
+  signal iQUAD_CNT_TH_R       : std_logic_vector (63 downto 0);
+  signal iQUAD_CNT_R_R        : std_logic_vector (63 downto 0);
+  signal iQUAD_CNT_TH_L       : std_logic_vector (63 downto 0);
+  signal iQUAD_CNT_R_L        : std_logic_vector (63 downto 0);
+
+  -- odometrie : robot_gps_odo a son multiplieur et son sin/cos (il lit le
+  -- produit combinatoire le cycle suivant, et ne peut pas attendre le
+  -- bloc partage avec le logiciel)
+  signal iGPS_CTRL            : std_logic_vector (1 downto 0);
+  signal iGPS_X_INIT          : std_logic_vector (63 downto 0);
+  signal iGPS_Y_INIT          : std_logic_vector (63 downto 0);
+  signal iGPS_THETA_INIT      : std_logic_vector (63 downto 0);
+  signal iGPS_MUL64_OP1       : std_logic_vector (63 downto 0);
+  signal iGPS_MUL64_OP2       : std_logic_vector (63 downto 0);
+  signal iGPS_MUL64_PRODUCT   : std_logic_vector (127 downto 0);
+  signal iGPS_TRIG_CMD        : std_logic_vector (31 downto 0);
+  signal iGPS_TRIG_STATUS     : std_logic_vector (31 downto 0);
+  signal iGPS_TRIG_ANGLE      : std_logic_vector (63 downto 0);
+  signal iGPS_TRIG_SIN        : std_logic_vector (63 downto 0);
+  signal iGPS_TRIG_COS        : std_logic_vector (63 downto 0);
+
+  -- vitesse par periode (cf QuadratureCounter.vhd) : nulle apres 100 ms
+  -- sans front ; BlendLow choisi avec tools/math/quad_speed_model.c pour
+  -- la fenetre de 1 ms. 0x84/0x8c : vitesse melangee (BlendedSpeedValue),
+  -- 0x85/0x8d et 0x86/0x8e : date du dernier front et compteur de cycles
+  constant QUAD_EDGE_TIMEOUT  : std_logic_vector (31 downto 0) := X"002625A0";
+  constant QUAD_BLEND_LOW     : std_logic_vector (15 downto 0) := X"0008";
+
+  signal iQUAD_SAMPLING       : std_logic_vector (31 downto 0);
+  signal iQUAD_INC_R          : std_logic_vector (15 downto 0);
+  signal iQUAD_INC_L          : std_logic_vector (15 downto 0);
+  signal iQUAD_INC_TH_R       : std_logic_vector (63 downto 0);
+  signal iQUAD_INC_R_R        : std_logic_vector (63 downto 0);
+  signal iQUAD_INC_TH_L       : std_logic_vector (63 downto 0);
+  signal iQUAD_INC_R_L        : std_logic_vector (63 downto 0);
+  signal iQUAD_VAL_R          : std_logic_vector (31 downto 0);
+  signal iQUAD_VAL_L          : std_logic_vector (31 downto 0);
+  signal iQUAD_SPEED_R        : std_logic_vector (31 downto 0);
+  signal iQUAD_SPEED_L        : std_logic_vector (31 downto 0);
+  signal iQUAD_EDGE_TIMER_R   : std_logic_vector (31 downto 0);
+  signal iQUAD_EDGE_TIMER_L   : std_logic_vector (31 downto 0);
+  signal iQUAD_LAST_EDGE_R    : std_logic_vector (31 downto 0);
+  signal iQUAD_LAST_EDGE_L    : std_logic_vector (31 downto 0);
+
+  -- instantane 0x10..0x1f : pose et compteurs 64 bits + timer, figes
+  -- ensemble par une ecriture de 0x10 (pas de valeur dechiree entre les
+  -- deux moities lues separement)
+  type t_SNAPSHOT is array (1 to 15) of std_logic_vector (31 downto 0);
+  signal iSNAP                : t_SNAPSHOT;
+  signal iSNAP_CMD            : std_logic;
+  signal iSNAP_PENDING        : std_logic;
+  signal iSNAP_SEQ            : std_logic_vector (15 downto 0);
+
+  -- instantane capteurs 0x20..0x25 (trame 's'/'S' du moniteur) : timer,
+  -- compteurs et vitesses figes ensemble par une ecriture de 0x20
+  signal iSENS_SEQ            : std_logic_vector (15 downto 0);
+  signal iSENS_TIMER          : std_logic_vector (31 downto 0);
+  signal iSENS_VAL_R          : std_logic_vector (31 downto 0);
+  signal iSENS_VAL_L          : std_logic_vector (31 downto 0);
+  signal iSENS_SPEED_R        : std_logic_vector (31 downto 0);
+  signal iSENS_SPEED_L        : std_logic_vector (31 downto 0);
+
+  -- boite aux lettres 0xe0..0xff, accessible a tous les masters :
+  --   0xe0..0xef : mesure de la boucle de controle, ecrite par le LEON
+  --                (cf soft_boot/drivers/loop_stats.c)
+  --   0xf0..0xff : asservissement de vitesse des roues, config ecrite par
+  --                I2C/SPI, etat ecrit par le LEON (cf drivers/speed_pid.c)
+  type t_MAILBOX is array (0 to 31) of std_logic_vector (31 downto 0);
+  signal iMAILBOX             : t_MAILBOX;
 
 begin
 
@@ -191,112 +476,124 @@ begin
   debug_test <= iDEBUG_REG;
 
 
--- FIXME : TODO ++
---  c_us1 : ULTRASOUND_HCSR04
---    port map (
---      RESET => iRESET,
---      CLK => pclk,
---      ACTUAL_DIST => iUS1_ACTUAL_DIST,
---      US_PULSE => us1_trig,
---      US_RESPONSE => us1_echo
---    );
--- FIXME : TODO ==
-  us1_trig <= '0';
-  iUS1_ACTUAL_DIST <= (others => '0');
--- FIXME : TODO --
-
--- FIXME : TODO ++
---  c_us2 : ULTRASOUND_HCSR04
---    port map (
---      RESET => iRESET,
---      CLK => pclk,
---      ACTUAL_DIST => iUS2_ACTUAL_DIST,
---      US_PULSE => us2_trig,
---      US_RESPONSE => us2_echo
---    );
--- FIXME : TODO ==
-  us2_trig <= '0';
-  iUS2_ACTUAL_DIST <= (others => '0');
--- FIXME : TODO --
-
--- FIXME : TODO ++
---  c_us3 : ULTRASOUND_HCSR04
---    port map (
---      RESET => iRESET,
---      CLK => pclk,
---      ACTUAL_DIST => iUS3_ACTUAL_DIST,
---      US_PULSE => us3_trig,
---      US_RESPONSE => us3_echo
---    );
--- FIXME : TODO ==
-  us3_trig <= '0';
-  iUS3_ACTUAL_DIST <= (others => '0');
--- FIXME : TODO --
-
--- FIXME : TODO ++
+  c_us1 : ULTRASOUND_HCSR04
+    port map (
+      RESET => iRESET,
+      CLK => pclk,
+      START => iUS_START(0),
+      TIMEOUT => iUS_TIMEOUT,
+      ACTUAL_DIST => iUS1_ACTUAL_DIST,
+      BUSY => iUS_BUSY(0),
+      DONE => iUS_DONE(0),
+      US_PULSE => us1_trig,
+      US_RESPONSE => us1_echo
+    );
+
+  c_us2 : ULTRASOUND_HCSR04
+    port map (
+      RESET => iRESET,
+      CLK => pclk,
+      START => iUS_START(1),
+      TIMEOUT => iUS_TIMEOUT,
+      ACTUAL_DIST => iUS2_ACTUAL_DIST,
+      BUSY => iUS_BUSY(1),
+      DONE => iUS_DONE(1),
+      US_PULSE => us2_trig,
+      US_RESPONSE => us2_echo
+    );
+
+  c_us3 : ULTRASOUND_HCSR04
+    port map (
+      RESET => iRESET,
+      CLK => pclk,
+      START => iUS_START(2),
+      TIMEOUT => iUS_TIMEOUT,
+      ACTUAL_DIST => iUS3_ACTUAL_DIST,
+      BUSY => iUS_BUSY(2),
+      DONE => iUS_DONE(2),
+      US_PULSE => us3_trig,
+      US_RESPONSE => us3_echo
+    );
+
   c_servo1 : SERVO
     port map (
       RESET => iRESET,
       CLK => pclk,
       PWM_SERVO_PERIOD => iSERVO1_PWM_PERIOD,
-      PWM_SERVO_PW => iSERVO1_PW,
+      PWM_SERVO_PW => iSERVO1_TARGET,
+      PWM_SERVO_SLEW => iSERVO1_SLEW,
+      PWM_SERVO_ACTUAL_PW => iSERVO1_ACTUAL_PW,
+      PWM_SERVO_DONE => iSERVO_DONE(0),
       PWM_SERVO => pwm_servo1
     );
--- FIXME : TODO ==
---  pwm_servo1 <= '0';
--- FIXME : TODO --
-
--- FIXME : TODO ++
---  c_servo2 : SERVO
---    port map (
---      RESET => iRESET,
---      CLK => pclk,
---      PWM_SERVO_PERIOD => iSERVO2_PWM_PERIOD,
---      PWM_SERVO_PW => iSERVO2_PW,
---      PWM_SERVO => pwm_servo2
---    );
--- FIXME : TODO ==
-  pwm_servo2 <= '0';
--- FIXME : TODO --
-
--- FIXME : TODO ++
---  c_servo3 : SERVO
---    port map (
---      RESET => iRESET,
---      CLK => pclk,
---      PWM_SERVO_PERIOD => iSERVO3_PWM_PERIOD,
---      PWM_SERVO_PW => iSERVO3_PW,
---      PWM_SERVO => pwm_servo3
---    );
--- FIXME : TODO ==
-  pwm_servo3 <= '0';
--- FIXME : TODO --
-
--- FIXME : TODO ++
---  c_pump1 : PUMP
---    port map (
---      RESET => iRESET,
---      CLK => pclk,
---      PWM_PUMP_PERIOD => iPUMP1_PWM_PERIOD,
---      PWM_PUMP_PW => iPUMP1_PW,
---      PWM_PUMP => pwm_magnet1
---    );
--- FIXME : TODO ==
-  pwm_magnet1 <= '0';
--- FIXME : TODO --
-
--- FIXME : TODO ++
---  c_pump2 : PUMP
---    port map (
---      RESET => iRESET,
---      CLK => pclk,
---      PWM_PUMP_PERIOD => iPUMP2_PWM_PERIOD,
---      PWM_PUMP_PW => iPUMP2_PW,
---      PWM_PUMP => pwm_magnet2
---    );
--- FIXME : TODO ==
-  pwm_magnet2 <= '0';
--- FIXME : TODO --
+
+  c_servo2 : SERVO
+    port map (
+      RESET => iRESET,
+      CLK => pclk,
+      PWM_SERVO_PERIOD => iSERVO2_PWM_PERIOD,
+      PWM_SERVO_PW => iSERVO2_TARGET,
+      PWM_SERVO_SLEW => iSERVO2_SLEW,
+      PWM_SERVO_ACTUAL_PW => iSERVO2_ACTUAL_PW,
+      PWM_SERVO_DONE => iSERVO_DONE(1),
+      PWM_SERVO => pwm_servo2
+    );
+
+  c_servo3 : SERVO
+    port map (
+      RESET => iRESET,
+      CLK => pclk,
+      PWM_SERVO_PERIOD => iSERVO3_PWM_PERIOD,
+      PWM_SERVO_PW => iSERVO3_TARGET,
+      PWM_SERVO_SLEW => iSERVO3_SLEW,
+      PWM_SERVO_ACTUAL_PW => iSERVO3_ACTUAL_PW,
+      PWM_SERVO_DONE => iSERVO_DONE(2),
+      PWM_SERVO => pwm_servo3
+    );
+
+  c_pump1 : PUMP
+    port map (
+      RESET => iRESET,
+      CLK => pclk,
+      PWM_PUMP_PERIOD => iPUMP1_PWM_PERIOD,
+      PWM_PUMP_PW => iPUMP1_TARGET,
+      PWM_PUMP => pwm_magnet1
+    );
+
+  c_pump2 : PUMP
+    port map (
+      RESET => iRESET,
+      CLK => pclk,
+      PWM_PUMP_PERIOD => iPUMP2_PWM_PERIOD,
+      PWM_PUMP_PW => iPUMP2_TARGET,
+      PWM_PUMP => pwm_magnet2
+    );
+
+  -- ombres pas encore appliquees
+  iACT_PENDING(0) <= '0' when (iSERVO1_PW = iSERVO1_TARGET) else '1';
+  iACT_PENDING(1) <= '0' when (iSERVO2_PW = iSERVO2_TARGET) else '1';
+  iACT_PENDING(2) <= '0' when (iSERVO3_PW = iSERVO3_TARGET) else '1';
+  iACT_PENDING(3) <= '0' when (iPUMP1_PW = iPUMP1_TARGET) else '1';
+  iACT_PENDING(4) <= '0' when (iPUMP2_PW = iPUMP2_TARGET) else '1';
+
+  c_stepper : STEPPER_POLOLU
+    port map (
+      RESET => iRESET,
+      CLK => pclk,
+      CTRL => iSTEPPER_CTRL(15 downto 0),
+      PERIOD => iSTEPPER_PERIOD(15 downto 0),
+      START_PERIOD => iSTEPPER_PERIOD(31 downto 16),
+      ACCEL => iSTEPPER_ACCEL(15 downto 0),
+      NEW_POS => iSTEPPER_TARGET(15 downto 0),
+      ACTUAL_POS => iSTEPPER_POS,
+      DONE => iSTEPPER_DONE,
+      HIGH_SW => '0', -- pas de fins de course sur la carte 2018
+      LOW_SW => '0',
+      N_ENABLE => stepper_n_en,
+      STEP => stepper_step,
+      DIR => stepper_dir,
+      PHASE => stepper_phase
+    );
 
   c_robot_spi_slave : ROBOT_SPI_SLAVE
     port map (
@@ -309,6 +606,13 @@ begin
       SPI_SLAVE_DATA => iSPI_SLAVE_DATA,
       SPI_SLAVE_ACK => '1',
       SPI_SLAVE_IRQ => open,
+      SPI_MASTER_WAIT => iSPI_MASTER_WAIT,
+      TRACE_RD => iSPI_TRACE_RD,
+      TRACE_DATA => iSPI_TRACE_DATA,
+      TRACE_READY => iSPI_TRACE_READY,
+      BSTR_WR => iSPI_BSTR_WR,
+      BSTR_DATA => iSPI_BSTR_DATA,
+      BSTR_EMPTY => iBSTR_FIFO_EMPTY,
       DBG_MST_DATA => iSPI_DBG_MST_DATA,
       DBG_SLV_DATA => iSPI_DBG_SLV_DATA,
       SPI_CS => spi_cs,
@@ -329,18 +633,26 @@ begin
       I2C_SLAVE_DATA => iI2C_SLAVE_DATA,
       I2C_SLAVE_ACK => '1', -- FIXME : TODO
       I2C_SLAVE_IRQ => open, -- FIXME : TODO
+      I2C_MASTER_WAIT => iI2C_MASTER_WAIT,
       -- trace fifo
       TRACE_FIFO => iTRACE_FIFO,
       TRACE_FIFO_DEBUG => iTRACE_FIFO_DEBUG,
       TRACE_FIFO_WR => iTRACE_FIFO_WR,
       TRACE_FIFO_FULL => iTRACE_FIFO_FULL,
       TRACE_FIFO_EMPTY => iTRACE_FIFO_EMPTY,
+      TRACE_FIFO_LEVEL => iTRACE_FIFO_LEVEL,
       -- bitstream fifo
       BSTR_FIFO => iBSTR_FIFO,
       BSTR_FIFO_DEBUG => iBSTR_FIFO_DEBUG,
       BSTR_FIFO_RD => iBSTR_FIFO_RD,
       BSTR_FIFO_FULL => iBSTR_FIFO_FULL,
       BSTR_FIFO_EMPTY => iBSTR_FIFO_EMPTY,
+      -- acces par l'esclave SPI
+      TRACE_EXT_RD => iSPI_TRACE_RD,
+      TRACE_EXT_DATA => iSPI_TRACE_DATA,
+      TRACE_EXT_READY => iSPI_TRACE_READY,
+      BSTR_EXT_WR => iSPI_BSTR_WR,
+      BSTR_EXT_DATA => iSPI_BSTR_DATA,
       -- I2C (external) interface
       SDA_IN => sda_in_slv,
       SDA_OUT => sda_out_slv,
@@ -351,6 +663,314 @@ begin
     );
 
 
+-- accelerateurs de calcul (2016) : multiplieur Q15.48 et sin/cos Q15.48
+-- (cf soft_boot/drivers/hwmath.c)
+  c_mul64 : mul_int64
+    port map (
+      dataa  => iMUL64_OP1,
+      datab  => iMUL64_OP2,
+      result => iMUL64_PRODUCT
+    );
+
+-- produit registre : le chemin combinatoire 64x64 ne va pas jusqu'au
+-- multiplexeur de lecture
+  mul64_proc : process (presetn, pclk)
+  begin
+    if presetn = '0' then
+      iMUL64_RESULT <= (others => '0');
+    elsif rising_edge(pclk) then
+      iMUL64_RESULT <= iMUL64_PRODUCT (111 downto 48);
+    end if;
+  end process;
+
+  c_sin_cos : sin_cos_cheby
+    port map (
+      clock_i     => pclk,
+      resetb_i    => presetn,
+      COMMAND     => iSINCOS_CMD,
+      STATUS      => iSINCOS_STATUS,
+      DATAIN      => iSINCOS_ANGLE,
+      DATAOUT_SIN => iSINCOS_SIN,
+      DATAOUT_COS => iSINCOS_COS
+    );
+
+-- odometrie integree (2016) : deux compteurs de quadrature (increments
+-- 64 bits en theta et en distance par front) et l'integration de la pose
+-- par robot_gps_odo toutes les GPS_SAMPLING_T+1 periodes de pclk
+g_odo : if ODOMETRY generate
+
+  c_quad_r : QuadratureCounterPorts
+    port map (
+      RESET             => iRESET,
+      clock             => pclk,
+      QuadA             => quad_r_a,
+      QuadB             => quad_r_b,
+      Increment_4_12    => iQUAD_INC_R,
+      SamplingInterval  => iQUAD_SAMPLING,
+      AsyncReset        => '0',
+      CounterValue      => iQUAD_VAL_R,
+      SpeedValue        => open,
+      SetAux1           => '0',
+      SetValueAux1      => (others => '0'),
+      CounterValueAux1  => open,
+      SpeedValueAux1    => open,
+      IncrementAuxTh    => iQUAD_INC_TH_R,
+      SetAuxTh          => '0',
+      SetValueAuxTh     => (others => '0'),
+      CounterValueAuxTh => iQUAD_CNT_TH_R,
+      SpeedValueAuxTh   => open,
+      IncrementAuxR     => iQUAD_INC_R_R,
+      SetAuxR           => '0',
+      SetValueAuxR      => (others => '0'),
+      CounterValueAuxR  => iQUAD_CNT_R_R,
+      SpeedValueAuxR    => open,
+      EdgeTimeout       => QUAD_EDGE_TIMEOUT,
+      BlendLow          => QUAD_BLEND_LOW,
+      EdgeTimerValue    => iQUAD_EDGE_TIMER_R,
+      LastEdgeTime      => iQUAD_LAST_EDGE_R,
+      PeriodSpeedValue  => open,
+      CountSpeedValue   => open,
+      BlendedSpeedValue => iQUAD_SPEED_R
+    );
+
+  c_quad_l : QuadratureCounterPorts
+    port map (
+      RESET             => iRESET,
+      clock             => pclk,
+      QuadA             => quad_l_a,
+      QuadB             => quad_l_b,
+      Increment_4_12    => iQUAD_INC_L,
+      SamplingInterval  => iQUAD_SAMPLING,
+      AsyncReset        => '0',
+      CounterValue      => iQUAD_VAL_L,
+      SpeedValue        => open,
+      SetAux1           => '0',
+      SetValueAux1      => (others => '0'),
+      CounterValueAux1  => open,
+      SpeedValueAux1    => open,
+      IncrementAuxTh    => iQUAD_INC_TH_L,
+      SetAuxTh          => '0',
+      SetValueAuxTh     => (others => '0'),
+      CounterValueAuxTh => iQUAD_CNT_TH_L,
+      SpeedValueAuxTh   => open,
+      IncrementAuxR     => iQUAD_INC_R_L,
+      SetAuxR           => '0',
+      SetValueAuxR      => (others => '0'),
+      CounterValueAuxR  => iQUAD_CNT_R_L,
+      SpeedValueAuxR    => open,
+      EdgeTimeout       => QUAD_EDGE_TIMEOUT,
+      BlendLow          => QUAD_BLEND_LOW,
+      EdgeTimerValue    => iQUAD_EDGE_TIMER_L,
+      LastEdgeTime      => iQUAD_LAST_EDGE_L,
+      PeriodSpeedValue  => open,
+      CountSpeedValue   => open,
+      BlendedSpeedValue => iQUAD_SPEED_L
+    );
+
+  c_gps : robot_gps_odo
+    port map (
+      clock_i        => pclk,
+      resetb_i       => presetn,
+      ENABLE         => iGPS_CTRL(0),
+      SETUP          => iGPS_CTRL(1),
+      GPS_X_INIT     => iGPS_X_INIT,
+      GPS_Y_INIT     => iGPS_Y_INIT,
+      GPS_THETA_INIT => iGPS_THETA_INIT,
+      QUAD_CNT_TH_R  => iQUAD_CNT_TH_R,
+      QUAD_CNT_R_R   => iQUAD_CNT_R_R,
+      QUAD_CNT_TH_L  => iQUAD_CNT_TH_L,
+      QUAD_CNT_R_L   => iQUAD_CNT_R_L,
+      GPS_SAMPLING_T => iGPS_SAMPLING_T,
+      MUL64_OP1      => iGPS_MUL64_OP1,
+      MUL64_OP2      => iGPS_MUL64_OP2,
+      MUL64_RES      => iGPS_MUL64_PRODUCT (111 downto 48),
+      TRIG_ENABLE    => iGPS_TRIG_CMD(0),
+      TRIG_ANGLE     => iGPS_TRIG_ANGLE,
+      TRIG_SIN       => iGPS_TRIG_SIN,
+      TRIG_COS       => iGPS_TRIG_COS,
+      TRIG_DONE      => iGPS_TRIG_STATUS(0),
+      GPS_X          => iGPS_X,
+      GPS_Y          => iGPS_Y,
+      GPS_THETA      => iGPS_THETA,
+      BUSY           => iGPS_BUSY
+    );
+
+  iGPS_TRIG_CMD(31 downto 1) <= (others => '0');
+
+  c_gps_mul64 : mul_int64
+    port map (
+      dataa  => iGPS_MUL64_OP1,
+      datab  => iGPS_MUL64_OP2,
+      result => iGPS_MUL64_PRODUCT
+    );
+
+  c_gps_sin_cos : sin_cos_cheby
+    port map (
+      clock_i     => pclk,
+      resetb_i    => presetn,
+      COMMAND     => iGPS_TRIG_CMD,
+      STATUS      => iGPS_TRIG_STATUS,
+      DATAIN      => iGPS_TRIG_ANGLE,
+      DATAOUT_SIN => iGPS_TRIG_SIN,
+      DATAOUT_COS => iGPS_TRIG_COS
+    );
+
+end generate g_odo;
+
+-- sans odometrie : compteurs, vitesses et pose lus a 0
+g_no_odo : if not ODOMETRY generate
+
+  iQUAD_VAL_R        <= (others => '0');
+  iQUAD_VAL_L        <= (others => '0');
+  iQUAD_SPEED_R      <= (others => '0');
+  iQUAD_SPEED_L      <= (others => '0');
+  iQUAD_EDGE_TIMER_R <= (others => '0');
+  iQUAD_EDGE_TIMER_L <= (others => '0');
+  iQUAD_LAST_EDGE_R  <= (others => '0');
+  iQUAD_LAST_EDGE_L  <= (others => '0');
+  iQUAD_CNT_TH_R     <= (others => '0');
+  iQUAD_CNT_R_R      <= (others => '0');
+  iQUAD_CNT_TH_L     <= (others => '0');
+  iQUAD_CNT_R_L      <= (others => '0');
+  iGPS_X             <= (others => '0');
+  iGPS_Y             <= (others => '0');
+  iGPS_THETA         <= (others => '0');
+  iGPS_BUSY          <= '0';
+
+end generate g_no_odo;
+
+-- instantane : la demande attend la fin d'une integration en cours de
+-- robot_gps_odo (BUSY, 46 cycles au plus), x, y et theta sont alors ceux
+-- de la meme periode
+  snap_proc : process (presetn, pclk)
+  begin
+    if presetn = '0' then
+      iSNAP         <= (others => (others => '0'));
+      iSNAP_PENDING <= '0';
+      iSNAP_SEQ     <= (others => '0');
+    elsif rising_edge(pclk) then
+      if (iSNAP_CMD = '1') or (iSNAP_PENDING = '1') then
+        if (iGPS_BUSY = '0') then
+          iSNAP(1)  <= iROBOT_TIMER;
+          iSNAP(2)  <= iGPS_X(63 downto 32);
+          iSNAP(3)  <= iGPS_X(31 downto 0);
+          iSNAP(4)  <= iGPS_Y(63 downto 32);
+          iSNAP(5)  <= iGPS_Y(31 downto 0);
+          iSNAP(6)  <= iGPS_THETA(63 downto 32);
+          iSNAP(7)  <= iGPS_THETA(31 downto 0);
+          iSNAP(8)  <= iQUAD_CNT_TH_R(63 downto 32);
+          iSNAP(9)  <= iQUAD_CNT_TH_R(31 downto 0);
+          iSNAP(10) <= iQUAD_CNT_R_R(63 downto 32);
+          iSNAP(11) <= iQUAD_CNT_R_R(31 downto 0);
+          iSNAP(12) <= iQUAD_CNT_TH_L(63 downto 32);
+          iSNAP(13) <= iQUAD_CNT_TH_L(31 downto 0);
+          iSNAP(14) <= iQUAD_CNT_R_L(63 downto 32);
+          iSNAP(15) <= iQUAD_CNT_R_L(31 downto 0);
+          iSNAP_SEQ <= iSNAP_SEQ + 1;
+          iSNAP_PENDING <= '0';
+        else
+          iSNAP_PENDING <= '1';
+        end if;
+      end if;
+    end if;
+  end process;
+
+-- seuil haut de la fifo de trace : IT LEON (niveau, le handler la masque)
+-- et broche hote, tant que la fifo n'est pas videe sous le seuil
+  trace_irq_proc : process (presetn, pclk)
+  begin
+    if presetn = '0' then
+      iTRACE_WM <= '0';
+      irq_leon  <= '0';
+      irq_host  <= '0';
+    elsif rising_edge(pclk) then
+      if (conv_integer(iTRACE_CTRL(8 downto 0)) /= 0) and
+        (conv_integer(iTRACE_FIFO_LEVEL) >= conv_integer(iTRACE_CTRL(8 downto 0))) then
+        iTRACE_WM <= '1';
+      else
+        iTRACE_WM <= '0';
+      end if;
+      irq_leon <= iTRACE_WM and iTRACE_CTRL(16);
+      irq_host <= iTRACE_WM and iTRACE_CTRL(17);
+    end if;
+  end process;
+
+-- ultrasons : un seul capteur en vol a la fois (pas de diaphonie), le
+-- suivant des capteurs actifs est declenche des que l'echo du precedent
+-- est revenu (ou au timeout) plus la garde (echos multiples) : la cadence
+-- totale suit les distances au lieu d'une periode fixe par capteur
+  us_sched_proc : process (iRESET, pclk)
+    variable found : std_logic;
+    variable n     : integer range 0 to 5;
+    variable nxt   : integer range 0 to 2;
+  begin
+    if iRESET = '1' then
+      iUS_SCHED     <= us_sched_guard;
+      iUS_GUARD_CNT <= (others => '0');
+      iUS_CUR       <= 2;
+      iUS_START     <= (others => '0');
+      iUS1_STAMP    <= (others => '0');
+      iUS2_STAMP    <= (others => '0');
+      iUS3_STAMP    <= (others => '0');
+    elsif rising_edge(pclk) then
+      iUS_START <= (others => '0');
+
+      if (iUS_DONE(0) = '1') then
+        iUS1_STAMP <= iROBOT_TIMER;
+      end if;
+      if (iUS_DONE(1) = '1') then
+        iUS2_STAMP <= iROBOT_TIMER;
+      end if;
+      if (iUS_DONE(2) = '1') then
+        iUS3_STAMP <= iROBOT_TIMER;
+      end if;
+
+      case iUS_SCHED is
+        when us_sched_guard =>
+          if (conv_integer(iUS_GUARD_CNT) >= conv_integer(iUS_GUARD(23 downto 0))) then
+            -- prochain capteur actif apres le courant (tourniquet)
+            found := '0';
+            nxt   := 0;
+            for i in 1 to 3 loop
+              n := iUS_CUR + i;
+              if (n >= 3) then
+                n := n - 3;
+              end if;
+              if (found = '0') and (iUS_CTRL(n) = '1') then
+                found := '1';
+                nxt   := n;
+              end if;
+            end loop;
+            if (found = '1') then
+              iUS_CUR        <= nxt;
+              iUS_START(nxt) <= '1';
+              iUS_SCHED      <= us_sched_run;
+            end if;
+          else
+            iUS_GUARD_CNT <= iUS_GUARD_CNT + 1;
+          end if;
+
+        when us_sched_run =>
+          if (iUS_DONE(iUS_CUR) = '1') then
+            iUS_GUARD_CNT <= (others => '0');
+            iUS_SCHED     <= us_sched_guard;
+          end if;
+      end case;
+    end if;
+  end process;
+
+-- dip switches : double resynchro sur pclk (entrees asynchrones)
+  dip_sw_proc : process (presetn, pclk)
+  begin
+    if presetn = '0' then
+      iDIP_SW_META <= (others => '0');
+      iDIP_SW      <= (others => '0');
+    elsif rising_edge(pclk) then
+      iDIP_SW_META <= dip_sw;
+      iDIP_SW      <= iDIP_SW_META;
+    end if;
+  end process;
+
 -- timer process
   timer_proc : process (iRESET, pclk)
     variable local_counter : integer := 0;
@@ -384,16 +1004,27 @@ begin
 --  iI2C_SLAVE_DATA <= iMST_RDATA;
 --  iSPI_SLAVE_DATA <= iMST_RDATA;
 
--- Multiplexeur pour les 2 interfaces master : APB et SPI
+-- Multiplexeur pour les 3 interfaces master : APB, SPI et I2C
+-- (priorite a l'APB, puis au SPI ; l'I2C n'est selectionne que si aucun
+-- acces SPI n'est en cours, au lieu de iDEBUG_REG(31) dans l'ancienne version)
+-- L'esclave SPI attend (SPI_MASTER_WAIT) tant que l'APB a le bus, l'esclave
+-- I2C (I2C_MASTER_WAIT) tant que l'APB ou le SPI l'a : une requete n'est
+-- jamais fusionnee avec un autre acces (RD/WR SPI deja masques par WAIT).
+  iSPI_MASTER_WAIT <= '1' when ((psel='1') and (penable='1')) else '0';
+  iI2C_MASTER_WAIT <= '1' when ((psel='1') and (penable='1')) or
+                      (iSPI_MASTER_RD='1') or (iSPI_MASTER_WR='1') else '0';
   iMST_READ  <= '1' when (((psel='1') and (penable='1') and (pwrite='0')) or
-                (iSPI_MASTER_RD='1')) else '0';
+                (iI2C_MASTER_RD='1') or (iSPI_MASTER_RD='1')) else '0';
   iMST_WRITE <= '1' when (((psel='1') and (penable='1') and (pwrite='1')) or
-                (iSPI_MASTER_WR='1')) else '0';
+                (iI2C_MASTER_WR='1') or (iSPI_MASTER_WR='1')) else '0';
   iMST_ADDR  <= paddr when ((psel='1') and (penable='1')) else
-                iSPI_MASTER_ADDR;
+                iSPI_MASTER_ADDR when ((iSPI_MASTER_RD='1') or (iSPI_MASTER_WR='1')) else
+                iI2C_MASTER_ADDR;
   iMST_WDATA <= pwdata when ((psel='1') and (penable='1') and (pwrite='1')) else
-                iSPI_MASTER_DATA;
+                iSPI_MASTER_DATA when (iSPI_MASTER_WR='1') else
+                iI2C_MASTER_DATA;
   prdata          <= iMST_RDATA;
+  iI2C_SLAVE_DATA <= iMST_RDATA;
   iSPI_SLAVE_DATA <= iMST_RDATA;
 
 -- APB Write process
@@ -414,15 +1045,70 @@ begin
       iPUMP1_PW          <= (others => '0');
       iPUMP2_PWM_PERIOD  <= X"00000200";
       iPUMP2_PW          <= (others => '0');
+      iSERVO1_TARGET     <= (others => '0');
+      iSERVO2_TARGET     <= (others => '0');
+      iSERVO3_TARGET     <= (others => '0');
+      iPUMP1_TARGET      <= (others => '0');
+      iPUMP2_TARGET      <= (others => '0');
+      -- par defaut une ecriture de xxx_PW s'applique tout de suite, comme
+      -- avant les ombres
+      iACT_AUTO          <= (others => '1');
+      iSERVO1_SLEW       <= (others => '0');
+      iSERVO2_SLEW       <= (others => '0');
+      iSERVO3_SLEW       <= (others => '0');
+
+      iSTEPPER_CTRL      <= (others => '0');
+      iSTEPPER_TARGET    <= (others => '0');
+      iSTEPPER_PERIOD    <= X"0FA003E8"; -- depart 4ms, croisiere 1ms
+      iSTEPPER_ACCEL     <= X"00000032"; -- 50us/pas
 
       iTRACE_FIFO        <= (others => '0');
       iTRACE_FIFO_WR     <= '0';
+      iTRACE_CTRL        <= (others => '0');
+      iTRACE_OVF         <= (others => '0');
+
+      iMAILBOX           <= (others => (others => '0'));
+
+      iMUL64_OP1         <= (others => '0');
+      iMUL64_OP2         <= (others => '0');
+      iSINCOS_CMD        <= (others => '0');
+      iSINCOS_ANGLE      <= (others => '0');
+      iSNAP_CMD          <= '0';
+
+      iSENS_SEQ          <= (others => '0');
+      iSENS_TIMER        <= (others => '0');
+      iSENS_VAL_R        <= (others => '0');
+      iSENS_VAL_L        <= (others => '0');
+      iSENS_SPEED_R      <= (others => '0');
+      iSENS_SPEED_L      <= (others => '0');
+
+      iGPS_SAMPLING_T    <= X"0000619F"; -- 1 ms (25000 cycles - 1)
+      iGPS_CTRL          <= (others => '0');
+      iGPS_X_INIT        <= (others => '0');
+      iGPS_Y_INIT        <= (others => '0');
+      iGPS_THETA_INIT    <= (others => '0');
+
+      iQUAD_SAMPLING     <= X"0000619F"; -- 1 ms
+      iQUAD_INC_R        <= X"1000";     -- 1.0 (Q4.12)
+      iQUAD_INC_L        <= X"1000";
+      iQUAD_INC_TH_R     <= (others => '0');
+      iQUAD_INC_R_R      <= (others => '0');
+      iQUAD_INC_TH_L     <= (others => '0');
+      iQUAD_INC_R_L      <= (others => '0');
+
+      iUS_CTRL           <= (others => '0');
+      iUS_TIMEOUT        <= X"000927C0"; -- 24 ms (~4 m)
+      iUS_GUARD          <= X"0003D090"; -- 10 ms
 
 -- FIXME : DEBUG ++
       iSPI_DBG_SLV_DATA  <= (others => '0');
 -- FIXME : DEBUG --
 
     elsif rising_edge(pclk) then
+      -- start du sin/cos : impulsion d'un cycle (sinon le calcul boucle)
+      iSINCOS_CMD <= (others => '0');
+      iSNAP_CMD   <= '0';
+
       if (iMST_WRITE = '1') then
         case iMST_ADDR(11 downto 2) is
           -- timer & reset
@@ -435,21 +1121,21 @@ begin
           when "0000000011" => -- 0x8000800c -- robot_reg[0x03]
             null;
 
-          -- was uart test in 2016
+          -- stepper (mode position)
           when "0000000100" => -- 0x80008010 -- robot_reg[0x04]
-            null; -- <available>
+            iSTEPPER_CTRL   <= iMST_WDATA;
           when "0000000101" => -- 0x80008014 -- robot_reg[0x05]
-            null; -- <available>
+            iSTEPPER_TARGET <= iMST_WDATA;
           when "0000000110" => -- 0x80008018 -- robot_reg[0x06]
-            null; -- <available>
+            iSTEPPER_PERIOD <= iMST_WDATA;
           when "0000000111" => -- 0x8000801c -- robot_reg[0x07]
-            null; -- <available>
+            iSTEPPER_ACCEL  <= iMST_WDATA;
 
           -- i2c slave
           when "0000001000" => -- 0x80008020 -- robot_reg[0x08]
-            null; -- FIXME : TODO : control (from APB)
+            iTRACE_CTRL <= iMST_WDATA; -- TRACE seuil + IT
           when "0000001001" => -- 0x80008024 -- robot_reg[0x09]
-            null; -- status (from I2C master)
+            iTRACE_OVF <= (others => '0'); -- TRACE mots perdus : raz
           when "0000001010" => -- 0x80008028 -- robot_reg[0x0a]
             null; -- ADDR from I2C master
           when "0000001011" => -- 0x8000802c -- robot_reg[0x0b]
@@ -459,53 +1145,96 @@ begin
           when "0000001101" => -- 0x80008034 -- robot_reg[0x0d]
             iTRACE_FIFO <= iMST_WDATA; -- TRACE FIFO wr
             iTRACE_FIFO_WR <= '1';
+            if (iTRACE_FIFO_FULL = '1') then
+              iTRACE_OVF <= iTRACE_OVF + 1;
+            end if;
           when "0000001110" => -- 0x80008038 -- robot_reg[0x0e]
             null; -- FIXME : TODO : BSTR control
           when "0000001111" => -- 0x8000803c -- robot_reg[0x0f]
             null; -- BSTR read-only for APB
 
+          -- instantane pose + compteurs : toute ecriture le declenche
+          when "0000010000" => -- 0x80008040 -- robot_reg[0x10]
+            iSNAP_CMD <= '1';
+
+          -- instantane capteurs : toute ecriture fige 0x21..0x25
+          when "0000100000" => -- 0x80008080 -- robot_reg[0x20]
+            iSENS_SEQ     <= iSENS_SEQ + 1;
+            iSENS_TIMER   <= iROBOT_TIMER;
+            iSENS_VAL_R   <= iQUAD_VAL_R;
+            iSENS_VAL_L   <= iQUAD_VAL_L;
+            iSENS_SPEED_R <= iQUAD_SPEED_R;
+            iSENS_SPEED_L <= iQUAD_SPEED_L;
+
           -- was motors in 2016
           when "0001000000" => -- 0x80008100 -- robot_reg[0x40]
             null; -- <available>
           when "0001001000" => -- 0x80008120 -- robot_reg[0x48]
             null; -- <available>
 
-          -- was odometry in 2016
+          -- odometrie : compteurs de quadrature (0x81.. droite, 0x89.. gauche)
           when "0010000001" => -- 0x80008204 -- robot_reg[0x81]
-            null; -- <available>
+            null; -- iQUAD_VAL_R (read-only)
           when "0010000011" => -- 0x8000820c -- robot_reg[0x83]
-            null; -- <available>
+            iQUAD_INC_R <= iMST_WDATA(15 downto 0);
           when "0010000100" => -- 0x80008210 -- robot_reg[0x84]
-            null; -- <available>
+            null; -- iQUAD_SPEED_R (read-only)
+          when "0010000101" => -- 0x80008214 -- robot_reg[0x85]
+            null; -- iQUAD_LAST_EDGE_R (read-only)
+          when "0010000110" => -- 0x80008218 -- robot_reg[0x86]
+            null; -- iQUAD_EDGE_TIMER_R (read-only)
           when "0010000111" => -- 0x8000821c -- robot_reg[0x87]
-            null; -- <available>
+            iQUAD_SAMPLING <= iMST_WDATA;
           when "0010001001" => -- 0x80008224 -- robot_reg[0x89]
-            null; -- <available>
+            null; -- iQUAD_VAL_L (read-only)
           when "0010001011" => -- 0x8000822c -- robot_reg[0x8b]
-            null; -- <available>
+            iQUAD_INC_L <= iMST_WDATA(15 downto 0);
           when "0010001100" => -- 0x80008230 -- robot_reg[0x8c]
-            null; -- <available>
+            null; -- iQUAD_SPEED_L (read-only)
+          when "0010001101" => -- 0x80008234 -- robot_reg[0x8d]
+            null; -- iQUAD_LAST_EDGE_L (read-only)
+          when "0010001110" => -- 0x80008238 -- robot_reg[0x8e]
+            null; -- iQUAD_EDGE_TIMER_L (read-only)
           when "0010001111" => -- 0x8000823c -- robot_reg[0x8f]
             null; -- <available>
 
-          -- was "advanced" odometry in 2016
+          -- odometrie integree : [0] ENABLE, [1] SETUP (pose initiale et
+          -- compteurs courants charges tant que SETUP est a 1)
+          when "0010010000" => -- 0x80008240 -- robot_reg[0x90]
+            iGPS_CTRL <= iMST_WDATA(1 downto 0);
           when "0010010001" => -- 0x80008244 -- robot_reg[0x91]
             null; -- <available>
+          when "0010010010" => -- 0x80008248 -- robot_reg[0x92]
+            iGPS_X_INIT(63 downto 32) <= iMST_WDATA;
           when "0010010011" => -- 0x8000824c -- robot_reg[0x93]
-            null; -- <available>
+            iGPS_X_INIT(31 downto 0) <= iMST_WDATA;
           when "0010010100" => -- 0x80008250 -- robot_reg[0x94]
-            null; -- <available>
+            iGPS_Y_INIT(63 downto 32) <= iMST_WDATA;
+          when "0010010101" => -- 0x80008254 -- robot_reg[0x95]
+            iGPS_Y_INIT(31 downto 0) <= iMST_WDATA;
+          when "0010010110" => -- 0x80008258 -- robot_reg[0x96]
+            iGPS_THETA_INIT(63 downto 32) <= iMST_WDATA;
           when "0010010111" => -- 0x8000825c -- robot_reg[0x97]
-            null; -- <available>
+            iGPS_THETA_INIT(31 downto 0) <= iMST_WDATA;
+          -- increments Q15.48 par front : theta (rad) et distance (mm)
+          when "0010011000" => -- 0x80008260 -- robot_reg[0x98]
+            iQUAD_INC_TH_R(63 downto 32) <= iMST_WDATA;
           when "0010011001" => -- 0x80008264 -- robot_reg[0x99]
-            null; -- <available>
+            iQUAD_INC_TH_R(31 downto 0) <= iMST_WDATA;
+          when "0010011010" => -- 0x80008268 -- robot_reg[0x9a]
+            iQUAD_INC_R_R(63 downto 32) <= iMST_WDATA;
           when "0010011011" => -- 0x8000826c -- robot_reg[0x9b]
-            null; -- <available>
+            iQUAD_INC_R_R(31 downto 0) <= iMST_WDATA;
           when "0010011100" => -- 0x80008270 -- robot_reg[0x9c]
-            null; -- <available>
+            iQUAD_INC_TH_L(63 downto 32) <= iMST_WDATA;
+          when "0010011101" => -- 0x80008274 -- robot_reg[0x9d]
+            iQUAD_INC_TH_L(31 downto 0) <= iMST_WDATA;
+          when "0010011110" => -- 0x80008278 -- robot_reg[0x9e]
+            iQUAD_INC_R_L(63 downto 32) <= iMST_WDATA;
           when "0010011111" => -- 0x8000827c -- robot_reg[0x9f]
-            null; -- <available>
+            iQUAD_INC_R_L(31 downto 0) <= iMST_WDATA;
 
+          -- was "advanced" odometry in 2016
           when "0010100001" => -- 0x80008284 -- robot_reg[0xa1]
             null; -- <available>
           when "0010100011" => -- 0x8000828c -- robot_reg[0xa3]
@@ -523,25 +1252,25 @@ begin
           when "0010101111" => -- 0x800082bc -- robot_reg[0xaf]
             null; -- <available>
 
-          -- was 64bit multiplier in 2016
+          -- multiplieur 64 bits (Q15.48) : op1 * op2 en 0xb4/0xb5
           when "0010110000" => -- 0x800082c0 -- robot_reg[0xb0]
-            null; -- <available>
+            iMUL64_OP1(63 downto 32) <= iMST_WDATA;
           when "0010110001" => -- 0x800082c4 -- robot_reg[0xb1]
-            null; -- <available>
+            iMUL64_OP1(31 downto 0) <= iMST_WDATA;
           when "0010110010" => -- 0x800082c8 -- robot_reg[0xb2]
-            null; -- <available>
+            iMUL64_OP2(63 downto 32) <= iMST_WDATA;
           when "0010110011" => -- 0x800082cc -- robot_reg[0xb3]
-            null; -- <available>
+            iMUL64_OP2(31 downto 0) <= iMST_WDATA;
 
-          -- was sin_cos in 2016
+          -- sin/cos (Q15.48) : bit 0 = start
           when "0010111000" => -- 0x800082e0 -- robot_reg[0xb8]
-            null; -- <available>
+            iSINCOS_CMD <= iMST_WDATA;
           when "0010111001" => -- 0x800082e4 -- robot_reg[0xb9]
             null; -- <available>
           when "0010111010" => -- 0x800082e8 -- robot_reg[0xba]
-            null; -- <available>
+            iSINCOS_ANGLE(63 downto 32) <= iMST_WDATA;
           when "0010111011" => -- 0x800082ec -- robot_reg[0xbb]
-            null; -- <available>
+            iSINCOS_ANGLE(31 downto 0) <= iMST_WDATA;
 
           -- PETIT ROBOT 2018
           when "0011000000" => -- 0x80008300 -- robot_reg[0xc0]
@@ -556,64 +1285,101 @@ begin
             iSERVO1_PWM_PERIOD <= iMST_WDATA;
           when "0011000101" => -- 0x80008314 -- robot_reg[0xc5]
             iSERVO1_PW         <= iMST_WDATA;
+            if iACT_AUTO(0) = '1' then
+              iSERVO1_TARGET <= iMST_WDATA;
+            end if;
           when "0011000110" => -- 0x80008318 -- robot_reg[0xc6]
             iSERVO2_PWM_PERIOD <= iMST_WDATA;
           when "0011000111" => -- 0x8000831c -- robot_reg[0xc7]
             iSERVO2_PW         <= iMST_WDATA;
+            if iACT_AUTO(1) = '1' then
+              iSERVO2_TARGET <= iMST_WDATA;
+            end if;
           when "0011001000" => -- 0x80008320 -- robot_reg[0xc8]
             iSERVO3_PWM_PERIOD <= iMST_WDATA;
           when "0011001001" => -- 0x80008324 -- robot_reg[0xc9]
             iSERVO3_PW         <= iMST_WDATA;
+            if iACT_AUTO(2) = '1' then
+              iSERVO3_TARGET <= iMST_WDATA;
+            end if;
+          -- mise a jour groupee : [4:0] = ombres a appliquer (servo1..3,
+          -- pompe1..2), toutes au meme front
           when "0011001010" => -- 0x80008328 -- robot_reg[0xca]
-            null; -- <available>
+            if iMST_WDATA(0) = '1' then
+              iSERVO1_TARGET <= iSERVO1_PW;
+            end if;
+            if iMST_WDATA(1) = '1' then
+              iSERVO2_TARGET <= iSERVO2_PW;
+            end if;
+            if iMST_WDATA(2) = '1' then
+              iSERVO3_TARGET <= iSERVO3_PW;
+            end if;
+            if iMST_WDATA(3) = '1' then
+              iPUMP1_TARGET <= iPUMP1_PW;
+            end if;
+            if iMST_WDATA(4) = '1' then
+              iPUMP2_TARGET <= iPUMP2_PW;
+            end if;
           when "0011001011" => -- 0x8000832c -- robot_reg[0xcb]
-            null; -- <available>
+            iACT_AUTO <= iMST_WDATA(4 downto 0);
           when "0011001100" => -- 0x80008330 -- robot_reg[0xcc]
             iPUMP1_PWM_PERIOD <= iMST_WDATA;
           when "0011001101" => -- 0x80008334 -- robot_reg[0xcd]
             iPUMP1_PW         <= iMST_WDATA;
+            if iACT_AUTO(3) = '1' then
+              iPUMP1_TARGET <= iMST_WDATA;
+            end if;
           when "0011001110" => -- 0x80008338 -- robot_reg[0xce]
             iPUMP2_PWM_PERIOD <= iMST_WDATA;
           when "0011001111" => -- 0x8000833c -- robot_reg[0xcf]
             iPUMP2_PW         <= iMST_WDATA;
+            if iACT_AUTO(4) = '1' then
+              iPUMP2_TARGET <= iMST_WDATA;
+            end if;
 
-          -- was GPS in 2016
+          -- was GPS in 2016 : ordonnanceur des ultrasons (0xd0..0xd5) et
+          -- periode d'integration de c_gps (0xd7, GPS_SAMPLING_T)
           when "0011010000" => -- 0x80008340 -- robot_reg[0xd0]
-            null; -- <available>
+            null; -- iUS1_STAMP (read-only)
           when "0011010001" => -- 0x80008344 -- robot_reg[0xd1]
-            null; -- <available>
+            null; -- iUS2_STAMP (read-only)
           when "0011010010" => -- 0x80008348 -- robot_reg[0xd2]
-            null; -- <available>
+            null; -- iUS3_STAMP (read-only)
           when "0011010011" => -- 0x8000834c -- robot_reg[0xd3]
-            null; -- <available>
+            iUS_CTRL <= iMST_WDATA;
           when "0011010100" => -- 0x80008350 -- robot_reg[0xd4]
-            null; -- <available>
+            iUS_TIMEOUT <= iMST_WDATA;
           when "0011010101" => -- 0x80008354 -- robot_reg[0xd5]
-            null; -- <available>
+            iUS_GUARD <= iMST_WDATA;
           when "0011010110" => -- 0x80008358 -- robot_reg[0xd6]
             null; -- <available>
           when "0011010111" => -- 0x8000835c -- robot_reg[0xd7]
-            null; -- <available>
+            iGPS_SAMPLING_T <= iMST_WDATA; -- cycles pclk - 1, 127 au moins
 
           -- ROBOT_SPI_SLAVE : esclave SPI
           when "0011011000" => -- 0x80008360 -- robot_reg[0xd8]
             iSPI_DBG_SLV_DATA <= iMST_WDATA;
           when "0011011001" => -- 0x80008364 -- robot_reg[0xd9]
             null; -- <available> -- iSPI_DBG_MST_DATA
+          -- rampe des servos : pas maxi de largeur par periode (0 : aucune)
           when "0011011010" => -- 0x80008368 -- robot_reg[0xda]
-            null; -- <available>
+            iSERVO1_SLEW <= iMST_WDATA(15 downto 0);
           when "0011011011" => -- 0x8000836c -- robot_reg[0xdb]
-            null; -- <available>
+            iSERVO2_SLEW <= iMST_WDATA(15 downto 0);
           when "0011011100" => -- 0x80008370 -- robot_reg[0xdc]
-            null; -- <available>
+            iSERVO3_SLEW <= iMST_WDATA(15 downto 0);
           when "0011011101" => -- 0x80008374 -- robot_reg[0xdd]
-            null; -- <available>
+            null; -- iSERVO1_ACTUAL_PW (read-only)
           when "0011011110" => -- 0x80008378 -- robot_reg[0xde]
-            null; -- <available>
+            null; -- iSERVO2_ACTUAL_PW (read-only)
           when "0011011111" => -- 0x8000837c -- robot_reg[0xdf]
-            null; -- <available>
+            null; -- iSERVO3_ACTUAL_PW (read-only)
 
           when others =>
+            -- boite aux lettres : 0x80008380..0x800083fc -- robot_reg[0xe0..0xff]
+            if (iMST_ADDR(11 downto 7) = "00111") then
+              iMAILBOX(conv_integer(iMST_ADDR(6 downto 2))) <= iMST_WDATA;
+            end if;
         end case;
       else
 
@@ -636,32 +1402,30 @@ begin
         when "0000000000" => -- 0x80008000 -- robot_reg[0x00]
           iMST_RDATA <= iROBOT_TIMER;
         when "0000000001" => -- 0x80008004 -- robot_reg[0x01]
-          -- FIXME : TODO : GPIO 2018
---          iMST_RDATA <= (others => '0');
+          -- GPIO 2018 : dip switches en [3:0]
+          iMST_RDATA <= X"0000000" & iDIP_SW;
           -- FIXME : DEBUG : SPI
-          iMST_RDATA <= iSPI_MASTER_ADDR;
+--          iMST_RDATA <= iSPI_MASTER_ADDR;
         when "0000000010" => -- 0x80008008 -- robot_reg[0x02]
           iMST_RDATA <= iDEBUG_REG;
         when "0000000011" => -- 0x8000800c -- robot_reg[0x03]
           iMST_RDATA <= X"54455354"; -- 'TEST' TAG
 
-        -- was uart test in 2016
-        when "0000000100" => -- 0x80008010 -- robot_reg[0x04]
-          iMST_RDATA <= (others => '0');
+        -- stepper (mode position)
+        when "0000000100" => -- 0x80008010 -- robot_reg[0x04] -- STEPPER status
+          iMST_RDATA <= iSTEPPER_DONE & "000" & X"000" & iSTEPPER_POS;
         when "0000000101" => -- 0x80008014 -- robot_reg[0x05]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSTEPPER_TARGET;
         when "0000000110" => -- 0x80008018 -- robot_reg[0x06]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSTEPPER_PERIOD;
         when "0000000111" => -- 0x8000801c -- robot_reg[0x07]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSTEPPER_ACCEL;
 
         -- i2c slave
-        when "0000001000" => -- 0x80008020 -- robot_reg[0x08]
-          -- FIXME : TODO : control (from APB)
-          iMST_RDATA <= (others => '0');
-        when "0000001001" => -- 0x80008024 -- robot_reg[0x09]
-          -- FIXME : TODO : status (from I2C master)
-          iMST_RDATA <= (others => '0');
+        when "0000001000" => -- 0x80008020 -- robot_reg[0x08] -- TRACE seuil
+          iMST_RDATA <= iTRACE_CTRL;
+        when "0000001001" => -- 0x80008024 -- robot_reg[0x09] -- TRACE perdus
+          iMST_RDATA <= iTRACE_OVF;
         when "0000001010" => -- 0x80008028 -- robot_reg[0x0a]
           -- FIXME : TODO : ADDR from I2C master
           iMST_RDATA <= (others => '0');
@@ -669,7 +1433,10 @@ begin
           -- FIXME : TODO : DATA from I2C master
           iMST_RDATA <= (others => '0');
         when "0000001100" => -- 0x80008030 -- robot_reg[0x0c] -- TRACE status
-          iMST_RDATA <= X"0000000"&"00"&iTRACE_FIFO_EMPTY&iTRACE_FIFO_FULL;
+          -- [24:16] niveau, [2] seuil atteint, [1] vide, [0] pleine
+          iMST_RDATA <= "0000000" & iTRACE_FIFO_LEVEL &
+                        X"000" & "0" & iTRACE_WM & iTRACE_FIFO_EMPTY &
+                        iTRACE_FIFO_FULL;
         when "0000001101" => -- 0x80008034 -- robot_reg[0x0d]
           iMST_RDATA <= iTRACE_FIFO_DEBUG; -- TRACE write-only for APB
         when "0000001110" => -- 0x80008038 -- robot_reg[0x0e] -- BSTR status
@@ -679,51 +1446,120 @@ begin
           iMST_RDATA <= iBSTR_FIFO;
           iBSTR_FIFO_RD <= '1';
 
+        -- instantane pose + compteurs : [31] demande en attente, [15:0] nombre
+        -- d'instantanes pris ; 0x11..0x1f figes ensemble
+        when "0000010000" => -- 0x80008040 -- robot_reg[0x10]
+          iMST_RDATA <= iSNAP_PENDING & "000" & X"000" & iSNAP_SEQ;
+        when "0000010001" => -- 0x80008044 -- robot_reg[0x11] -- timer (us)
+          iMST_RDATA <= iSNAP(1);
+        when "0000010010" => -- 0x80008048 -- robot_reg[0x12] -- GPS_X
+          iMST_RDATA <= iSNAP(2);
+        when "0000010011" => -- 0x8000804c -- robot_reg[0x13]
+          iMST_RDATA <= iSNAP(3);
+        when "0000010100" => -- 0x80008050 -- robot_reg[0x14] -- GPS_Y
+          iMST_RDATA <= iSNAP(4);
+        when "0000010101" => -- 0x80008054 -- robot_reg[0x15]
+          iMST_RDATA <= iSNAP(5);
+        when "0000010110" => -- 0x80008058 -- robot_reg[0x16] -- GPS_THETA
+          iMST_RDATA <= iSNAP(6);
+        when "0000010111" => -- 0x8000805c -- robot_reg[0x17]
+          iMST_RDATA <= iSNAP(7);
+        when "0000011000" => -- 0x80008060 -- robot_reg[0x18] -- QUAD_CNT_TH_R
+          iMST_RDATA <= iSNAP(8);
+        when "0000011001" => -- 0x80008064 -- robot_reg[0x19]
+          iMST_RDATA <= iSNAP(9);
+        when "0000011010" => -- 0x80008068 -- robot_reg[0x1a] -- QUAD_CNT_R_R
+          iMST_RDATA <= iSNAP(10);
+        when "0000011011" => -- 0x8000806c -- robot_reg[0x1b]
+          iMST_RDATA <= iSNAP(11);
+        when "0000011100" => -- 0x80008070 -- robot_reg[0x1c] -- QUAD_CNT_TH_L
+          iMST_RDATA <= iSNAP(12);
+        when "0000011101" => -- 0x80008074 -- robot_reg[0x1d]
+          iMST_RDATA <= iSNAP(13);
+        when "0000011110" => -- 0x80008078 -- robot_reg[0x1e] -- QUAD_CNT_R_L
+          iMST_RDATA <= iSNAP(14);
+        when "0000011111" => -- 0x8000807c -- robot_reg[0x1f]
+          iMST_RDATA <= iSNAP(15);
+
+        -- instantane capteurs : [15:0] nombre d'instantanes pris
+        when "0000100000" => -- 0x80008080 -- robot_reg[0x20]
+          iMST_RDATA <= X"0000" & iSENS_SEQ;
+        when "0000100001" => -- 0x80008084 -- robot_reg[0x21] -- timer (us)
+          iMST_RDATA <= iSENS_TIMER;
+        when "0000100010" => -- 0x80008088 -- robot_reg[0x22] -- RC_VAL_1
+          iMST_RDATA <= iSENS_VAL_R;
+        when "0000100011" => -- 0x8000808c -- robot_reg[0x23] -- RC_VAL_2
+          iMST_RDATA <= iSENS_VAL_L;
+        when "0000100100" => -- 0x80008090 -- robot_reg[0x24] -- RC_SPEED_1
+          iMST_RDATA <= iSENS_SPEED_R;
+        when "0000100101" => -- 0x80008094 -- robot_reg[0x25] -- RC_SPEED_2
+          iMST_RDATA <= iSENS_SPEED_L;
+
         -- was motors in 2016
         when "0001000000" => -- 0x80008100 -- robot_reg[0x40]
           iMST_RDATA <= (others => '0');
         when "0001001000" => -- 0x80008120 -- robot_reg[0x48]
           iMST_RDATA <= (others => '0');
 
-        -- was odometry in 2016
+        -- odometrie : compteurs de quadrature (0x81.. droite, 0x89.. gauche)
         when "0010000001" => -- 0x80008204 -- robot_reg[0x81]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_VAL_R;
         when "0010000011" => -- 0x8000820c -- robot_reg[0x83]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= X"0000" & iQUAD_INC_R;
         when "0010000100" => -- 0x80008210 -- robot_reg[0x84]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_SPEED_R;
+        when "0010000101" => -- 0x80008214 -- robot_reg[0x85]
+          iMST_RDATA <= iQUAD_LAST_EDGE_R;
+        when "0010000110" => -- 0x80008218 -- robot_reg[0x86]
+          iMST_RDATA <= iQUAD_EDGE_TIMER_R;
         when "0010000111" => -- 0x8000821c -- robot_reg[0x87]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_SAMPLING;
         when "0010001001" => -- 0x80008224 -- robot_reg[0x89]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_VAL_L;
         when "0010001011" => -- 0x8000822c -- robot_reg[0x8b]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= X"0000" & iQUAD_INC_L;
         when "0010001100" => -- 0x80008230 -- robot_reg[0x8c]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_SPEED_L;
+        when "0010001101" => -- 0x80008234 -- robot_reg[0x8d]
+          iMST_RDATA <= iQUAD_LAST_EDGE_L;
+        when "0010001110" => -- 0x80008238 -- robot_reg[0x8e]
+          iMST_RDATA <= iQUAD_EDGE_TIMER_L;
         when "0010001111" => -- 0x8000823c -- robot_reg[0x8f]
           iMST_RDATA <= (others => '0');
 
-        -- was "advanced" odometry in 2016
+        -- odometrie integree : [0] ENABLE, [1] SETUP, [8] BUSY
+        when "0010010000" => -- 0x80008240 -- robot_reg[0x90]
+          iMST_RDATA <= X"00000" & "000" & iGPS_BUSY & "000000" & iGPS_CTRL;
         when "0010010001" => -- 0x80008244 -- robot_reg[0x91]
           iMST_RDATA <= (others => '0');
         when "0010010010" => -- 0x80008248 -- robot_reg[0x92]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iGPS_X_INIT(63 downto 32);
         when "0010010011" => -- 0x8000824c -- robot_reg[0x93]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iGPS_X_INIT(31 downto 0);
         when "0010010100" => -- 0x80008250 -- robot_reg[0x94]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iGPS_Y_INIT(63 downto 32);
+        when "0010010101" => -- 0x80008254 -- robot_reg[0x95]
+          iMST_RDATA <= iGPS_Y_INIT(31 downto 0);
+        when "0010010110" => -- 0x80008258 -- robot_reg[0x96]
+          iMST_RDATA <= iGPS_THETA_INIT(63 downto 32);
         when "0010010111" => -- 0x8000825c -- robot_reg[0x97]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iGPS_THETA_INIT(31 downto 0);
+        when "0010011000" => -- 0x80008260 -- robot_reg[0x98]
+          iMST_RDATA <= iQUAD_INC_TH_R(63 downto 32);
         when "0010011001" => -- 0x80008264 -- robot_reg[0x99]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_INC_TH_R(31 downto 0);
         when "0010011010" => -- 0x80008268 -- robot_reg[0x9a]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_INC_R_R(63 downto 32);
         when "0010011011" => -- 0x8000826c -- robot_reg[0x9b]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_INC_R_R(31 downto 0);
         when "0010011100" => -- 0x80008270 -- robot_reg[0x9c]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_INC_TH_L(63 downto 32);
+        when "0010011101" => -- 0x80008274 -- robot_reg[0x9d]
+          iMST_RDATA <= iQUAD_INC_TH_L(31 downto 0);
+        when "0010011110" => -- 0x80008278 -- robot_reg[0x9e]
+          iMST_RDATA <= iQUAD_INC_R_L(63 downto 32);
         when "0010011111" => -- 0x8000827c -- robot_reg[0x9f]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iQUAD_INC_R_L(31 downto 0);
 
         -- was "advanced" odometry in 2016
         when "0010100001" => -- 0x80008284 -- robot_reg[0xa1]
@@ -747,33 +1583,35 @@ begin
         when "0010101111" => -- 0x800082bc -- robot_reg[0xaf]
           iMST_RDATA <= (others => '0');
 
-        -- was 64bit multiplier in 2016
+        -- multiplieur 64 bits (Q15.48)
         when "0010110000" => -- 0x800082c0 -- robot_reg[0xb0]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iMUL64_OP1(63 downto 32);
         when "0010110001" => -- 0x800082c4 -- robot_reg[0xb1]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iMUL64_OP1(31 downto 0);
         when "0010110010" => -- 0x800082c8 -- robot_reg[0xb2]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iMUL64_OP2(63 downto 32);
         when "0010110011" => -- 0x800082cc -- robot_reg[0xb3]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iMUL64_OP2(31 downto 0);
         when "0010110100" => -- 0x800082d0 -- robot_reg[0xb4]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iMUL64_RESULT(63 downto 32);
         when "0010110101" => -- 0x800082d4 -- robot_reg[0xb5]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iMUL64_RESULT(31 downto 0);
 
-        -- was sin_cos in 2016
+        -- sin/cos (Q15.48) : status bit 0 = resultat pret (masque pendant
+        -- l'impulsion de start, STATUS(0) ne retombe qu'au cycle suivant)
         when "0010111000" => -- 0x800082e0 -- robot_reg[0xb8]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSINCOS_STATUS(31 downto 1) &
+                        (iSINCOS_STATUS(0) and not iSINCOS_CMD(0));
         when "0010111001" => -- 0x800082e4 -- robot_reg[0xb9]
           iMST_RDATA <= (others => '0');
         when "0010111010" => -- 0x800082e8 -- robot_reg[0xba]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSINCOS_SIN(63 downto 32);
         when "0010111011" => -- 0x800082ec -- robot_reg[0xbb]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSINCOS_SIN(31 downto 0);
         when "0010111100" => -- 0x800082f0 -- robot_reg[0xbc]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSINCOS_COS(63 downto 32);
         when "0010111101" => -- 0x800082f4 -- robot_reg[0xbd]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSINCOS_COS(31 downto 0);
 
         -- PETIT ROBOT 2018
         when "0011000000" => -- 0x80008300 -- robot_reg[0xc0]
@@ -796,10 +1634,12 @@ begin
           iMST_RDATA <= iSERVO3_PWM_PERIOD;
         when "0011001001" => -- 0x80008324 -- robot_reg[0xc9]
           iMST_RDATA <= iSERVO3_PW;
+        -- [4:0] ombres pas encore appliquees, [10:8] servos en rampe
         when "0011001010" => -- 0x80008328 -- robot_reg[0xca]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= X"00000" & "0" & (not iSERVO_DONE) &
+                        "000" & iACT_PENDING;
         when "0011001011" => -- 0x8000832c -- robot_reg[0xcb]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= X"000000" & "000" & iACT_AUTO;
         when "0011001100" => -- 0x80008330 -- robot_reg[0xcc]
           iMST_RDATA <= iPUMP1_PWM_PERIOD;
         when "0011001101" => -- 0x80008334 -- robot_reg[0xcd]
@@ -809,23 +1649,27 @@ begin
         when "0011001111" => -- 0x8000833c -- robot_reg[0xcf]
           iMST_RDATA <= iPUMP2_PW;
 
-        -- was gps in 2016
+        -- was gps in 2016 : ultrasons, date des dernieres mesures et
+        -- ordonnanceur ([5:4] capteur en cours, [8] mesure en vol)
         when "0011010000" => -- 0x80008340 -- robot_reg[0xd0]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iUS1_STAMP;
         when "0011010001" => -- 0x80008344 -- robot_reg[0xd1]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iUS2_STAMP;
         when "0011010010" => -- 0x80008348 -- robot_reg[0xd2]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iUS3_STAMP;
         when "0011010011" => -- 0x8000834c -- robot_reg[0xd3]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= X"00000" & "000" &
+                        (iUS_BUSY(0) or iUS_BUSY(1) or iUS_BUSY(2)) &
+                        "00" & conv_std_logic_vector(iUS_CUR, 2) &
+                        "0" & iUS_CTRL(2 downto 0);
         when "0011010100" => -- 0x80008350 -- robot_reg[0xd4]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iUS_TIMEOUT;
         when "0011010101" => -- 0x80008354 -- robot_reg[0xd5]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iUS_GUARD;
         when "0011010110" => -- 0x80008358 -- robot_reg[0xd6]
           iMST_RDATA <= (others => '0');
         when "0011010111" => -- 0x8000835c -- robot_reg[0xd7]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iGPS_SAMPLING_T;
 
         -- ROBOT_SPI_SLAVE : esclave SPI
         when "0011011000" => -- 0x80008360 -- robot_reg[0xd8]
@@ -833,19 +1677,24 @@ begin
         when "0011011001" => -- 0x80008364 -- robot_reg[0xd9]
           iMST_RDATA <= iSPI_DBG_MST_DATA;
         when "0011011010" => -- 0x80008368 -- robot_reg[0xda]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= X"0000" & iSERVO1_SLEW;
         when "0011011011" => -- 0x8000836c -- robot_reg[0xdb]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= X"0000" & iSERVO2_SLEW;
         when "0011011100" => -- 0x80008370 -- robot_reg[0xdc]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= X"0000" & iSERVO3_SLEW;
+        -- largeur effectivement generee (rampe en cours)
         when "0011011101" => -- 0x80008374 -- robot_reg[0xdd]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSERVO1_ACTUAL_PW;
         when "0011011110" => -- 0x80008378 -- robot_reg[0xde]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSERVO2_ACTUAL_PW;
         when "0011011111" => -- 0x8000837c -- robot_reg[0xdf]
-          iMST_RDATA <= (others => '0');
+          iMST_RDATA <= iSERVO3_ACTUAL_PW;
 
         when others =>
+          -- boite aux lettres : 0x80008380..0x800083fc -- robot_reg[0xe0..0xff]
+          if (iMST_ADDR(11 downto 7) = "00111") then
+            iMST_RDATA <= iMAILBOX(conv_integer(iMST_ADDR(6 downto 2)));
+          end if;
       end case;
     else
       iMST_RDATA <= (others => '1');
@@ -25,6 +25,10 @@ entity robot_gps_odo is
     QUAD_CNT_TH_L  : in std_logic_vector(63 downto 0);
     QUAD_CNT_R_L   : in std_logic_vector(63 downto 0);
 
+    -- periode d'integration en cycles de clock_i, moins 1
+    -- (24999 = 1 ms a 25 MHz), bornee a GPS_SAMPLING_MIN
+    GPS_SAMPLING_T : in std_logic_vector(31 downto 0);
+
     MUL64_OP1      : out std_logic_vector(63 downto 0);
     MUL64_OP2      : out std_logic_vector(63 downto 0);
     MUL64_RES      : in std_logic_vector(63 downto 0);
@@ -45,8 +49,13 @@ end robot_gps_odo;
 
 architecture robot_gps_odo_rtl of robot_gps_odo is
 
-  constant GPS_SAMPLING_T    : std_logic_vector(31 downto 0) :=
-    X"000F423F"; -- 40 ms avec pclk=25MHz
+  -- une integration dure 46 cycles (cf commentaires de la FSM, soit
+  -- 1.84 us a 25 MHz, 0.2% d'une periode de 1 ms) : en dessous de
+  -- GPS_SAMPLING_MIN, des periodes seraient sautees
+  constant GPS_SAMPLING_MIN  : std_logic_vector(31 downto 0) :=
+    X"0000007F"; -- 128 cycles
+
+  signal iGPS_SAMPLING_T     : std_logic_vector(31 downto 0);
 
   signal iGPS_X              : std_logic_vector(63 downto 0);
   signal iGPS_Y              : std_logic_vector(63 downto 0);
@@ -76,6 +85,7 @@ architecture robot_gps_odo_rtl of robot_gps_odo is
     fsm_read_odo ,
     fsm_compute_delta ,
     fsm_compute_theta ,
+    fsm_wait_trigo ,
     fsm_compute_trigo ,
     fsm_compute_x ,
     fsm_compute_y ,
@@ -87,6 +97,9 @@ architecture robot_gps_odo_rtl of robot_gps_odo is
 
 begin --architecture robot_gps_odo_rtl		 
 
+  iGPS_SAMPLING_T <= GPS_SAMPLING_MIN when (GPS_SAMPLING_T < GPS_SAMPLING_MIN)
+                     else GPS_SAMPLING_T;
+
   gps_proc : process (clock_i, resetb_i)
   begin
     if resetb_i = '0' then
@@ -184,10 +197,19 @@ begin --architecture robot_gps_odo_rtl
             fsm_state <= fsm_idle;
           else
             TRIG_ENABLE <= '1';
-            fsm_state <= fsm_compute_trigo;
+            fsm_state <= fsm_wait_trigo;
           end if;
-        when fsm_compute_trigo =>                             -- gps_ticks = 4
+        when fsm_wait_trigo =>                                -- gps_ticks = 4
+          -- le STATUS du sin/cos ne retombe qu'au front qui voit le start :
+          -- sans ce cycle, TRIG_DONE etait encore a '1' (calcul precedent)
+          -- et x/y etaient integres avec le sin/cos de la periode d'avant
           TRIG_ENABLE <= '0';
+          if ENABLE = '0' then
+            fsm_state <= fsm_idle;
+          else
+            fsm_state <= fsm_compute_trigo;
+          end if;
+        when fsm_compute_trigo =>                             -- gps_ticks = 5..43
           if ENABLE = '0' then
             fsm_state <= fsm_idle;
           elsif TRIG_DONE = '1' then
@@ -195,7 +217,7 @@ begin --architecture robot_gps_odo_rtl
             MUL64_OP2 <= iQUAD_DELTA_R_R + iQUAD_DELTA_R_L;
             fsm_state <= fsm_compute_x;
           end if;
-        when fsm_compute_x =>                                 -- gps_ticks ~ 40
+        when fsm_compute_x =>                                 -- gps_ticks = 44
           iGPS_X      <= iGPS_X + MUL64_RES;
           MUL64_OP1 <= TRIG_SIN;
           if ENABLE = '0' then
@@ -203,14 +225,14 @@ begin --architecture robot_gps_odo_rtl
           else
             fsm_state <= fsm_compute_y;
           end if;
-        when fsm_compute_y =>                                 -- gps_ticks ~ 41
+        when fsm_compute_y =>                                 -- gps_ticks = 45
           iGPS_Y      <= iGPS_Y + MUL64_RES;
           if ENABLE = '0' then
             fsm_state <= fsm_idle;
           else
             fsm_state <= fsm_done;
           end if;
-        when fsm_done =>                                      -- gps_ticks ~ 42
+        when fsm_done =>                                      -- gps_ticks = 46
           if ENABLE = '0' then
             fsm_state <= fsm_idle;
           else
@@ -218,7 +240,9 @@ begin --architecture robot_gps_odo_rtl
           end if;
         when others => fsm_state <= fsm_idle;
       end case;  
-      if iGPS_TICKS = GPS_SAMPLING_T then
+      -- >= : une periode raccourcie en cours de comptage prend effet
+      -- tout de suite (pas de tour complet du compteur 32 bits)
+      if iGPS_TICKS >= iGPS_SAMPLING_T then
         iGPS_TICKS <= X"00000000";
       else
         iGPS_TICKS <= iGPS_TICKS + 1;
@@ -20,6 +20,9 @@ entity robot_i2c_slave is
     I2C_SLAVE_DATA      : in std_logic_vector(31 downto 0);
     I2C_SLAVE_ACK       : in std_logic;
     I2C_SLAVE_IRQ       : out std_logic;
+    -- acces APB ou SPI en cours : la requete I2C (RD/WR) est maintenue et
+    -- n'est presentee au multiplexeur qu'une fois le bus libre
+    I2C_MASTER_WAIT     : in std_logic;
 
     -- trace fifo
     TRACE_FIFO          : in std_logic_vector(31 downto 0);
@@ -27,6 +30,7 @@ entity robot_i2c_slave is
     TRACE_FIFO_WR       : in std_logic;
     TRACE_FIFO_FULL     : out std_logic;
     TRACE_FIFO_EMPTY    : out std_logic;
+    TRACE_FIFO_LEVEL    : out std_logic_vector(8 downto 0); -- 0..256 mots
 
     -- bitstream fifo
     BSTR_FIFO           : out std_logic_vector(31 downto 0);
@@ -35,6 +39,14 @@ entity robot_i2c_slave is
     BSTR_FIFO_FULL      : out std_logic;
     BSTR_FIFO_EMPTY     : out std_logic;
 
+    -- acces de l'esclave SPI au mot de trace et aux commandes (le maitre
+    -- utilise l'un ou l'autre lien, pas les deux a la fois)
+    TRACE_EXT_RD        : in std_logic;
+    TRACE_EXT_DATA      : out std_logic_vector(31 downto 0);
+    TRACE_EXT_READY     : out std_logic;
+    BSTR_EXT_WR         : in std_logic;
+    BSTR_EXT_DATA       : in std_logic_vector(31 downto 0);
+
     -- I2C (external) interface
     SDA_IN              : in     std_logic;
     SDA_OUT             : out    std_logic;
@@ -58,7 +70,8 @@ component fifo256x32 is
     wrreq   : in std_logic;
     empty   : out std_logic;
     full    : out std_logic;
-    q       : out std_logic_vector (31 downto 0)
+    q       : out std_logic_vector (31 downto 0);
+    usedw   : out std_logic_vector (7 downto 0)
   );
 end component;
 
@@ -78,6 +91,7 @@ signal iI2c_read_old      : std_logic;
 signal iI2c_rbusy         : std_logic;
 signal iI2cRBus           : std_logic_vector( 7 downto 0 );
 signal iI2cNoData         : std_logic;
+signal iI2cNoWait         : std_logic;
 signal iI2cWBus           : std_logic_vector( 7 downto 0 );
 signal iI2cDebug          : std_logic_vector( 7 downto 0 );
 signal iI2cRegAddr        : std_logic_vector( 7 downto 0 );
@@ -92,10 +106,12 @@ signal iTRACE_FIFO_RD2    : std_logic;
 signal iTRACE_FIFO_EMPTY  : std_logic;
 signal iTRACE_FIFO_FULL   : std_logic;
 signal iTRACE_FIFO_RDATA  : std_logic_vector( 31 downto 0 );
+signal iTRACE_FIFO_USEDW  : std_logic_vector( 7 downto 0 );
 
 signal iI2cBstrData       : std_logic_vector( 31 downto 0 );
 signal iI2cBstrState      : std_logic_vector( 3 downto 0 );
 signal iI2cBstrNoData     : std_logic;
+signal iI2cNoSpace        : std_logic;
 signal iBSTR_FIFO_RD_OLD  : std_logic;
 
 signal iI2cRBus_05        : std_logic_vector( 7 downto 0 );
@@ -109,6 +125,9 @@ signal iI2C_SLAVE_DATA    : std_logic_vector(31 downto 0);
 signal iMstAddrState      : std_logic_vector( 3 downto 0 );
 signal iMstDataState      : std_logic_vector( 3 downto 0 );
 signal iSlvDataState      : std_logic_vector( 3 downto 0 );
+signal iMstBurstCnt       : std_logic_vector( 2 downto 0 );
+signal iMstAddrWrite      : std_logic;
+signal iMstDataWrite      : std_logic;
 
 
 begin
@@ -121,16 +140,25 @@ iI2C_SCL_IN <= SCL_IN;
 SCL_OUT <= iI2C_SCL_OUT;
 SCL_EN <= iI2C_SCL_EN;
 
+-- jusqu'au Fast-mode Plus (1 MHz) ; SCL etire 1 ms au plus quand le mot
+-- de trace est en cours de lecture dans la fifo (0x01), la lecture APB pas
+-- faite (0x05) ou la commande precedente pas lue par le LEON (0x02), NACK
+-- ensuite. Fifo de trace vide : NACK tout de suite (l'hote la vide jusqu'au
+-- NACK, sans attendre 1 ms a chaque fois)
 c_i2c_core : entity work.I2C_SLAVE_CORE
   generic map (
-    CLK_FREQ => 25000000,
-    BAUD     => 400000
+    CLK_FREQ   => 25000000,
+    BAUD       => 1000000,
+    FILTER_NS  => 50,
+    STRETCH_US => 1000
     )
   port map (
     SYS_CLK     => CLK,
     SYS_RST     => RESET,
     SLV_DIN     => iI2cRBus,
     SLV_NODATA  => iI2cNoData,
+    SLV_NOWAIT  => iI2cNoWait,
+    SLV_NOSPACE => iI2cNoSpace,
     SLV_ADDR    => X"42",
     SLV_READ    => iI2c_read,
     SLV_RBUSY   => iI2c_rbusy,
@@ -175,7 +203,8 @@ c_trace_fifo256x32 : fifo256x32 port map (
     wrreq  => TRACE_FIFO_WR,
     empty  => iTRACE_FIFO_EMPTY,
     full   => iTRACE_FIFO_FULL,
-    q      => iTRACE_FIFO_RDATA
+    q      => iTRACE_FIFO_RDATA,
+    usedw  => iTRACE_FIFO_USEDW
   );
 
 p_i2c_trace: process (CLK, RESET)
@@ -212,6 +241,13 @@ begin
       end if;
     end if;
 
+    -- mot pret et pas entame par l'I2C : lu d'un bloc par le SPI
+    if (TRACE_EXT_RD = '1') and (iI2cNoData_01 = '0') and
+      (iI2cTraceState = X"0") then
+      iI2cTraceNoData <= '1';
+      iI2cNoData_01 <= '1';
+    end if;
+
     if (iTRACE_FIFO_EMPTY='0') and (iI2c_rbusy='0') and
       (iI2cTraceNoData='1') and (iTRACE_FIFO_RD = '0') then
       iTRACE_FIFO_RD <= '1';
@@ -233,7 +269,12 @@ begin
 end process p_i2c_trace;
 TRACE_FIFO_FULL <= iTRACE_FIFO_FULL;
 TRACE_FIFO_EMPTY <= iTRACE_FIFO_EMPTY;
+-- usedw repasse a 0 quand la fifo est pleine
+TRACE_FIFO_LEVEL <= iTRACE_FIFO_FULL & iTRACE_FIFO_USEDW;
 TRACE_FIFO_DEBUG <= iTRACE_FIFO_RDATA;
+TRACE_EXT_DATA <= iI2cTraceData;
+TRACE_EXT_READY <= '1' when (iI2cNoData_01 = '0') and (iI2cTraceState = X"0")
+                   else '0';
 
 
 -- firmware (or command) interface
@@ -271,6 +312,14 @@ begin
       end if;
     end if;
 
+    if (BSTR_EXT_WR = '1') then
+      iI2cBstrData <= BSTR_EXT_DATA;
+      iI2cBstrState <= X"0";
+      iI2cBstrNoData <= '0';
+      BSTR_FIFO <= BSTR_EXT_DATA;
+      BSTR_FIFO_FULL <= '1';
+    end if;
+
     if (BSTR_FIFO_RD = '1') and (iBSTR_FIFO_RD_OLD = '0') then
       if (iI2cBstrNoData = '0') then
         iI2cBstrState <= X"0";
@@ -283,6 +332,11 @@ begin
   end if;
 end process p_i2c_bstr;
 BSTR_FIFO_EMPTY <= iI2cBstrNoData;
+-- 4eme octet d'une commande alors que la precedente est encore la : l'ACK
+-- attend que le LEON l'ait lue (plus d'ecrasement au chargement)
+iI2cNoSpace <= '1' when (iI2cRegAddr = X"02") and (iI2cBstrState = X"3") and
+                        (iI2cBstrNoData = '0')
+               else '0';
 BSTR_FIFO_DEBUG <= iI2cBstrData;
 
 
@@ -291,6 +345,34 @@ BSTR_FIFO_DEBUG <= iI2cBstrData;
 I2C_SLAVE_IRQ <= '0';
 -- FIXME : TODO --
 
+-- ecriture en rafale (0x06) : suite de paires adresse APB (4 octets) +
+-- donnee (4 octets) dans une seule transaction I2C, chaque paire fait une
+-- ecriture APB comme 0x03 puis 0x04 (mouvement coordonne des servos :
+-- ombres puis R_ROBOT_ACT_COMMIT). Les compteurs repartent de l'adresse a
+-- chaque nouvelle transaction. L'ecriture APB d'une paire est servie bien
+-- avant l'octet suivant (9 us au moins a 1 MHz), l'adresse n'est donc pas
+-- ecrasee par la paire suivante tant que le bus n'est pas pris aussi
+-- longtemps par l'APB ou le SPI
+p_mst_burst: process (CLK, RESET)
+begin
+  if RESET = '1' then
+    iMstBurstCnt <= "000";
+  elsif CLK'event and CLK = '1' then  
+    if (iI2c_waddr = '1') then
+      iMstBurstCnt <= "000";
+    elsif (iI2cRegAddr = X"06") and (iI2c_write = '1') and (iI2c_write_old = '0') then
+      iMstBurstCnt <= iMstBurstCnt + 1;
+    end if;
+  end if;
+end process p_mst_burst;
+
+iMstAddrWrite <= '1' when (iI2c_write = '1') and (iI2c_write_old = '0') and
+                          ((iI2cRegAddr = X"03") or
+                           ((iI2cRegAddr = X"06") and (iMstBurstCnt(2) = '0'))) else '0';
+iMstDataWrite <= '1' when (iI2c_write = '1') and (iI2c_write_old = '0') and
+                          ((iI2cRegAddr = X"04") or
+                           ((iI2cRegAddr = X"06") and (iMstBurstCnt(2) = '1'))) else '0';
+
 -- robot master addr
 p_mst_addr: process (CLK, RESET)
 begin
@@ -298,25 +380,25 @@ begin
     iI2C_MASTER_ADDR <= (others => '0');
     iMstAddrState <= X"0";
   elsif CLK'event and CLK = '1' then  
-    if (iI2cRegAddr = X"03") then
-      if (iI2c_write = '1') and (iI2c_write_old = '0') then
-        case iMstAddrState is
-          when X"0" =>
-            iI2C_MASTER_ADDR(31 downto 24) <= iI2cWBus;
-            iMstAddrState <= X"1";
-          when X"1" =>
-            iI2C_MASTER_ADDR(23 downto 16) <= iI2cWBus;
-            iMstAddrState <= X"2";
-          when X"2" =>
-            iI2C_MASTER_ADDR(15 downto 8) <= iI2cWBus;
-            iMstAddrState <= X"3";
-          when X"3" =>
-            iI2C_MASTER_ADDR(7 downto 0) <= iI2cWBus;
-            iMstAddrState <= X"0";
-          when others =>
-            null;
-        end case;
-      end if;
+    if (iI2c_waddr = '1') and (iI2cWBus = X"06") then
+      iMstAddrState <= X"0";
+    elsif (iMstAddrWrite = '1') then
+      case iMstAddrState is
+        when X"0" =>
+          iI2C_MASTER_ADDR(31 downto 24) <= iI2cWBus;
+          iMstAddrState <= X"1";
+        when X"1" =>
+          iI2C_MASTER_ADDR(23 downto 16) <= iI2cWBus;
+          iMstAddrState <= X"2";
+        when X"2" =>
+          iI2C_MASTER_ADDR(15 downto 8) <= iI2cWBus;
+          iMstAddrState <= X"3";
+        when X"3" =>
+          iI2C_MASTER_ADDR(7 downto 0) <= iI2cWBus;
+          iMstAddrState <= X"0";
+        when others =>
+          null;
+      end case;
     end if;
   end if;
 end process p_mst_addr;
@@ -330,26 +412,28 @@ begin
     iI2C_MASTER_DATA <= (others => '0');
     iMstDataState <= X"0";
   elsif CLK'event and CLK = '1' then  
-    if (iI2cRegAddr = X"04") then
+    if (iI2c_waddr = '1') and (iI2cWBus = X"06") and (iMstDataState(3 downto 2) = "00") then
+      iMstDataState <= X"0";
+    elsif (iI2cRegAddr = X"04") or (iI2cRegAddr = X"06") then
       case iMstDataState is
         when X"0" =>
           iI2C_MASTER_WR <= '0';
-          if (iI2c_write = '1') and (iI2c_write_old = '0') then
+          if (iMstDataWrite = '1') then
             iI2C_MASTER_DATA(31 downto 24) <= iI2cWBus;
             iMstDataState <= X"1";
           end if;
         when X"1" =>
-          if (iI2c_write = '1') and (iI2c_write_old = '0') then
+          if (iMstDataWrite = '1') then
             iI2C_MASTER_DATA(23 downto 16) <= iI2cWBus;
             iMstDataState <= X"2";
           end if;
         when X"2" =>
-          if (iI2c_write = '1') and (iI2c_write_old = '0') then
+          if (iMstDataWrite = '1') then
             iI2C_MASTER_DATA(15 downto 8) <= iI2cWBus;
             iMstDataState <= X"3";
           end if;
         when X"3" =>
-          if (iI2c_write = '1') and (iI2c_write_old = '0') then
+          if (iMstDataWrite = '1') then
             iI2C_MASTER_DATA(7 downto 0) <= iI2cWBus;
             iMstDataState <= X"4";
           end if;
@@ -357,15 +441,18 @@ begin
           iI2C_MASTER_WR <= '1';
           iMstDataState <= X"5";
         when X"5" =>
-          iI2C_MASTER_WR <= '0';
-          iMstDataState <= X"0";
+          -- requete servie pendant le cycle ou le bus est libre
+          if (I2C_MASTER_WAIT = '0') then
+            iI2C_MASTER_WR <= '0';
+            iMstDataState <= X"0";
+          end if;
         when others =>
           null;
       end case;
     end if;
   end if;
 end process p_mst_data_wr;
-I2C_MASTER_WR <= iI2C_MASTER_WR;
+I2C_MASTER_WR <= iI2C_MASTER_WR and not I2C_MASTER_WAIT;
 I2C_MASTER_DATA <= iI2C_MASTER_DATA;
 
 -- robot master data read
@@ -379,13 +466,14 @@ begin
     iI2cNoData_05 <= '1';
   elsif CLK'event and CLK = '1' then  
 -- FIXME : TODO : improve management of data source(s)
+    -- la requete est maintenue tant que le bus est pris par l'APB ou le SPI
     if (iI2c_waddr = '1') and (iI2cWBus = X"05") then
       iI2C_MASTER_RD <= '1';
-    else
+    elsif (I2C_MASTER_WAIT = '0') then
       iI2C_MASTER_RD <= '0';
     end if;
 
-    if (iI2C_MASTER_RD = '1') then
+    if (iI2C_MASTER_RD = '1') and (I2C_MASTER_WAIT = '0') then
       iI2cNoData_05 <= '0';
       iI2C_SLAVE_DATA <= I2C_SLAVE_DATA;
     end if;
@@ -414,12 +502,15 @@ begin
     end if;
   end if;
 end process p_mst_data_rd;
-I2C_MASTER_RD <= iI2C_MASTER_RD;
+I2C_MASTER_RD <= iI2C_MASTER_RD and not I2C_MASTER_WAIT;
 
 iI2cRBus   <= iI2cRBus_01   when (iI2cRegAddr = X"01") else
               iI2cRBus_05   when (iI2cRegAddr = X"05") else X"33";
 iI2cNoData <= iI2cNoData_01 when (iI2cRegAddr = X"01") else
               iI2cNoData_05 when (iI2cRegAddr = X"05") else '1';
+-- pas d'etirement sans donnee a attendre
+iI2cNoWait <= (iTRACE_FIFO_EMPTY and iI2cTraceNoData) when (iI2cRegAddr = X"01") else
+              '0' when (iI2cRegAddr = X"05") else '1';
 
 end arch;
 
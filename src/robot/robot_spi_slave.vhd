@@ -1,6 +1,44 @@
 ----------------------------------------------------------------------------
 ---- robot_spi_slave : esclave SPI                                      ----
 ----------------------------------------------------------------------------
+--
+-- Trames de 48 bits (6 octets, MSB en premier, mode 0 : echantillonnage sur
+-- front montant), enchainables dans un meme transfert :
+--
+--   MOSI : CMD(7..4) & 0000 | DATA(31..0) | CHK = xor des 4 octets de DATA
+--   MISO : STATUS           | DATA(31..0) | CHK = xor des 4 octets de DATA
+--
+-- STATUS (fige en fin de trame precedente) :
+--   7..4 : "1010" (MISO en l'air : 0xff ou 0x00)
+--   3    : erreur de CHK sur la derniere trame d'ecriture
+--   2    : commande (BSTR) pas encore lue par le LEON
+--   1    : mot de trace disponible
+--   0    : '0'
+--
+-- Commandes (memes numeros que les registres de l'esclave I2C 0x42) :
+--   0 : debug (DBG_MST_DATA / DBG_SLV_DATA)
+--   1 : lecture d'un mot de trace (0 si STATUS(1) etait a 0)
+--   2 : ecriture d'une commande pour le LEON (BSTR), ignoree si STATUS(2)
+--   3 : adresse APB
+--   4 : ecriture APB a l'adresse
+--   5 : lecture APB a l'adresse
+--   6 : lecture APB a l'adresse, puis adresse + 4 (rafale)
+--   7 : ecriture APB a l'adresse, puis adresse + 4 (rafale)
+--   8 : compteurs : trames (31..16), erreurs de CHK ou commandes perdues
+--       (15..0)
+--
+-- Les ecritures (0, 2, 3, 4, 7) ne sont prises en compte que si CHK est
+-- bon. Une trame est recommencee quand SPI_CS est inactif (haut) ou apres
+-- 128 cycles de CLK sans front montant de SPI_CLK (5.12 us a 25 MHz, SPI_CS n'est
+-- pas cable sur la carte 2018). SPI_CLK est echantillonne sur CLK :
+-- 6 MHz au plus a 25 MHz (4 MHz recommandes).
+--
+-- Les requetes APB (SPI_MASTER_RD/WR) sont maintenues tant que
+-- SPI_MASTER_WAIT est a 1 (acces du LEON en cours) et ne sont presentees
+-- qu'une fois le bus libre, comme pour l'esclave I2C. Une lecture est
+-- demandee au 5e bit de la trame et sa donnee n'est utilisee qu'au 8e :
+-- 12 cycles de CLK au moins a 6 MHz, un acces APB en prend 2.
+--
 
 library IEEE;
 use IEEE.std_logic_1164.all;
@@ -21,6 +59,13 @@ entity robot_spi_slave is
     SPI_SLAVE_DATA      : in std_logic_vector(31 downto 0);
     SPI_SLAVE_ACK       : in std_logic;
     SPI_SLAVE_IRQ       : out std_logic;
+    SPI_MASTER_WAIT     : in std_logic;
+    TRACE_RD            : out std_logic;
+    TRACE_DATA          : in std_logic_vector(31 downto 0);
+    TRACE_READY         : in std_logic;
+    BSTR_WR             : out std_logic;
+    BSTR_DATA           : out std_logic_vector(31 downto 0);
+    BSTR_EMPTY          : in std_logic;
     DBG_MST_DATA        : out std_logic_vector(31 downto 0);
     DBG_SLV_DATA        : in std_logic_vector(31 downto 0);
     SPI_CS              : in std_logic;
@@ -46,6 +91,8 @@ architecture robot_spi_slave_arch of robot_spi_slave is
   signal iSPI_MOSI_OLD2    : std_logic;
   signal iSPI_CLK          : std_logic;
   signal iSPI_CLK_OLD      : std_logic;
+  signal iSPI_CS           : std_logic;
+  signal iSPI_CS_META      : std_logic;
 
   signal iPERIOD_DETECT    : std_logic_vector(31 downto 0);
   signal iBITCNT           : std_logic_vector(7 downto 0);
@@ -59,6 +106,17 @@ architecture robot_spi_slave_arch of robot_spi_slave is
 
   signal iSPI_MASTER_RD    : std_logic;
   signal iSPI_MASTER_WR    : std_logic;
+  signal iADDR_INC         : std_logic;
+
+  signal iTRACE_OK         : std_logic;
+  signal iTRACE_WORD       : std_logic_vector(31 downto 0);
+  signal iTRACE_RD         : std_logic;
+  signal iBSTR_WR          : std_logic;
+  signal iBSTR_DATA        : std_logic_vector(31 downto 0);
+  signal iCHK_ERR          : std_logic;
+  signal iFRAME_CNT        : std_logic_vector(15 downto 0);
+  signal iERR_CNT          : std_logic_vector(15 downto 0);
+  signal iSTATUS           : std_logic_vector(7 downto 0);
 
 begin
 
@@ -70,18 +128,26 @@ begin
       iSPI_MOSI_OLD2 <= '0';
       iSPI_CLK <= '0';
       iSPI_CLK_OLD <= '0';
+      iSPI_CS_META <= '1';
+      iSPI_CS <= '1';
     elsif rising_edge(CLK) then
       iSPI_MOSI <= SPI_MOSI;
       iSPI_MOSI_OLD <= iSPI_MOSI;
       iSPI_MOSI_OLD2 <= iSPI_MOSI_OLD;
       iSPI_CLK <= SPI_CLK;
       iSPI_CLK_OLD <= iSPI_CLK;
+      iSPI_CS_META <= SPI_CS;
+      iSPI_CS <= iSPI_CS_META;
     end if;
   end process;
 
+  -- octet d'etat envoye en tete de la trame suivante
+  iSTATUS <= "1010" & iCHK_ERR & (not BSTR_EMPTY) & TRACE_READY & '0';
+
   slave_spi_proc : process (CLK, RESET)
     variable iRECV_SR_NEXT : std_logic_vector(47 downto 0) := zero48;
     variable iSLV_DATA_NEXT : std_logic_vector(31 downto 0) := zero32;
+    variable iCHK_OK : boolean;
   begin
     if RESET = '1' then
       iRECV_SR         <= zero48;
@@ -94,7 +160,19 @@ begin
       iSPI_MASTER_ADDR <= zero32;
       iSPI_MASTER_DATA <= zero32;
       iSPI_SLAVE_DATA  <= zero32;
+      iADDR_INC        <= '0';
+      iTRACE_OK        <= '0';
+      iTRACE_WORD      <= zero32;
+      iTRACE_RD        <= '0';
+      iBSTR_WR         <= '0';
+      iBSTR_DATA       <= zero32;
+      iCHK_ERR         <= '0';
+      iFRAME_CNT       <= zero16;
+      iERR_CNT         <= zero16;
     elsif rising_edge(CLK) then
+      iTRACE_RD <= '0';
+      iBSTR_WR  <= '0';
+
       if (iSPI_CLK_OLD = '0') and (iSPI_CLK = '1') then
         iPERIOD_DETECT <= zero32;
       else
@@ -102,28 +180,37 @@ begin
           iPERIOD_DETECT <= iPERIOD_DETECT + 1;
         end if;
       end if;
-      if (iPERIOD_DETECT=X"00000080") then
+      -- hors trame : etat rafraichi tant que la ligne est au repos
+      if ((iPERIOD_DETECT >= X"00000080") and
+          not ((iSPI_CLK_OLD = '0') and (iSPI_CLK = '1'))) or
+         (iSPI_CS = '1') then
         iRECV_SR    <= zero48;
         iBITCNT     <= zero8;
         iREG_SELECT <= "0000";
+        iSEND_SR    <= iSTATUS & X"FFFFFFFFFF";
+        iTRACE_OK   <= TRACE_READY;
       else
         if (iSPI_CLK_OLD = '0') and (iSPI_CLK = '1') then
-          if (iBITCNT = X"00") then
-            iSEND_SR         <= (others => '1');
-          elsif (iBITCNT = X"07") then
+          if (iBITCNT = X"07") then
             case iREG_SELECT is
               when X"0" =>
                 iSLV_DATA_NEXT := DBG_SLV_DATA;
               when X"1" =>
-                iSLV_DATA_NEXT := X"55AA55AA"; -- FIXME : TODO : trace
+                if (iTRACE_OK = '1') then
+                  iSLV_DATA_NEXT := iTRACE_WORD;
+                else
+                  iSLV_DATA_NEXT := zero32;
+                end if;
               when X"2" =>
-                iSLV_DATA_NEXT := X"55AA55AA"; -- FIXME : TODO : leon bstream
+                iSLV_DATA_NEXT := iBSTR_DATA;
               when X"3" =>
                 iSLV_DATA_NEXT := iSPI_MASTER_ADDR;
-              when X"4" =>
+              when X"4" | X"7" =>
                 iSLV_DATA_NEXT := iSPI_MASTER_DATA;
-              when X"5" =>
+              when X"5" | X"6" =>
                 iSLV_DATA_NEXT := iSPI_SLAVE_DATA;
+              when X"8" =>
+                iSLV_DATA_NEXT := iFRAME_CNT & iERR_CNT;
               when others =>
                 iSLV_DATA_NEXT := X"55AA55AA";
             end case;
@@ -133,6 +220,10 @@ begin
                          iSLV_DATA_NEXT(15 downto 8)  xor
                          iSLV_DATA_NEXT(7 downto 0)) &
                         "11111111";
+          elsif (iBITCNT = X"2F") then
+            -- etat de la trame suivante, deja sur MISO avant son 1er front
+            iSEND_SR <= iSTATUS & X"FFFFFFFFFF";
+            iTRACE_OK <= TRACE_READY;
           else
             iSEND_SR <= iSEND_SR(46 downto 0) & '1';
           end if;
@@ -147,25 +238,65 @@ begin
             iREG_SELECT <= iRECV_SR_NEXT(3 downto 0);
           end if;
           if (iBITCNT = X"04") then
-            if (iREG_SELECT = X"5") then
+            if (iREG_SELECT = X"5") or (iREG_SELECT = X"6") then
               iSPI_MASTER_RD <= '1';
             end if;
+            -- mot de trace annonce dans STATUS : consomme maintenant
+            if (iREG_SELECT = X"1") and (iTRACE_OK = '1') then
+              iTRACE_WORD <= TRACE_DATA;
+              iTRACE_RD <= '1';
+            end if;
           end if;
           if (iBITCNT = X"2F") then
+            iCHK_OK := (iRECV_SR_NEXT(7 downto 0) =
+                        (iRECV_SR_NEXT(39 downto 32) xor
+                         iRECV_SR_NEXT(31 downto 24) xor
+                         iRECV_SR_NEXT(23 downto 16) xor
+                         iRECV_SR_NEXT(15 downto 8)));
+            iFRAME_CNT <= iFRAME_CNT + 1;
+            case iREG_SELECT is
+              when X"0" | X"2" | X"3" | X"4" | X"7" =>
+                if iCHK_OK then
+                  iCHK_ERR <= '0';
+                else
+                  iCHK_ERR <= '1';
+                  iERR_CNT <= iERR_CNT + 1;
+                end if;
+              when others =>
+                null;
+            end case;
             case iREG_SELECT is
               when X"0" =>
-                DBG_MST_DATA <= iRECV_SR_NEXT(39 downto 8);
+                if iCHK_OK then
+                  DBG_MST_DATA <= iRECV_SR_NEXT(39 downto 8);
+                end if;
               when X"1" =>
-                null; -- FIXME : TODO : trace
+                null; -- trace : mot deja consomme
               when X"2" =>
-                null; -- FIXME : TODO : leon bstream
+                if iCHK_OK then
+                  if (BSTR_EMPTY = '1') then
+                    iBSTR_DATA <= iRECV_SR_NEXT(39 downto 8);
+                    iBSTR_WR <= '1';
+                  else
+                    iERR_CNT <= iERR_CNT + 1; -- commande precedente pas lue
+                  end if;
+                end if;
               when X"3" =>
-                iSPI_MASTER_ADDR <= iRECV_SR_NEXT(39 downto 8);
-              when X"4" =>
-                iSPI_MASTER_DATA <= iRECV_SR_NEXT(39 downto 8);
-                iSPI_MASTER_WR <= '1';
+                if iCHK_OK then
+                  iSPI_MASTER_ADDR <= iRECV_SR_NEXT(39 downto 8);
+                end if;
+              when X"4" | X"7" =>
+                if iCHK_OK then
+                  iSPI_MASTER_DATA <= iRECV_SR_NEXT(39 downto 8);
+                  iSPI_MASTER_WR <= '1';
+                  if (iREG_SELECT = X"7") then
+                    iADDR_INC <= '1';
+                  end if;
+                end if;
               when X"5" =>
                 null; -- SPI_SLAVE_DATA
+              when X"6" =>
+                iSPI_MASTER_ADDR <= iSPI_MASTER_ADDR + 4;
               when others =>
                 null;
             end case;
@@ -173,10 +304,16 @@ begin
           end if;
         end if;
       end if;
-      if (iSPI_MASTER_WR = '1') then
+      -- requete servie pendant le cycle ou le bus est libre
+      if (iSPI_MASTER_WR = '1') and (SPI_MASTER_WAIT = '0') then
         iSPI_MASTER_WR <= '0';
+        -- rafale : adresse suivante une fois l'ecriture faite
+        if (iADDR_INC = '1') then
+          iSPI_MASTER_ADDR <= iSPI_MASTER_ADDR + 4;
+          iADDR_INC <= '0';
+        end if;
       end if;
-      if (iSPI_MASTER_RD = '1') then
+      if (iSPI_MASTER_RD = '1') and (SPI_MASTER_WAIT = '0') then
         iSPI_SLAVE_DATA <= SPI_SLAVE_DATA;
         iSPI_MASTER_RD <= '0';
       end if;
@@ -187,14 +324,18 @@ begin
 
   SPI_MASTER_DATA  <= iSPI_MASTER_DATA;
 
-  SPI_MASTER_WR    <= iSPI_MASTER_WR;
+  SPI_MASTER_WR    <= iSPI_MASTER_WR and not SPI_MASTER_WAIT;
 --  SPI_MASTER_WR    <= '0';
 
-  SPI_MASTER_RD    <= iSPI_MASTER_RD;
+  SPI_MASTER_RD    <= iSPI_MASTER_RD and not SPI_MASTER_WAIT;
 
   SPI_MISO <= iSEND_SR(47);
 --  SPI_MISO <= '1';
 
   SPI_SLAVE_IRQ <= '0';
 
+  TRACE_RD  <= iTRACE_RD;
+  BSTR_WR   <= iBSTR_WR;
+  BSTR_DATA <= iBSTR_DATA;
+
 end robot_spi_slave_arch;
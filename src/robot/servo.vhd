@@ -4,6 +4,12 @@
 --
 -- ----------------------------------------------------------------------------
 -- Fonction : - PWM generator for servomotor control (ex.: Futaba S3003)
+--            - Slew rate limiter : the pulse width actually generated
+--              (ACTUAL_PW) moves towards PWM_SERVO_PW by at most SLEW cycles
+--              per PWM period (SLEW = 0 : no limit). PW = 0 (servo off) is
+--              applied at once, and the first target after 0 too (position
+--              of the servo unknown)
+--            - DONE : '1' when ACTUAL_PW = PWM_SERVO_PW
 --
 -- --========================================================================--
 
@@ -22,6 +28,9 @@ entity SERVO is
     -- internal interface
     PWM_SERVO_PERIOD   : in std_logic_vector (31 downto 0);
     PWM_SERVO_PW       : in std_logic_vector (31 downto 0);
+    PWM_SERVO_SLEW     : in std_logic_vector (15 downto 0);
+    PWM_SERVO_ACTUAL_PW: out std_logic_vector (31 downto 0);
+    PWM_SERVO_DONE     : out std_logic;
 
     -- the PWM signal 
     PWM_SERVO          : out std_logic
@@ -50,6 +59,8 @@ signal iCLK                 : std_logic;
 
 signal iPWM_SERVO_PERIOD    : std_logic_vector (31 downto 0);
 signal iPWM_SERVO_PW        : std_logic_vector (31 downto 0);
+signal iPWM_SERVO_SLEW      : std_logic_vector (31 downto 0);
+signal iPWM_SERVO_CUR_PW    : std_logic_vector (31 downto 0);
 signal iPWM_SERVO_COUNT     : std_logic_vector (31 downto 0);
 signal iPWM_SERVO           : std_logic;
 
@@ -61,28 +72,47 @@ iCLK <= CLK;
 
 iPWM_SERVO_PERIOD <= PWM_SERVO_PERIOD;
 iPWM_SERVO_PW <= PWM_SERVO_PW;
+iPWM_SERVO_SLEW <= X"0000" & PWM_SERVO_SLEW;
 PWM_SERVO <= iPWM_SERVO;
 
+PWM_SERVO_ACTUAL_PW <= iPWM_SERVO_CUR_PW;
+PWM_SERVO_DONE <= '1' when (iPWM_SERVO_CUR_PW = iPWM_SERVO_PW) else '0';
+
 -- SERVO pwm management
 -- REM :
 -- PWM_SERVO_PERIOD : std_logic_vector (31 downto 0) := X"00080000";
 --  ~80 ms - 12.5 hz
 p_PwmServoSM : process (iCLK, iRESET)
+variable vPW : std_logic_vector (31 downto 0);
 begin
   if (iRESET = '1') then
     iPWM_SERVO <= '0';
     iPWM_SERVO_COUNT <= (others => '0');
+    iPWM_SERVO_CUR_PW <= (others => '0');
   elsif (iCLK'event and iCLK = '1') then
     if iPWM_SERVO_COUNT = iPWM_SERVO_PERIOD then
       iPWM_SERVO_COUNT <= (others => '0');
-      if iPWM_SERVO_PW = X"00000000" then
+      -- nouvelle largeur : un pas de rampe par periode
+      if (iPWM_SERVO_SLEW = X"00000000") or
+         (iPWM_SERVO_PW = X"00000000") or
+         (iPWM_SERVO_CUR_PW = X"00000000") then
+        vPW := iPWM_SERVO_PW;
+      elsif iPWM_SERVO_PW > iPWM_SERVO_CUR_PW + iPWM_SERVO_SLEW then
+        vPW := iPWM_SERVO_CUR_PW + iPWM_SERVO_SLEW;
+      elsif iPWM_SERVO_PW + iPWM_SERVO_SLEW < iPWM_SERVO_CUR_PW then
+        vPW := iPWM_SERVO_CUR_PW - iPWM_SERVO_SLEW;
+      else
+        vPW := iPWM_SERVO_PW;
+      end if;
+      iPWM_SERVO_CUR_PW <= vPW;
+      if vPW = X"00000000" then
         iPWM_SERVO <= '0';
       else
         iPWM_SERVO <= '1';
       end if;
     else
       iPWM_SERVO_COUNT <= iPWM_SERVO_COUNT + 1;
-      if iPWM_SERVO_PW = iPWM_SERVO_COUNT then
+      if iPWM_SERVO_CUR_PW = iPWM_SERVO_COUNT then
         iPWM_SERVO <= '0';
       end if;
     end if;
@@ -4,6 +4,18 @@
 --
 -- ----------------------------------------------------------------------------
 -- Fonction : - Pulse & dir generator for Pololu driver for stepper motor
+--            - Position mode : the motor is driven towards NEW_POS, with a
+--              linear ramp on the step period (START_PERIOD -> PERIOD by
+--              ACCEL us per step, and back down before the target)
+--            - Half-step phase outputs (unipolar motor, same sequence as
+--              the host-driven STEPPER_STATE_xxxx commands)
+--
+--   CTRL(0)      : enable (N_ENABLE / PHASE outputs active)
+--   CTRL(1)      : raz position (ACTUAL_POS <= 0, no motion)
+--   PERIOD       : cruise step period (us)
+--   START_PERIOD : start/stop step period (us)
+--   ACCEL        : period decrement per step during the ramp (us), 0 = no ramp
+--   DONE         : '1' when ACTUAL_POS = NEW_POS and no step in progress
 --
 -- --========================================================================--
 
@@ -12,26 +24,30 @@ use IEEE.STD_LOGIC_1164.ALL;
 use IEEE.STD_LOGIC_ARITH.ALL;
 use IEEE.STD_LOGIC_UNSIGNED.ALL;
 
-use work.FPGA_CONST.ALL;
+--use work.FPGA_CONST.ALL;
 
 entity STEPPER_POLOLU is
   port (
     -- reset & clock
     RESET          : in std_logic;
-    CLK            : in std_logic;
+    CLK            : in std_logic; -- the clock should be @ 25MHz
 
     -- internal interface
     CTRL           : in std_logic_vector (15 downto 0);
     PERIOD         : in std_logic_vector (15 downto 0);
+    START_PERIOD   : in std_logic_vector (15 downto 0);
+    ACCEL          : in std_logic_vector (15 downto 0);
     NEW_POS        : in std_logic_vector (15 downto 0);
     ACTUAL_POS     : out std_logic_vector (15 downto 0);
+    DONE           : out std_logic;
 
     -- external interface
     HIGH_SW        : in std_logic;
     LOW_SW         : in std_logic;
     N_ENABLE       : out std_logic;
     STEP           : out std_logic;
-    DIR            : out std_logic
+    DIR            : out std_logic;
+    PHASE          : out std_logic_vector (3 downto 0)
   );
 end STEPPER_POLOLU;
 
@@ -50,10 +66,16 @@ architecture arch of STEPPER_POLOLU is
 -- ----------------------------------------------------------------------------
 
 constant ST_IDDLE           : std_logic_vector(5 downto 0) := "000000";
-constant ST_PULSE_LOW_SETUP : std_logic_vector(5 downto 0) := "000001";
+constant ST_DIR_SETUP       : std_logic_vector(5 downto 0) := "000001";
 constant ST_PULSE_HIGH      : std_logic_vector(5 downto 0) := "000010";
 constant ST_PULSE_LOW       : std_logic_vector(5 downto 0) := "000011";
 
+-- 1 us tick @ 25MHz
+constant US_DIV             : integer := 24;
+
+-- STEP pulse width (us)
+constant PULSE_WIDTH        : std_logic_vector(15 downto 0) := X"0002";
+
 
 -- ----------------------------------------------------------------------------
 -- Signal declarations
@@ -65,12 +87,27 @@ signal iACTUAL_POS          : std_logic_vector (15 downto 0);
 signal iNEW_POS             : std_logic_vector (15 downto 0);
 signal iSTEP                : std_logic;
 signal iDIR                 : std_logic;
+signal iDONE                : std_logic;
+signal iMOVING              : std_logic;
+
+signal iPERIOD              : std_logic_vector (15 downto 0);
+signal iSTART_PERIOD        : std_logic_vector (15 downto 0);
+signal iACCEL               : std_logic_vector (15 downto 0);
+
+signal iCUR_PERIOD          : std_logic_vector (15 downto 0);
+signal iPERIOD_CNT          : std_logic_vector (15 downto 0);
+signal iWIDTH_CNT           : std_logic_vector (15 downto 0);
+signal iRAMP_CNT            : std_logic_vector (15 downto 0);
 
-signal iPULSE_PERIOD        : std_logic_vector (31 downto 0);
-signal iPULSE_WIDTH         : std_logic_vector (31 downto 0);
+signal iDELTA               : std_logic_vector (16 downto 0);
+signal iREMAIN              : std_logic_vector (16 downto 0);
 
-signal iPULSE_PERIOD_CNT    : std_logic_vector (31 downto 0);
-signal iPULSE_WIDTH_CNT     : std_logic_vector (31 downto 0);
+signal iUS_CNT              : integer range 0 to US_DIV;
+signal iUS_TICK             : std_logic;
+signal iSETUP_TICK          : std_logic;
+
+signal iPHASE_IDX           : std_logic_vector (2 downto 0);
+signal iPHASE               : std_logic_vector (3 downto 0);
 
 signal iHIGH_SW             : std_logic;
 signal iLOW_SW              : std_logic;
@@ -78,25 +115,67 @@ signal iLOW_SW              : std_logic;
 begin
 
 ACTUAL_POS <= iACTUAL_POS;
+DONE <= iDONE;
 
 N_ENABLE <= not iCTRL(0);
 STEP <= iSTEP;
 DIR <= iDIR;
+PHASE <= iPHASE when (iCTRL(0) = '1') else "0000";
+
+-- distance (signee) a parcourir et sa valeur absolue
+iDELTA  <= SXT(iNEW_POS, 17) - SXT(iACTUAL_POS, 17);
+iREMAIN <= iDELTA when (iDELTA(16) = '0') else (0 - iDELTA);
+
+-- sequence demi-pas (cf STEPPER_STATE_xxxx dans load_soft_uart.c)
+with iPHASE_IDX select
+  iPHASE <= "0001" when "000",
+            "0101" when "001",
+            "0100" when "010",
+            "0110" when "011",
+            "0010" when "100",
+            "1010" when "101",
+            "1000" when "110",
+            "1001" when others;
+
+p_UsTick : process (CLK, RESET)
+begin
+  if (RESET = '1') then
+    iUS_CNT  <= 0;
+    iUS_TICK <= '0';
+  elsif (CLK'event and CLK = '1') then
+    if (iUS_CNT = US_DIV) then
+      iUS_CNT  <= 0;
+      iUS_TICK <= '1';
+    else
+      iUS_CNT  <= iUS_CNT + 1;
+      iUS_TICK <= '0';
+    end if;
+  end if;
+end process p_UsTick;
 
 p_PulseSM : process (CLK, RESET)
+  variable vPERIOD : std_logic_vector (16 downto 0);
 begin
   if (RESET = '1') then
     iPULSE_STATE      <= ST_IDDLE;
     iCTRL             <= (others => '0');
     iACTUAL_POS       <= (others => '0');
     iNEW_POS          <= (others => '0');
-    iPULSE_PERIOD_CNT <= (others => '0');
-    iPULSE_WIDTH_CNT  <= (others => '0');
-    iSTEP <= '0';
-    iDIR  <= '0';
-
-    iPULSE_PERIOD <= X"0010" & X"0000";
-    iPULSE_WIDTH  <= X"00001000";
+    iPERIOD_CNT       <= (others => '0');
+    iWIDTH_CNT        <= (others => '0');
+    iRAMP_CNT         <= (others => '0');
+    iSTEP   <= '0';
+    iDIR    <= '0';
+    iDONE   <= '1';
+    iMOVING <= '0';
+    iSETUP_TICK <= '0';
+
+    iPERIOD       <= X"03E8";
+    iSTART_PERIOD <= X"0FA0";
+    iACCEL        <= X"0000";
+    iCUR_PERIOD   <= X"0FA0";
+
+    iPHASE_IDX <= "000";
 
     iHIGH_SW <= '0';
     iLOW_SW  <= '0';
@@ -105,62 +184,110 @@ begin
     iNEW_POS <= NEW_POS;
     iCTRL <= CTRL;
 
-    iPULSE_PERIOD <= PERIOD & X"0000";
-    iPULSE_WIDTH  <= X"00001000";
+    iPERIOD       <= PERIOD;
+    iSTART_PERIOD <= START_PERIOD;
+    iACCEL        <= ACCEL;
 
     case iPULSE_STATE is
       when ST_IDDLE =>
         iSTEP <= '0';
 
-        if (iACTUAL_POS > iNEW_POS) then
-          iACTUAL_POS <= iACTUAL_POS - 1;
-          iDIR  <= '0';
-          iPULSE_PERIOD_CNT <= iPULSE_PERIOD;
-          iPULSE_WIDTH_CNT  <= X"00000010";
-          iPULSE_STATE <= ST_PULSE_LOW_SETUP;
-        end if;
-
-        if (iACTUAL_POS < iNEW_POS) then
-          iACTUAL_POS <= iACTUAL_POS + 1;
-          iDIR  <= '1';
-          iPULSE_PERIOD_CNT <= iPULSE_PERIOD;
-          iPULSE_WIDTH_CNT  <= X"00000010";
-          iPULSE_STATE <= ST_PULSE_LOW_SETUP;
+        if (iCTRL(1) = '1') then
+          -- raz position
+          iACTUAL_POS <= (others => '0');
+          iMOVING     <= '0';
+          iDONE       <= '0';
+        elsif (iCTRL(0) = '0') or (iREMAIN = 0) then
+          -- arrete (desactive ou arrive)
+          iMOVING <= '0';
+          if (iREMAIN = 0) then
+            iDONE <= '1';
+          else
+            iDONE <= '0';
+          end if;
+        else
+          iDONE <= '0';
+
+          -- calcul de la periode du prochain pas (rampe lineaire)
+          if (iACCEL = 0) then
+            vPERIOD := '0' & iPERIOD;
+          elsif (iMOVING = '0') or (iDIR = iDELTA(16)) then
+            -- depart ou inversion de sens : on repart a la vitesse mini
+            vPERIOD := '0' & iSTART_PERIOD;
+            iRAMP_CNT <= (others => '0');
+          elsif (iREMAIN <= ('0' & iRAMP_CNT)) then
+            -- deceleration
+            vPERIOD := ('0' & iCUR_PERIOD) + ('0' & iACCEL);
+            if (vPERIOD > ('0' & iSTART_PERIOD)) then
+              vPERIOD := '0' & iSTART_PERIOD;
+            end if;
+            if (iRAMP_CNT /= 0) then
+              iRAMP_CNT <= iRAMP_CNT - 1;
+            end if;
+          elsif (('0' & iCUR_PERIOD) > (('0' & iPERIOD) + ('0' & iACCEL))) then
+            -- acceleration
+            vPERIOD := ('0' & iCUR_PERIOD) - ('0' & iACCEL);
+            iRAMP_CNT <= iRAMP_CNT + 1;
+          else
+            -- vitesse de croisiere
+            vPERIOD := '0' & iPERIOD;
+          end if;
+
+          iCUR_PERIOD <= vPERIOD(15 downto 0);
+          iPERIOD_CNT <= vPERIOD(15 downto 0);
+          iWIDTH_CNT  <= PULSE_WIDTH;
+          iMOVING     <= '1';
+
+          if (iDELTA(16) = '1') then
+            iACTUAL_POS <= iACTUAL_POS - 1;
+            iPHASE_IDX  <= iPHASE_IDX - 1;
+            iDIR  <= '0';
+          else
+            iACTUAL_POS <= iACTUAL_POS + 1;
+            iPHASE_IDX  <= iPHASE_IDX + 1;
+            iDIR  <= '1';
+          end if;
+          iSETUP_TICK  <= '0';
+          iPULSE_STATE <= ST_DIR_SETUP;
         end if;
 
-      when ST_PULSE_LOW_SETUP =>
+      when ST_DIR_SETUP =>
+        -- DIR stable au moins 1us avant le front de STEP : le premier tick
+        -- arrive n'importe quand (40ns a 1us), on attend le suivant
         iSTEP <= '0';
-        if (iPULSE_WIDTH_CNT = X"00000000") then
-          iPULSE_WIDTH_CNT <= iPULSE_WIDTH;
-          iPULSE_STATE <= ST_PULSE_HIGH;
-        elsif (iPULSE_PERIOD_CNT = X"00000000") then
-          iPULSE_STATE <= ST_IDDLE;
-        else
-          iPULSE_PERIOD_CNT <= iPULSE_PERIOD_CNT - 1;
-          iPULSE_WIDTH_CNT  <= iPULSE_WIDTH_CNT - 1;
+        if (iUS_TICK = '1') then
+          if (iPERIOD_CNT /= 0) then
+            iPERIOD_CNT <= iPERIOD_CNT - 1;
+          end if;
+          if (iSETUP_TICK = '1') then
+            iPULSE_STATE <= ST_PULSE_HIGH;
+          end if;
+          iSETUP_TICK <= '1';
         end if;
 
       when ST_PULSE_HIGH =>
         iSTEP <= '1';
-        if (iPULSE_WIDTH_CNT = X"00000000") then
-          iPULSE_STATE <= ST_PULSE_LOW;
-        elsif (iPULSE_PERIOD_CNT = X"00000000") then
-          iPULSE_STATE <= ST_IDDLE;
-        else
-          iPULSE_PERIOD_CNT <= iPULSE_PERIOD_CNT - 1;
-          iPULSE_WIDTH_CNT  <= iPULSE_WIDTH_CNT - 1;
+        if (iUS_TICK = '1') then
+          if (iPERIOD_CNT /= 0) then
+            iPERIOD_CNT <= iPERIOD_CNT - 1;
+          end if;
+          if (iWIDTH_CNT = 0) then
+            iPULSE_STATE <= ST_PULSE_LOW;
+          else
+            iWIDTH_CNT <= iWIDTH_CNT - 1;
+          end if;
         end if;
 
       when ST_PULSE_LOW =>
         iSTEP <= '0';
-        if (iPULSE_PERIOD_CNT = X"00000000") then
+        if (iPERIOD_CNT = 0) then
           iPULSE_STATE <= ST_IDDLE;
-        else
-          iPULSE_PERIOD_CNT <= iPULSE_PERIOD_CNT - 1;
+        elsif (iUS_TICK = '1') then
+          iPERIOD_CNT <= iPERIOD_CNT - 1;
         end if;
 
       when others =>
-        null;
+        iPULSE_STATE <= ST_IDDLE;
     end case;
 
     iHIGH_SW <= HIGH_SW;
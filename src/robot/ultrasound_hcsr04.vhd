@@ -4,6 +4,11 @@
 --
 -- ----------------------------------------------------------------------------
 -- Fonction : - Interface for HC-SR04 ultrasound module
+--            - une mesure par impulsion sur START (cf us_sched_proc dans
+--              robot_apb.vhd : les capteurs sont declenches a tour de role)
+--            - ACTUAL_DIST = largeur de l'echo en cycles de CLK, tous les
+--              bits a 1 si pas d'echo avant TIMEOUT cycles apres la fin de
+--              l'impulsion de declenchement ; DONE (1 cycle) a la fin
 --
 -- --========================================================================--
 
@@ -19,7 +24,11 @@ entity ULTRASOUND_HCSR04 is
     CLK            : in std_logic; -- the clock should be @ 25MHz
 
     -- internal interface
+    START          : in std_logic;
+    TIMEOUT        : in std_logic_vector (31 downto 0);
     ACTUAL_DIST    : out std_logic_vector (31 downto 0);
+    BUSY           : out std_logic;
+    DONE           : out std_logic;
 
     -- external interface
     US_PULSE       : out std_logic;
@@ -41,53 +50,81 @@ architecture arch of ULTRASOUND_HCSR04 is
 -- Constant declarations
 -- ----------------------------------------------------------------------------
 
+-- impulsion de declenchement : 10 us
+constant PULSE_LEN          : integer := 250;
 
 -- ----------------------------------------------------------------------------
 -- Signal declarations
 -- ----------------------------------------------------------------------------
 
-signal iACTUAL_DIST         : std_logic_vector (31 downto 0);
+type t_US_STATE is (us_idle, us_pulse_st, us_wait_echo, us_echo);
+
+signal iUS_STATE            : t_US_STATE;
+signal iCOUNTER             : std_logic_vector (31 downto 0);
+signal iWIDTH               : std_logic_vector (31 downto 0);
 signal iUS_RESPONSE1        : std_logic;
 signal iUS_RESPONSE2        : std_logic;
 
 begin
 
+BUSY <= '0' when (iUS_STATE = us_idle) else '1';
 
 p_PulseSM : process (CLK, RESET)
-  variable local_counter : integer := 0;
-  variable counting : std_logic := '0';
 begin
   if (RESET = '1') then
-    local_counter := 0;
-    counting := '0';
+    iUS_STATE <= us_idle;
+    iCOUNTER <= (others => '0');
+    iWIDTH <= (others => '0');
     iUS_RESPONSE1 <= '0';
     iUS_RESPONSE2 <= '0';
-    iACTUAL_DIST <= (others => '0');
     ACTUAL_DIST <= (others => '0');
+    DONE <= '0';
     US_PULSE <= '0';
   elsif (CLK'event and CLK = '1') then
-    if ( local_counter = 124999 ) then
-      local_counter := 0;
-      counting := '0';
-      ACTUAL_DIST <= iACTUAL_DIST;
-      iACTUAL_DIST <= (others => '0');
-      US_PULSE <= '1';
-    else
-      if ( local_counter = 250 ) then
-        US_PULSE <= '0';
-      end if;
-      if ( local_counter > 255 ) then
+    DONE <= '0';
+    case iUS_STATE is
+      when us_idle =>
+        if ( START = '1' ) then
+          iCOUNTER <= (others => '0');
+          US_PULSE <= '1';
+          iUS_STATE <= us_pulse_st;
+        end if;
+
+      when us_pulse_st =>
+        if ( iCOUNTER = PULSE_LEN - 1 ) then
+          iCOUNTER <= (others => '0');
+          US_PULSE <= '0';
+          iUS_STATE <= us_wait_echo;
+        else
+          iCOUNTER <= iCOUNTER + 1;
+        end if;
+
+      -- le timeout court depuis la fin de l'impulsion, echo compris
+      when us_wait_echo =>
         if ( (iUS_RESPONSE2='0') and (iUS_RESPONSE1='1') ) then
-          counting := '1';
-        elsif ( (iUS_RESPONSE2='1') and (iUS_RESPONSE1='0') ) then
-          counting := '0';
+          iWIDTH <= (others => '0');
+          iUS_STATE <= us_echo;
+        elsif ( iCOUNTER >= TIMEOUT ) then
+          ACTUAL_DIST <= (others => '1');
+          DONE <= '1';
+          iUS_STATE <= us_idle;
+        end if;
+        iCOUNTER <= iCOUNTER + 1;
+
+      when us_echo =>
+        if ( (iUS_RESPONSE2='1') and (iUS_RESPONSE1='0') ) then
+          ACTUAL_DIST <= iWIDTH;
+          DONE <= '1';
+          iUS_STATE <= us_idle;
+        elsif ( iCOUNTER >= TIMEOUT ) then
+          -- echo trop long (rien a portee) : pas d'obstacle
+          ACTUAL_DIST <= (others => '1');
+          DONE <= '1';
+          iUS_STATE <= us_idle;
         end if;
-      end if;
-      if ( counting = '1' ) then
-        iACTUAL_DIST <= iACTUAL_DIST + 1;
-      end if;
-      local_counter := local_counter + 1;
-    end if;
+        iWIDTH <= iWIDTH + 1;
+        iCOUNTER <= iCOUNTER + 1;
+    end case;
     iUS_RESPONSE2 <= iUS_RESPONSE1;
     iUS_RESPONSE1 <= US_RESPONSE;
   end if;
@@ -96,4 +133,3 @@ end process p_PulseSM;
 end arch;
 
 -- --================================= End ==================================--
-
@@ -0,0 +1,565 @@
+/*
+ * leon_bootldr.c -- chargement d'un soft par le chargeur binaire UART ('L')
+ *
+ * Protocole : cf soft_boot/include/bootldr.h. Le moniteur doit etre
+ * deverrouille (ou demarre en mode rapide, DIP_SW_0) :
+ *
+ *   leon_bootldr [-s baud] [-n] [-b rates] [-w window] [-c] [-x] [-v]
+ *                device image
+ *
+ * L'image est un binaire (big endian, comme rom.bin) ou un fichier texte
+ * d'un mot hexa par ligne (-x, ou extension .hex). Apres le 'hello', le
+ * debit est monte par paliers (-b, autobaud cote LEON) : chaque palier est
+ * valide par des pings, et en cas d'echec on revient a 115200 et on essaie
+ * le suivant. L'image est envoyee avec une fenetre glissante, verifiee par
+ * crc32 puis lancee (sauf -c : verification seule, retour au moniteur).
+ *
+ * Teste avec leon_uart_emu (-X et -E pour simuler une liaison limitee).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <termios.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/select.h>
+
+#define BL_SYNC0          0xa5
+#define BL_SYNC1          0x5c
+#define BL_MAX_PAYLOAD    (4+256)
+#define BL_CHUNK          256
+#define BL_IMAGE_MAX      (16*1024)
+#define BL_BAUD_AUTO      5   /* BAUTOBAUD (enum uart_baudrate_t) */
+#define BL_BAUD_TIMEOUT   2000000 /* us, cf BOOTLDR_BAUD_TIMEOUT */
+
+#define BL_E_CRC          1
+#define BL_E_SEQ          2
+#define BL_E_RANGE        3
+#define BL_E_VERIFY       4
+
+int rfd = -1;
+int parity_odd = 1; /* uart_init() du moniteur : parite impaire */
+int verbose = 0;
+int cur_baud = 115200;
+unsigned long stat_tx = 0;
+unsigned long stat_rx = 0;
+unsigned long stat_resend = 0;
+unsigned long stat_nak = 0;
+unsigned long stat_timeout = 0;
+
+void usage (FILE *fp, int rc)
+{
+  fprintf(fp, "Usage: leon_bootldr [-s speed] [-n] [-b rates] [-w window] [-c] [-x] [-v] device image\n\n"
+          "\t-s\tmonitor baud rate (default 115200)\n"
+          "\t-n\tno parity (default odd, as the monitor)\n"
+          "\t-b\tbaud rates to try, highest first (default 1000000,921600,500000,460800,230400)\n"
+          "\t\t\"-b 115200\" stays at the monitor rate\n"
+          "\t-w\twindow (default: advertised by the loader)\n"
+          "\t-c\tcheck only: load and verify, then back to the monitor\n"
+          "\t-x\timage is hex text, one word per line (default for *.hex)\n"
+          "\t-v\tverbose\n");
+  exit(rc);
+}
+
+/* crc32 zlib, comme crc32_update() du LEON */
+unsigned int crc32_byte (unsigned int crc, unsigned char b)
+{
+  int k;
+
+  crc ^= b;
+  for (k=0; k<8; k++)
+    crc = (crc>>1) ^ ((crc&1) ? 0xedb88320 : 0);
+  return crc;
+}
+
+unsigned int crc32_buf (unsigned char *buf, unsigned int len)
+{
+  unsigned int crc = 0xffffffff;
+
+  while (len--)
+    crc = crc32_byte(crc, *buf++);
+  return ~crc;
+}
+
+double now_s (void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec*1e-6;
+}
+
+speed_t baud_to_speed (int baud)
+{
+  switch (baud) {
+  case 9600:    return B9600;
+  case 19200:   return B19200;
+  case 38400:   return B38400;
+  case 57600:   return B57600;
+  case 115200:  return B115200;
+  case 230400:  return B230400;
+  case 460800:  return B460800;
+  case 500000:  return B500000;
+  case 576000:  return B576000;
+  case 921600:  return B921600;
+  case 1000000: return B1000000;
+  default:
+    fprintf(stderr, "ERROR: unsupported baud rate %d\n", baud);
+    exit(1);
+  }
+}
+
+void set_baud (int baud)
+{
+  struct termios tio;
+
+  if (tcgetattr(rfd, &tio) == 0) {
+    cfsetispeed(&tio, baud_to_speed(baud));
+    cfsetospeed(&tio, baud_to_speed(baud));
+    tcsetattr(rfd, TCSADRAIN, &tio);
+  }
+  cur_baud = baud;
+}
+
+int open_device (char *path, int baud)
+{
+  struct termios tio;
+  int fd;
+
+  fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: open(%s) failed, errno=%d\n", path, errno);
+    exit(1);
+  }
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baud_to_speed(baud));
+    cfsetospeed(&tio, baud_to_speed(baud));
+    tio.c_cflag |= CLOCAL | CREAD;
+    if (parity_odd)
+      tio.c_cflag |= PARENB | PARODD;
+    tcsetattr(fd, TCSAFLUSH, &tio);
+  }
+  cur_baud = baud;
+  return fd;
+}
+
+/* lecture d'un octet, -1 si timeout */
+int get_byte (int timeout_ms)
+{
+  unsigned char b;
+  struct timeval tv;
+  fd_set infds;
+
+  FD_ZERO(&infds);
+  FD_SET(rfd, &infds);
+  tv.tv_sec = timeout_ms/1000;
+  tv.tv_usec = (timeout_ms%1000)*1000;
+  if (select(rfd+1, &infds, NULL, NULL, &tv) <= 0)
+    return -1;
+  if (read(rfd, &b, 1) != 1)
+    return -1;
+  stat_rx++;
+  return b;
+}
+
+void write_all (unsigned char *buf, int len)
+{
+  int n;
+
+  while (len > 0) {
+    n = write(rfd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      fprintf(stderr, "ERROR: write failed, errno=%d\n", errno);
+      exit(1);
+    }
+    buf += n;
+    len -= n;
+    stat_tx += n;
+  }
+}
+
+void send_frame (unsigned char type, unsigned char seq, unsigned char *data,
+                 int len)
+{
+  unsigned char f[6+BL_MAX_PAYLOAD+4];
+  unsigned int crc;
+
+  f[0] = BL_SYNC0;
+  f[1] = BL_SYNC1;
+  f[2] = type;
+  f[3] = seq;
+  f[4] = len>>8;
+  f[5] = len;
+  if (len > 0)
+    memcpy(f+6, data, len);
+  crc = crc32_buf(f+2, 4+len);
+  f[6+len] = crc>>24;
+  f[7+len] = crc>>16;
+  f[8+len] = crc>>8;
+  f[9+len] = crc;
+  write_all(f, 10+len);
+}
+
+/* reception d'une trame
+
+   @return 0 si ok, -1 si timeout, -2 si trame corrompue */
+int recv_frame (unsigned char *type, unsigned char *seq, unsigned char *data,
+                int *len, int timeout_ms)
+{
+  unsigned char hdr[4];
+  unsigned int crc, crc_in;
+  int b, prev = -1, i, n;
+
+  for (;;) {
+    b = get_byte(timeout_ms);
+    if (b < 0)
+      return -1;
+    if ((prev == BL_SYNC0) && (b == BL_SYNC1))
+      break;
+    prev = b;
+  }
+  for (i=0; i<4; i++) {
+    if ((b = get_byte(timeout_ms)) < 0)
+      return -1;
+    hdr[i] = b;
+  }
+  n = (hdr[2]<<8) | hdr[3];
+  if (n > BL_MAX_PAYLOAD)
+    return -2;
+  for (i=0; i<n; i++) {
+    if ((b = get_byte(timeout_ms)) < 0)
+      return -1;
+    data[i] = b;
+  }
+  crc_in = 0;
+  for (i=0; i<4; i++) {
+    if ((b = get_byte(timeout_ms)) < 0)
+      return -1;
+    crc_in = (crc_in<<8) | b;
+  }
+  crc = 0xffffffff;
+  for (i=0; i<4; i++)
+    crc = crc32_byte(crc, hdr[i]);
+  for (i=0; i<n; i++)
+    crc = crc32_byte(crc, data[i]);
+  if (crc_in != ~crc)
+    return -2;
+  *type = hdr[0];
+  *seq = hdr[1];
+  *len = n;
+  return 0;
+}
+
+/* requete simple : attend une reponse du type donne (ou 'N')
+
+   @return 0 si ok, -1 sinon */
+int transact (unsigned char type, unsigned char *data, int len,
+              unsigned char want, unsigned char *reply, int *rlen,
+              int timeout_ms, int tries)
+{
+  static unsigned char seq = 0x80;
+  unsigned char rtype, rseq;
+  unsigned char buf[BL_MAX_PAYLOAD];
+  int n, rc;
+
+  while (tries-- > 0) {
+    seq++;
+    send_frame(type, seq, data, len);
+    for (;;) {
+      rc = recv_frame(&rtype, &rseq, buf, &n, timeout_ms);
+      if (rc == -1)
+        break;
+      if ((rc != 0) || (rseq != seq))
+        continue; /* reste d'un echange precedent */
+      if (rtype == 'N') {
+        if (verbose)
+          fprintf(stderr, "'%c': nak %d\n", type, (n>0) ? buf[0] : -1);
+        return -1;
+      }
+      if (rtype != want)
+        continue;
+      if (reply != NULL)
+        memcpy(reply, buf, n);
+      if (rlen != NULL)
+        *rlen = n;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int hello (int *window)
+{
+  unsigned char r[BL_MAX_PAYLOAD];
+  int n;
+
+  tcflush(rfd, TCIFLUSH);
+  if ((transact('H', NULL, 0, 'H', r, &n, 500, 4) != 0) || (n < 16))
+    return -1;
+  *window = r[1];
+  if (verbose)
+    fprintf(stderr, "hello: version %d, window %d, max payload %d, "
+            "stage 0x%08x (%u bytes), scaler %u\n",
+            r[0], r[1], (r[2]<<8) | r[3],
+            (r[4]<<24) | (r[5]<<16) | (r[6]<<8) | r[7],
+            (r[8]<<24) | (r[9]<<16) | (r[10]<<8) | r[11],
+            (r[12]<<24) | (r[13]<<16) | (r[14]<<8) | r[15]);
+  return 0;
+}
+
+/* passage a un debit plus rapide, valide par des pings
+
+   @return 0 si ok, -1 si retour a 115200 */
+int try_baud (int baud, int *window)
+{
+  unsigned char b[5], sync[64], ping[BL_CHUNK], r[BL_MAX_PAYLOAD];
+  int i, k, n, ok = 1;
+
+  b[0] = BL_BAUD_AUTO;
+  b[1] = baud>>24; b[2] = baud>>16; b[3] = baud>>8; b[4] = baud;
+  if (transact('B', b, 5, 'A', NULL, NULL, 500, 1) != 0)
+    return -1;
+
+  /* le LEON mesure les 0x55 au nouveau debit (bloc autobaud) */
+  tcdrain(rfd);
+  set_baud(baud);
+  usleep(1000);
+  memset(sync, 0x55, sizeof(sync));
+  write_all(sync, sizeof(sync));
+  tcdrain(rfd);
+  usleep(2000);
+  tcflush(rfd, TCIFLUSH);
+
+  for (k=0; (k<8) && ok; k++) {
+    for (i=0; i<BL_CHUNK; i++)
+      ping[i] = rand();
+    if ((transact('P', ping, BL_CHUNK, 'P', r, &n, 200, 1) != 0) ||
+        (n != BL_CHUNK) || (memcmp(ping, r, BL_CHUNK) != 0))
+      ok = 0;
+  }
+  if (ok)
+    return 0;
+
+  /* le LEON revient seul a 115200 faute de trame valide */
+  if (verbose)
+    fprintf(stderr, "%d bauds: ping failed, back to 115200\n", baud);
+  set_baud(115200);
+  usleep(BL_BAUD_TIMEOUT + 500000);
+  if (hello(window) != 0) {
+    fprintf(stderr, "ERROR: loader lost after baud change\n");
+    exit(1);
+  }
+  return -1;
+}
+
+unsigned char *load_image (char *name, int hex, unsigned int *size)
+{
+  unsigned char *img;
+  unsigned int w, n = 0;
+  char line[128];
+  FILE *fp;
+  int c;
+
+  img = calloc(BL_IMAGE_MAX+BL_CHUNK, 1);
+  fp = fopen(name, hex ? "r" : "rb");
+  if ((img == NULL) || (fp == NULL)) {
+    fprintf(stderr, "ERROR: cannot open %s, errno=%d\n", name, errno);
+    exit(1);
+  }
+  if (hex) {
+    while (fgets(line, sizeof(line), fp) != NULL) {
+      if (sscanf(line, "%x", &w) != 1)
+        continue;
+      if (n >= BL_IMAGE_MAX)
+        break;
+      img[n++] = w>>24; img[n++] = w>>16; img[n++] = w>>8; img[n++] = w;
+    }
+  } else {
+    while (((c = fgetc(fp)) != EOF) && (n < BL_IMAGE_MAX))
+      img[n++] = c;
+  }
+  if (!feof(fp) && !hex) {
+    fprintf(stderr, "ERROR: image larger than %d bytes\n", BL_IMAGE_MAX);
+    exit(1);
+  }
+  fclose(fp);
+  *size = (n+3) & ~3;
+  return img;
+}
+
+/* envoi de l'image en "go-back-N" : jusqu'a window trames en vol, reprise
+   a partir de la sequence indiquee par un 'N', ou du debut de la fenetre
+   sur timeout */
+void send_image (unsigned char *img, unsigned int size, int window)
+{
+  unsigned char buf[BL_MAX_PAYLOAD];
+  unsigned char type, seq;
+  unsigned int nchunks = (size + BL_CHUNK-1) / BL_CHUNK;
+  unsigned int base = 0, next = 0, idx, off, len;
+  int n, rc, timeouts = 0;
+  /* temps de la fenetre au debit courant, plus la latence de l'ack */
+  int timeout_ms = 100 + window*(10+BL_MAX_PAYLOAD)*11*1000/cur_baud;
+
+  while (base < nchunks) {
+    while ((next < base+window) && (next < nchunks)) {
+      off = next*BL_CHUNK;
+      len = (size-off < BL_CHUNK) ? size-off : BL_CHUNK;
+      buf[0] = off>>24; buf[1] = off>>16; buf[2] = off>>8; buf[3] = off;
+      memcpy(buf+4, img+off, len);
+      send_frame('D', next & 0xff, buf, 4+len);
+      next++;
+    }
+
+    rc = recv_frame(&type, &seq, buf, &n, timeout_ms);
+    if (rc == -1) {
+      /* ack ou nak perdu : tout renvoyer depuis base */
+      if (++timeouts > 20) {
+        fprintf(stderr, "ERROR: no answer from loader\n");
+        exit(1);
+      }
+      stat_timeout++;
+      stat_resend += next-base;
+      next = base;
+      continue;
+    }
+    if (rc != 0)
+      continue;
+    timeouts = 0;
+    idx = base + ((seq - base) & 0xff);
+    if (type == 'A') {
+      if ((idx >= base) && (idx < next))
+        base = idx+1;
+    } else if (type == 'N') {
+      stat_nak++;
+      if ((n > 0) && (buf[0] == BL_E_RANGE)) {
+        fprintf(stderr, "ERROR: image rejected (range)\n");
+        exit(1);
+      }
+      if ((idx >= base) && (idx <= next)) {
+        base = idx;
+        stat_resend += next-idx;
+        next = idx;
+      }
+    }
+    if (verbose && ((base % 16) == 0))
+      fprintf(stderr, "\r%u/%u", base*BL_CHUNK < size ? base*BL_CHUNK : size,
+              size);
+  }
+  if (verbose)
+    fprintf(stderr, "\r%u/%u\n", size, size);
+}
+
+int main (int argc, char *argv[])
+{
+  char *rates = "1000000,921600,500000,460800,230400";
+  char *p, *name;
+  int baud = 115200;
+  int hex = -1, check_only = 0, window = 0, user_window = 0;
+  unsigned char *img, b[8], r[BL_MAX_PAYLOAD];
+  unsigned int size, crc;
+  double t0, t1, t2;
+  int c, rate;
+
+  while ((c = getopt(argc, argv, "?hs:nb:w:cxv")) > 0) {
+    switch (c) {
+    case 's':
+      baud = atoi(optarg);
+      break;
+    case 'n':
+      parity_odd = 0;
+      break;
+    case 'b':
+      rates = optarg;
+      break;
+    case 'w':
+      user_window = atoi(optarg);
+      break;
+    case 'c':
+      check_only = 1;
+      break;
+    case 'x':
+      hex = 1;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      usage((c=='h' || c=='?') ? stdout : stderr, (c=='h' || c=='?') ? 0 : 1);
+    }
+  }
+  if (argc - optind < 2)
+    usage(stderr, 1);
+  name = argv[optind+1];
+  if (hex < 0)
+    hex = (strlen(name) > 4) && (strcmp(name+strlen(name)-4, ".hex") == 0);
+  img = load_image(name, hex, &size);
+  if (size == 0) {
+    fprintf(stderr, "ERROR: empty image\n");
+    return 1;
+  }
+  crc = crc32_buf(img, size);
+
+  rfd = open_device(argv[optind], baud);
+  t0 = now_s();
+
+  /* commande 'L' du moniteur */
+  tcflush(rfd, TCIFLUSH);
+  write_all((unsigned char *) "L", 1);
+  usleep(50000);
+  if (hello(&window) != 0) {
+    fprintf(stderr, "ERROR: no answer from loader (monitor locked?)\n");
+    return 1;
+  }
+  if (user_window > 0)
+    window = user_window;
+  if (window < 1)
+    window = 1;
+
+  /* montee en debit */
+  for (p = rates; *p != '\0'; ) {
+    rate = strtol(p, &p, 10);
+    if (*p == ',') p++;
+    if (rate <= cur_baud)
+      continue;
+    if (try_baud(rate, &window) == 0)
+      break;
+    if (user_window > 0)
+      window = user_window;
+  }
+  if (verbose)
+    fprintf(stderr, "link at %d bauds, window %d\n", cur_baud, window);
+
+  t1 = now_s();
+  send_image(img, size, window);
+  t2 = now_s();
+
+  b[0] = size>>24; b[1] = size>>16; b[2] = size>>8; b[3] = size;
+  b[4] = crc>>24;  b[5] = crc>>16;  b[6] = crc>>8;  b[7] = crc;
+  if (transact('V', b, 8, 'A', r, NULL, 1000, 3) != 0) {
+    fprintf(stderr, "ERROR: verify failed (crc 0x%08x)\n", crc);
+    return 1;
+  }
+
+  printf("%u bytes, crc 0x%08x, %d bauds: %.2f s (transfer %.2f s, "
+         "%.1f kB/s, %.0f%% of line rate), %lu resent, %lu naks, "
+         "%lu timeouts\n",
+         size, crc, cur_baud, t2-t0, t2-t1, size/(t2-t1)/1000.0,
+         100.0*size*11/(t2-t1)/cur_baud, stat_resend, stat_nak, stat_timeout);
+
+  if (transact(check_only ? 'Q' : 'G', NULL, 0, 'A', NULL, NULL, 1000, 3)
+      != 0) {
+    fprintf(stderr, "ERROR: no ack for '%c'\n", check_only ? 'Q' : 'G');
+    return 1;
+  }
+  tcdrain(rfd);
+  close(rfd);
+  return 0;
+}
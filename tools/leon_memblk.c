@@ -0,0 +1,325 @@
+/*
+ * leon_memblk.c -- commandes memoire par blocs du moniteur soft_boot ('M')
+ *
+ * Envoie une requete binaire au moniteur (deverrouille) et decode la
+ * reponse (cf soft_boot/include/memblk.h) :
+ *
+ *   leon_memblk [-s baud] [-n] [-t ms] [-o fichier] [-v] device op args
+ *
+ *   dump ADDR N        N mots a partir de ADDR (hexa sur stdout, ou binaire
+ *                      big endian dans le fichier -o)
+ *   fill ADDR N VAL    ecrit VAL dans N mots
+ *   copy SRC N DST     copie N mots de SRC vers DST
+ *   crc ADDR N         crc32 (zlib) des N mots
+ *   cmp A N B          compare N mots de A et B
+ *
+ * Les nombres sont en C (0x.. pour l'hexa). Teste avec leon_uart_emu.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <getopt.h>
+#include <termios.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/select.h>
+
+#define MEMBLK_SYNC0       0xa5
+#define MEMBLK_SYNC1       0x5b
+#define MEMBLK_REQ_SZ      14
+#define MEMBLK_MAX_WORDS   0x4000
+
+int rfd = -1;
+int parity_odd = 1; /* uart_init() du moniteur : parite impaire */
+int timeout_ms = 2000;
+int verbose = 0;
+unsigned long stat_rx = 0;
+
+void usage (FILE *fp, int rc)
+{
+  fprintf(fp, "Usage: leon_memblk [-s speed] [-n] [-t ms] [-o file] [-v] device op args\n\n"
+          "\t-s\tbaud rate (default 115200)\n"
+          "\t-n\tno parity (default odd, as the monitor)\n"
+          "\t-t\treply timeout in ms (default 2000)\n"
+          "\t-o\twrite dump to file (raw, big endian)\n"
+          "\t-v\tverbose (frame size, compression ratio)\n\n"
+          "\tdump ADDR N\n"
+          "\tfill ADDR N VAL\n"
+          "\tcopy SRC N DST\n"
+          "\tcrc ADDR N\n"
+          "\tcmp A N B\n");
+  exit(rc);
+}
+
+speed_t baud_to_speed (int baud)
+{
+  switch (baud) {
+  case 9600:   return B9600;
+  case 19200:  return B19200;
+  case 38400:  return B38400;
+  case 57600:  return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  default:
+    fprintf(stderr, "ERROR: unsupported baud rate %d\n", baud);
+    exit(1);
+  }
+}
+
+int open_device (char *path, int baud)
+{
+  struct termios tio;
+  int fd;
+
+  fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: open(%s) failed, errno=%d\n", path, errno);
+    exit(1);
+  }
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baud_to_speed(baud));
+    cfsetospeed(&tio, baud_to_speed(baud));
+    tio.c_cflag |= CLOCAL | CREAD;
+    if (parity_odd)
+      tio.c_cflag |= PARENB | PARODD;
+    tcsetattr(fd, TCSAFLUSH, &tio);
+  }
+  return fd;
+}
+
+/* lecture d'un octet, -1 si timeout */
+int get_byte (void)
+{
+  unsigned char b;
+  struct timeval tv;
+  fd_set infds;
+
+  FD_ZERO(&infds);
+  FD_SET(rfd, &infds);
+  tv.tv_sec = timeout_ms/1000;
+  tv.tv_usec = (timeout_ms%1000)*1000;
+  if (select(rfd+1, &infds, NULL, NULL, &tv) <= 0)
+    return -1;
+  if (read(rfd, &b, 1) != 1)
+    return -1;
+  stat_rx++;
+  return b;
+}
+
+unsigned char rx_csum;
+
+unsigned int get_word (void)
+{
+  unsigned int w = 0;
+  int i, b;
+
+  for (i=0; i<4; i++) {
+    b = get_byte();
+    if (b < 0) {
+      fprintf(stderr, "ERROR: timeout\n");
+      exit(1);
+    }
+    rx_csum += b;
+    w = (w<<8) | b;
+  }
+  return w;
+}
+
+unsigned int get_hdr_byte (void)
+{
+  int b = get_byte();
+
+  if (b < 0) {
+    fprintf(stderr, "ERROR: timeout\n");
+    exit(1);
+  }
+  rx_csum += b;
+  return b;
+}
+
+/* envoi de la requete et attente de l'entete de la reponse
+
+   @return nombre de mots annonces */
+unsigned int memblk_request (unsigned char op, unsigned int addr,
+                             unsigned int n, unsigned int arg)
+{
+  unsigned char req[MEMBLK_REQ_SZ+1];
+  unsigned char csum = 0;
+  int i, b, prev = -1;
+  unsigned int rop, status;
+
+  req[0] = 'M';
+  req[1] = op;
+  req[2] = addr>>24; req[3] = addr>>16; req[4] = addr>>8;  req[5] = addr;
+  req[6] = n>>24;    req[7] = n>>16;    req[8] = n>>8;     req[9] = n;
+  req[10] = arg>>24; req[11] = arg>>16; req[12] = arg>>8;  req[13] = arg;
+  for (i=1; i<MEMBLK_REQ_SZ; i++)
+    csum += req[i];
+  req[MEMBLK_REQ_SZ] = csum;
+
+  tcflush(rfd, TCIFLUSH);
+  if (write(rfd, req, sizeof(req)) != sizeof(req)) {
+    fprintf(stderr, "ERROR: write failed, errno=%d\n", errno);
+    exit(1);
+  }
+
+  /* synchro (le moniteur peut envoyer des snapshots ou de l'echo) */
+  for (;;) {
+    b = get_byte();
+    if (b < 0) {
+      fprintf(stderr, "ERROR: no reply\n");
+      exit(1);
+    }
+    if ((prev == MEMBLK_SYNC0) && (b == MEMBLK_SYNC1))
+      break;
+    prev = b;
+  }
+
+  rx_csum = 0;
+  rop = get_hdr_byte();
+  status = get_hdr_byte();
+  n = get_word();
+  if ((rop != op) || (status != 0)) {
+    get_hdr_byte();
+    fprintf(stderr, "ERROR: op '%c' status %u%s\n", rop, status,
+            (status==1) ? " (checksum)" : (status==2) ? " (op)" :
+            (status==3) ? " (range)" : (status==4) ? " (timeout)" : "");
+    exit(1);
+  }
+  return n;
+}
+
+void memblk_check_csum (void)
+{
+  unsigned char csum = rx_csum;
+
+  if (get_hdr_byte() != csum) {
+    fprintf(stderr, "ERROR: bad checksum\n");
+    exit(1);
+  }
+}
+
+int main (int argc, char *argv[])
+{
+  char *out_name = NULL;
+  int baud = 115200;
+  unsigned int addr, n, arg = 0;
+  unsigned int *buf;
+  unsigned int i, k, h, w;
+  char *op;
+  int c;
+
+  while ((c = getopt(argc, argv, "?hs:nt:o:v")) > 0) {
+    switch (c) {
+    case 's':
+      baud = atoi(optarg);
+      break;
+    case 'n':
+      parity_odd = 0;
+      break;
+    case 't':
+      timeout_ms = atoi(optarg);
+      break;
+    case 'o':
+      out_name = optarg;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      usage((c=='h' || c=='?') ? stdout : stderr, (c=='h' || c=='?') ? 0 : 1);
+    }
+  }
+
+  if (argc - optind < 4)
+    usage(stderr, 1);
+  op = argv[optind+1];
+  addr = strtoul(argv[optind+2], NULL, 0);
+  n = strtoul(argv[optind+3], NULL, 0);
+  if (n > MEMBLK_MAX_WORDS) {
+    fprintf(stderr, "ERROR: at most %u words\n", MEMBLK_MAX_WORDS);
+    return 1;
+  }
+  if ((strcmp(op, "fill")==0) || (strcmp(op, "copy")==0) ||
+      (strcmp(op, "cmp")==0)) {
+    if (argc - optind < 5)
+      usage(stderr, 1);
+    arg = strtoul(argv[optind+4], NULL, 0);
+  }
+
+  rfd = open_device(argv[optind], baud);
+
+  if (strcmp(op, "dump")==0) {
+    FILE *fp;
+
+    n = memblk_request('d', addr, n, 0);
+    buf = malloc((n+1)*sizeof(unsigned int));
+    for (i=0; i<n; ) {
+      h = get_hdr_byte();
+      if (h & 0x80) {
+        w = get_word();
+        for (k=0; (k<(h&0x7f)+1) && (i<n); k++)
+          buf[i++] = w;
+      } else {
+        for (k=0; (k<h+1) && (i<n); k++)
+          buf[i++] = get_word();
+      }
+    }
+    memblk_check_csum();
+
+    if (out_name != NULL) {
+      fp = fopen(out_name, "wb");
+      if (fp == NULL) {
+        fprintf(stderr, "ERROR: cannot open %s, errno=%d\n", out_name, errno);
+        return 1;
+      }
+      for (i=0; i<n; i++) {
+        fputc(buf[i]>>24, fp); fputc(buf[i]>>16, fp);
+        fputc(buf[i]>>8, fp);  fputc(buf[i], fp);
+      }
+      fclose(fp);
+    } else {
+      for (i=0; i<n; i++) {
+        if ((i%4)==0) printf("%08x:", addr+4*i);
+        printf(" %08x", buf[i]);
+        if (((i%4)==3) || (i==n-1)) printf("\n");
+      }
+    }
+    if (verbose)
+      fprintf(stderr, "%u words, %lu bytes received (raw %u)\n",
+              n, stat_rx, 4*n);
+    free(buf);
+  } else if (strcmp(op, "fill")==0) {
+    memblk_request('f', addr, n, arg);
+    memblk_check_csum();
+  } else if (strcmp(op, "copy")==0) {
+    memblk_request('c', addr, n, arg);
+    memblk_check_csum();
+  } else if (strcmp(op, "crc")==0) {
+    memblk_request('k', addr, n, 0);
+    w = get_word();
+    memblk_check_csum();
+    printf("0x%08x\n", w);
+  } else if (strcmp(op, "cmp")==0) {
+    memblk_request('m', addr, n, arg);
+    w = get_word();
+    k = get_word();
+    memblk_check_csum();
+    if (w == 0)
+      printf("identical\n");
+    else
+      printf("%u words differ, first at 0x%08x\n", w, addr+4*k);
+    close(rfd);
+    return (w == 0) ? 0 : 2;
+  } else {
+    usage(stderr, 1);
+  }
+
+  close(rfd);
+  return 0;
+}
@@ -0,0 +1,1201 @@
+/*
+ * leon_uart_emu.c -- emulateur (PTY) du moniteur UART soft_boot
+ *
+ * Ouvre un pseudo-terminal et y repond comme la carte LEON :
+ *  - mode "monitor" (par defaut) : sequence de deverrouillage "goldo" puis
+ *    commandes du moniteur de soft_boot/main.c (? w r @ $ R W M L + - ! % s S T t)
+ *  - mode "robot" (-m robot) : commandes utilisees par load_soft_uart
+ *    ('w' laser, '<' odometrie, 'h'/'g', mots de commande "XXXXXXXX>")
+ * avec un espace de registres simule (RAM, registres robot, timer 1us).
+ *
+ * Le debit en sortie est cadence sur le baudrate demande (10 bits/octet) et
+ * une latence d'echo configurable est ajoutee avant chaque reponse, pour
+ * tester et mesurer load_soft_uart, tip, etc. sans carte :
+ *
+ *   gcc -O2 -o leon_uart_emu leon_uart_emu.c
+ *   ./leon_uart_emu -s 115200 -e 200 -L /tmp/leon
+ *   ./tip -s 115200 /tmp/leon
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* espace d'adresses simule */
+#define ROM_BASE          0x00000000
+#define ROM_SIZE          (16*1024)
+#define RAM_BASE          0x40000000
+#define RAM_SIZE          (64*1024)
+#define ROBOT_BASE        0x80008000
+#define ROBOT_NREGS       1024
+
+#define R_ROBOT_TIMER          0x00
+#define R_ROBOT_RESET          0x01 /* W */
+#define R_ROBOT_GPIO           0x01 /* R : dip switches */
+#define R_ROBOT_DEBUG          0x02
+#define R_ROBOT_TAG            0x03
+#define R_ROBOT_STEPPER_CS     0x04
+#define R_ROBOT_STEPPER_TARGET 0x05
+#define R_ROBOT_I2C_TRACE_CS   0x0c
+#define R_ROBOT_I2C_TRACE_D    0x0d
+#define R_ROBOT_I2C_BSTR_CS    0x0e
+#define R_ROBOT_I2C_BSTR_D     0x0f
+#define R_ROBOT_RC_VAL_1       0x81
+#define R_ROBOT_RC_ODO_1_INC   0x83
+#define R_ROBOT_RC_SPEED_1     0x84
+#define R_ROBOT_RC_VAL_2       0x89
+#define R_ROBOT_RC_ODO_2_INC   0x8b
+#define R_ROBOT_RC_SPEED_2     0x8c
+#define R_ROBOT_LASER_RAW      0xc3
+
+#define MISC_NREGS        256
+
+#define INPUT_BUF_SZ      16
+
+#define MODE_MONITOR      0
+#define MODE_ROBOT        1
+
+int emu_mode = MODE_MONITOR;
+unsigned int baud = 115200;
+unsigned int echo_latency_us = 0;
+int skip_pwd = 0;
+int verbose = 0;
+
+int mfd = -1;
+char *link_name = NULL;
+
+unsigned char rom[ROM_SIZE];
+unsigned char ram[RAM_SIZE];
+unsigned int robot_reg[ROBOT_NREGS];
+
+struct misc_reg {
+  unsigned int addr;
+  unsigned int val;
+} misc_reg[MISC_NREGS];
+int misc_nregs = 0;
+
+struct timespec t0;
+
+/* statistiques */
+unsigned long stat_rx = 0;
+unsigned long stat_tx = 0;
+unsigned long stat_cmd = 0;
+
+/* etat du moniteur */
+int pwd_state = 0;
+int edit_cmd = 0;
+int ib_index = 0;
+char input_buf[INPUT_BUF_SZ];
+unsigned int mem_test_addr = 0;
+unsigned int mem_test_data = 0;
+unsigned int i2c_test_data = 0;
+unsigned int snapshot_period = 0;
+unsigned int snapshot_next = 0;
+unsigned char snapshot_seq = 0;
+int memblk_len = -1; /* >=0 : reception d'une requete 'M' */
+unsigned char memblk_req[14];
+
+/* chargeur binaire 'L' (cf soft_boot/include/bootldr.h) */
+int bl_active = 0;
+int bl_state = 0;
+int bl_cnt = 0;
+int bl_err = 0;
+unsigned char bl_hdr[4];
+unsigned int bl_len, bl_crc, bl_crc_in;
+unsigned char bl_buf[4+256];
+unsigned char bl_next = 0;
+int bl_nak_sent = 0;
+unsigned int bl_verified = 0;
+unsigned char bl_stage[16*1024];
+unsigned int bl_last_rx = 0;
+int bl_probation = 0;
+int bl_garbled = 0;          /* debit au dela de -X : liaison inutilisable */
+unsigned int bl_max_baud = 0; /* -X : debit max simule (0 = pas de limite) */
+unsigned int bl_err_ppm = 0;  /* -E : erreurs de ligne simulees (rx) */
+unsigned int baud_init;
+unsigned long stat_bl_frames = 0;
+unsigned long stat_bl_naks = 0;
+
+/* etat du mode robot */
+char robot_cmd[16];
+int robot_cmd_len = 0;
+int robot_active = 0;
+int stepper_pos = 0;
+double sim_dist_mm = 500.0;
+
+
+/*****************************************************************************/
+/* temps et cadencement */
+
+unsigned int emu_time_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned int)((ts.tv_sec-t0.tv_sec)*1000000 +
+                        (ts.tv_nsec-t0.tv_nsec)/1000);
+}
+
+/* instant (us) ou le dernier octet emis aura fini de sortir de l'UART */
+static unsigned long long tx_free_at = 0;
+
+static unsigned long long emu_time_us64 (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)(ts.tv_sec-t0.tv_sec)*1000000ULL +
+    (ts.tv_nsec-t0.tv_nsec)/1000;
+}
+
+void emu_putchar (unsigned char c)
+{
+  unsigned long long now, byte_us;
+
+  /* 1 start + 8 data + 1 stop */
+  byte_us = (baud>0) ? (10000000ULL/baud) : 0;
+  now = emu_time_us64();
+  if (tx_free_at < now)
+    tx_free_at = now;
+  tx_free_at += byte_us;
+  if (tx_free_at > now + 1000)
+    usleep(tx_free_at - now - 1000);
+
+  write(mfd, &c, 1);
+  stat_tx++;
+}
+
+void emu_putstring (char *s)
+{
+  while (*s)
+    emu_putchar(*s++);
+}
+
+void emu_printhex (unsigned int val)
+{
+  char buf[16];
+
+  sprintf(buf, "%08x", val);
+  emu_putstring(buf);
+}
+
+
+/*****************************************************************************/
+/* espace de registres */
+
+unsigned int *misc_reg_p (unsigned int addr, int create)
+{
+  int i;
+
+  for (i=0; i<misc_nregs; i++)
+    if (misc_reg[i].addr==addr)
+      return &misc_reg[i].val;
+  if (!create || (misc_nregs>=MISC_NREGS))
+    return NULL;
+  misc_reg[misc_nregs].addr = addr;
+  misc_reg[misc_nregs].val = 0;
+  return &misc_reg[misc_nregs++].val;
+}
+
+unsigned int robot_read (unsigned int idx)
+{
+  switch (idx) {
+  case R_ROBOT_TIMER:
+    return emu_time_us() - robot_reg[R_ROBOT_TIMER];
+  case R_ROBOT_GPIO:
+    /* -u : DIP_SW_0 (demarrage rapide) */
+    return skip_pwd ? 1 : 0;
+  case R_ROBOT_TAG:
+    return 0x54455354; /* 'TEST' */
+  case R_ROBOT_STEPPER_CS:
+    /* le pas a pas simule arrive instantanement */
+    return 0x80000000 | (robot_reg[R_ROBOT_STEPPER_TARGET] & 0xffff);
+  case R_ROBOT_LASER_RAW:
+    return (sim_dist_mm>280.0) ? (unsigned int)((sim_dist_mm-280.0)*1.8) : 0;
+  default:
+    return robot_reg[idx];
+  }
+}
+
+void robot_write (unsigned int idx, unsigned int val)
+{
+  switch (idx) {
+  case R_ROBOT_TIMER:
+    break;
+  case R_ROBOT_RESET:
+    /* le timer repart de 0 */
+    if (val & 1)
+      robot_reg[R_ROBOT_TIMER] = emu_time_us();
+    robot_reg[idx] = val;
+    break;
+  case R_ROBOT_I2C_TRACE_D:
+    robot_reg[idx] = val;
+    break;
+  default:
+    robot_reg[idx] = val;
+    break;
+  }
+}
+
+unsigned int mem_read (unsigned int addr)
+{
+  unsigned int *p;
+  unsigned char *b = NULL;
+
+  addr &= ~3;
+  if ((addr-ROM_BASE)<ROM_SIZE) /* ROM_BASE = 0 */
+    b = &rom[addr-ROM_BASE];
+  else if ((addr>=RAM_BASE) && (addr<RAM_BASE+RAM_SIZE))
+    b = &ram[addr-RAM_BASE];
+  else if ((addr>=ROBOT_BASE) && (addr<ROBOT_BASE+4*ROBOT_NREGS))
+    return robot_read((addr-ROBOT_BASE)>>2);
+
+  if (b!=NULL) /* big endian (SPARC) */
+    return (b[0]<<24) | (b[1]<<16) | (b[2]<<8) | b[3];
+
+  p = misc_reg_p(addr, 0);
+  return (p!=NULL) ? *p : 0;
+}
+
+void mem_write (unsigned int addr, unsigned int val)
+{
+  unsigned int *p;
+  unsigned char *b = NULL;
+
+  addr &= ~3;
+  if ((addr>=RAM_BASE) && (addr<RAM_BASE+RAM_SIZE))
+    b = &ram[addr-RAM_BASE];
+  else if ((addr>=ROBOT_BASE) && (addr<ROBOT_BASE+4*ROBOT_NREGS)) {
+    robot_write((addr-ROBOT_BASE)>>2, val);
+    return;
+  } else if ((addr-ROM_BASE)<ROM_SIZE)
+    return;
+
+  if (b!=NULL) {
+    b[0] = val>>24; b[1] = val>>16; b[2] = val>>8; b[3] = val;
+    return;
+  }
+
+  p = misc_reg_p(addr, 1);
+  if (p!=NULL)
+    *p = val;
+}
+
+
+/*****************************************************************************/
+/* moniteur soft_boot */
+
+int convert_input_buf (int base)
+{
+  int i;
+  int test_val;
+  int result_val = 0;
+  int result_sign = 1;
+  int blank_space = 1;
+
+  for (i=0; i<INPUT_BUF_SZ; i++) {
+    test_val=input_buf[i];
+    if ((test_val==0x20) || (test_val==0x5f)) { /* ' ' or '_' */
+      if (blank_space) continue; else break;
+    } else if (test_val==0x2d) { /* '-' */
+      if (!blank_space) break;
+      result_sign = -1;
+      blank_space = 0;
+    } else if ((test_val>=0x30) && (test_val<=0x39)) {
+      result_val = result_val*base + (test_val-0x30);
+    } else if ((base==16) && (test_val>=0x41) && (test_val<=0x46)) {
+      result_val = result_val*16 + (test_val-0x41) + 10;
+    } else if ((base==16) && (test_val>=0x61) && (test_val<=0x66)) {
+      result_val = result_val*16 + (test_val-0x61) + 10;
+    } else {
+      break;
+    }
+  }
+
+  return result_sign * result_val;
+}
+
+void send_snapshot (void)
+{
+  unsigned int snap[6];
+  unsigned char csum, b;
+  int i, j;
+
+  /* instantane R_ROBOT_SENS_xxx : lu directement (pas de concurrence) */
+  snap[0] = robot_read(R_ROBOT_TIMER);
+  snap[1] = robot_read(R_ROBOT_RC_VAL_1);
+  snap[2] = robot_read(R_ROBOT_RC_VAL_2);
+  snap[3] = robot_read(R_ROBOT_RC_SPEED_1);
+  snap[4] = robot_read(R_ROBOT_RC_SPEED_2);
+  snap[5] = 0; /* ultrasons : pas d'obstacle (pas d'ordonnanceur emule) */
+
+  emu_putchar(0xa5);
+  emu_putchar(0x5a);
+  emu_putchar(24);
+  csum = 24 + snapshot_seq;
+  emu_putchar(snapshot_seq++);
+  for (i=0; i<6; i++) {
+    for (j=24; j>=0; j-=8) {
+      b = (snap[i]>>j) & 0xff;
+      csum += b;
+      emu_putchar(b);
+    }
+  }
+  emu_putchar(csum);
+}
+
+void print_banner (void)
+{
+  emu_putstring("\nRobot GOLDO - TEST INTEGRATION carte_log_gr_v1 (emulateur)\n");
+  if (skip_pwd)
+    emu_putstring("BOOT rapide\n");
+  emu_putstring("Fonctions OK :\n");
+  emu_putstring("   @ : adresse de test AHB/APB\n");
+  emu_putstring("   $ : data de test AHB/APB\n");
+  emu_putstring("   R : test lecture 32b AHB/APB\n");
+  emu_putstring("   W : test ecriture 32b AHB/APB\n");
+  emu_putstring("   M : dump/fill/copy/crc32/compare (binaire)\n");
+  emu_putstring("   + : increment debug reg\n");
+  emu_putstring("   - : decrement debug reg\n");
+  emu_putstring("   ? : debug esclave i2c\n");
+  emu_putstring("   w : ecrire ds trace i2c\n");
+  emu_putstring("   r : lire ds bstr i2c\n");
+  emu_putstring("   ! : charger nouveau soft\n");
+  emu_putstring("   L : charger nouveau soft (UART binaire)\n");
+  emu_putstring("   % : robot reset\n");
+  emu_putstring("   s : snapshot capteurs (binaire)\n");
+  emu_putstring("   S : flux de snapshots (periode en ms, 0=stop)\n");
+  emu_putstring("   T : mesure boucle de controle (t : raz)\n");
+  emu_putstring("\n");
+}
+
+/* fin de saisie d'un champ (apres '@', '$' ou 'S') */
+void monitor_edit_done (void)
+{
+  switch (edit_cmd) {
+  case '@':
+    mem_test_addr = convert_input_buf(16);
+    break;
+  case '$':
+    mem_test_data = convert_input_buf(16);
+    break;
+  case 'S':
+    snapshot_period = convert_input_buf(10);
+    if ((int)snapshot_period < 0) snapshot_period = 0;
+    snapshot_period *= 1000;
+    snapshot_next = robot_read(R_ROBOT_TIMER);
+    break;
+  }
+  emu_putchar(0xa);
+  edit_cmd = 0;
+}
+
+/* commandes memoire par blocs (cf soft_boot/include/memblk.h) */
+unsigned char memblk_csum;
+
+void memblk_putchar (unsigned char b)
+{
+  memblk_csum += b;
+  emu_putchar(b);
+}
+
+void memblk_putword (unsigned int w)
+{
+  memblk_putchar(w>>24);
+  memblk_putchar(w>>16);
+  memblk_putchar(w>>8);
+  memblk_putchar(w);
+}
+
+void memblk_header (unsigned char op, unsigned char status, unsigned int n)
+{
+  emu_putchar(0xa5);
+  emu_putchar(0x5b);
+  memblk_csum = 0;
+  memblk_putchar(op);
+  memblk_putchar(status);
+  memblk_putword(n);
+}
+
+unsigned int memblk_crc32 (unsigned int crc, unsigned char b)
+{
+  int k;
+
+  crc ^= b;
+  for (k=0; k<8; k++)
+    crc = (crc>>1) ^ ((crc&1) ? 0xedb88320 : 0);
+  return crc;
+}
+
+void memblk_cmd (unsigned char *req)
+{
+  unsigned char op = req[0];
+  unsigned int addr = (req[1]<<24) | (req[2]<<16) | (req[3]<<8) | req[4];
+  unsigned int n    = (req[5]<<24) | (req[6]<<16) | (req[7]<<8) | req[8];
+  unsigned int arg  = (req[9]<<24) | (req[10]<<16) | (req[11]<<8) | req[12];
+  unsigned char csum = 0;
+  unsigned int i, w = 0, prev = 0, run;
+  unsigned int lit[32];
+  int k, nlit;
+
+  for (k=0; k<13; k++)
+    csum += req[k];
+  if (csum!=req[13]) {
+    memblk_header(op, 1, 0);
+    emu_putchar(memblk_csum);
+    return;
+  }
+  if ((addr&3) || (n>0x4000) || (((op=='c') || (op=='m')) && (arg&3))) {
+    memblk_header(op, 3, 0);
+    emu_putchar(memblk_csum);
+    return;
+  }
+
+  switch (op) {
+  case 'd':
+    memblk_header(op, 0, n);
+    nlit = 0;
+    prev = 0;
+    run = 0;
+    for (i=0; i<=n; i++) {
+      if (i<n) {
+        w = mem_read(addr+4*i);
+        if ((run!=0) && (w==prev) && (run<128)) {
+          run++;
+          continue;
+        }
+      }
+      if (run>=2) {
+        if (nlit) {
+          memblk_putchar(nlit-1);
+          for (k=0; k<nlit; k++) memblk_putword(lit[k]);
+          nlit = 0;
+        }
+        memblk_putchar(0x80|(run-1));
+        memblk_putword(prev);
+      } else if (run==1) {
+        lit[nlit++] = prev;
+      }
+      if ((nlit==32) || ((i==n) && nlit)) {
+        memblk_putchar(nlit-1);
+        for (k=0; k<nlit; k++) memblk_putword(lit[k]);
+        nlit = 0;
+      }
+      prev = w;
+      run = 1;
+    }
+    break;
+  case 'f':
+    for (i=0; i<n; i++)
+      mem_write(addr+4*i, arg);
+    memblk_header(op, 0, 0);
+    break;
+  case 'c':
+    if (arg<addr) {
+      for (i=0; i<n; i++)
+        mem_write(arg+4*i, mem_read(addr+4*i));
+    } else if (arg>addr) {
+      for (i=n; i>0; i--)
+        mem_write(arg+4*(i-1), mem_read(addr+4*(i-1)));
+    }
+    memblk_header(op, 0, 0);
+    break;
+  case 'k':
+    w = 0xffffffff;
+    for (i=0; i<n; i++) {
+      prev = mem_read(addr+4*i);
+      for (k=24; k>=0; k-=8)
+        w = memblk_crc32(w, (prev>>k)&0xff);
+    }
+    memblk_header(op, 0, 1);
+    memblk_putword(~w);
+    break;
+  case 'm':
+    w = 0;
+    prev = 0xffffffff;
+    for (i=0; i<n; i++) {
+      if (mem_read(addr+4*i)!=mem_read(arg+4*i)) {
+        if (w==0) prev = i;
+        w++;
+      }
+    }
+    memblk_header(op, 0, 2);
+    memblk_putword(w);
+    memblk_putword(prev);
+    break;
+  default:
+    memblk_header(op, 2, 0);
+    break;
+  }
+  emu_putchar(memblk_csum);
+}
+
+/* chargeur binaire 'L' */
+unsigned int bl_tx_crc;
+
+void bl_put (unsigned char b)
+{
+  bl_tx_crc = memblk_crc32(bl_tx_crc, b);
+  emu_putchar(bl_garbled ? b^0x55 : b);
+}
+
+void bl_send (unsigned char type, unsigned char seq, unsigned char *data,
+              int len)
+{
+  unsigned int crc;
+  int i;
+
+  emu_putchar(0xa5);
+  emu_putchar(0x5c);
+  bl_tx_crc = 0xffffffff;
+  bl_put(type);
+  bl_put(seq);
+  bl_put(len>>8);
+  bl_put(len);
+  for (i=0; i<len; i++)
+    bl_put(data[i]);
+  crc = ~bl_tx_crc;
+  emu_putchar(crc>>24);
+  emu_putchar(crc>>16);
+  emu_putchar(crc>>8);
+  emu_putchar(crc);
+  if (type=='N')
+    stat_bl_naks++;
+}
+
+void bl_nak (unsigned char seq, unsigned char err)
+{
+  bl_send('N', seq, &err, 1);
+}
+
+void bl_set_baud (unsigned int new_baud)
+{
+  baud = new_baud;
+  bl_garbled = (bl_max_baud!=0) && (baud>bl_max_baud);
+  if (verbose)
+    fprintf(stderr, "loader: %u bauds%s\n", baud, bl_garbled ? " (KO)" : "");
+}
+
+void bl_frame (unsigned char type, unsigned char seq, unsigned char *data,
+               unsigned int len)
+{
+  static const unsigned int rates[5] = {9600, 19200, 38400, 57600, 115200};
+  unsigned char reply[16];
+  unsigned int off, size, crc, i, target;
+
+  stat_bl_frames++;
+  switch (type) {
+  case 'D':
+    if (seq!=bl_next) {
+      if (!bl_nak_sent) {
+        bl_nak(bl_next, 2);
+        bl_nak_sent = 1;
+      }
+      break;
+    }
+    off = (data[0]<<24) | (data[1]<<16) | (data[2]<<8) | data[3];
+    if ((len<4) || (off&3) || ((len-4)&3) || (off+len-4>sizeof(bl_stage))) {
+      bl_nak(bl_next, 3);
+      bl_nak_sent = 1;
+      break;
+    }
+    memcpy(&bl_stage[off], data+4, len-4);
+    bl_verified = 0;
+    bl_nak_sent = 0;
+    bl_send('A', seq, NULL, 0);
+    bl_next++;
+    break;
+  case 'H':
+    reply[0] = 1;
+    reply[1] = 4;
+    reply[2] = 0x01; reply[3] = 0x04;
+    reply[4] = 0x40; reply[5] = 0x00; reply[6] = 0x20; reply[7] = 0x00;
+    reply[8] = 0x00; reply[9] = 0x00; reply[10] = 0x40; reply[11] = 0x00;
+    i = (baud>0) ? 25000000/(8*baud) - 1 : 0;
+    reply[12] = i>>24; reply[13] = i>>16; reply[14] = i>>8; reply[15] = i;
+    bl_next = 0;
+    bl_nak_sent = 0;
+    bl_send('H', seq, reply, 16);
+    break;
+  case 'B':
+    if ((len<1) || (data[0]>5)) {
+      bl_nak(seq, 3);
+      break;
+    }
+    bl_send('A', seq, NULL, 0);
+    target = (len>=5) ? (data[1]<<24) | (data[2]<<16) | (data[3]<<8) | data[4]
+                      : 115200;
+    bl_set_baud((data[0]==5) ? target : rates[data[0]]);
+    bl_state = 0;
+    bl_probation = 1;
+    break;
+  case 'P':
+    bl_send('P', seq, data, len);
+    break;
+  case 'V':
+    size = (data[0]<<24) | (data[1]<<16) | (data[2]<<8) | data[3];
+    if ((len<8) || (size&3) || (size>sizeof(bl_stage))) {
+      bl_nak(seq, 3);
+      break;
+    }
+    crc = 0xffffffff;
+    for (i=0; i<size; i++)
+      crc = memblk_crc32(crc, bl_stage[i]);
+    crc = ~crc;
+    reply[0] = crc>>24; reply[1] = crc>>16; reply[2] = crc>>8; reply[3] = crc;
+    if (crc==(unsigned int)((data[4]<<24) | (data[5]<<16) | (data[6]<<8) | data[7])) {
+      bl_verified = size;
+      bl_send('A', seq, reply, 4);
+    } else {
+      bl_verified = 0;
+      bl_nak(seq, 4);
+    }
+    break;
+  case 'G':
+    if (bl_verified==0) {
+      bl_nak(seq, 5);
+      break;
+    }
+    bl_send('A', seq, NULL, 0);
+    memcpy(rom, bl_stage, bl_verified);
+    fprintf(stderr, "leon_uart_emu: new image loaded (%u bytes), reset\n",
+            bl_verified);
+    bl_active = 0;
+    bl_set_baud(baud_init);
+    /* le mot de demarrage a chaud est arme : pas de mot de passe */
+    print_banner();
+    break;
+  case 'Q':
+    bl_send('A', seq, NULL, 0);
+    bl_active = 0;
+    bl_set_baud(baud_init);
+    break;
+  default:
+    bl_nak(seq, 6);
+    break;
+  }
+}
+
+void bl_byte (unsigned char c)
+{
+  /* erreurs de ligne simulees */
+  if (bl_garbled || ((bl_err_ppm!=0) && ((unsigned)(rand()%1000000)<bl_err_ppm)))
+    c ^= 1<<(rand()%8);
+
+  switch (bl_state) {
+  case 0:
+    if (c==0xa5) bl_state = 1;
+    return;
+  case 1:
+    if (c==0x5c) {
+      bl_state = 2;
+      bl_cnt = 0;
+      bl_crc = 0xffffffff;
+    } else if (c!=0xa5) {
+      bl_state = 0;
+    }
+    return;
+  case 2:
+    bl_hdr[bl_cnt++] = c;
+    bl_crc = memblk_crc32(bl_crc, c);
+    if (bl_cnt==4) {
+      bl_len = (bl_hdr[2]<<8) | bl_hdr[3];
+      bl_cnt = 0;
+      if (bl_len>sizeof(bl_buf)) {
+        bl_state = 0;
+        if (!bl_nak_sent) {
+          bl_nak(bl_next, 1);
+          bl_nak_sent = 1;
+        }
+        return;
+      }
+      bl_state = (bl_len!=0) ? 3 : 4;
+    }
+    return;
+  case 3:
+    bl_buf[bl_cnt++] = c;
+    bl_crc = memblk_crc32(bl_crc, c);
+    if ((unsigned int) bl_cnt==bl_len) {
+      bl_state = 4;
+      bl_cnt = 0;
+    }
+    return;
+  case 4:
+    bl_crc_in = (bl_crc_in<<8) | c;
+    if (++bl_cnt<4)
+      return;
+    bl_state = 0;
+    if (bl_crc_in!=~bl_crc) {
+      if (!bl_nak_sent) {
+        bl_nak(bl_next, 1);
+        bl_nak_sent = 1;
+      }
+      return;
+    }
+    bl_last_rx = emu_time_us();
+    bl_probation = 0;
+    bl_frame(bl_hdr[0], bl_hdr[1], bl_buf, bl_len);
+    return;
+  }
+}
+
+void bl_tick (void)
+{
+  unsigned int now = emu_time_us();
+
+  if (bl_probation && (now-bl_last_rx > 2000000)) {
+    /* l'hote n'a pas suivi le changement de debit */
+    bl_probation = 0;
+    bl_state = 0;
+    bl_last_rx = now;
+    bl_set_baud(115200);
+  }
+  if (now-bl_last_rx > 30000000) {
+    bl_active = 0;
+    bl_set_baud(baud_init);
+  }
+}
+
+void monitor_byte (unsigned char c)
+{
+  unsigned int val;
+  int i;
+
+  /* deverrouillage */
+  if (pwd_state<5) {
+    switch (pwd_state) {
+    case 0: pwd_state = (c=='g') ? 1 : 0; break;
+    case 1: pwd_state = (c=='o') ? 2 : 0; break;
+    case 2: pwd_state = (c=='l') ? 3 : 0; break;
+    case 3: pwd_state = (c=='d') ? 4 : 0; break;
+    case 4: pwd_state = (c=='o') ? 5 : 0; break;
+    }
+    if (pwd_state==5)
+      print_banner();
+    return;
+  }
+
+  /* chargeur binaire 'L' */
+  if (bl_active) {
+    bl_byte(c);
+    return;
+  }
+
+  /* requete binaire 'M' (pas de timeout simule) */
+  if (memblk_len>=0) {
+    memblk_req[memblk_len++] = c;
+    if (memblk_len==14) {
+      memblk_len = -1;
+      memblk_cmd(memblk_req);
+    }
+    return;
+  }
+
+  /* saisie en cours (edit_input_buf()) */
+  if (edit_cmd) {
+    if ((c=='>') || (c==0x0a) || (c==0x0d)) {
+      emu_putchar('>');
+      emu_putchar(0xa);
+      monitor_edit_done();
+    } else {
+      emu_putchar(c);
+      input_buf[ib_index++] = c;
+      if (ib_index>=INPUT_BUF_SZ) {
+        emu_putchar('>');
+        emu_putchar(0xa);
+        monitor_edit_done();
+      }
+    }
+    return;
+  }
+
+  stat_cmd++;
+
+  switch (c) {
+  case '?':
+  case 'w':
+  case 'r':
+    emu_putstring("DEBUG I2C: \n");
+    if (c=='r') {
+      emu_putstring(" bstr data: ");
+      i2c_test_data = robot_read(R_ROBOT_I2C_BSTR_D);
+      emu_printhex(i2c_test_data);
+      emu_putchar(0xa);
+    }
+    if (c=='w') {
+      emu_putstring(" write to trace: ");
+      emu_printhex(i2c_test_data);
+      emu_putchar(0xa);
+      robot_write(R_ROBOT_I2C_TRACE_D, i2c_test_data);
+    }
+    emu_putstring(" trace status: ");
+    emu_printhex(robot_read(R_ROBOT_I2C_TRACE_CS));
+    emu_putchar(0xa);
+    emu_putstring(" trace data dbg: ");
+    emu_printhex(robot_read(R_ROBOT_I2C_TRACE_D));
+    emu_putchar(0xa);
+    emu_putstring(" bstr status: ");
+    emu_printhex(robot_read(R_ROBOT_I2C_BSTR_CS));
+    emu_putchar(0xa);
+    emu_putstring(" uart tx dropped: ");
+    emu_printhex(0);
+    emu_putchar(0xa);
+    break;
+  case '@':
+  case '$':
+  case 'S':
+    emu_putchar(c);
+    emu_putstring(" : ");
+    for (i=0; i<INPUT_BUF_SZ; i++)
+      input_buf[i] = '_';
+    ib_index = 0;
+    edit_cmd = c;
+    break;
+  case 'R':
+    val = mem_read(mem_test_addr);
+    emu_putstring("@0x");
+    emu_printhex(mem_test_addr);
+    emu_putstring(" : 0x");
+    emu_printhex(val);
+    emu_putchar(0xa);
+    break;
+  case 'W':
+    mem_write(mem_test_addr, mem_test_data);
+    emu_putstring("0x");
+    emu_printhex(mem_test_data);
+    emu_putstring("=> @0x");
+    emu_printhex(mem_test_addr);
+    emu_putchar(0xa);
+    break;
+  case '+':
+  case '-':
+    mem_test_addr = ROBOT_BASE + 4*R_ROBOT_DEBUG;
+    val = mem_read(mem_test_addr) + ((c=='+') ? 1 : -1);
+    mem_write(mem_test_addr, val);
+    emu_putstring("0x");
+    emu_printhex(val);
+    emu_putchar(0xa);
+    break;
+  case '!':
+    emu_putchar('!');
+    emu_putchar(0xa);
+    /* FIXME : TODO : pas de load_bitstream simule, on reste dans le moniteur */
+    break;
+  case '%':
+    emu_putstring("RESET\n");
+    robot_write(R_ROBOT_RESET, 1);
+    robot_write(R_ROBOT_RESET, 0);
+    break;
+  case 'T':
+    /* pas de boucle de controle simulee : compteurs a 0 */
+    emu_putstring("LOOP count: ");
+    emu_printhex(0);
+    emu_putstring(" overruns: ");
+    emu_printhex(0);
+    emu_putchar(0xa);
+    emu_putstring(" exec min/mean/max: ");
+    emu_printhex(0xffffffff);
+    emu_putchar(' ');
+    emu_printhex(0);
+    emu_putchar(' ');
+    emu_printhex(0);
+    emu_putchar(0xa);
+    emu_putstring(" slack min/mean: ");
+    emu_printhex(0x7fffffff);
+    emu_putchar(' ');
+    emu_printhex(0);
+    emu_putstring(" late max: ");
+    emu_printhex(0);
+    emu_putchar(0xa);
+    emu_putstring(" exec hist:\n");
+    emu_putstring(" slack hist:\n");
+    emu_putstring("BOOT main/unlock/tick (us): ");
+    emu_printhex(0);
+    emu_putchar(' ');
+    emu_printhex(0);
+    emu_putchar(' ');
+    emu_printhex(0);
+    emu_putstring(skip_pwd ? " rapide\n" : " mdp\n");
+    break;
+  case 't':
+    emu_putstring("LOOP RAZ\n");
+    break;
+  case 's':
+    send_snapshot();
+    break;
+  case 'M':
+    memblk_len = 0;
+    break;
+  case 'L':
+    emu_putstring("L\n");
+    bl_active = 1;
+    bl_state = 0;
+    bl_next = 0;
+    bl_nak_sent = 0;
+    bl_verified = 0;
+    bl_last_rx = emu_time_us();
+    break;
+  default:
+    stat_cmd--;
+    break;
+  }
+}
+
+/* taches periodiques de la boucle robot */
+void monitor_tick (void)
+{
+  if (bl_active) {
+    bl_tick();
+    return;
+  }
+  if ((pwd_state==5) && (snapshot_period!=0) &&
+      ((int)(robot_read(R_ROBOT_TIMER) - snapshot_next) >= 0)) {
+    send_snapshot();
+    snapshot_next += snapshot_period;
+  }
+}
+
+
+/*****************************************************************************/
+/* jeu de commandes "robot" (load_soft_uart) */
+
+void robot_cmd_word (unsigned int cmd)
+{
+  /* 0x0c00000X : phases du moteur pas a pas */
+  static const unsigned int seq[8] = {1, 5, 4, 6, 2, 0xa, 8, 9};
+  static int last_idx = 0;
+  int i;
+
+  if ((cmd & 0xfffffff0)==0x0c000000) {
+    for (i=0; i<8; i++)
+      if (seq[i]==(cmd & 0xf))
+        break;
+    if (i<8) {
+      if (i==((last_idx+1)&7)) stepper_pos++;
+      else if (i==((last_idx+7)&7)) stepper_pos--;
+      last_idx = i;
+    }
+  }
+}
+
+void robot_byte (unsigned char c)
+{
+  unsigned int val;
+  char buf[16];
+
+  switch (c) {
+  case 'w':
+    stat_cmd++;
+    val = robot_read(R_ROBOT_LASER_RAW);
+    sprintf(buf, "w%04x\n", val & 0xffff);
+    emu_putstring(buf);
+    return;
+  case '<':
+    stat_cmd++;
+    sprintf(buf, "<%04x%04x\n", robot_reg[R_ROBOT_RC_ODO_1_INC] & 0xffff,
+            robot_reg[R_ROBOT_RC_ODO_2_INC] & 0xffff);
+    emu_putstring(buf);
+    return;
+  case 'h':
+  case 'g':
+    stat_cmd++;
+    robot_active = (c=='g');
+    emu_putchar(c);
+    emu_putchar(0xa);
+    return;
+  case '>':
+    stat_cmd++;
+    emu_putchar(c);
+    emu_putchar(0xa);
+    robot_cmd[robot_cmd_len] = 0;
+    robot_cmd_word(strtoul(robot_cmd, NULL, 16));
+    robot_cmd_len = 0;
+    return;
+  default:
+    emu_putchar(c);
+    if (robot_cmd_len < (int)sizeof(robot_cmd)-1)
+      robot_cmd[robot_cmd_len++] = c;
+    return;
+  }
+}
+
+
+/*****************************************************************************/
+
+void print_stats (void)
+{
+  unsigned int t = emu_time_us();
+
+  fprintf(stderr, "leon_uart_emu: %.3f s, rx %lu bytes, tx %lu bytes, "
+          "%lu cmds (%.1f cmds/s)\n", t/1e6, stat_rx, stat_tx, stat_cmd,
+          (t>0) ? stat_cmd*1e6/t : 0.0);
+  if (stat_bl_frames)
+    fprintf(stderr, "leon_uart_emu: loader %lu frames, %lu naks\n",
+            stat_bl_frames, stat_bl_naks);
+}
+
+void sighandler (int sig)
+{
+  (void) sig;
+  print_stats();
+  if (link_name!=NULL)
+    unlink(link_name);
+  exit(0);
+}
+
+void usage (FILE *fp, int rc)
+{
+  fprintf(fp, "Usage: leon_uart_emu [-m monitor|robot] [-s baud] "
+          "[-e echo_latency_us] [-L link] [-d dist_mm] [-u] [-X baud] "
+          "[-E ppm] [-v]\n\n"
+          "\t-m\tprotocol (default monitor)\n"
+          "\t-s\toutput pacing baud rate, 0 = no pacing (default 115200)\n"
+          "\t-e\tlatency before each answer in us (default 0)\n"
+          "\t-L\tcreate a symlink to the pty slave\n"
+          "\t-d\tsimulated laser distance in mm (default 500)\n"
+          "\t-u\tstart unlocked (DIP_SW_0 set, skip the \"goldo\" sequence)\n"
+          "\t-X\tloader: highest working baud rate (default no limit)\n"
+          "\t-E\tloader: simulated line errors on rx, per million bytes\n"
+          "\t-v\tverbose\n");
+  exit(rc);
+}
+
+int main (int argc, char *argv[])
+{
+  struct termios tio;
+  struct sigaction sact;
+  struct timeval tv;
+  fd_set infds;
+  unsigned char buf[256];
+  char *slave;
+  int c, i, n;
+
+  while ((c = getopt(argc, argv, "?hm:s:e:L:d:uX:E:v")) > 0) {
+    switch (c) {
+    case 'm':
+      if (strcmp(optarg, "robot")==0) emu_mode = MODE_ROBOT;
+      else if (strcmp(optarg, "monitor")==0) emu_mode = MODE_MONITOR;
+      else usage(stderr, 1);
+      break;
+    case 's':
+      baud = atoi(optarg);
+      break;
+    case 'e':
+      echo_latency_us = atoi(optarg);
+      break;
+    case 'L':
+      link_name = optarg;
+      break;
+    case 'd':
+      sim_dist_mm = atof(optarg);
+      break;
+    case 'u':
+      skip_pwd = 1;
+      break;
+    case 'X':
+      bl_max_baud = atoi(optarg);
+      break;
+    case 'E':
+      bl_err_ppm = atoi(optarg);
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      usage((c=='h' || c=='?') ? stdout : stderr, (c=='h' || c=='?') ? 0 : 1);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  baud_init = baud;
+
+  mfd = posix_openpt(O_RDWR | O_NOCTTY);
+  if ((mfd < 0) || (grantpt(mfd) < 0) || (unlockpt(mfd) < 0)) {
+    fprintf(stderr, "ERROR: cannot open pty, errno=%d\n", errno);
+    return 1;
+  }
+  slave = ptsname(mfd);
+
+  /* pas de traitement de ligne cote esclave */
+  i = open(slave, O_RDWR | O_NOCTTY);
+  if (i >= 0) {
+    tcgetattr(i, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(i, TCSANOW, &tio);
+    close(i);
+  }
+
+  if (link_name!=NULL) {
+    unlink(link_name);
+    if (symlink(slave, link_name) < 0)
+      fprintf(stderr, "ERROR: cannot create link %s, errno=%d\n",
+              link_name, errno);
+  }
+  printf("leon_uart_emu: %s ready on %s%s%s (%u bauds, echo latency %u us)\n",
+         (emu_mode==MODE_ROBOT) ? "robot" : "monitor", slave,
+         (link_name!=NULL) ? " -> " : "", (link_name!=NULL) ? link_name : "",
+         baud, echo_latency_us);
+  fflush(stdout);
+
+  memset(&sact, 0, sizeof(sact));
+  sact.sa_handler = sighandler;
+  sigaction(SIGINT, &sact, NULL);
+  sigaction(SIGTERM, &sact, NULL);
+
+  if (skip_pwd) {
+    pwd_state = 5;
+    print_banner();
+  }
+
+  for (;;) {
+    FD_ZERO(&infds);
+    FD_SET(mfd, &infds);
+    tv.tv_sec = 0;
+    tv.tv_usec = 1000;
+    n = select(mfd+1, &infds, NULL, NULL, &tv);
+    if (n < 0) {
+      if (errno==EINTR) continue;
+      break;
+    }
+
+    if ((n > 0) && FD_ISSET(mfd, &infds)) {
+      n = read(mfd, buf, sizeof(buf));
+      if (n < 0) {
+        /* EIO : pas (encore) de client sur l'esclave */
+        usleep(10000);
+        continue;
+      }
+      for (i=0; i<n; i++) {
+        stat_rx++;
+        if (verbose)
+          fprintf(stderr, "rx %02x '%c'\n", buf[i],
+                  (buf[i]>=0x20 && buf[i]<0x7f) ? buf[i] : '.');
+        if (echo_latency_us)
+          usleep(echo_latency_us);
+        if (emu_mode==MODE_ROBOT)
+          robot_byte(buf[i]);
+        else
+          monitor_byte(buf[i]);
+      }
+    }
+
+    if (emu_mode==MODE_MONITOR)
+      monitor_tick();
+  }
+
+  print_stats();
+  if (link_name!=NULL)
+    unlink(link_name);
+  return 0;
+}
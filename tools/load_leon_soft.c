@@ -40,10 +40,8 @@ int i2c_write_word (unsigned int data)
   i2c_buf[2] = (data>>16) & 0xff;
   i2c_buf[3] = (data>>8) & 0xff;
   i2c_buf[4] = (data) & 0xff;
-  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
-    printf("I2C Write failed\n");
+  if (write(i2c_dev_file, i2c_buf, 5) != 5)
     return -1;
-  }
 
   return 0;
 }
@@ -55,6 +53,8 @@ char soft_hex_buf[SOFT_HEX_BUF_SZ];
 #define LEON_SOFT_WORD_SIZE 4096
 unsigned int leon_soft_buf[LEON_SOFT_WORD_SIZE];
 
+#define LOAD_MAX_RETRIES 100
+
 int main(int argc, char *argv[])
 {
   int soft_file;
@@ -63,6 +63,7 @@ int main(int argc, char *argv[])
   int i;
   char *pnext_token;
   int verbose=0;
+  int retry;
 
   if(argc<2) {
     printf("Usage: %s <leon_soft.hex>\n", argv[0]);
@@ -101,10 +102,17 @@ int main(int argc, char *argv[])
     pnext_token = strtok(NULL, "\n");
   }
 
+  /* l'esclave retient l'ACK (SCL etire) tant que le LEON n'a pas lu le mot
+     precedent, NACK au bout de 1 ms : on renvoie le mot */
   for (i=0; i<LEON_SOFT_WORD_SIZE; i++) {
     if (verbose)
       printf (" %6d: %.8x\n", i, leon_soft_buf[i]);
-    if (i2c_write_word (leon_soft_buf[i])) break;
+    for (retry=0; retry<LOAD_MAX_RETRIES; retry++)
+      if (i2c_write_word (leon_soft_buf[i])==0) break;
+    if (retry==LOAD_MAX_RETRIES) {
+      printf("I2C Write failed (word %d)\n", i);
+      break;
+    }
   }
 
   if(i2c_dev_file >= 0)
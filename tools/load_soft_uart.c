@@ -57,12 +57,33 @@
 unsigned int read_fpga_laser(void);
 void laser_conv_tab_init(void);
 unsigned int laser_conv_mm(unsigned int raw_laser);
+int laser_conv_load_profile(char *fname);
+int read_local_line(char *buf, int len);
+void laser_calib_record(void);
+int laser_calib_fit(char *fname);
+extern char *laser_profile;
+extern int laser_fit_deg;
+extern int laser_calib_n;
 void do_laser_scan(void);
 int inc_stepper (int n_steps, int activate_fpga);
 int go_stepper (int new_pos, int activate_fpga);
 void raz_pos_stepper (void);
+int go_stepper_hw (int new_pos, unsigned int period_us);
 void test_traj(void);
 unsigned int read_fpga_odo(int *odo_l, int *odo_r);
+typedef struct robot_snapshot {
+  unsigned char seq;
+  unsigned int timer;
+  int odo_1;
+  int odo_2;
+  int speed_1;
+  int speed_2;
+  unsigned int us_state; /* US_STATE_xxx de soft_boot/include/ultrasound.h */
+} robot_snapshot_t;
+
+int read_fpga_snapshot(robot_snapshot_t *snap);
+void print_fpga_snapshot(robot_snapshot_t *snap);
+void stream_fpga_snapshot(void);
 #endif
 
 
@@ -570,8 +591,38 @@ int loopit()
             raz_pos_stepper();
             break;
           case '5':
-            printf ("?? (FIXME : TODO)\n");
-            /* FIXME : TODO */
+            printf ("go_stepper()\n");
+            {
+              char line[16];
+              printf ("target position ? ");
+              fflush (stdout);
+              if (read_local_line(line, sizeof(line)) > 0)
+                printf ("  pos = %d\n", go_stepper(atoi(line), 0));
+            }
+            break;
+          case '6':
+            printf ("read_fpga_snapshot()\n");
+            {
+              robot_snapshot_t snap;
+              if (read_fpga_snapshot(&snap)==0)
+                print_fpga_snapshot(&snap);
+            }
+            break;
+          case '7':
+            printf ("stream_fpga_snapshot()\n");
+            stream_fpga_snapshot();
+            break;
+          case 'c':
+            printf ("laser_calib_record()\n");
+            laser_calib_record();
+            break;
+          case 'f':
+            printf ("laser_calib_fit()\n");
+            laser_calib_fit((laser_profile!=NULL)?laser_profile:"laser_profile.txt");
+            break;
+          case 'z':
+            printf ("laser calib samples cleared\n");
+            laser_calib_n = 0;
             break;
           case '?':
             printf ("\n");
@@ -580,7 +631,12 @@ int loopit()
             printf ("  2 : inc_stepper(1,1)\n");
             printf ("  3 : inc_stepper(-1,1)\n");
             printf ("  4 : raz_pos_stepper()\n");
-            printf ("  5 : ?? ()\n");
+            printf ("  5 : go_stepper()\n");
+            printf ("  6 : read_fpga_snapshot()\n");
+            printf ("  7 : stream_fpga_snapshot()\n");
+            printf ("  c : laser calib : record samples at a reference distance\n");
+            printf ("  f : laser calib : fit and write profile\n");
+            printf ("  z : laser calib : clear samples\n");
             printf ("  s : send script\n");
             printf ("  t : test_traj()\n");
             printf ("  q : quit\n");
@@ -682,7 +738,7 @@ int opensoc(void)
 void usage(FILE *fp, int rc)
 {
 	fprintf(fp, "Usage: tip [-?heonxrwcqt125678] [-s speed] [-w file] "
-		"[-p tcpport] [-l device] [device]\n\n"
+		"[-p tcpport] [-l device] [-L profile] [-F deg] [device]\n\n"
 		"\t-h?\tthis help\n"
 		"\t-q\tquiet mode (no helpful messages)\n"
 		"\t-1\t1 stop bits (default)\n"
@@ -703,7 +759,9 @@ void usage(FILE *fp, int rc)
 		"\t-w\tcapture remote output to local file\n"
 		"\t-p\tbind to tcpport instead of using stdin/stdout\n"
 		"\t-l\tdevice to use\n"
-		"\t-d\tdownload file name\n");
+		"\t-d\tdownload file name\n"
+		"\t-L\tlaser calibration profile (loaded at startup, written by $f)\n"
+		"\t-F\tlaser calibration fit degree (0 = piecewise-linear)\n");
 	exit(rc);
 }
 
@@ -724,7 +782,7 @@ int main(int argc, char *argv[])
 	ofd = 1;
 	gotdevice = 0;
 
-	while ((c = getopt(argc, argv, "?heonxrcqtf125678w:s:p:l:d:")) > 0) {
+	while ((c = getopt(argc, argv, "?heonxrcqtf125678w:s:p:l:d:L:F:")) > 0) {
 		switch (c) {
 		case 'v':
 			printf("%s: version %s\n", argv[0], version);
@@ -796,6 +854,18 @@ int main(int argc, char *argv[])
 		case 'd':
 			filename = optarg;
 			break;
+		case 'L':
+			laser_profile = optarg;
+			break;
+		case 'F':
+			laser_fit_deg = atoi(optarg);
+			if ((laser_fit_deg < 0) || (laser_fit_deg > 3)) {
+				fprintf(stderr,
+					"ERROR: laser fit degree %d (0..3)\n",
+					laser_fit_deg);
+				exit(1);
+			}
+			break;
 		case 'h':
 		case '?':
 			usage(stdout, 0);
@@ -807,6 +877,15 @@ int main(int argc, char *argv[])
 		}
 	}
 
+#if 1 /* FIXME : DEBUG */
+	if (laser_profile != NULL) {
+		struct stat st;
+		/* profil absent : il sera cree par la calibration ($f) */
+		if (stat(laser_profile, &st) == 0)
+			laser_conv_load_profile(laser_profile);
+	}
+#endif
+
 	if ((optind < argc) && (gotdevice == 0)) {
 		gotdevice++;
 		devname = argv[optind++];
@@ -1103,6 +1182,17 @@ struct laser_calib LC[] = {
 };
 #endif
 
+/* table de conversion courante : LC[] compile par defaut, ou profil charge
+   depuis un fichier (-L) ou issu d'une calibration ('$c' puis '$f') */
+laser_calib_t *LCP = LC;
+int LC_n = sizeof(LC)/sizeof(struct laser_calib);
+
+/* modele polynomial (si laser_poly_deg>0) : d = sum(a[k]*(raw/scale)^k) */
+#define LASER_POLY_MAX_DEG 3
+int laser_poly_deg = 0;
+double laser_poly_scale = 1.0;
+double laser_poly_a[LASER_POLY_MAX_DEG+1];
+
 void laser_conv_tab_init(void)
 {
   int i,n;
@@ -1115,20 +1205,458 @@ void laser_conv_tab_init(void)
   LC[n-1].c = (LC[n-1].d0-LC[1].d0)/(LC[n-1].l0-LC[1].l0);
 }
 
-unsigned int laser_conv_mm(unsigned int raw_laser)
+double laser_conv_model(double raw_laser)
 {
   int i,n;
+  double x, d;
+
+  if (laser_poly_deg>0) {
+    x = raw_laser/laser_poly_scale;
+    d = 0.0;
+    for (i=laser_poly_deg; i>=0; i--)
+      d = d*x + laser_poly_a[i];
+    return d;
+  }
 
-  n = sizeof(LC)/sizeof(struct laser_calib);
+  n = LC_n;
+
+  for (i=1; i<n-1; i++) {
+    if ((raw_laser>=LCP[i].l0) && (raw_laser<LCP[i+1].l0))
+      return (LCP[i].d0 + (raw_laser-LCP[i].l0)*LCP[i].c);
+  }
+
+  return (LCP[1].d0 + (raw_laser-LCP[1].l0)*LCP[n-1].c);
+}
 
+unsigned int laser_conv_mm(unsigned int raw_laser)
+{
   if (raw_laser==0) return 0.0;
 
-  for (i=1; i<n-1; i++) {
-    if ((raw_laser>=LC[i].l0) && (raw_laser<LC[i+1].l0))
-      return (LC[i].d0 + (raw_laser-LC[i].l0)*LC[i].c);
+  return laser_conv_model(raw_laser);
+}
+
+
+/* Profil de calibration laser (fichier texte) :
+ *   # commentaire
+ *   pwl <n>
+ *   <l0> <d0> <c>        (n lignes, meme convention que LC[])
+ * ou :
+ *   poly <deg> <scale>
+ *   <a0> <a1> .. <adeg>
+ */
+char *laser_profile = NULL;
+
+int laser_conv_load_profile(char *fname)
+{
+  FILE *f;
+  char line[256];
+  char kind[16];
+  int i, n, deg;
+  double scale;
+  laser_calib_t *tab = NULL;
+
+  f = fopen(fname, "r");
+  if (f==NULL) {
+    printf ("ERROR: cannot open laser profile %s\n", fname);
+    return -1;
+  }
+
+  n = -1;
+  while (fgets(line, sizeof(line), f)!=NULL) {
+    if ((line[0]=='#') || (line[0]=='\n'))
+      continue;
+    if (sscanf(line, "%15s", kind)!=1)
+      continue;
+    if (strcmp(kind, "pwl")==0) {
+      if ((sscanf(line, "%*s %d", &n)!=1) || (n<3))
+        goto bad_profile;
+      tab = calloc(n, sizeof(laser_calib_t));
+      if (tab==NULL)
+        goto bad_profile;
+      for (i=0; i<n; ) {
+        if (fgets(line, sizeof(line), f)==NULL)
+          goto bad_profile;
+        if ((line[0]=='#') || (line[0]=='\n'))
+          continue;
+        if (sscanf(line, "%x %lf %lf", &tab[i].l0, &tab[i].d0, &tab[i].c)!=3)
+          goto bad_profile;
+        i++;
+      }
+      if (LCP!=LC)
+        free(LCP);
+      LCP = tab;
+      LC_n = n;
+      laser_poly_deg = 0;
+      break;
+    } else if (strcmp(kind, "poly")==0) {
+      if ((sscanf(line, "%*s %d %lf", &deg, &scale)!=2) ||
+          (deg<1) || (deg>LASER_POLY_MAX_DEG) || (scale<=0.0))
+        goto bad_profile;
+      do {
+        if (fgets(line, sizeof(line), f)==NULL)
+          goto bad_profile;
+      } while ((line[0]=='#') || (line[0]=='\n'));
+      if (sscanf(line, "%lf %lf %lf %lf", &laser_poly_a[0], &laser_poly_a[1],
+                 &laser_poly_a[2], &laser_poly_a[3])<deg+1)
+        goto bad_profile;
+      laser_poly_scale = scale;
+      laser_poly_deg = deg;
+      n = deg+1;
+      break;
+    } else {
+      goto bad_profile;
+    }
+  }
+
+  fclose(f);
+  if (n<0) {
+    printf ("ERROR: empty laser profile %s\n", fname);
+    return -1;
+  }
+  printf ("laser profile %s loaded (%s)\n", fname,
+          (laser_poly_deg>0)?"poly":"pwl");
+  return 0;
+
+bad_profile:
+  printf ("ERROR: bad laser profile %s\n", fname);
+  if (tab!=NULL)
+    free(tab);
+  fclose(f);
+  return -1;
+}
+
+
+/* Calibration : on enregistre LASER_CALIB_N_READ mesures brutes par distance
+ * de reference ('$c'), puis on ajuste le modele par moindres carres ('$f').
+ * Les points aberrants sont rejetes par distance de reference
+ * (|raw - mediane| > LASER_CALIB_K_MAD * 1.4826 * MAD).
+ */
+#define LASER_CALIB_MAX_SAMPLES 2048
+#define LASER_CALIB_MAX_REF     32
+#define LASER_CALIB_N_READ      32
+#define LASER_CALIB_K_MAD       3.0
+
+typedef struct laser_calib_sample {
+  double d;
+  unsigned int raw;
+  int inlier;
+} laser_calib_sample_t;
+
+laser_calib_sample_t laser_calib_samples[LASER_CALIB_MAX_SAMPLES];
+int laser_calib_n = 0;
+
+/* degre du polynome pour l'ajustement (-F), 0 : lineaire par morceaux */
+int laser_fit_deg = 0;
+
+static int cmp_uint(const void *a, const void *b)
+{
+  unsigned int ua = *(const unsigned int *)a;
+  unsigned int ub = *(const unsigned int *)b;
+  return (ua>ub) - (ua<ub);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+  return (da>db) - (da<db);
+}
+
+/* lecture d'une ligne sur le terminal local (en mode raw) */
+int read_local_line(char *buf, int len)
+{
+  int n = 0;
+  char ch;
+
+  while (n<len-1) {
+    if (read(ifd, &ch, 1)!=1)
+      break;
+    if ((ch=='\r') || (ch=='\n'))
+      break;
+    if (((ch==0x7f) || (ch==0x08)) && (n>0)) {
+      n--;
+      write(ofd, "\b \b", 3);
+      continue;
+    }
+    buf[n++] = ch;
+    write(ofd, &ch, 1);
+  }
+  buf[n] = 0;
+  write(ofd, "\r\n", 2);
+  return n;
+}
+
+void laser_calib_record(void)
+{
+  char line[32];
+  double d;
+  unsigned int raw;
+  int i, nok;
+
+  printf ("reference distance (mm) ? ");
+  fflush (stdout);
+  if (read_local_line(line, sizeof(line))==0)
+    return;
+  d = strtod(line, NULL);
+  if (d<=0.0) {
+    printf ("  bad distance\n");
+    return;
+  }
+
+  nok = 0;
+  for (i=0; i<LASER_CALIB_N_READ; i++) {
+    if (laser_calib_n>=LASER_CALIB_MAX_SAMPLES) {
+      printf ("  sample buffer full\n");
+      break;
+    }
+    raw = read_fpga_laser();
+    /* 0 : pas d'echo ou erreur de lecture */
+    if (raw==0)
+      continue;
+    laser_calib_samples[laser_calib_n].d = d;
+    laser_calib_samples[laser_calib_n].raw = raw;
+    laser_calib_samples[laser_calib_n].inlier = 1;
+    laser_calib_n++;
+    nok++;
+  }
+  printf ("  %d samples @ %.1f mm (total %d)\n", nok, d, laser_calib_n);
+}
+
+/* regroupe les echantillons par distance de reference (triees) et marque
+   les points aberrants ; renvoie le nombre de references */
+static int laser_calib_group(double *ref_d, double *ref_raw)
+{
+  static unsigned int raws[LASER_CALIB_MAX_SAMPLES];
+  static double devs[LASER_CALIB_MAX_SAMPLES];
+  int i, j, k, n_ref, m, nrej;
+  double med, mad;
+
+  n_ref = 0;
+  for (i=0; i<laser_calib_n; i++) {
+    for (k=0; k<n_ref; k++)
+      if (ref_d[k]==laser_calib_samples[i].d)
+        break;
+    if ((k==n_ref) && (n_ref<LASER_CALIB_MAX_REF))
+      ref_d[n_ref++] = laser_calib_samples[i].d;
+  }
+  qsort(ref_d, n_ref, sizeof(double), cmp_double);
+
+  for (k=0; k<n_ref; k++) {
+    m = 0;
+    for (i=0; i<laser_calib_n; i++)
+      if (laser_calib_samples[i].d==ref_d[k])
+        raws[m++] = laser_calib_samples[i].raw;
+    qsort(raws, m, sizeof(unsigned int), cmp_uint);
+    med = (m&1) ? raws[m/2] : 0.5*(raws[m/2-1]+raws[m/2]);
+    for (j=0; j<m; j++)
+      devs[j] = (raws[j]>med) ? (raws[j]-med) : (med-raws[j]);
+    qsort(devs, m, sizeof(double), cmp_double);
+    mad = (m&1) ? devs[m/2] : 0.5*(devs[m/2-1]+devs[m/2]);
+    /* pas de dispersion : on garde au moins les points egaux a la mediane */
+    if (mad<0.5)
+      mad = 0.5;
+
+    nrej = 0;
+    for (i=0; i<laser_calib_n; i++) {
+      if (laser_calib_samples[i].d!=ref_d[k])
+        continue;
+      devs[0] = laser_calib_samples[i].raw - med;
+      if (devs[0]<0.0) devs[0] = -devs[0];
+      laser_calib_samples[i].inlier =
+        (devs[0] <= LASER_CALIB_K_MAD*1.4826*mad);
+      if (!laser_calib_samples[i].inlier)
+        nrej++;
+    }
+    ref_raw[k] = med;
+    printf ("  ref %7.1f mm : raw median 0x%04x, %d samples, %d rejected\n",
+            ref_d[k], (unsigned int)med, m, nrej);
+  }
+
+  return n_ref;
+}
+
+/* moindres carres d = a + b*raw sur les points retenus dans [d_min,d_max] */
+static int laser_calib_fit_line(double d_min, double d_max,
+                                double *a, double *b)
+{
+  int i, n;
+  double sx, sy, sxx, sxy, x, y, det;
+
+  n = 0;
+  sx = sy = sxx = sxy = 0.0;
+  for (i=0; i<laser_calib_n; i++) {
+    if (!laser_calib_samples[i].inlier) continue;
+    y = laser_calib_samples[i].d;
+    if ((y<d_min) || (y>d_max)) continue;
+    x = laser_calib_samples[i].raw;
+    sx += x; sy += y; sxx += x*x; sxy += x*y;
+    n++;
+  }
+  det = n*sxx - sx*sx;
+  if ((n<2) || (det==0.0))
+    return -1;
+  *b = (n*sxy - sx*sy)/det;
+  *a = (sy - (*b)*sx)/n;
+  return 0;
+}
+
+/* moindres carres polynomial (equations normales, pivot de Gauss) */
+static int laser_calib_fit_poly(int deg, double scale, double *coef)
+{
+  double M[LASER_POLY_MAX_DEG+1][LASER_POLY_MAX_DEG+2];
+  double xp[2*LASER_POLY_MAX_DEG+1];
+  double x, y, t;
+  int i, j, k, r, n;
+
+  n = deg+1;
+  memset(M, 0, sizeof(M));
+  for (i=0; i<laser_calib_n; i++) {
+    if (!laser_calib_samples[i].inlier) continue;
+    x = laser_calib_samples[i].raw/scale;
+    y = laser_calib_samples[i].d;
+    xp[0] = 1.0;
+    for (k=1; k<=2*deg; k++)
+      xp[k] = xp[k-1]*x;
+    for (j=0; j<n; j++) {
+      for (k=0; k<n; k++)
+        M[j][k] += xp[j+k];
+      M[j][n] += xp[j]*y;
+    }
+  }
+
+  for (j=0; j<n; j++) {
+    r = j;
+    for (k=j+1; k<n; k++)
+      if (((M[k][j]<0)?-M[k][j]:M[k][j]) > ((M[r][j]<0)?-M[r][j]:M[r][j]))
+        r = k;
+    if (M[r][j]==0.0)
+      return -1;
+    for (k=0; k<=n; k++) {
+      t = M[j][k]; M[j][k] = M[r][k]; M[r][k] = t;
+    }
+    for (i=0; i<n; i++) {
+      if (i==j) continue;
+      t = M[i][j]/M[j][j];
+      for (k=j; k<=n; k++)
+        M[i][k] -= t*M[j][k];
+    }
+  }
+  for (j=0; j<n; j++)
+    coef[j] = M[j][n]/M[j][j];
+  return 0;
+}
+
+/* erreur residuelle (moyenne et max en mm) du modele courant par segment */
+static void laser_calib_report(double *ref_d, int n_ref)
+{
+  int i, k, n;
+  double e, e_sum, e_max;
+
+  printf ("  residuals :\n");
+  for (k=0; k<n_ref-1; k++) {
+    n = 0;
+    e_sum = e_max = 0.0;
+    for (i=0; i<laser_calib_n; i++) {
+      if (!laser_calib_samples[i].inlier) continue;
+      if ((laser_calib_samples[i].d<ref_d[k]) ||
+          (laser_calib_samples[i].d>ref_d[k+1])) continue;
+      e = laser_conv_model(laser_calib_samples[i].raw) -
+        laser_calib_samples[i].d;
+      if (e<0.0) e = -e;
+      e_sum += e;
+      if (e>e_max) e_max = e;
+      n++;
+    }
+    printf ("    [%7.1f,%7.1f] mm : n=%4d mean=%6.2f mm max=%6.2f mm\n",
+            ref_d[k], ref_d[k+1], n, (n>0)?(e_sum/n):0.0, e_max);
+  }
+}
+
+int laser_calib_fit(char *fname)
+{
+  double ref_d[LASER_CALIB_MAX_REF];
+  double ref_raw[LASER_CALIB_MAX_REF];
+  double coef[LASER_POLY_MAX_DEG+1];
+  double a, b, ga, gb, scale;
+  laser_calib_t *tab;
+  int k, n_ref;
+  FILE *f;
+
+  n_ref = laser_calib_group(ref_d, ref_raw);
+  if (n_ref<2) {
+    printf ("ERROR: need at least 2 reference distances\n");
+    return -1;
+  }
+
+  if (laser_fit_deg>0) {
+    if (n_ref<=laser_fit_deg) {
+      printf ("ERROR: need at least %d reference distances\n",
+              laser_fit_deg+1);
+      return -1;
+    }
+    scale = ref_raw[n_ref-1];
+    if (scale<1.0) scale = 1.0;
+    if (laser_calib_fit_poly(laser_fit_deg, scale, coef)!=0) {
+      printf ("ERROR: singular polynomial fit\n");
+      return -1;
+    }
+    for (k=0; k<=laser_fit_deg; k++)
+      laser_poly_a[k] = coef[k];
+    laser_poly_scale = scale;
+    laser_poly_deg = laser_fit_deg;
+  } else {
+    /* LC[] : [0] inutilise, [1..n_ref] un noeud par reference, la pente
+       du dernier noeud est la pente globale (extrapolation) */
+    if (laser_calib_fit_line(ref_d[0], ref_d[n_ref-1], &ga, &gb)!=0) {
+      printf ("ERROR: singular linear fit\n");
+      return -1;
+    }
+    tab = calloc(n_ref+1, sizeof(laser_calib_t));
+    if (tab==NULL)
+      return -1;
+    for (k=0; k<n_ref-1; k++) {
+      if (laser_calib_fit_line(ref_d[k], ref_d[k+1], &a, &b)!=0) {
+        a = ga; b = gb;
+      }
+      tab[k+1].l0 = ref_raw[k];
+      tab[k+1].d0 = a + b*tab[k+1].l0;
+      tab[k+1].c  = b;
+      if (k==n_ref-2) {
+        tab[k+2].l0 = ref_raw[k+1];
+        tab[k+2].d0 = a + b*tab[k+2].l0;
+      }
+    }
+    tab[n_ref].c = gb;
+    if (LCP!=LC)
+      free(LCP);
+    LCP = tab;
+    LC_n = n_ref+1;
+    laser_poly_deg = 0;
   }
 
-  return (LC[1].d0 + (raw_laser-LC[1].l0)*LC[n-1].c);
+  laser_calib_report(ref_d, n_ref);
+
+  f = fopen(fname, "w");
+  if (f==NULL) {
+    printf ("ERROR: cannot write laser profile %s\n", fname);
+    return -1;
+  }
+  fprintf (f, "# laser profile : %d samples, %d references\n",
+           laser_calib_n, n_ref);
+  if (laser_poly_deg>0) {
+    fprintf (f, "poly %d %.6f\n", laser_poly_deg, laser_poly_scale);
+    for (k=0; k<=laser_poly_deg; k++)
+      fprintf (f, "%.9e ", laser_poly_a[k]);
+    fprintf (f, "\n");
+  } else {
+    fprintf (f, "pwl %d\n", LC_n);
+    for (k=0; k<LC_n; k++)
+      fprintf (f, "0x%04x %10.3f %12.8f\n", LCP[k].l0, LCP[k].d0, LCP[k].c);
+  }
+  fclose(f);
+  printf ("  laser profile written to %s\n", fname);
+
+  return 0;
 }
 
 
@@ -1168,6 +1696,25 @@ struct mirror_calib MC[] = {
 /* FIXME : TODO : necessary? */
 #endif
 
+/* stepper en mode position dans le FPGA (stepper_pololu.vhd) : on ecrit la
+   cible et la periode dans les registres robot via le moniteur soft_boot, la
+   rampe et la sequence de phases sont generees par le materiel */
+#define STEPPER_HW 1
+
+#define A_ROBOT_STEPPER_CS      0x80008010
+#define A_ROBOT_STEPPER_TARGET  0x80008014
+#define A_ROBOT_STEPPER_PERIOD  0x80008018
+#define A_ROBOT_STEPPER_ACCEL   0x8000801c
+
+#define STEPPER_CTRL_ENABLE     0x00000001
+#define STEPPER_CTRL_RAZ        0x00000002
+#define STEPPER_STATUS_DONE     0x80000000
+
+#define STEPPER_HW_PERIOD       1000 /* us */
+#define STEPPER_HW_START_PERIOD 4000 /* us */
+#define STEPPER_HW_ACCEL        50   /* us/pas */
+#define STEPPER_HW_TIMEOUT      5000 /* ms */
+
 #define STEPPER_STATE_0001  0x0c000001
 #define STEPPER_STATE_0101  0x0c000005
 #define STEPPER_STATE_0100  0x0c000004
@@ -1180,13 +1727,123 @@ struct mirror_calib MC[] = {
 static int stepper_pos = 0;
 static int stepper_state = STEPPER_STATE_0001;
 
+/* lecture d'une ligne du moniteur (timeout en ms) */
+int read_fpga_line(char *buf, int len, int timeout_ms)
+{
+  fd_set infds;
+  struct timeval tv;
+  int n = 0;
+  char ch;
+
+  while (n<len-1) {
+    FD_ZERO(&infds);
+    FD_SET(rfd, &infds);
+    tv.tv_sec = timeout_ms/1000;
+    tv.tv_usec = (timeout_ms%1000)*1000;
+    if (select(rfd+1, &infds, NULL, NULL, &tv) <= 0)
+      return -1;
+    if (read(rfd, &ch, 1)!=1)
+      continue;
+    if (ch=='\n')
+      break;
+    buf[n++] = ch;
+  }
+  buf[n] = 0;
+  return n;
+}
+
+/* envoi d'une commande moniteur, et lecture des n_lines lignes de reponse */
+int fpga_mon_cmd(char *cmd, int n_lines, char *last_line, int len)
+{
+  char line[128];
+  int i;
+
+  for (i=0; cmd[i]!=0; i++) {
+    write(rfd, &cmd[i], 1);
+    usleep(200);
+  }
+  for (i=0; i<n_lines; i++) {
+    if (read_fpga_line(line, sizeof(line), 100) < 0)
+      return -1;
+  }
+  if (last_line!=NULL) {
+    snprintf(last_line, len, "%s", line);
+  }
+  return 0;
+}
+
+int write_fpga_reg(unsigned int addr, unsigned int val)
+{
+  char cmd_buf[16];
+
+  sprintf (cmd_buf, "@%08x>", addr);
+  if (fpga_mon_cmd(cmd_buf, 2, NULL, 0) < 0)
+    return -1;
+  sprintf (cmd_buf, "$%08x>", val);
+  if (fpga_mon_cmd(cmd_buf, 2, NULL, 0) < 0)
+    return -1;
+  return fpga_mon_cmd("W", 1, NULL, 0);
+}
+
+int read_fpga_reg(unsigned int addr, unsigned int *val)
+{
+  char cmd_buf[16];
+  char line[64];
+  unsigned int r_addr;
+
+  sprintf (cmd_buf, "@%08x>", addr);
+  if (fpga_mon_cmd(cmd_buf, 2, NULL, 0) < 0)
+    return -1;
+  if (fpga_mon_cmd("R", 1, line, sizeof(line)) < 0)
+    return -1;
+  if (sscanf(line, "@0x%x : 0x%x", &r_addr, val)!=2)
+    return -1;
+  return 0;
+}
+
+/* deplacement en mode position : le FPGA genere les pas et la rampe */
+int go_stepper_hw (int new_pos, unsigned int period_us)
+{
+  unsigned int status;
+  int elapsed_ms;
+
+  write_fpga_reg(A_ROBOT_STEPPER_PERIOD,
+                 (STEPPER_HW_START_PERIOD<<16) | (period_us & 0xffff));
+  write_fpga_reg(A_ROBOT_STEPPER_ACCEL, STEPPER_HW_ACCEL);
+  write_fpga_reg(A_ROBOT_STEPPER_TARGET, new_pos & 0xffff);
+  write_fpga_reg(A_ROBOT_STEPPER_CS, STEPPER_CTRL_ENABLE);
+
+  for (elapsed_ms=0; elapsed_ms<STEPPER_HW_TIMEOUT; elapsed_ms+=2) {
+    if (read_fpga_reg(A_ROBOT_STEPPER_CS, &status) < 0)
+      break;
+    stepper_pos = (short)(status & 0xffff);
+    if (status & STEPPER_STATUS_DONE)
+      return stepper_pos;
+    usleep(2000);
+  }
+
+  printf ("go_stepper_hw(%d) : timeout (pos=%d)\n", new_pos, stepper_pos);
+  return stepper_pos;
+}
+
 void raz_pos_stepper (void)
 {
   stepper_pos = 0;
+#if defined(STEPPER_HW)
+  write_fpga_reg(A_ROBOT_STEPPER_TARGET, 0);
+  write_fpga_reg(A_ROBOT_STEPPER_CS, STEPPER_CTRL_RAZ);
+  write_fpga_reg(A_ROBOT_STEPPER_CS, STEPPER_CTRL_ENABLE);
+#endif
 }
 
 int inc_stepper (int n_steps, int activate_fpga)
 {
+#if defined(STEPPER_HW)
+  /* les registres stepper sont ecrits via le moniteur : pas de bascule
+     "h"/"g" du FPGA, activate_fpga est sans objet ici */
+  (void) activate_fpga;
+  return go_stepper_hw (stepper_pos+n_steps, STEPPER_HW_PERIOD);
+#else
   char cmd_buf[16];
   int i;
   int abs_n_steps;
@@ -1248,6 +1905,7 @@ int inc_stepper (int n_steps, int activate_fpga)
   }
 
   return stepper_pos;
+#endif
 }
 
 int go_stepper (int new_pos, int activate_fpga)
@@ -1353,6 +2011,140 @@ unsigned int read_fpga_odo(int *odo_l, int *odo_r)
   return 1;
 }
 
+/* snapshot capteurs (commande 's' du moniteur soft_boot) : une seule trame
+   binaire, toutes les valeurs figees au meme cycle cote FPGA */
+#define SNAPSHOT_SYNC0     0xa5
+#define SNAPSHOT_SYNC1     0x5a
+#define SNAPSHOT_NWORDS    6 /* comme soft_boot/main.c */
+#define SNAPSHOT_FRAME_SZ  (4+4*SNAPSHOT_NWORDS+1)
+
+static int read_fpga_byte(unsigned char *b, int timeout_ms)
+{
+  fd_set infds;
+  struct timeval tv;
+
+  for (;;) {
+    FD_ZERO(&infds);
+    FD_SET(rfd, &infds);
+    tv.tv_sec = timeout_ms/1000;
+    tv.tv_usec = (timeout_ms%1000)*1000;
+    if (select(rfd+1, &infds, NULL, NULL, &tv) <= 0)
+      return -1;
+    if (read(rfd, b, 1)==1)
+      return 0;
+  }
+}
+
+/* recherche de la synchro puis decodage d'une trame (sans envoi de 's') */
+int recv_fpga_snapshot(robot_snapshot_t *snap, int timeout_ms)
+{
+  unsigned char frame[SNAPSHOT_FRAME_SZ];
+  unsigned char csum;
+  unsigned int w[SNAPSHOT_NWORDS];
+  int i;
+
+  frame[1] = 0;
+  do {
+    frame[0] = frame[1];
+    if (read_fpga_byte(&frame[1], timeout_ms) < 0)
+      return -1;
+  } while ((frame[0]!=SNAPSHOT_SYNC0) || (frame[1]!=SNAPSHOT_SYNC1));
+
+  for (i=2; i<SNAPSHOT_FRAME_SZ; i++)
+    if (read_fpga_byte(&frame[i], timeout_ms) < 0)
+      return -1;
+
+  if (frame[2]!=4*SNAPSHOT_NWORDS)
+    return -1;
+  csum = 0;
+  for (i=2; i<SNAPSHOT_FRAME_SZ-1; i++)
+    csum += frame[i];
+  if (csum!=frame[SNAPSHOT_FRAME_SZ-1]) {
+    printf ("snapshot : bad checksum\n");
+    return -1;
+  }
+
+  for (i=0; i<SNAPSHOT_NWORDS; i++)
+    w[i] = (frame[4+4*i]<<24) | (frame[5+4*i]<<16) |
+      (frame[6+4*i]<<8) | frame[7+4*i];
+
+  snap->seq     = frame[3];
+  snap->timer   = w[0];
+  snap->odo_1   = w[1];
+  snap->odo_2   = w[2];
+  snap->speed_1 = w[3];
+  snap->speed_2 = w[4];
+  snap->us_state = w[5];
+  return 0;
+}
+
+int read_fpga_snapshot(robot_snapshot_t *snap)
+{
+  int rc;
+
+  rc = write(rfd, "s", 1);
+  if (rc <= 0)
+    return -1;
+
+  return recv_fpga_snapshot(snap, 100);
+}
+
+void print_fpga_snapshot(robot_snapshot_t *snap)
+{
+  printf ("#%3d t=%10u odo=(%d,%d) speed=(%d,%d) "
+          "us: obst=%x perime=%x\n",
+          snap->seq, snap->timer, snap->odo_1, snap->odo_2,
+          snap->speed_1, snap->speed_2,
+          snap->us_state & 0x7, (snap->us_state >> 8) & 0x7);
+}
+
+/* flux de snapshots ('S' du moniteur), jusqu'a l'appui sur une touche */
+void stream_fpga_snapshot(void)
+{
+  robot_snapshot_t snap;
+  char line[16];
+  char cmd_buf[16];
+  fd_set infds;
+  struct timeval tv;
+  int period_ms, n, lost;
+  unsigned char last_seq = 0;
+
+  printf ("period (ms) ? ");
+  fflush (stdout);
+  if (read_local_line(line, sizeof(line))==0)
+    return;
+  period_ms = atoi(line);
+  if (period_ms<=0)
+    return;
+
+  sprintf (cmd_buf, "S%d>", period_ms);
+  fpga_mon_cmd(cmd_buf, 2, NULL, 0);
+
+  n = lost = 0;
+  for (;;) {
+    FD_ZERO(&infds);
+    FD_SET(ifd, &infds);
+    tv.tv_sec = 0;
+    tv.tv_usec = 0;
+    if (select(ifd+1, &infds, NULL, NULL, &tv) > 0) {
+      read(ifd, line, 1);
+      break;
+    }
+    if (recv_fpga_snapshot(&snap, 2*period_ms+100) < 0)
+      continue;
+    if ((n>0) && (snap.seq!=(unsigned char)(last_seq+1)))
+      lost += (unsigned char)(snap.seq-last_seq-1);
+    last_seq = snap.seq;
+    n++;
+    print_fpga_snapshot(&snap);
+    if (cfd > 0)
+      write(cfd, &snap, sizeof(snap));
+  }
+
+  fpga_mon_cmd("S0>", 2, NULL, 0);
+  printf ("%d snapshots, %d lost\n", n, lost);
+}
+
 
 #define TEST_SPEED 4000000
 
@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "fxp.h"
+
+/* Test sur PC de soft_boot/math/fxp.c : erreur de chaque routine contre le
+   calcul en double (ou en entiers 128 bits), et bornes annoncees dans
+   fxp.h. Sur PC, ce sont les chemins C (#else de __sparc__) de
+   fxp_smul64/fxp_mul_q/fxp_div_q qui sont testes, pas l'assembleur v8.
+
+   gcc -Wall -O2 -I ../../soft_boot/include -o fxp_test fxp_test.c \
+       ../../soft_boot/math/fxp.c -lm
+
+   Code de retour 0 si toutes les bornes sont tenues. */
+
+#define SINCOS_MAX_ERR     3e-8   /* fxp_sincos_bam, en unites */
+#define SINCOS_RAD_MAX_ERR 1e-7   /* fxp_sincos, |rad| < 100 */
+#define ATAN2_MAX_LSB      1.0    /* fxp_atan2, lsb Q16.16 */
+#define SQRT_MAX_LSB       1.0    /* fxp_sqrt, lsb Q16.16 */
+
+#define N_RANDOM           1000000
+
+static int n_fail;
+
+/* tirage reproductible sur 32 bits */
+static unsigned int rnd_state = 12345;
+
+static unsigned int rnd32 (void)
+{
+  /* xorshift 32 bits */
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 17;
+  rnd_state ^= rnd_state << 5;
+  return rnd_state;
+}
+
+static void check (const char *name, double err, double max, const char *unit)
+{
+  printf ("%-14s max err = %.3g %s (borne %.3g)%s\n", name, err, unit, max,
+          (err < max) ? "" : "  ECHEC");
+  if (!(err < max))
+    n_fail++;
+}
+
+static void check_exact (const char *name, long n_bad, long n)
+{
+  printf ("%-14s %ld/%ld differences%s\n", name, n_bad, n,
+          (n_bad==0) ? "" : "  ECHEC");
+  if (n_bad)
+    n_fail++;
+}
+
+static void test_sincos_bam (void)
+{
+  double err, max_err = 0.0, a;
+  q1_30_t s, c;
+  unsigned long long bam;
+  long i;
+
+  /* balayage regulier (65537 points, tous les quadrants) puis aleatoire */
+  for (bam=0; bam<0x100000000ULL; bam+=0x10000) {
+    fxp_sincos_bam ((fxp_bam_t) bam, &s, &c);
+    a = (double) bam * (2.0*M_PI/4294967296.0);
+    err = fabs (s/1073741824.0 - sin(a));
+    if (err > max_err) max_err = err;
+    err = fabs (c/1073741824.0 - cos(a));
+    if (err > max_err) max_err = err;
+  }
+  for (i=0; i<N_RANDOM; i++) {
+    bam = rnd32 ();
+    fxp_sincos_bam ((fxp_bam_t) bam, &s, &c);
+    a = (double) bam * (2.0*M_PI/4294967296.0);
+    err = fabs (s/1073741824.0 - sin(a));
+    if (err > max_err) max_err = err;
+    err = fabs (c/1073741824.0 - cos(a));
+    if (err > max_err) max_err = err;
+  }
+  check ("sincos_bam", max_err, SINCOS_MAX_ERR, "");
+}
+
+static void test_sincos_rad (void)
+{
+  double err, max_err = 0.0, a;
+  q1_30_t s, c;
+  q16_16_t rad;
+  long i;
+
+  for (i=0; i<N_RANDOM; i++) {
+    rad = (q16_16_t) (rnd32 () % (2*100*65536)) - 100*65536;
+    fxp_sincos (rad, &s, &c);
+    a = rad/65536.0;
+    err = fabs (s/1073741824.0 - sin(a));
+    if (err > max_err) max_err = err;
+    err = fabs (c/1073741824.0 - cos(a));
+    if (err > max_err) max_err = err;
+    if ((s != fxp_sin (rad)) || (c != fxp_cos (rad)))
+      max_err = 1.0;
+  }
+  check ("sincos (rad)", max_err, SINCOS_RAD_MAX_ERR, "");
+}
+
+static void test_atan2 (void)
+{
+  double err, max_err = 0.0;
+  int32_t x, y;
+  int shift;
+  long i;
+
+  /* toutes les amplitudes, de quelques lsb a la pleine echelle */
+  for (i=0; i<N_RANDOM; i++) {
+    shift = rnd32 () % 31;
+    x = ((int32_t) rnd32 ()) >> shift;
+    y = ((int32_t) rnd32 ()) >> shift;
+    if ((x == 0) && (y == 0))
+      continue;
+    err = fabs (fxp_atan2 (y, x) - atan2 (y, x)*65536.0);
+    if (err > max_err) max_err = err;
+  }
+  /* axes et diagonales */
+  for (i=-1; i<=1; i++) {
+    for (shift=-1; shift<=1; shift++) {
+      if ((i == 0) && (shift == 0))
+        continue;
+      x = i*0x40000000; y = shift*0x40000000;
+      err = fabs (fxp_atan2 (y, x) - atan2 (y, x)*65536.0);
+      if (err > max_err) max_err = err;
+    }
+  }
+  if (fxp_atan2 (0, 0) != 0)
+    max_err = 1e9;
+  check ("atan2", max_err, ATAN2_MAX_LSB, "lsb");
+}
+
+static void test_sqrt (void)
+{
+  double err, max_err = 0.0;
+  q16_16_t x;
+  long i;
+
+  for (i=0; i<N_RANDOM; i++) {
+    x = (q16_16_t) (rnd32 () >> (1 + rnd32 () % 31));
+    err = fabs (fxp_sqrt (x) - sqrt (x/65536.0)*65536.0);
+    if (err > max_err) max_err = err;
+  }
+  if ((fxp_sqrt (0) != 0) || (fxp_sqrt (-Q16_16_ONE) != 0))
+    max_err = 1e9;
+  check ("sqrt", max_err, SQRT_MAX_LSB, "lsb");
+}
+
+/* quotient (a << q) / b tronque vers 0, sature, b = 0 sature au signe de a */
+static int32_t ref_div (int32_t a, int32_t b, int q)
+{
+  __int128 r;
+
+  if (b == 0)
+    return (a < 0) ? FXP_MIN : FXP_MAX;
+  r = ((__int128) a * ((__int128) 1 << q)) / b;
+  if (r > FXP_MAX) return FXP_MAX;
+  if (r < FXP_MIN) return FXP_MIN;
+  return (int32_t) r;
+}
+
+static void test_div (void)
+{
+  static const int qs[] = { 16, 30, 1, 31 };
+  int32_t a, b;
+  long i, n = 0, n_bad = 0;
+  int k;
+
+  for (k=0; k<4; k++) {
+    for (i=0; i<N_RANDOM/4; i++) {
+      a = ((int32_t) rnd32 ()) >> (rnd32 () % 32);
+      b = ((int32_t) rnd32 ()) >> (rnd32 () % 32);
+      if ((i & 0xff) == 0)
+        b = 0;
+      n++;
+      if (fxp_div_q (a, b, qs[k]) != ref_div (a, b, qs[k]))
+        n_bad++;
+    }
+  }
+  /* extremes */
+  n += 3;
+  if (fxp_div (FXP_MIN, -1) != FXP_MAX) n_bad++;
+  if (fxp_div (-1, 0) != FXP_MIN) n_bad++;
+  if (fxp_div (3*Q16_16_ONE, -2*Q16_16_ONE) != -(3*Q16_16_ONE/2)) n_bad++;
+  check_exact ("div", n_bad, n);
+}
+
+static void test_mul (void)
+{
+  static const int qs[] = { 16, 30, 28, 1 };
+  int32_t a, b, r;
+  int64_t a48, b48;
+  __int128 p;
+  long i, n = 0, n_bad = 0;
+  int k;
+
+  /* fxp_mul_q : produit arrondi au plus pres, 32 bits de poids faible */
+  for (k=0; k<4; k++) {
+    for (i=0; i<N_RANDOM/4; i++) {
+      a = (int32_t) rnd32 ();
+      b = ((int32_t) rnd32 ()) >> (rnd32 () % 32);
+      p = ((__int128) a * b + ((__int128) 1 << (qs[k]-1))) >> qs[k];
+      n++;
+      if (fxp_mul_q (a, b, qs[k]) != (int32_t) (uint32_t) p)
+        n_bad++;
+    }
+  }
+  /* fxp_smul64 / fxp_umul64 */
+  for (i=0; i<N_RANDOM/4; i++) {
+    a = (int32_t) rnd32 ();
+    b = (int32_t) rnd32 ();
+    n++;
+    if ((fxp_smul64 (a, b) != (int64_t) a * b) ||
+        (fxp_umul64 (a, b) != (uint64_t) (uint32_t) a * (uint32_t) b))
+      n_bad++;
+  }
+  check_exact ("mul_q/mul64", n_bad, n);
+
+  /* fxp_mul_q48 : bits 111..48 du produit signe 128 bits */
+  n = n_bad = 0;
+  for (i=0; i<N_RANDOM; i++) {
+    a48 = (int64_t) (((uint64_t) rnd32 () << 32) | rnd32 ()) >> (rnd32 () % 64);
+    b48 = (int64_t) (((uint64_t) rnd32 () << 32) | rnd32 ()) >> (rnd32 () % 64);
+    p = ((__int128) a48 * b48) >> 48;
+    n++;
+    if (fxp_mul_q48 (a48, b48) != (int64_t) p)
+      n_bad++;
+  }
+  check_exact ("mul_q48", n_bad, n);
+
+  /* additions saturees */
+  n = n_bad = 0;
+  for (i=0; i<N_RANDOM; i++) {
+    int64_t s, d;
+
+    a = (int32_t) rnd32 ();
+    b = (int32_t) rnd32 ();
+    s = (int64_t) a + b;
+    d = (int64_t) a - b;
+    if (s > FXP_MAX) s = FXP_MAX;
+    if (s < FXP_MIN) s = FXP_MIN;
+    if (d > FXP_MAX) d = FXP_MAX;
+    if (d < FXP_MIN) d = FXP_MIN;
+    r = fxp_add_sat (a, b);
+    n++;
+    if ((r != s) || (fxp_sub_sat (a, b) != d))
+      n_bad++;
+  }
+  check_exact ("add/sub_sat", n_bad, n);
+}
+
+int main (int argc, char **argv)
+{
+  test_sincos_bam ();
+  test_sincos_rad ();
+  test_atan2 ();
+  test_sqrt ();
+  test_div ();
+  test_mul ();
+
+  if (n_fail) {
+    printf ("%d ECHEC(S)\n", n_fail);
+    return 1;
+  }
+  printf ("OK\n");
+  return 0;
+}
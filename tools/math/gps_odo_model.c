@@ -0,0 +1,434 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/* Modele C bit a bit de robot_gps_odo.vhd (avec sin_cos_cheby.vhd et
+   mul_int64), et mesure de l'erreur de pose en fonction de la periode
+   d'integration (GPS_SAMPLING_T, robot_reg[0xd7]).
+
+   Trace de codeurs : une ligne "t_us compteur_gauche compteur_droit" par
+   echantillon (compteurs cumules, increments). Sans fichier, une
+   trajectoire de match est synthetisee (-w pour l'ecrire au meme format).
+   La reference est l'integration en double, en arcs de cercle, de chaque
+   echantillon de la trace : l'erreur ne vient que de la periode
+   d'integration et de la virgule fixe.
+
+   Usage : gps_odo_model [-f trace] [-w trace] [-m mm/increment]
+                         [-b voie_mm] [-c] */
+
+#define FXP_MULT (0x0001000000000000LL)
+
+#define CLOCK_HZ          25000000
+/* cycles d'une integration, de la lecture des compteurs a GPS_X/Y
+   (cf commentaires gps_ticks de la FSM) */
+#define GPS_FSM_CYCLES    46
+
+typedef long long int q15_48_t;
+
+/* bits 111..48 du produit signe 128 bits (mul_int64, tronque) */
+q15_48_t mul64_q48 (q15_48_t a, q15_48_t b)
+{
+  unsigned long long al = (unsigned int) a, ah = (unsigned long long) a >> 32;
+  unsigned long long bl = (unsigned int) b, bh = (unsigned long long) b >> 32;
+  unsigned long long p0, p1, p2, mid, hi;
+
+  p0 = al*bl;
+  p1 = ah*bl;
+  p2 = al*bh;
+  mid = (p0 >> 32) + (p1 & 0xffffffffULL) + (p2 & 0xffffffffULL);
+  hi = ah*bh + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+  if (a < 0) hi -= (unsigned long long) b;
+  if (b < 0) hi -= (unsigned long long) a;
+
+  return (q15_48_t) ((hi << 16) | ((mid & 0xffffffffULL) >> 16));
+}
+
+/* cheby_coeff_proc, indexe par clenshaw_iterator */
+const q15_48_t cheby_coeff[15] = {
+  0x0000000000000000LL, 0x00012236c458df17LL, 0x0000000000000000LL,
+  (q15_48_t) 0xffffdca753fb0eb2ULL, 0x0000000000000000LL,
+  0x000001264daed31bLL, 0x0000000000000000LL,
+  (q15_48_t) 0xfffffffb90293c00ULL, 0x0000000000000000LL,
+  0x0000000009e24ac5LL, 0x0000000000000000LL,
+  (q15_48_t) 0xfffffffffff1a9c4ULL, 0x0000000000000000LL,
+  0x0000000000000e9eLL, 0x0000000000000000LL
+};
+
+/* fsm_iterate_clenshaw_xxx + fsm_last_clenshaw_xxx */
+q15_48_t clenshaw_model (q15_48_t x)
+{
+  unsigned long long b_r1 = 0, b_r2 = 0, b_r, m;
+  int it;
+
+  for (it=14; it>0; it--) {
+    m = mul64_q48 (x, b_r1);
+    b_r = cheby_coeff[it] + m + m - b_r2;
+    b_r2 = b_r1;
+    b_r1 = b_r;
+  }
+  return (q15_48_t) (mul64_q48 (x, b_r1) - b_r2 + cheby_coeff[0]);
+}
+
+void sin_cos_cheby_model (q15_48_t angle, q15_48_t *s, q15_48_t *c)
+{
+  const unsigned long long mask50 = (1ULL << 50) - 1;
+  const unsigned long long m_pi2 = 1ULL << 48, m_pi = 2ULL << 48;
+  const unsigned long long m_3pi2 = 3ULL << 48, m_2pi = 0;
+  unsigned long long in_angle, x, x_cos;
+  int neg_sin, neg_cos;
+  q15_48_t r;
+
+  /* fsm_init_scale : division par pi/2 */
+  in_angle = mul64_q48 (angle, 0x0000a2f9836e4e44LL) & mask50;
+
+  /* fsm_init_normalize */
+  switch ((in_angle >> 48) & 3) {
+  case 0:
+    x = in_angle;           neg_sin = 0;
+    x_cos = m_pi2 - in_angle; neg_cos = 0;
+    break;
+  case 1:
+    x = m_pi - in_angle;    neg_sin = 0;
+    x_cos = in_angle - m_pi2; neg_cos = 1;
+    break;
+  case 2:
+    x = in_angle - m_pi;    neg_sin = 1;
+    x_cos = m_3pi2 - in_angle; neg_cos = 1;
+    break;
+  default:
+    x = m_2pi - in_angle;   neg_sin = 1;
+    x_cos = in_angle - m_3pi2; neg_cos = 0;
+    break;
+  }
+  x &= mask50;
+  x_cos &= mask50;
+
+  r = clenshaw_model ((q15_48_t) x);
+  *s = neg_sin ? (q15_48_t) (0ULL - (unsigned long long) r) : r;
+  r = clenshaw_model ((q15_48_t) x_cos);
+  *c = neg_cos ? (q15_48_t) (0ULL - (unsigned long long) r) : r;
+}
+
+typedef struct {
+  q15_48_t x, y, theta;
+  q15_48_t cnt_th_r_old, cnt_r_r_old, cnt_th_l_old, cnt_r_l_old;
+} gps_odo_t;
+
+/* fsm_setup */
+void gps_odo_setup (gps_odo_t *g, q15_48_t x, q15_48_t y, q15_48_t theta,
+                    q15_48_t cnt_th_r, q15_48_t cnt_r_r,
+                    q15_48_t cnt_th_l, q15_48_t cnt_r_l)
+{
+  g->x = x;
+  g->y = y;
+  g->theta = theta;
+  g->cnt_th_r_old = cnt_th_r;
+  g->cnt_r_r_old  = cnt_r_r;
+  g->cnt_th_l_old = cnt_th_l;
+  g->cnt_r_l_old  = cnt_r_l;
+}
+
+/* fsm_read_odo .. fsm_compute_y */
+void gps_odo_step (gps_odo_t *g, q15_48_t cnt_th_r, q15_48_t cnt_r_r,
+                   q15_48_t cnt_th_l, q15_48_t cnt_r_l)
+{
+  unsigned long long d_th_r, d_r_r, d_th_l, d_r_l;
+  q15_48_t s, c, d;
+
+  d_th_r = (unsigned long long) cnt_th_r - g->cnt_th_r_old;
+  d_r_r  = (unsigned long long) cnt_r_r  - g->cnt_r_r_old;
+  d_th_l = (unsigned long long) cnt_th_l - g->cnt_th_l_old;
+  d_r_l  = (unsigned long long) cnt_r_l  - g->cnt_r_l_old;
+  g->cnt_th_r_old = cnt_th_r;
+  g->cnt_r_r_old  = cnt_r_r;
+  g->cnt_th_l_old = cnt_th_l;
+  g->cnt_r_l_old  = cnt_r_l;
+
+  /* fsm_compute_theta : decalage arithmetique des distances */
+  d_r_r = (unsigned long long) ((q15_48_t) d_r_r >> 1);
+  d_r_l = (unsigned long long) ((q15_48_t) d_r_l >> 1);
+  g->theta = (q15_48_t) ((unsigned long long) g->theta + (d_th_r - d_th_l));
+
+  /* fsm_compute_trigo .. fsm_compute_y */
+  sin_cos_cheby_model (g->theta, &s, &c);
+  d = (q15_48_t) (d_r_r + d_r_l);
+  g->x = (q15_48_t) ((unsigned long long) g->x + mul64_q48 (c, d));
+  g->y = (q15_48_t) ((unsigned long long) g->y + mul64_q48 (s, d));
+}
+
+/* ----------------------------------------------------------------------
+   traces de codeurs */
+
+typedef struct {
+  unsigned int t_us;
+  int left, right;
+} odo_sample_t;
+
+odo_sample_t *trace;
+int trace_n;
+int trace_max;
+
+void trace_add (unsigned int t_us, int left, int right)
+{
+  if (trace_n == trace_max) {
+    trace_max = trace_max ? 2*trace_max : 65536;
+    trace = realloc (trace, trace_max*sizeof(odo_sample_t));
+    if (trace == NULL) {
+      printf (" error : realloc()\n");
+      exit (1);
+    }
+  }
+  trace[trace_n].t_us  = t_us;
+  trace[trace_n].left  = left;
+  trace[trace_n].right = right;
+  trace_n++;
+}
+
+int trace_load (const char *name)
+{
+  FILE *f;
+  char line[256];
+  unsigned int t_us;
+  int left, right;
+
+  f = fopen (name, "r");
+  if (f == NULL) {
+    printf (" error : cannot open %s\n", name);
+    return -1;
+  }
+  while (fgets (line, sizeof(line), f) != NULL) {
+    if ((line[0] == '#') || (line[0] == '\n'))
+      continue;
+    if (sscanf (line, "%u %d %d", &t_us, &left, &right) == 3)
+      trace_add (t_us, left, right);
+  }
+  fclose (f);
+  return trace_n;
+}
+
+/* trajectoire de match : segments (duree, vitesse, vitesse angulaire),
+   rampes d'acceleration bornees, trace echantillonnee a 20 us */
+#define SYNTH_DT_US       20
+#define SYNTH_ACC         1500.0 /* mm/s2 */
+#define SYNTH_ACC_W       12.0   /* rad/s2 */
+
+const double synth_segments[][3] = {
+  /* s     mm/s    rad/s */
+  { 0.3,     0.0,  0.0  },
+  { 1.5,   800.0,  0.0  },
+  { 0.6,     0.0,  0.0  },
+  { 0.8,     0.0,  2.5  },
+  { 2.0,   600.0,  0.8  },
+  { 1.0,   900.0, -1.2  },
+  { 0.5,     0.0,  0.0  },
+  { 0.6,     0.0, -3.5  },
+  { 2.5,   700.0,  0.0  },
+  { 1.5,   400.0,  1.5  },
+  { 1.5,   400.0, -1.5  },
+  { 1.0,  -500.0,  0.0  },
+  { 0.8,     0.0,  0.0  },
+};
+
+void trace_synth (double mm_per_inc, double track_mm)
+{
+  double v = 0.0, w = 0.0, pos_l = 0.0, pos_r = 0.0, dt, t_end = 0.0;
+  double v_cmd, w_cmd, dv, dw;
+  unsigned int t_us = 0;
+  int k, nseg = sizeof(synth_segments)/sizeof(synth_segments[0]);
+
+  dt = SYNTH_DT_US*1e-6;
+  for (k=0; k<nseg; k++) {
+    t_end += synth_segments[k][0];
+    v_cmd = synth_segments[k][1];
+    w_cmd = synth_segments[k][2];
+    while (t_us*1e-6 < t_end) {
+      dv = v_cmd - v;
+      dw = w_cmd - w;
+      if (dv >  SYNTH_ACC*dt) dv =  SYNTH_ACC*dt;
+      if (dv < -SYNTH_ACC*dt) dv = -SYNTH_ACC*dt;
+      if (dw >  SYNTH_ACC_W*dt) dw =  SYNTH_ACC_W*dt;
+      if (dw < -SYNTH_ACC_W*dt) dw = -SYNTH_ACC_W*dt;
+      v += dv;
+      w += dw;
+      pos_l += (v - w*track_mm/2.0)*dt;
+      pos_r += (v + w*track_mm/2.0)*dt;
+      trace_add (t_us, (int) floor (pos_l/mm_per_inc),
+                 (int) floor (pos_r/mm_per_inc));
+      t_us += SYNTH_DT_US;
+    }
+  }
+}
+
+int trace_write (const char *name)
+{
+  FILE *f;
+  int i;
+
+  f = fopen (name, "w");
+  if (f == NULL) {
+    printf (" error : cannot create %s\n", name);
+    return -1;
+  }
+  fprintf (f, "# t_us compteur_gauche compteur_droit\n");
+  for (i=0; i<trace_n; i++)
+    fprintf (f, "%u %d %d\n", trace[i].t_us, trace[i].left, trace[i].right);
+  fclose (f);
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   banc d'erreur */
+
+double mm_per_inc = 0.0460; /* codeur 1024 points x4, roue de 60 mm */
+double track_mm   = 200.0;
+
+q15_48_t inc_r_q48;  /* IncrementAuxR : mm par increment */
+q15_48_t inc_th_q48; /* IncrementAuxTh : rad par increment */
+
+#define Q48_TO_D(v)  ((double) (v) / (double) FXP_MULT)
+#define D_TO_Q48(v)  ((q15_48_t) ((v) * (double) FXP_MULT))
+
+double angle_diff (double a, double b)
+{
+  double d = fmod (a - b, 2.0*M_PI);
+
+  if (d > M_PI) d -= 2.0*M_PI;
+  if (d < -M_PI) d += 2.0*M_PI;
+  return d;
+}
+
+/* compteurs 64 bits du QuadratureCounter : increments x pas */
+void odo_counters (const odo_sample_t *s, q15_48_t *th_r, q15_48_t *r_r,
+                   q15_48_t *th_l, q15_48_t *r_l)
+{
+  *th_r = (q15_48_t) ((unsigned long long) inc_th_q48 * (long long) s->right);
+  *r_r  = (q15_48_t) ((unsigned long long) inc_r_q48  * (long long) s->right);
+  *th_l = (q15_48_t) ((unsigned long long) inc_th_q48 * (long long) s->left);
+  *r_l  = (q15_48_t) ((unsigned long long) inc_r_q48  * (long long) s->left);
+}
+
+void bench_period (unsigned int period_us)
+{
+  gps_odo_t g;
+  q15_48_t th_r, r_r, th_l, r_l;
+  double x = 0.0, y = 0.0, th = M_PI/2, ds, dth, e, e_max = 0.0;
+  double eth, eth_max = 0.0;
+  unsigned int t_next;
+  int i, n = 0;
+
+  odo_counters (&trace[0], &th_r, &r_r, &th_l, &r_l);
+  gps_odo_setup (&g, 0, 0, D_TO_Q48 (M_PI/2), th_r, r_r, th_l, r_l);
+  t_next = trace[0].t_us + period_us;
+
+  for (i=1; i<trace_n; i++) {
+    /* reference : arc de cercle par echantillon */
+    ds  = (trace[i].right - trace[i-1].right +
+           trace[i].left - trace[i-1].left) * mm_per_inc / 2.0;
+    dth = (trace[i].right - trace[i-1].right -
+           trace[i].left + trace[i-1].left) * mm_per_inc / track_mm;
+    x  += ds*cos (th + dth/2.0);
+    y  += ds*sin (th + dth/2.0);
+    th += dth;
+
+    /* FPGA : compteurs lus toutes les periodes */
+    if (trace[i].t_us >= t_next) {
+      odo_counters (&trace[i], &th_r, &r_r, &th_l, &r_l);
+      gps_odo_step (&g, th_r, r_r, th_l, r_l);
+      n++;
+      e = hypot (Q48_TO_D (g.x) - x, Q48_TO_D (g.y) - y);
+      if (e > e_max) e_max = e;
+      eth = fabs (angle_diff (Q48_TO_D (g.theta), th));
+      if (eth > eth_max) eth_max = eth;
+      t_next += period_us;
+    }
+  }
+
+  printf ("%9.3f ms %8u %10.3f %10.3f %10.3f %10.3f %8.3f%%\n",
+          period_us/1000.0, n, e_max,
+          hypot (Q48_TO_D (g.x) - x, Q48_TO_D (g.y) - y),
+          eth_max*1e6,
+          fabs (angle_diff (Q48_TO_D (g.theta), th))*1e6,
+          100.0*GPS_FSM_CYCLES/(period_us*(CLOCK_HZ/1000000)));
+}
+
+/* sin_cos_cheby contre la libm */
+void check_sincos (void)
+{
+  q15_48_t s, c;
+  double a, e, e_max = 0.0;
+  int i;
+
+  for (i=0; i<=200000; i++) {
+    a = -50.0 + i*(100.0/200000);
+    sin_cos_cheby_model (D_TO_Q48 (a), &s, &c);
+    e = fabs (Q48_TO_D (s) - sin (a));
+    if (e > e_max) e_max = e;
+    e = fabs (Q48_TO_D (c) - cos (a));
+    if (e > e_max) e_max = e;
+  }
+  printf ("sin_cos_cheby : erreur max %.3g sur [-50, 50] rad\n", e_max);
+}
+
+void usage (const char *prog_name)
+{
+  printf ("Usage:\n");
+  printf (" %s [-f trace] [-w trace] [-m mm/inc] [-b voie_mm] [-c]\n",
+          prog_name);
+  printf ("   trace : lignes \"t_us compteur_gauche compteur_droit\"\n");
+  printf ("   -c : seulement la verification du sin/cos\n");
+}
+
+const unsigned int bench_periods_us[] = {
+  40000, 20000, 10000, 5000, 2000, 1000, 500, 250
+};
+
+int main (int argc, char **argv)
+{
+  const char *in_name = NULL, *out_name = NULL;
+  int i, check_only = 0;
+
+  for (i=1; i<argc; i++) {
+    if ((strcmp (argv[i], "-f") == 0) && (i+1 < argc)) {
+      in_name = argv[++i];
+    } else if ((strcmp (argv[i], "-w") == 0) && (i+1 < argc)) {
+      out_name = argv[++i];
+    } else if ((strcmp (argv[i], "-m") == 0) && (i+1 < argc)) {
+      mm_per_inc = atof (argv[++i]);
+    } else if ((strcmp (argv[i], "-b") == 0) && (i+1 < argc)) {
+      track_mm = atof (argv[++i]);
+    } else if (strcmp (argv[i], "-c") == 0) {
+      check_only = 1;
+    } else {
+      usage (argv[0]);
+      return 1;
+    }
+  }
+
+  check_sincos ();
+  if (check_only)
+    return 0;
+
+  inc_r_q48  = D_TO_Q48 (mm_per_inc);
+  inc_th_q48 = D_TO_Q48 (mm_per_inc/track_mm);
+
+  if (in_name != NULL) {
+    if (trace_load (in_name) < 2)
+      return 1;
+  } else {
+    trace_synth (mm_per_inc, track_mm);
+  }
+  if (out_name != NULL)
+    trace_write (out_name);
+
+  printf ("trace : %d echantillons, %.1f s, %.4f mm/inc, voie %.1f mm\n",
+          trace_n, (trace[trace_n-1].t_us - trace[0].t_us)*1e-6,
+          mm_per_inc, track_mm);
+  printf ("FSM : %d cycles par integration (%.2f us a %d MHz)\n",
+          GPS_FSM_CYCLES, GPS_FSM_CYCLES*1e6/CLOCK_HZ, CLOCK_HZ/1000000);
+  printf ("  periode      maj  pos max mm  fin mm  theta max urad  fin urad  FSM\n");
+  for (i=0; i<(int)(sizeof(bench_periods_us)/sizeof(bench_periods_us[0])); i++)
+    bench_period (bench_periods_us[i]);
+
+  return 0;
+}
@@ -0,0 +1,466 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/* Modele C de l'estimation de vitesse de QuadratureCounter.vhd (comptage
+   par fenetre, periode entre fronts, melange), et erreur de chaque
+   estimateur contre la vitesse vraie, lue par la boucle de controle.
+   Le melange est lu comme le fait l'asservissement (R_ROBOT_RC_SPEED_x,
+   increments/s entiers, cf speed_pid_read() dans drivers/speed_pid.c).
+
+   Fronts : une ligne "t_cycles sens" par front compte (un par cycle de
+   quadrature, sens 1 ou -1, cycles a 25 MHz). Sans fichier, une
+   trajectoire est synthetisee (-w pour l'ecrire au meme format) : la
+   reference est alors la vitesse vraie. Pour des fronts enregistres, la
+   reference est la pente de la position interpolee entre fronts, sur
+   +/- REF_HALF_US (non causale).
+
+   -j : erreur d'espacement des traits du disque (+/- %% d'un pas, tiree
+   une fois par trait, reproduite a chaque tour), qui penalise la mesure
+   de periode a haute vitesse.
+
+   Usage : quad_speed_model [-f fronts] [-w fronts] [-m mm/front]
+                            [-j erreur_%] [-l blend_low] [-t timeout_ms] */
+
+#define CLOCK_HZ          25000000
+/* filtre en entree du decodeur : entrees echantillonnees sur 32 cycles */
+#define EDGE_QUANTUM      32
+#define BLEND_SHIFT       3
+
+#define EVAL_US           1000   /* periode de la boucle de controle */
+#define REF_HALF_US       2000
+
+typedef struct {
+  unsigned int t;       /* cycles */
+  int dir;
+} edge_t;
+
+edge_t *edges;
+int edges_n;
+int edges_max;
+
+/* vitesse vraie (fronts/s) aux instants d'evaluation, trace synthetique */
+double *ref_speed;
+int ref_n;
+
+void edge_add (unsigned int t, int dir)
+{
+  if (edges_n == edges_max) {
+    edges_max = edges_max ? 2*edges_max : 65536;
+    edges = realloc (edges, edges_max*sizeof(edge_t));
+    if (edges == NULL) {
+      printf (" error : realloc()\n");
+      exit (1);
+    }
+  }
+  edges[edges_n].t   = t;
+  edges[edges_n].dir = dir;
+  edges_n++;
+}
+
+int edges_load (const char *name)
+{
+  FILE *f;
+  char line[256];
+  unsigned int t;
+  int dir;
+
+  f = fopen (name, "r");
+  if (f == NULL) {
+    printf (" error : cannot open %s\n", name);
+    return -1;
+  }
+  while (fgets (line, sizeof(line), f) != NULL) {
+    if ((line[0] == '#') || (line[0] == '\n'))
+      continue;
+    if (sscanf (line, "%u %d", &t, &dir) == 2)
+      edge_add (t, (dir < 0) ? -1 : 1);
+  }
+  fclose (f);
+  return edges_n;
+}
+
+int edges_write (const char *name)
+{
+  FILE *f;
+  int i;
+
+  f = fopen (name, "w");
+  if (f == NULL) {
+    printf (" error : cannot create %s\n", name);
+    return -1;
+  }
+  fprintf (f, "# t_cycles sens\n");
+  for (i=0; i<edges_n; i++)
+    fprintf (f, "%u %d\n", edges[i].t, edges[i].dir);
+  fclose (f);
+  return 0;
+}
+
+/* ----------------------------------------------------------------------
+   trajectoire synthetique : segments (duree, vitesse), acceleration
+   bornee, du rampement a la pleine vitesse, arrets et inversions */
+#define SYNTH_DT_US       1
+#define SYNTH_ACC         1500.0 /* mm/s2 */
+#define SYNTH_LINES       1024   /* traits par tour */
+
+double line_err[SYNTH_LINES];
+
+/* position du trait k, en fronts */
+double line_pos (long k)
+{
+  return k + line_err[k & (SYNTH_LINES-1)];
+}
+
+const double synth_segments[][2] = {
+  /* s     mm/s */
+  { 0.3,     0.0 },
+  { 1.0,    10.0 },
+  { 1.0,    40.0 },
+  { 1.5,  1000.0 },
+  { 0.8,   150.0 },
+  { 0.5,     0.0 },
+  { 1.0,   -25.0 },
+  { 1.5,  -600.0 },
+  { 0.6,     5.0 },
+  { 1.0,   300.0 },
+  { 0.8,     0.0 },
+};
+
+void edges_synth (double mm_per_edge, double jitter_pct)
+{
+  double v = 0.0, pos = 0.0, dt, dv, v_cmd, t_end = 0.0;
+  unsigned int t_us = 0;
+  long k = 0;
+  int s, nseg = sizeof(synth_segments)/sizeof(synth_segments[0]);
+
+  dt = SYNTH_DT_US*1e-6;
+  ref_n = 0;
+  srand (1);
+  for (s=0; s<SYNTH_LINES; s++)
+    line_err[s] = jitter_pct/100.0*(2.0*rand ()/(double) RAND_MAX - 1.0);
+
+  for (s=0; s<nseg; s++)
+    t_end += synth_segments[s][0];
+  ref_speed = malloc (((size_t) (t_end*1e6/EVAL_US) + 2)*sizeof(double));
+  if (ref_speed == NULL) {
+    printf (" error : malloc()\n");
+    exit (1);
+  }
+
+  t_end = 0.0;
+  for (s=0; s<nseg; s++) {
+    t_end += synth_segments[s][0];
+    v_cmd = synth_segments[s][1]/mm_per_edge;
+    while (t_us*1e-6 < t_end) {
+      if ((t_us % EVAL_US) == 0)
+        ref_speed[ref_n++] = v;
+      dv = v_cmd - v;
+      if (dv >  SYNTH_ACC/mm_per_edge*dt) dv =  SYNTH_ACC/mm_per_edge*dt;
+      if (dv < -SYNTH_ACC/mm_per_edge*dt) dv = -SYNTH_ACC/mm_per_edge*dt;
+      v += dv;
+      pos += v*dt;
+      t_us += SYNTH_DT_US;
+      /* un front par trait franchi, date au filtre d'entree pres */
+      while (1) {
+        if (pos >= line_pos (k+1)) {
+          k++;
+          edge_add ((t_us*(CLOCK_HZ/1000000)) & ~(EDGE_QUANTUM-1), 1);
+        } else if (pos < line_pos (k)) {
+          k--;
+          edge_add ((t_us*(CLOCK_HZ/1000000)) & ~(EDGE_QUANTUM-1), -1);
+        } else {
+          break;
+        }
+      }
+    }
+  }
+}
+
+/* position (somme des sens) apres chaque front, pour la reference */
+int *edges_pos;
+
+void edges_pos_init (void)
+{
+  int i, pos = 0;
+
+  edges_pos = malloc (edges_n*sizeof(int));
+  if (edges_pos == NULL) {
+    printf (" error : malloc()\n");
+    exit (1);
+  }
+  for (i=0; i<edges_n; i++) {
+    pos += edges[i].dir;
+    edges_pos[i] = pos;
+  }
+}
+
+/* position interpolee entre fronts a t (cycles) */
+double edges_pos_at (unsigned int t)
+{
+  int lo = 0, hi = edges_n, mid;
+
+  /* premier front apres t */
+  while (lo < hi) {
+    mid = (lo + hi)/2;
+    if (edges[mid].t <= t) lo = mid + 1; else hi = mid;
+  }
+  if (lo == 0)
+    return 0.0;
+  if (lo == edges_n)
+    return edges_pos[edges_n-1];
+  return edges_pos[lo-1] + edges[lo].dir*(double) (t - edges[lo-1].t) /
+    (double) (edges[lo].t - edges[lo-1].t);
+}
+
+/* pente de la position interpolee sur +/- REF_HALF_US, fronts/s */
+double edges_ref_speed (unsigned int t)
+{
+  unsigned int h = REF_HALF_US*(CLOCK_HZ/1000000);
+  unsigned int t0 = (t > h) ? t - h : 0;
+
+  return (edges_pos_at (t + h) - edges_pos_at (t0))*CLOCK_HZ /
+    (double) (t + h - t0);
+}
+
+/* ----------------------------------------------------------------------
+   QuadratureCounter : edge_proc, period_proc, sampling_proc, blend_proc */
+
+typedef struct {
+  unsigned int window;          /* SamplingInterval + 1 */
+  unsigned int timeout;         /* EdgeTimeout */
+  unsigned int blend_low;       /* BlendLow */
+  unsigned int t0, t1;          /* EdgeTime0/1 */
+  int valid, dir;               /* EdgeValid, EdgeDir */
+  int count, count_old;         /* EdgeCount, EdgeCount_old */
+  int per_window;               /* EdgesPerWindow */
+  unsigned int next_window;     /* fin de la fenetre en cours */
+} quad_speed_t;
+
+void quad_speed_init (quad_speed_t *q, unsigned int window,
+                      unsigned int timeout, unsigned int blend_low)
+{
+  memset (q, 0, sizeof(*q));
+  q->window      = window;
+  q->timeout     = timeout;
+  q->blend_low   = blend_low;
+  q->next_window = window;
+}
+
+void quad_speed_edge (quad_speed_t *q, unsigned int t, int dir)
+{
+  if ((q->valid != 0) && (t - q->t0 > q->timeout))
+    q->valid = 0;
+  q->valid = ((q->valid == 0) || (dir != q->dir)) ? 1 : 2;
+  q->t1  = q->t0;
+  q->t0  = t;
+  q->dir = dir;
+  q->count += dir;
+}
+
+/* fronts et fins de fenetre jusqu'a now inclus */
+void quad_speed_run (quad_speed_t *q, unsigned int now, int *edge_idx)
+{
+  while (1) {
+    if ((*edge_idx < edges_n) && (edges[*edge_idx].t <= now) &&
+        (edges[*edge_idx].t < q->next_window)) {
+      quad_speed_edge (q, edges[*edge_idx].t, edges[*edge_idx].dir);
+      (*edge_idx)++;
+    } else if (q->next_window <= now) {
+      q->per_window = q->count - q->count_old;
+      q->count_old  = q->count;
+      q->next_window += q->window;
+    } else {
+      break;
+    }
+  }
+}
+
+/* Q16.16, fronts par fenetre */
+int quad_speed_period (quad_speed_t *q, unsigned int now)
+{
+  unsigned int period, elapsed;
+  unsigned long long quot;
+
+  elapsed = now - q->t0;
+  if ((q->valid != 0) && (elapsed > q->timeout))
+    q->valid = 0;
+  if (q->valid != 2)
+    return 0;
+
+  period = q->t0 - q->t1;
+  if (elapsed > period)
+    period = elapsed;
+  quot = ((unsigned long long) (q->window & 0x3fffffff) << 16) / period;
+  if (quot > 0x7fffffffULL)
+    quot = 0x7fffffffULL;
+  return (q->dir < 0) ? -(int) quot : (int) quot;
+}
+
+int quad_speed_count (quad_speed_t *q)
+{
+  return (int) (short) q->per_window * 65536;
+}
+
+int quad_speed_blend (quad_speed_t *q, int sp, int sc)
+{
+  long long e = q->per_window, low = q->blend_low, d;
+
+  if (e < 0) e = -e;
+  if (e <= low)
+    return sp;
+  if (e >= low + (1 << BLEND_SHIFT))
+    return sc;
+  d = ((long long) sc - sp)*(e - low);
+  return sp + (int) (d >> BLEND_SHIFT);
+}
+
+/* lecture par speed_pid_read() : Q16.16 x fenetres/s, tronque */
+int quad_speed_inc_s (int v, unsigned int window)
+{
+  return (int) (((long long) v * (CLOCK_HZ/window)) >> 16);
+}
+
+/* ----------------------------------------------------------------------
+   banc d'erreur */
+
+double mm_per_edge = 0.184; /* codeur 1024 points, roue de 60 mm */
+
+typedef struct {
+  double sum2, max;
+  int n;
+} err_t;
+
+void err_add (err_t *e, double v)
+{
+  e->sum2 += v*v;
+  if (fabs (v) > e->max) e->max = fabs (v);
+  e->n++;
+}
+
+double err_rms (err_t *e)
+{
+  return e->n ? sqrt (e->sum2/e->n) : 0.0;
+}
+
+/* vitesse lente : moins d'un front par ms */
+#define SLOW_EDGES_S  1000.0
+
+void bench_window (unsigned int window_us, unsigned int timeout_ms,
+                   unsigned int blend_low)
+{
+  quad_speed_t q;
+  err_t ec = {0}, ep = {0}, eb = {0}, eb_slow = {0};
+  unsigned int now, t_end, window;
+  double k, ref, vc, vp, vb;
+  int idx = 0, i, sp, sc;
+
+  window = window_us*(CLOCK_HZ/1000000);
+  quad_speed_init (&q, window, timeout_ms*(CLOCK_HZ/1000), blend_low);
+  /* fronts/fenetre Q16.16 -> mm/s */
+  k = mm_per_edge*CLOCK_HZ/(65536.0*window);
+  t_end = edges[edges_n-1].t;
+
+  for (i=0, now=0; now<=t_end; i++, now+=EVAL_US*(CLOCK_HZ/1000000)) {
+    quad_speed_run (&q, now, &idx);
+    sp = quad_speed_period (&q, now);
+    sc = quad_speed_count (&q);
+    vp = sp*k;
+    vc = sc*k;
+    vb = quad_speed_inc_s (quad_speed_blend (&q, sp, sc), window)*mm_per_edge;
+    if (ref_speed != NULL) {
+      if (i >= ref_n)
+        break;
+      ref = ref_speed[i]*mm_per_edge;
+    } else {
+      ref = edges_ref_speed (now)*mm_per_edge;
+    }
+    err_add (&ec, vc - ref);
+    err_add (&ep, vp - ref);
+    err_add (&eb, vb - ref);
+    if (fabs (ref) < SLOW_EDGES_S*mm_per_edge)
+      err_add (&eb_slow, vb - ref);
+  }
+
+  printf ("%7.1f ms %6u %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+          window_us/1000.0, blend_low,
+          err_rms (&ec), err_rms (&ep), err_rms (&eb), eb.max,
+          err_rms (&eb_slow), eb_slow.max);
+}
+
+void usage (const char *prog_name)
+{
+  printf ("Usage:\n");
+  printf (" %s [-f fronts] [-w fronts] [-m mm/front] [-j erreur_%%]\n"
+          "    [-l blend_low] [-t timeout_ms]\n", prog_name);
+  printf ("   fronts : lignes \"t_cycles sens\" (sens 1 ou -1)\n");
+  printf ("   blend_low : fronts par fenetre sous lesquels seule la periode compte\n");
+}
+
+const unsigned int bench_windows_us[] = {
+  20000, 10000, 5000, 2000, 1000
+};
+
+const unsigned int bench_blend_low[] = {
+  0, 2, 4, 8, 16
+};
+
+int main (int argc, char **argv)
+{
+  const char *in_name = NULL, *out_name = NULL;
+  unsigned int timeout_ms = 100;
+  double jitter_pct = 0.0;
+  int i, j, blend_low = -1;
+
+  for (i=1; i<argc; i++) {
+    if ((strcmp (argv[i], "-f") == 0) && (i+1 < argc)) {
+      in_name = argv[++i];
+    } else if ((strcmp (argv[i], "-w") == 0) && (i+1 < argc)) {
+      out_name = argv[++i];
+    } else if ((strcmp (argv[i], "-m") == 0) && (i+1 < argc)) {
+      mm_per_edge = atof (argv[++i]);
+    } else if ((strcmp (argv[i], "-j") == 0) && (i+1 < argc)) {
+      jitter_pct = atof (argv[++i]);
+    } else if ((strcmp (argv[i], "-l") == 0) && (i+1 < argc)) {
+      blend_low = atoi (argv[++i]);
+    } else if ((strcmp (argv[i], "-t") == 0) && (i+1 < argc)) {
+      timeout_ms = atoi (argv[++i]);
+    } else {
+      usage (argv[0]);
+      return 1;
+    }
+  }
+
+  if (in_name != NULL) {
+    if (edges_load (in_name) < 2)
+      return 1;
+  } else {
+    if ((jitter_pct < 0.0) || (jitter_pct >= 50.0)) {
+      usage (argv[0]);
+      return 1;
+    }
+    edges_synth (mm_per_edge, jitter_pct);
+  }
+  if (out_name != NULL)
+    edges_write (out_name);
+  if (ref_speed == NULL)
+    edges_pos_init ();
+
+  printf ("fronts : %d, %.1f s, %.4f mm/front, timeout %u ms, reference %s\n",
+          edges_n, edges[edges_n-1].t/(double) CLOCK_HZ, mm_per_edge,
+          timeout_ms, (ref_speed != NULL) ? "vraie" : "interpolee");
+  printf ("erreurs rms/max en mm/s, lecture toutes les %d us, lent : < %.0f mm/s\n",
+          EVAL_US, SLOW_EDGES_S*mm_per_edge);
+  printf (" fenetre   low   comptage    periode    melange   mel. max  lent rms   lent max\n");
+  for (i=0; i<(int)(sizeof(bench_windows_us)/sizeof(bench_windows_us[0])); i++) {
+    if (blend_low >= 0) {
+      bench_window (bench_windows_us[i], timeout_ms, blend_low);
+      continue;
+    }
+    for (j=0; j<(int)(sizeof(bench_blend_low)/sizeof(bench_blend_low[0])); j++)
+      bench_window (bench_windows_us[i], timeout_ms, bench_blend_low[j]);
+  }
+
+  return 0;
+}
@@ -16,8 +16,6 @@
 #define ROBOT_I2C_CMD_SET_TRAJ_D  0x44000000
 #define ROBOT_I2C_CMD_SET_TRAJ_T  0x74000000
 #define ROBOT_I2C_CMD_GET_STATE   0x3f000000
-#define ROBOT_I2C_CMD_SERVO_LEFT  0x51000000
-#define ROBOT_I2C_CMD_SERVO_RIGHT 0x52000000
 
 #define ROBOT_CMD_TYPE_NONE         0
 #define ROBOT_CMD_TYPE_TRANSLATION  1
@@ -40,6 +38,25 @@
 #define I2C_DEV "/dev/i2c-0"
 #define I2C_SLAVE_ADDR 0x42
 
+/* bras : servo1 a gauche, servo3 a droite (cf robot_leon.h) ; les largeurs
+   sont ecrites dans les ombres puis appliquees ensemble par ACT_COMMIT, la
+   rampe est faite par le FPGA. Seules ces deux voies passent par le commit,
+   servo2 et les pompes restent en application immediate */
+#define A_ROBOT_SERVO1_PW     0x80008314
+#define A_ROBOT_SERVO3_PW     0x80008324
+#define A_ROBOT_ACT_COMMIT    0x80008328
+#define A_ROBOT_ACT_AUTO      0x8000832c
+#define A_ROBOT_SERVO1_SLEW   0x80008368
+#define A_ROBOT_SERVO3_SLEW   0x80008370
+
+#define ACT_SERVO_LEFT        0x00000001
+#define ACT_SERVO_RIGHT       0x00000004
+#define ACT_ALL               0x0000001f
+#define ACT_STATUS_RAMP       0x00000700
+
+/* ~0.8 us par periode de 10.5 ms : 0x9000 -> 0xb600 en 200 ms */
+#define ARM_SLEW              0x200
+
 
 unsigned char i2c_buf[256];
 
@@ -112,6 +129,89 @@ int i2c_read_word (unsigned int *pdata)
 }
 
 
+int master_i2c_write_word (unsigned int apb_addr, unsigned int data)
+{
+  i2c_buf[0] = 0x03;
+  i2c_buf[1] = (apb_addr>>24) & 0xff;
+  i2c_buf[2] = (apb_addr>>16) & 0xff;
+  i2c_buf[3] = (apb_addr>>8) & 0xff;
+  i2c_buf[4] = (apb_addr) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5)
+    return -1;
+
+  i2c_buf[0] = 0x04;
+  i2c_buf[1] = (data>>24) & 0xff;
+  i2c_buf[2] = (data>>16) & 0xff;
+  i2c_buf[3] = (data>>8) & 0xff;
+  i2c_buf[4] = (data) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5)
+    return -1;
+
+  return 0;
+}
+
+/* ecriture en rafale (registre I2C 0x06) : n paires adresse APB + donnee
+   dans une seule transaction */
+int master_i2c_write_burst (unsigned int *apb_addr, unsigned int *data, int n)
+{
+  int i, len;
+
+  len = 0;
+  i2c_buf[len++] = 0x06;
+  for (i=0; i<n; i++) {
+    i2c_buf[len++] = (apb_addr[i]>>24) & 0xff;
+    i2c_buf[len++] = (apb_addr[i]>>16) & 0xff;
+    i2c_buf[len++] = (apb_addr[i]>>8) & 0xff;
+    i2c_buf[len++] = (apb_addr[i]) & 0xff;
+    i2c_buf[len++] = (data[i]>>24) & 0xff;
+    i2c_buf[len++] = (data[i]>>16) & 0xff;
+    i2c_buf[len++] = (data[i]>>8) & 0xff;
+    i2c_buf[len++] = (data[i]) & 0xff;
+  }
+  if (write(i2c_dev_file, i2c_buf, len) != len)
+    return -1;
+
+  return 0;
+}
+
+int arm_init (void)
+{
+  if ((master_i2c_write_word (A_ROBOT_ACT_AUTO,
+                              ACT_ALL & ~(ACT_SERVO_LEFT|ACT_SERVO_RIGHT)) < 0) ||
+      (master_i2c_write_word (A_ROBOT_SERVO1_SLEW, ARM_SLEW) < 0) ||
+      (master_i2c_write_word (A_ROBOT_SERVO3_SLEW, ARM_SLEW) < 0)) {
+    printf(" error : arm_init()\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* nouvelles cibles des servos de mask (0 : servo coupe), appliquees au
+   meme instant : ombres puis commit en une seule transaction I2C */
+int arm_move (unsigned int mask, unsigned int pw_left, unsigned int pw_right)
+{
+  unsigned int addr[3];
+  unsigned int data[3];
+  int n = 0;
+
+  if (mask & ACT_SERVO_LEFT) {
+    addr[n] = A_ROBOT_SERVO1_PW;
+    data[n++] = pw_left;
+  }
+  if (mask & ACT_SERVO_RIGHT) {
+    addr[n] = A_ROBOT_SERVO3_PW;
+    data[n++] = pw_right;
+  }
+  addr[n] = A_ROBOT_ACT_COMMIT;
+  data[n++] = mask;
+
+  if (master_i2c_write_burst (addr, data, n) < 0) {
+    printf(" error : arm_move()\n");
+    return -1;
+  }
+  return 0;
+}
+
 #define I2C_READ_WORD_BLOCKING() \
   do {                                                                      \
     i2c_result=0;                                                           \
@@ -546,81 +646,42 @@ int main_goto(int do_debug, int set_end_theta, int debug_t, int debug_D, double
 
 void chopper_poisson_droite()
 {
-  unsigned int i2c_cmd;
-  i2c_cmd = (unsigned int) 0x0000b600;
-  i2c_cmd = ROBOT_I2C_CMD_SERVO_RIGHT | (i2c_cmd & 0x00ffffff);
-  if (i2c_write_word (i2c_cmd)) {
-    printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_RIGHT)\n");
-  }
+  arm_move (ACT_SERVO_RIGHT, 0, 0x0000b600);
 }
 
 void sortir_poisson_droite()
 {
-  unsigned int i2c_cmd;
-  i2c_cmd = (unsigned int) 0x00009000;
-  i2c_cmd = ROBOT_I2C_CMD_SERVO_RIGHT | (i2c_cmd & 0x00ffffff);
-  if (i2c_write_word (i2c_cmd)) {
-    printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_RIGHT)\n");
-  }
+  arm_move (ACT_SERVO_RIGHT, 0, 0x00009000);
 }
 
 void lever_bras_droite()
 {
-  unsigned int i2c_cmd;
-  i2c_cmd = (unsigned int) 0x00007000;
-  i2c_cmd = ROBOT_I2C_CMD_SERVO_RIGHT | (i2c_cmd & 0x00ffffff);
-  if (i2c_write_word (i2c_cmd)) {
-    printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_RIGHT)\n");
-  }
+  arm_move (ACT_SERVO_RIGHT, 0, 0x00007000);
   sleep(1);
-  i2c_cmd = (unsigned int) 0x00007000;
-  i2c_cmd = ROBOT_I2C_CMD_SERVO_RIGHT | (i2c_cmd & 0x00ffffff);
-  if (i2c_write_word (i2c_cmd)) {
-    printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_RIGHT)\n");
-  }
 }
 
 void chopper_poisson_gauche()
 {
-  unsigned int i2c_cmd;
-  i2c_cmd = (unsigned int) 0x00006c00;
-  i2c_cmd = ROBOT_I2C_CMD_SERVO_LEFT | (i2c_cmd & 0x00ffffff);
-  if (i2c_write_word (i2c_cmd)) {
-    printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_LEFT)\n");
-  }
+  arm_move (ACT_SERVO_LEFT, 0x00006c00, 0);
 }
 
 void sortir_poisson_gauche()
 {
-  unsigned int i2c_cmd;
-  i2c_cmd = (unsigned int) 0x00009000;
-  i2c_cmd = ROBOT_I2C_CMD_SERVO_LEFT | (i2c_cmd & 0x00ffffff);
-  if (i2c_write_word (i2c_cmd)) {
-    printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_LEFT)\n");
-  }
+  arm_move (ACT_SERVO_LEFT, 0x00009000, 0);
 }
 
 void lever_bras_gauche()
 {
-  unsigned int i2c_cmd;
-  i2c_cmd = (unsigned int) 0x0000b000;
-  i2c_cmd = ROBOT_I2C_CMD_SERVO_LEFT | (i2c_cmd & 0x00ffffff);
-  if (i2c_write_word (i2c_cmd)) {
-    printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_LEFT)\n");
-  }
+  arm_move (ACT_SERVO_LEFT, 0x0000b000, 0);
+  /* le temps que le bras arrive avant de couper le servo */
   sleep(1);
-  i2c_cmd = (unsigned int) 0x00000000;
-  i2c_cmd = ROBOT_I2C_CMD_SERVO_LEFT | (i2c_cmd & 0x00ffffff);
-  if (i2c_write_word (i2c_cmd)) {
-    printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_LEFT)\n");
-  }
+  arm_move (ACT_SERVO_LEFT, 0x00000000, 0);
 }
 
 int main(int argc, char *argv[])
 {
   int result;
   int tourne_a_gauche = 0;
-  unsigned int i2c_cmd;
 
   printf(" robot_compet\n");
 
@@ -645,46 +706,26 @@ Cote gauche:
   * chopper poisson : 0x00007000=> @0x80008314
   * sortir poisson :  0x00009000=> @0x80008314
 */
+  if (arm_init()!=0) {
+    return 1;
+  }
+
   if ((robot_switches&2)==0) {
     printf(" jumper ON : violet : tourne a gauche\n");
     tourne_a_gauche = 1;
-    i2c_cmd = (unsigned int) 0x0000b400;
-    i2c_cmd = ROBOT_I2C_CMD_SERVO_RIGHT | (i2c_cmd & 0x00ffffff);
-    if (i2c_write_word (i2c_cmd)) {
-      printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_RIGHT)\n");
-    }
+    arm_move (ACT_SERVO_RIGHT, 0, 0x0000b400);
     sleep (2);
-    i2c_cmd = (unsigned int) 0x00009000;
-    i2c_cmd = ROBOT_I2C_CMD_SERVO_RIGHT | (i2c_cmd & 0x00ffffff);
-    if (i2c_write_word (i2c_cmd)) {
-      printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_RIGHT)\n");
-    }
+    arm_move (ACT_SERVO_RIGHT, 0, 0x00009000);
     sleep (2);
-    i2c_cmd = (unsigned int) 0x00000000;
-    i2c_cmd = ROBOT_I2C_CMD_SERVO_RIGHT | (i2c_cmd & 0x00ffffff);
-    if (i2c_write_word (i2c_cmd)) {
-      printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_RIGHT)\n");
-    }
+    arm_move (ACT_SERVO_RIGHT, 0, 0x00000000);
   } else {
     printf(" jumper OFF : vert : tourne a droite\n");
     tourne_a_gauche = 0;
-    i2c_cmd = (unsigned int) 0x00007000;
-    i2c_cmd = ROBOT_I2C_CMD_SERVO_LEFT | (i2c_cmd & 0x00ffffff);
-    if (i2c_write_word (i2c_cmd)) {
-      printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_LEFT)\n");
-    }
+    arm_move (ACT_SERVO_LEFT, 0x00007000, 0);
     sleep (2);
-    i2c_cmd = (unsigned int) 0x00009000;
-    i2c_cmd = ROBOT_I2C_CMD_SERVO_LEFT | (i2c_cmd & 0x00ffffff);
-    if (i2c_write_word (i2c_cmd)) {
-      printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_LEFT)\n");
-    }
+    arm_move (ACT_SERVO_LEFT, 0x00009000, 0);
     sleep (2);
-    i2c_cmd = (unsigned int) 0x00000000;
-    i2c_cmd = ROBOT_I2C_CMD_SERVO_LEFT | (i2c_cmd & 0x00ffffff);
-    if (i2c_write_word (i2c_cmd)) {
-      printf(" error : i2c_write_word(ROBOT_I2C_CMD_SERVO_LEFT)\n");
-    }
+    arm_move (ACT_SERVO_LEFT, 0x00000000, 0);
   }
 
   //return -1;
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "i2c-dev.h"
+
+/* Debit du lien I2C avec l'esclave 0x42 (src/robot/robot_i2c_slave.vhd)
+   selon la vitesse du bus : mot APB, etat complet (instantane, 16 mots),
+   ecritures APB, chargement de commandes (0x02) et vidage de la fifo de
+   trace (0x01), compares au temps bus minimal a la vitesse nominale.
+
+   L'esclave suit le maitre jusqu'au Fast-mode Plus (1 MHz) et etire SCL
+   quand la donnee n'est pas prete : plus de pauses entre les acces. La
+   vitesse se regle cote noyau (i2c-dev n'a pas d'ioctl pour ca) : sur les
+   OMAP (Gumstix Overo) par "i2c_bus=<n>,<kHz>" sur la ligne de commande,
+   sinon par clock-frequency dans le device tree ; -s donne la vitesse
+   attendue, comparee a celle du device tree quand elle est lisible. */
+
+#define I2C_DEV "/dev/i2c-0"
+#define I2C_SLAVE_ADDR 0x42
+#define I2C_SPEED_KHZ 100
+
+/* instantane pose + compteurs (cf robot_leon.h) */
+#define A_SNAP_CS          0x80008040
+#define SNAP_NB_WORDS      15
+
+/* boite aux lettres 0xe0..0xef : mesure de boucle du LEON, reecrite par
+   le LEON a chaque publication (cf loop_stats.c) */
+#define BENCH_WRITE_ADDR   0x80008380
+#define BENCH_WRITE_WORDS  16
+
+/* bits sur le bus par operation : 9 par octet (adresse esclave comprise),
+   plus ~2 pour START/STOP par transaction */
+#define BITS_WR(n)         (9*((n)+1) + 2)
+#define BITS_RD(n)         (9*((n)+1) + 2)
+#define BITS_READ_WORD     (BITS_WR(5) + BITS_WR(1) + BITS_RD(4))
+#define BITS_WRITE_WORD    (BITS_WR(5) + BITS_WR(5))
+#define BITS_STATE         (BITS_WRITE_WORD + (SNAP_NB_WORDS+1)*BITS_READ_WORD)
+#define BITS_CMD           BITS_WR(5)
+#define BITS_TRACE         (BITS_WR(1) + BITS_RD(4))
+
+unsigned char i2c_buf[256];
+
+int i2c_dev_file;
+char i2c_dev_name[20];
+
+unsigned int i2c_speed_khz = I2C_SPEED_KHZ;
+
+int i2c_init (const char *dev)
+{
+  snprintf(i2c_dev_name, sizeof(i2c_dev_name), "%s", dev);
+
+  if ((i2c_dev_file = open(i2c_dev_name,O_RDWR)) < 0) {
+    printf("i2c_init() : Cannot open %s\n", i2c_dev_name);
+    return -1;
+  }
+
+  if (ioctl(i2c_dev_file, I2C_SLAVE, I2C_SLAVE_ADDR) < 0) {
+    printf("i2c_init() : Cannot assign device addr (%x) %s\n",
+	   I2C_SLAVE_ADDR, i2c_dev_name);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* vitesse du bus declaree dans le device tree, en kHz (0 : inconnue) */
+unsigned int i2c_bus_speed_khz (const char *dev)
+{
+  char path[80];
+  unsigned char be[4];
+  int bus, fd, n;
+
+  if (sscanf(dev, "/dev/i2c-%d", &bus) != 1)
+    return 0;
+  snprintf(path, sizeof(path),
+           "/sys/class/i2c-adapter/i2c-%d/of_node/clock-frequency", bus);
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return 0;
+  n = read(fd, be, 4);
+  close(fd);
+  if (n != 4)
+    return 0;
+  return ((be[0]<<24) + (be[1]<<16) + (be[2]<<8) + be[3]) / 1000;
+}
+
+int master_i2c_read_word (unsigned int apb_addr, unsigned int *pdata)
+{
+  i2c_buf[0] = 0x03;
+  i2c_buf[1] = (apb_addr>>24) & 0xff;
+  i2c_buf[2] = (apb_addr>>16) & 0xff;
+  i2c_buf[3] = (apb_addr>>8) & 0xff;
+  i2c_buf[4] = (apb_addr) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5)
+    return -1;
+
+  i2c_buf[0] = 0x05;
+  if (write(i2c_dev_file, i2c_buf, 1) != 1)
+    return -1;
+
+  if (read(i2c_dev_file, i2c_buf, 4) < 4)
+    return -1;
+
+  *pdata = (i2c_buf[0]<<24) + (i2c_buf[1]<<16) + (i2c_buf[2]<<8) + (i2c_buf[3]);
+  return 4;
+}
+
+int master_i2c_write_word (unsigned int apb_addr, unsigned int data)
+{
+  i2c_buf[0] = 0x03;
+  i2c_buf[1] = (apb_addr>>24) & 0xff;
+  i2c_buf[2] = (apb_addr>>16) & 0xff;
+  i2c_buf[3] = (apb_addr>>8) & 0xff;
+  i2c_buf[4] = (apb_addr) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5)
+    return -1;
+
+  i2c_buf[0] = 0x04;
+  i2c_buf[1] = (data>>24) & 0xff;
+  i2c_buf[2] = (data>>16) & 0xff;
+  i2c_buf[3] = (data>>8) & 0xff;
+  i2c_buf[4] = (data) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5)
+    return -1;
+
+  return 0;
+}
+
+/* commande pour le LEON : l'ACK du dernier octet attend (SCL etire) que
+   le LEON ait lu la precedente, NACK au bout de 1 ms */
+int i2c_write_cmd (unsigned int data)
+{
+  i2c_buf[0] = 0x02;
+  i2c_buf[1] = (data>>24) & 0xff;
+  i2c_buf[2] = (data>>16) & 0xff;
+  i2c_buf[3] = (data>>8) & 0xff;
+  i2c_buf[4] = (data) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5)
+    return -1;
+
+  return 0;
+}
+
+/* mot de la fifo de trace : NACK tout de suite si elle est vide */
+int i2c_read_trace (unsigned int *pdata)
+{
+  i2c_buf[0] = 0x01;
+  if (write(i2c_dev_file, i2c_buf, 1) != 1)
+    return -1;
+
+  if (read(i2c_dev_file, i2c_buf, 4) < 4)
+    return 0;
+
+  *pdata = (i2c_buf[0]<<24) + (i2c_buf[1]<<16) + (i2c_buf[2]<<8) + (i2c_buf[3]);
+  return 4;
+}
+
+int i2c_read_state (unsigned int *snap)
+{
+  unsigned int status;
+  int i;
+
+  if (master_i2c_write_word (A_SNAP_CS, 1)<0)
+    return -1;
+  if (master_i2c_read_word (A_SNAP_CS, &status)<0)
+    return -1;
+  for (i=0; i<SNAP_NB_WORDS; i++) {
+    if (master_i2c_read_word (A_SNAP_CS + 4 + 4*i, &snap[i])<0)
+      return -1;
+  }
+  return 0;
+}
+
+double time_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e6 + ts.tv_nsec/1000.0;
+}
+
+void bench_print (const char *name, double t_us, int bits, int errors)
+{
+  double t_min = bits * 1e3 / i2c_speed_khz;
+
+  printf("  %-18s %9.1f us  (bus %7.1f us, %3.0f%%)", name, t_us, t_min,
+         100.0*t_min/t_us);
+  if (errors)
+    printf("  %d erreurs", errors);
+  printf("\n");
+}
+
+void bench (int n, int with_cmd)
+{
+  unsigned int data, snap[SNAP_NB_WORDS];
+  double t0;
+  int i, j, err, words;
+
+  printf("I2C %s 0x%x, %u kHz\n", i2c_dev_name, I2C_SLAVE_ADDR,
+         i2c_speed_khz);
+
+  err = 0;
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    err += (master_i2c_read_word (0x80008000, &data) < 0);
+  bench_print ("mot APB (lecture)", (time_us() - t0)/n, BITS_READ_WORD, err);
+
+  err = 0;
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    err += (i2c_read_state (snap) < 0);
+  bench_print ("etat (16 mots)", (time_us() - t0)/n, BITS_STATE, err);
+
+  err = 0;
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    for (j=0; j<BENCH_WRITE_WORDS; j++)
+      err += (master_i2c_write_word (BENCH_WRITE_ADDR + 4*j, i+j) < 0);
+  bench_print ("mot APB (ecriture)", (time_us() - t0)/n/BENCH_WRITE_WORDS,
+               BITS_WRITE_WORD, err);
+
+  /* fifo vide : NACK des l'adresse, sans etirement */
+  err = 0;
+  words = 0;
+  t0 = time_us();
+  for (i=0; i<n; i++) {
+    j = i2c_read_trace (&data);
+    if (j<0)
+      err++;
+    else if (j>0)
+      words++;
+  }
+  t0 = time_us() - t0;
+  if (words)
+    bench_print ("trace (mot)", t0/n, BITS_TRACE, err);
+  printf("  trace : %d mots lus sur %d\n", words, n);
+
+  if (!with_cmd)
+    return;
+
+  /* chargement : cadence par la lecture des commandes par le LEON */
+  err = 0;
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    err += (i2c_write_cmd (0x01000000) < 0);
+  bench_print ("commande (0x02)", (time_us() - t0)/n, BITS_CMD, err);
+}
+
+void usage(const char *prog_name)
+{
+  printf("Usage: %s [-d i2c_dev] [-s speed_khz] <commande>\n", prog_name);
+  printf("  speed                  (vitesse du bus vue par le noyau)\n");
+  printf("  bench [n] [cmd]        (debits ; cmd : chargement 0x02, les\n");
+  printf("                          commandes doivent etre lues par le LEON)\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const char *dev = I2C_DEV;
+  unsigned int khz;
+  int n, a = 1;
+
+  while ((a+1<argc) && (argv[a][0]=='-')) {
+    if (strcmp(argv[a], "-d")==0) {
+      dev = argv[a+1];
+    } else if (strcmp(argv[a], "-s")==0) {
+      i2c_speed_khz = strtol(argv[a+1], NULL, 0);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+    a += 2;
+  }
+
+  if ((a>=argc) || (i2c_speed_khz==0)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  khz = i2c_bus_speed_khz (dev);
+  if (khz && (khz != i2c_speed_khz)) {
+    printf("%s : bus a %u kHz (device tree), pas %u kHz\n", dev, khz,
+           i2c_speed_khz);
+    printf("  i2c_bus=<n>,%u sur la ligne de commande du noyau (OMAP) ou\n",
+           i2c_speed_khz);
+    printf("  clock-frequency = <%u> dans le device tree\n",
+           i2c_speed_khz*1000);
+  }
+
+  if (strcmp(argv[a], "speed")==0) {
+    if (khz)
+      printf("%s : %u kHz\n", dev, khz);
+    else
+      printf("%s : vitesse inconnue (pas de device tree)\n", dev);
+    return 0;
+  }
+
+  if (i2c_init(dev)!=0) {
+    printf("Cannot init i2c\n");
+    return 1;
+  }
+
+  if (strcmp(argv[a], "bench")==0) {
+    n = (a+1<argc) ? strtol(argv[a+1], NULL, 0) : 1000;
+    if (n<1)
+      n = 1;
+    bench (n, (a+2<argc) && (strcmp(argv[a+2], "cmd")==0));
+  } else {
+    usage(argv[0]);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+
+#include "i2c-dev.h"
+
+/* Reglage de l'asservissement de vitesse des roues du LEON
+   (soft_boot/drivers/speed_pid.c) par la boite aux lettres
+   0x800083c0..0x800083f8, et lecture des erreurs de suivi dans la fifo de
+   trace I2C. */
+
+#define I2C_DEV "/dev/i2c-0"
+#define I2C_SLAVE_ADDR 0x42
+
+#define A_SPID_CTRL       0x800083c0
+#define A_SPID_PERIOD     0x800083c4
+#define A_SPID_KP         0x800083c8
+#define A_SPID_KI         0x800083cc
+#define A_SPID_KD         0x800083d0
+#define A_SPID_KFF        0x800083d4
+#define A_SPID_OUT_MAX    0x800083d8
+#define A_SPID_SP_1       0x800083dc
+#define A_SPID_SP_2       0x800083e0
+#define A_SPID_ERR        0x800083e4
+#define A_SPID_CMD        0x800083e8
+#define A_SPID_TICKS      0x800083ec
+#define A_SPID_SAT        0x800083f0
+#define A_SPID_TRACE_DROP 0x800083f4
+#define A_SPID_STATUS     0x800083f8
+
+#define SPID_CTRL_ENABLE  0x00000001
+#define SPID_CTRL_TRACE   0x00000002
+
+#define Q16_16_MULT       65536.0
+
+unsigned char i2c_buf[256];
+
+int i2c_dev_file;
+char i2c_dev_name[20];
+
+int i2c_init (void)
+{
+  sprintf(i2c_dev_name, I2C_DEV);
+
+  if ((i2c_dev_file = open(i2c_dev_name,O_RDWR)) < 0) {
+    printf("i2c_init() : Cannot open %s\n", I2C_DEV);
+    return -1;
+  }
+
+  if (ioctl(i2c_dev_file, I2C_SLAVE, I2C_SLAVE_ADDR) < 0) {
+    printf("i2c_init() : Cannot assign device addr (%x) %s\n",
+	   I2C_SLAVE_ADDR, I2C_DEV);
+    return -1;
+  }
+
+  return 0;
+}
+
+int master_i2c_read_word (unsigned int apb_addr, unsigned int *pdata)
+{
+  unsigned int data;
+  int rbytes;
+
+  i2c_buf[0] = 0x03;
+  i2c_buf[1] = (apb_addr>>24) & 0xff;
+  i2c_buf[2] = (apb_addr>>16) & 0xff;
+  i2c_buf[3] = (apb_addr>>8) & 0xff;
+  i2c_buf[4] = (apb_addr) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
+    printf("I2C Send apb_addr (0x03) failed\n");
+    return -1;
+  }
+
+  i2c_buf[0] = 0x05;
+  if (write(i2c_dev_file, i2c_buf, 1) != 1) {
+    printf("I2C Send APB read command (0x05) failed\n");
+    return -1;
+  }
+
+  rbytes = read(i2c_dev_file, i2c_buf, 4);
+  if (rbytes<4) {
+    printf("I2C APB read failed\n");
+    return -1;
+  }
+
+  data= (i2c_buf[0]<<24) + (i2c_buf[1]<<16) + (i2c_buf[2]<<8) + (i2c_buf[3]);
+  *pdata = data;
+
+  return 4;
+}
+
+int master_i2c_write_word (unsigned int apb_addr, unsigned int data)
+{
+  i2c_buf[0] = 0x03;
+  i2c_buf[1] = (apb_addr>>24) & 0xff;
+  i2c_buf[2] = (apb_addr>>16) & 0xff;
+  i2c_buf[3] = (apb_addr>>8) & 0xff;
+  i2c_buf[4] = (apb_addr) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
+    printf("I2C Send apb_addr (0x03) failed\n");
+    return -1;
+  }
+
+  i2c_buf[0] = 0x04;
+  i2c_buf[1] = (data>>24) & 0xff;
+  i2c_buf[2] = (data>>16) & 0xff;
+  i2c_buf[3] = (data>>8) & 0xff;
+  i2c_buf[4] = (data) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
+    printf("I2C APB write (0x04) failed\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* mot de la fifo de trace (cf trace_dump.c) */
+int i2c_read_trace (unsigned int *pdata)
+{
+  int rbytes;
+
+  i2c_buf[0] = 0x01;
+  if (write(i2c_dev_file, i2c_buf, 1) != 1) {
+    printf("I2C Send reg_addr (0x01) failed\n");
+    return -1;
+  }
+
+  rbytes = read(i2c_dev_file, i2c_buf, 4);
+  if (rbytes<4)
+    return 0;
+
+  *pdata = (i2c_buf[0]<<24) + (i2c_buf[1]<<16) + (i2c_buf[2]<<8) + (i2c_buf[3]);
+  return 4;
+}
+
+unsigned int q16_16 (const char *s)
+{
+  return (unsigned int) (int) (atof(s)*Q16_16_MULT);
+}
+
+/* nouvelle generation de la config : le LEON la prend en compte en bloc */
+int spid_commit (unsigned int flags_set, unsigned int flags_clr)
+{
+  unsigned int ctrl;
+
+  if (master_i2c_read_word (A_SPID_CTRL, &ctrl)<0)
+    return -1;
+  ctrl = (ctrl + 0x10000) & ~flags_clr;
+  ctrl |= flags_set;
+  return master_i2c_write_word (A_SPID_CTRL, ctrl);
+}
+
+void usage(const char *prog_name)
+{
+  printf("Usage:\n");
+  printf(" %s gains <kp> <ki> <kd> <kff> [out_max]\n", prog_name);
+  printf(" %s period <us>           (1000..100000)\n", prog_name);
+  printf(" %s speed <sp_1> <sp_2>   (increments/s)\n", prog_name);
+  printf(" %s on|off\n", prog_name);
+  printf(" %s trace <log2_dec>|off\n", prog_name);
+  printf(" %s status\n", prog_name);
+  printf(" %s dump                  (ticks, erreurs, commandes)\n",
+	 prog_name);
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int val, err, cmd, ticks, sat, drop, status;
+  int dec;
+
+  if(argc<2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if(i2c_init()!=0) {
+    printf("Cannot init i2c\n");
+    return 1;
+  }
+
+  if ((strcmp(argv[1], "gains")==0) && (argc>=6)) {
+    master_i2c_write_word (A_SPID_KP, q16_16(argv[2]));
+    master_i2c_write_word (A_SPID_KI, q16_16(argv[3]));
+    master_i2c_write_word (A_SPID_KD, q16_16(argv[4]));
+    master_i2c_write_word (A_SPID_KFF, q16_16(argv[5]));
+    if (argc>=7)
+      master_i2c_write_word (A_SPID_OUT_MAX, strtol(argv[6], NULL, 0));
+    spid_commit (0, 0);
+  } else if ((strcmp(argv[1], "period")==0) && (argc>=3)) {
+    master_i2c_write_word (A_SPID_PERIOD, strtol(argv[2], NULL, 0));
+    spid_commit (0, 0);
+  } else if ((strcmp(argv[1], "speed")==0) && (argc>=4)) {
+    master_i2c_write_word (A_SPID_SP_1, strtol(argv[2], NULL, 0));
+    master_i2c_write_word (A_SPID_SP_2, strtol(argv[3], NULL, 0));
+  } else if (strcmp(argv[1], "on")==0) {
+    spid_commit (SPID_CTRL_ENABLE, 0);
+  } else if (strcmp(argv[1], "off")==0) {
+    spid_commit (0, SPID_CTRL_ENABLE);
+  } else if ((strcmp(argv[1], "trace")==0) && (argc>=3)) {
+    if (strcmp(argv[2], "off")==0) {
+      spid_commit (0, SPID_CTRL_TRACE);
+    } else {
+      dec = strtol(argv[2], NULL, 0) & 0xf;
+      spid_commit (SPID_CTRL_TRACE | (dec<<4), 0xf0);
+    }
+  } else if (strcmp(argv[1], "status")==0) {
+    master_i2c_read_word (A_SPID_STATUS, &status);
+    master_i2c_read_word (A_SPID_PERIOD, &val);
+    master_i2c_read_word (A_SPID_ERR, &err);
+    master_i2c_read_word (A_SPID_CMD, &cmd);
+    master_i2c_read_word (A_SPID_TICKS, &ticks);
+    master_i2c_read_word (A_SPID_SAT, &sat);
+    master_i2c_read_word (A_SPID_TRACE_DROP, &drop);
+    printf("gen %u %s%s period %u us\n", status>>16,
+	   (status&SPID_CTRL_ENABLE) ? "on" : "off",
+	   (status&SPID_CTRL_TRACE) ? " trace" : "", val);
+    printf("err %d %d cmd %d %d\n", (short)(err>>16), (short)(err&0xffff),
+	   (short)(cmd>>16), (short)(cmd&0xffff));
+    printf("ticks %u sat %u trace drop %u\n", ticks, sat, drop);
+  } else if (strcmp(argv[1], "dump")==0) {
+    /* enregistrements de 3 mots : ticks, erreurs, commandes */
+    while (1) {
+      if (i2c_read_trace (&ticks)==0) {
+	usleep(200);
+	continue;
+      }
+      while (i2c_read_trace (&err)==0)
+	usleep(200);
+      while (i2c_read_trace (&cmd)==0)
+	usleep(200);
+      printf ("%8u %6d %6d %6d %6d\n", ticks,
+	      (short)(err>>16), (short)(err&0xffff),
+	      (short)(cmd>>16), (short)(cmd&0xffff));
+    }
+  } else {
+    usage(argv[0]);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <sys/ioctl.h>
+
+#include "i2c-dev.h"
+
+/* Lecture coherente de la pose (robot_gps_odo) et des compteurs 64 bits
+   par l'instantane 0x80008040..0x8000807c : l'ecriture de SNAP_CS fige
+   tous les mots ensemble, plus besoin de relire et comparer les moities
+   hautes et basses. */
+
+#define FXP_MULT (0x0001000000000000LL)
+
+#define I2C_DEV "/dev/i2c-0"
+#define I2C_SLAVE_ADDR 0x42
+
+#define A_SNAP_CS         0x80008040
+#define A_SNAP_TIMER      0x80008044
+#define SNAP_NB_WORDS     15 /* 0x80008044..0x8000807c */
+
+#define SNAP_STATUS_SEQ     0x0000ffff
+#define SNAP_STATUS_PENDING 0x80000000
+
+/* au pire 46 cycles pclk, bien moins qu'une transaction I2C */
+#define SNAP_MAX_POLLS    10
+
+unsigned char i2c_buf[256];
+
+int i2c_dev_file;
+char i2c_dev_name[20];
+
+int i2c_init (void)
+{
+  sprintf(i2c_dev_name, I2C_DEV);
+
+  if ((i2c_dev_file = open(i2c_dev_name,O_RDWR)) < 0) {
+    printf("i2c_init() : Cannot open %s\n", I2C_DEV);
+    return -1;
+  }
+
+  if (ioctl(i2c_dev_file, I2C_SLAVE, I2C_SLAVE_ADDR) < 0) {
+    printf("i2c_init() : Cannot assign device addr (%x) %s\n",
+	   I2C_SLAVE_ADDR, I2C_DEV);
+    return -1;
+  }
+
+  return 0;
+}
+
+int master_i2c_read_word (unsigned int apb_addr, unsigned int *pdata)
+{
+  unsigned int data;
+  int rbytes;
+
+  i2c_buf[0] = 0x03;
+  i2c_buf[1] = (apb_addr>>24) & 0xff;
+  i2c_buf[2] = (apb_addr>>16) & 0xff;
+  i2c_buf[3] = (apb_addr>>8) & 0xff;
+  i2c_buf[4] = (apb_addr) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
+    printf("I2C Send apb_addr (0x03) failed\n");
+    return -1;
+  }
+
+  i2c_buf[0] = 0x05;
+  if (write(i2c_dev_file, i2c_buf, 1) != 1) {
+    printf("I2C Send APB read command (0x05) failed\n");
+    return -1;
+  }
+
+  rbytes = read(i2c_dev_file, i2c_buf, 4);
+  if (rbytes<4) {
+    printf("I2C APB read failed\n");
+    return -1;
+  }
+
+  data= (i2c_buf[0]<<24) + (i2c_buf[1]<<16) + (i2c_buf[2]<<8) + (i2c_buf[3]);
+  *pdata = data;
+
+  return 4;
+}
+
+int master_i2c_write_word (unsigned int apb_addr, unsigned int data)
+{
+  i2c_buf[0] = 0x03;
+  i2c_buf[1] = (apb_addr>>24) & 0xff;
+  i2c_buf[2] = (apb_addr>>16) & 0xff;
+  i2c_buf[3] = (apb_addr>>8) & 0xff;
+  i2c_buf[4] = (apb_addr) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
+    printf("I2C Send apb_addr (0x03) failed\n");
+    return -1;
+  }
+
+  i2c_buf[0] = 0x04;
+  i2c_buf[1] = (data>>24) & 0xff;
+  i2c_buf[2] = (data>>16) & 0xff;
+  i2c_buf[3] = (data>>8) & 0xff;
+  i2c_buf[4] = (data) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
+    printf("I2C APB write (0x04) failed\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+long long int snap_q48 (unsigned int *snap, int i)
+{
+  return (long long int) (((unsigned long long) snap[i] << 32) | snap[i+1]);
+}
+
+/* declenche un instantane et relit les 15 mots figes
+
+   @return numero de l'instantane, -1 en cas d'erreur */
+int snap_read (unsigned int *snap)
+{
+  unsigned int status;
+  int i;
+
+  if (master_i2c_write_word (A_SNAP_CS, 1)<0)
+    return -1;
+
+  for (i=0; i<SNAP_MAX_POLLS; i++) {
+    if (master_i2c_read_word (A_SNAP_CS, &status)<0)
+      return -1;
+    if ((status & SNAP_STATUS_PENDING)==0)
+      break;
+  }
+  if (i==SNAP_MAX_POLLS) {
+    printf("snap_read() : instantane toujours en attente (0x%.8x)\n", status);
+    return -1;
+  }
+
+  for (i=0; i<SNAP_NB_WORDS; i++) {
+    if (master_i2c_read_word (A_SNAP_TIMER + 4*i, &snap[i])<0)
+      return -1;
+  }
+
+  return status & SNAP_STATUS_SEQ;
+}
+
+void usage(const char *prog_name)
+{
+  printf("Usage:\n");
+  printf(" %s [period_ms [count]]\n", prog_name);
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int snap[SNAP_NB_WORDS];
+  int period_ms = 0, count = 1, n, seq;
+  double x, y, theta;
+
+  if (argc>=2) {
+    if (argv[1][0]=='-') {
+      usage(argv[0]);
+      return 1;
+    }
+    period_ms = atoi(argv[1]);
+    count = (argc>=3) ? atoi(argv[2]) : -1;
+  }
+
+  if(i2c_init()!=0) {
+    printf("Cannot init i2c\n");
+    return 1;
+  }
+
+  for (n=0; (count<0) || (n<count); n++) {
+    seq = snap_read (snap);
+    if (seq<0)
+      return 1;
+
+    /* snap[0] : timer, puis x, y, theta, cnt_th_r, cnt_r_r, cnt_th_l,
+       cnt_r_l (H, L) */
+    x = (double) snap_q48 (snap, 1) / FXP_MULT;
+    y = (double) snap_q48 (snap, 3) / FXP_MULT;
+    theta = (double) snap_q48 (snap, 5) / FXP_MULT;
+    printf("#%5d t %10u us  x %10.3f mm  y %10.3f mm  theta %8.3f deg\n",
+           seq, snap[0], x, y, theta*180.0/M_PI);
+    printf("       cnt th_r %016llx r_r %016llx th_l %016llx r_l %016llx\n",
+           snap_q48 (snap, 7), snap_q48 (snap, 9),
+           snap_q48 (snap, 11), snap_q48 (snap, 13));
+
+    if (period_ms>0)
+      usleep(period_ms*1000);
+  }
+
+  return 0;
+}
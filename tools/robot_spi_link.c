@@ -0,0 +1,512 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+
+#include "i2c-dev.h"
+
+/* Lien SPI avec le robot (src/robot/robot_spi_slave.vhd) par spidev : memes
+   commandes que l'esclave I2C 0x42 (lecture/ecriture APB, commandes pour le
+   LEON, fifo de trace) plus les rafales APB, et comparaison des temps
+   d'acces SPI / I2C.
+
+   Trames de 6 octets, enchainees dans un meme transfert :
+     MOSI : cmd<<4, data (4 octets, MSB en premier), xor des 4 octets
+     MISO : etat, data, xor des 4 octets */
+
+#define SPI_DEV "/dev/spidev1.0"
+#define SPI_SPEED_HZ 4000000
+
+#define I2C_DEV "/dev/i2c-0"
+#define I2C_SLAVE_ADDR 0x42
+
+#define SPI_CMD_DEBUG      0x0
+#define SPI_CMD_TRACE      0x1
+#define SPI_CMD_BSTR       0x2
+#define SPI_CMD_ADDR       0x3
+#define SPI_CMD_WRITE      0x4
+#define SPI_CMD_READ       0x5
+#define SPI_CMD_READ_INC   0x6
+#define SPI_CMD_WRITE_INC  0x7
+#define SPI_CMD_COUNTERS   0x8
+
+#define SPI_STATUS_MARK    0xa0
+#define SPI_STATUS_MASK    0xf1
+#define SPI_STATUS_CHK_ERR 0x08
+#define SPI_STATUS_BSTR    0x04 /* commande precedente pas lue par le LEON */
+#define SPI_STATUS_TRACE   0x02
+
+#define SPI_FRAME_LEN      6
+#define SPI_MAX_FRAMES     512
+
+/* instantane pose + compteurs (cf robot_leon.h) */
+#define A_SNAP_CS          0x80008040
+#define SNAP_NB_WORDS      15
+
+int spi_dev_file;
+unsigned int spi_speed_hz = SPI_SPEED_HZ;
+
+unsigned char spi_tx[SPI_MAX_FRAMES*SPI_FRAME_LEN];
+unsigned char spi_rx[SPI_MAX_FRAMES*SPI_FRAME_LEN];
+int spi_nb_frames;
+
+unsigned int spi_chk_errors;
+
+unsigned char i2c_buf[256];
+
+int i2c_dev_file;
+char i2c_dev_name[20];
+
+int spi_init (const char *dev)
+{
+  unsigned char mode = SPI_MODE_0;
+  unsigned char bits = 8;
+
+  if ((spi_dev_file = open(dev, O_RDWR)) < 0) {
+    printf("spi_init() : Cannot open %s\n", dev);
+    return -1;
+  }
+
+  if ((ioctl(spi_dev_file, SPI_IOC_WR_MODE, &mode) < 0) ||
+      (ioctl(spi_dev_file, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) ||
+      (ioctl(spi_dev_file, SPI_IOC_WR_MAX_SPEED_HZ, &spi_speed_hz) < 0)) {
+    printf("spi_init() : Cannot configure %s\n", dev);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* ajoute une trame au transfert en preparation */
+void spi_frame_add (int cmd, unsigned int data)
+{
+  unsigned char *p = &spi_tx[spi_nb_frames*SPI_FRAME_LEN];
+
+  p[0] = cmd<<4;
+  p[1] = (data>>24) & 0xff;
+  p[2] = (data>>16) & 0xff;
+  p[3] = (data>>8) & 0xff;
+  p[4] = (data) & 0xff;
+  p[5] = p[1] ^ p[2] ^ p[3] ^ p[4];
+  spi_nb_frames++;
+}
+
+/* envoie les trames preparees, un seul transfert */
+int spi_frames_send (void)
+{
+  struct spi_ioc_transfer xfer;
+  int len = spi_nb_frames*SPI_FRAME_LEN;
+
+  memset(&xfer, 0, sizeof(xfer));
+  xfer.tx_buf = (unsigned long) spi_tx;
+  xfer.rx_buf = (unsigned long) spi_rx;
+  xfer.len = len;
+  xfer.speed_hz = spi_speed_hz;
+  xfer.bits_per_word = 8;
+
+  spi_nb_frames = 0;
+  if (ioctl(spi_dev_file, SPI_IOC_MESSAGE(1), &xfer) < len) {
+    printf("SPI transfer failed\n");
+    return -1;
+  }
+  return 0;
+}
+
+int spi_frame_status (int i)
+{
+  return spi_rx[i*SPI_FRAME_LEN];
+}
+
+/* donnee de la trame i de la reponse, -1 si l'esclave ne repond pas ou si
+   le xor ne correspond pas */
+int spi_frame_data (int i, unsigned int *pdata)
+{
+  unsigned char *p = &spi_rx[i*SPI_FRAME_LEN];
+
+  if ((p[0] & SPI_STATUS_MASK) != SPI_STATUS_MARK) {
+    printf("SPI : pas de reponse (etat 0x%.2x)\n", p[0]);
+    return -1;
+  }
+  if ((p[1] ^ p[2] ^ p[3] ^ p[4]) != p[5]) {
+    spi_chk_errors++;
+    return -1;
+  }
+
+  *pdata = (p[1]<<24) + (p[2]<<16) + (p[3]<<8) + (p[4]);
+  return 0;
+}
+
+int master_spi_read_word (unsigned int apb_addr, unsigned int *pdata)
+{
+  spi_frame_add (SPI_CMD_ADDR, apb_addr);
+  spi_frame_add (SPI_CMD_READ, 0);
+  if (spi_frames_send ()<0)
+    return -1;
+  return spi_frame_data (1, pdata);
+}
+
+int master_spi_write_word (unsigned int apb_addr, unsigned int data)
+{
+  spi_frame_add (SPI_CMD_ADDR, apb_addr);
+  spi_frame_add (SPI_CMD_WRITE, data);
+  if (spi_frames_send ()<0)
+    return -1;
+  /* erreur de xor : visible dans l'etat de la trame suivante */
+  spi_frame_add (SPI_CMD_COUNTERS, 0);
+  if (spi_frames_send ()<0)
+    return -1;
+  if (spi_frame_status (0) & SPI_STATUS_CHK_ERR) {
+    spi_chk_errors++;
+    return -1;
+  }
+  return 0;
+}
+
+/* n mots consecutifs a partir de apb_addr, en un seul transfert */
+int master_spi_read_burst (unsigned int apb_addr, unsigned int *pdata, int n)
+{
+  int i;
+
+  if (n > SPI_MAX_FRAMES-1)
+    return -1;
+
+  spi_frame_add (SPI_CMD_ADDR, apb_addr);
+  for (i=0; i<n; i++)
+    spi_frame_add (SPI_CMD_READ_INC, 0);
+  if (spi_frames_send ()<0)
+    return -1;
+
+  for (i=0; i<n; i++) {
+    if (spi_frame_data (i+1, &pdata[i])<0)
+      return -1;
+  }
+  return n;
+}
+
+/* mot de la fifo de trace, 0 si vide */
+int spi_read_trace (unsigned int *pdata)
+{
+  spi_frame_add (SPI_CMD_TRACE, 0);
+  if (spi_frames_send ()<0)
+    return -1;
+  if ((spi_frame_status (0) & SPI_STATUS_TRACE) == 0)
+    return 0;
+  if (spi_frame_data (0, pdata)<0)
+    return -1;
+  return 4;
+}
+
+/* commande pour le LEON (equivalent de l'ecriture I2C en 0x02) */
+int spi_write_cmd (unsigned int data)
+{
+  int i;
+
+  /* la commande precedente doit avoir ete lue, sinon elle serait perdue */
+  for (i=0; i<100; i++) {
+    spi_frame_add (SPI_CMD_COUNTERS, 0);
+    if (spi_frames_send ()<0)
+      return -1;
+    if ((spi_frame_status (0) & SPI_STATUS_BSTR) == 0)
+      break;
+    usleep(200);
+  }
+  if (i==100) {
+    printf("SPI : commande precedente toujours pas lue par le LEON\n");
+    return -1;
+  }
+
+  spi_frame_add (SPI_CMD_BSTR, data);
+  return spi_frames_send ();
+}
+
+/* instantane pose + compteurs : ecriture de SNAP_CS, une trame pour
+   laisser finir l'integration en cours, puis relecture en rafale */
+int spi_read_state (unsigned int *snap)
+{
+  int i;
+
+  spi_frame_add (SPI_CMD_ADDR, A_SNAP_CS);
+  spi_frame_add (SPI_CMD_WRITE_INC, 1);
+  spi_frame_add (SPI_CMD_COUNTERS, 0);
+  for (i=0; i<SNAP_NB_WORDS; i++)
+    spi_frame_add (SPI_CMD_READ_INC, 0);
+  if (spi_frames_send ()<0)
+    return -1;
+
+  for (i=0; i<SNAP_NB_WORDS; i++) {
+    if (spi_frame_data (i+3, &snap[i])<0)
+      return -1;
+  }
+  return 0;
+}
+
+int i2c_init (void)
+{
+  sprintf(i2c_dev_name, I2C_DEV);
+
+  if ((i2c_dev_file = open(i2c_dev_name,O_RDWR)) < 0) {
+    printf("i2c_init() : Cannot open %s\n", I2C_DEV);
+    return -1;
+  }
+
+  if (ioctl(i2c_dev_file, I2C_SLAVE, I2C_SLAVE_ADDR) < 0) {
+    printf("i2c_init() : Cannot assign device addr (%x) %s\n",
+	   I2C_SLAVE_ADDR, I2C_DEV);
+    return -1;
+  }
+
+  return 0;
+}
+
+int master_i2c_read_word (unsigned int apb_addr, unsigned int *pdata)
+{
+  unsigned int data;
+  int rbytes;
+
+  i2c_buf[0] = 0x03;
+  i2c_buf[1] = (apb_addr>>24) & 0xff;
+  i2c_buf[2] = (apb_addr>>16) & 0xff;
+  i2c_buf[3] = (apb_addr>>8) & 0xff;
+  i2c_buf[4] = (apb_addr) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
+    printf("I2C Send apb_addr (0x03) failed\n");
+    return -1;
+  }
+
+  i2c_buf[0] = 0x05;
+  if (write(i2c_dev_file, i2c_buf, 1) != 1) {
+    printf("I2C Send APB read command (0x05) failed\n");
+    return -1;
+  }
+
+  rbytes = read(i2c_dev_file, i2c_buf, 4);
+  if (rbytes<4) {
+    printf("I2C APB read failed\n");
+    return -1;
+  }
+
+  data= (i2c_buf[0]<<24) + (i2c_buf[1]<<16) + (i2c_buf[2]<<8) + (i2c_buf[3]);
+  *pdata = data;
+
+  return 4;
+}
+
+int master_i2c_write_word (unsigned int apb_addr, unsigned int data)
+{
+  i2c_buf[0] = 0x03;
+  i2c_buf[1] = (apb_addr>>24) & 0xff;
+  i2c_buf[2] = (apb_addr>>16) & 0xff;
+  i2c_buf[3] = (apb_addr>>8) & 0xff;
+  i2c_buf[4] = (apb_addr) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
+    printf("I2C Send apb_addr (0x03) failed\n");
+    return -1;
+  }
+
+  i2c_buf[0] = 0x04;
+  i2c_buf[1] = (data>>24) & 0xff;
+  i2c_buf[2] = (data>>16) & 0xff;
+  i2c_buf[3] = (data>>8) & 0xff;
+  i2c_buf[4] = (data) & 0xff;
+  if (write(i2c_dev_file, i2c_buf, 5) != 5) {
+    printf("I2C APB write (0x04) failed\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+int i2c_read_state (unsigned int *snap)
+{
+  unsigned int status;
+  int i;
+
+  if (master_i2c_write_word (A_SNAP_CS, 1)<0)
+    return -1;
+  if (master_i2c_read_word (A_SNAP_CS, &status)<0)
+    return -1;
+  for (i=0; i<SNAP_NB_WORDS; i++) {
+    if (master_i2c_read_word (A_SNAP_CS + 4 + 4*i, &snap[i])<0)
+      return -1;
+  }
+  return 0;
+}
+
+double time_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e6 + ts.tv_nsec/1000.0;
+}
+
+/* boite aux lettres 0xe0..0xff : relue sans effet de bord (pas de fifo) */
+#define BENCH_BURST_ADDR  0x80008380
+#define BENCH_BURST_WORDS 32
+
+/* meme suite d'acces par les deux liens : mot seul, etat complet (16 mots),
+   boite aux lettres en rafale (debit) */
+void bench (int n, int with_i2c)
+{
+  unsigned int data, snap[SNAP_NB_WORDS], burst[BENCH_BURST_WORDS];
+  double t0, t_word, t_state, t_burst;
+  int i, j, err = 0;
+
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    err |= master_spi_read_word (0x80008000, &data);
+  t_word = (time_us() - t0)/n;
+
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    err |= spi_read_state (snap);
+  t_state = (time_us() - t0)/n;
+
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    err |= (master_spi_read_burst (BENCH_BURST_ADDR, burst,
+                                   BENCH_BURST_WORDS) < 0);
+  t_burst = (time_us() - t0)/n;
+
+  printf("SPI %.1f MHz%s\n", spi_speed_hz/1e6,
+         err ? " (erreurs de transfert)" : "");
+  printf("  mot APB         %8.1f us\n", t_word);
+  printf("  etat (16 mots)  %8.1f us\n", t_state);
+  printf("  rafale          %8.1f kmots/s\n", BENCH_BURST_WORDS*1e3/t_burst);
+  printf("  erreurs de xor  %u\n", spi_chk_errors);
+
+  if (!with_i2c)
+    return;
+
+  err = 0;
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    err |= (master_i2c_read_word (0x80008000, &data) < 0);
+  t_word = (time_us() - t0)/n;
+
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    err |= i2c_read_state (snap);
+  t_state = (time_us() - t0)/n;
+
+  t0 = time_us();
+  for (i=0; i<n; i++)
+    for (j=0; j<BENCH_BURST_WORDS; j++)
+      err |= (master_i2c_read_word (BENCH_BURST_ADDR + 4*j, &burst[j]) < 0);
+  t_burst = (time_us() - t0)/n;
+
+  printf("I2C 0x%x%s\n", I2C_SLAVE_ADDR, err ? " (erreurs de transfert)" : "");
+  printf("  mot APB         %8.1f us\n", t_word);
+  printf("  etat (16 mots)  %8.1f us\n", t_state);
+  printf("  rafale          %8.1f kmots/s\n", BENCH_BURST_WORDS*1e3/t_burst);
+}
+
+void usage(const char *prog_name)
+{
+  printf("Usage: %s [-d spidev] [-s speed_hz] <commande>\n", prog_name);
+  printf("  read <apb_addr> [n]\n");
+  printf("  write <apb_addr> <data>\n");
+  printf("  cmd <word>             (commande pour le LEON, cf I2C 0x02)\n");
+  printf("  trace                  (fifo de trace, cf I2C 0x01)\n");
+  printf("  state                  (instantane pose + compteurs)\n");
+  printf("  status                 (trames et erreurs vues par l'esclave)\n");
+  printf("  bench [n] [i2c]        (temps d'acces SPI, et I2C si demande)\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const char *dev = SPI_DEV;
+  unsigned int data, snap[SNAP_NB_WORDS], buf[SPI_MAX_FRAMES];
+  int i, n, a = 1;
+
+  while ((a+1<argc) && (argv[a][0]=='-')) {
+    if (strcmp(argv[a], "-d")==0) {
+      dev = argv[a+1];
+    } else if (strcmp(argv[a], "-s")==0) {
+      spi_speed_hz = strtol(argv[a+1], NULL, 0);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+    a += 2;
+  }
+
+  if (a>=argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (spi_init(dev)!=0) {
+    printf("Cannot init spi\n");
+    return 1;
+  }
+
+  if ((strcmp(argv[a], "read")==0) && (a+1<argc)) {
+    n = (a+2<argc) ? strtol(argv[a+2], NULL, 0) : 1;
+    if ((n<1) || (n>SPI_MAX_FRAMES-1))
+      n = 1;
+    if (master_spi_read_burst (strtoul(argv[a+1], NULL, 0), buf, n)<0) {
+      printf("SPI read failed\n");
+      return 1;
+    }
+    for (i=0; i<n; i++)
+      printf("%.8x\n", buf[i]);
+  } else if ((strcmp(argv[a], "write")==0) && (a+2<argc)) {
+    if (master_spi_write_word (strtoul(argv[a+1], NULL, 0),
+                               strtoul(argv[a+2], NULL, 0))<0) {
+      printf("SPI write failed\n");
+      return 1;
+    }
+  } else if ((strcmp(argv[a], "cmd")==0) && (a+1<argc)) {
+    if (spi_write_cmd (strtoul(argv[a+1], NULL, 0))<0)
+      return 1;
+  } else if (strcmp(argv[a], "trace")==0) {
+    while (1) {
+      n = spi_read_trace (&data);
+      if (n<0)
+        return 1;
+      if (n==0) {
+        usleep(200);
+        continue;
+      }
+      printf("%.8x\n", data);
+    }
+  } else if (strcmp(argv[a], "state")==0) {
+    if (spi_read_state (snap)<0) {
+      printf("SPI state read failed\n");
+      return 1;
+    }
+    printf("t %u us\n", snap[0]);
+    for (i=1; i<SNAP_NB_WORDS; i+=2)
+      printf("%.8x%.8x\n", snap[i], snap[i+1]);
+  } else if (strcmp(argv[a], "status")==0) {
+    spi_frame_add (SPI_CMD_COUNTERS, 0);
+    if ((spi_frames_send ()<0) || (spi_frame_data (0, &data)<0))
+      return 1;
+    printf("etat 0x%.2x trames %u erreurs %u\n", spi_frame_status (0),
+           data>>16, data&0xffff);
+  } else if (strcmp(argv[a], "bench")==0) {
+    n = (a+1<argc) ? strtol(argv[a+1], NULL, 0) : 1000;
+    if (n<1)
+      n = 1;
+    if ((a+2<argc) && (strcmp(argv[a+2], "i2c")==0)) {
+      if (i2c_init()!=0) {
+        printf("Cannot init i2c\n");
+        return 1;
+      }
+      bench (n, 1);
+    } else {
+      bench (n, 0);
+    }
+  } else {
+    usage(argv[0]);
+    return 1;
+  }
+
+  return 0;
+}
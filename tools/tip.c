@@ -47,6 +47,8 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <pthread.h>
+#include <time.h>
 
 #ifndef EMBED
 #include <sys/select.h>
@@ -89,6 +91,7 @@ int		net_connection = 0;
 int		gotdevice;
 int		ifd, ofd;
 int		rfd, cfd;
+int		capformat;
 
 /*
  *	Working termios settings.
@@ -295,6 +298,239 @@ int setremotetermios()
 
 /*****************************************************************************/
 
+/*
+ *	Capture writer. The serial side only copies each received chunk,
+ *	tagged with a monotonic timestamp, into a single-producer/single-
+ *	consumer ring (no lock, no syscall). A separate thread drains the
+ *	ring into large aligned blocks and does the file writes, so a slow
+ *	disk never stalls the serial reader. If the ring is full the data
+ *	is dropped and counted instead.
+ *
+ *	Binary log format (-B) : "TIPCAP01" then, for every chunk, a
+ *	struct caprec header (native endian) followed by len data bytes.
+ */
+#define	CAP_FMT_RAW	0	/* data only (default) */
+#define	CAP_FMT_TEXT	1	/* "[sec.usec] " at each line start (-T) */
+#define	CAP_FMT_BIN	2	/* binary records (-B) */
+
+#define	CAP_RING_SIZE	(1 << 20)	/* power of 2 */
+#define	CAP_BLOCK_SIZE	(64 * 1024)
+#define	CAP_FLUSH_MS	200
+#define	CAP_MAGIC	"TIPCAP01"
+
+struct caprec {
+	unsigned int	sec;
+	unsigned int	nsec;
+	unsigned int	len;
+};
+
+unsigned char		capring[CAP_RING_SIZE];
+volatile unsigned int	caphead;	/* written by the reader only */
+volatile unsigned int	captail;	/* written by the writer only */
+volatile int		capstop;
+unsigned long		capdropped;
+unsigned long long	capbytes;
+
+pthread_t		capthread;
+int			capthread_ok;
+unsigned char		*capblk;
+unsigned int		capfill;
+off_t			capoff;
+struct timespec		capt0;
+
+static void capring_in(unsigned int pos, void *buf, unsigned int n)
+{
+	unsigned int	i = pos & (CAP_RING_SIZE - 1);
+	unsigned int	n1 = CAP_RING_SIZE - i;
+
+	if (n1 > n)
+		n1 = n;
+	memcpy(&capring[i], buf, n1);
+	memcpy(&capring[0], (unsigned char *) buf + n1, n - n1);
+}
+
+static void capring_out(unsigned int pos, void *buf, unsigned int n)
+{
+	unsigned int	i = pos & (CAP_RING_SIZE - 1);
+	unsigned int	n1 = CAP_RING_SIZE - i;
+
+	if (n1 > n)
+		n1 = n;
+	memcpy(buf, &capring[i], n1);
+	memcpy((unsigned char *) buf + n1, &capring[0], n - n1);
+}
+
+/*
+ *	Producer side, called from loopit() for every chunk read.
+ */
+void capture_put(void *buf, int n)
+{
+	struct caprec	rec;
+	struct timespec	ts;
+	unsigned int	head, need;
+
+	if (!capthread_ok) {
+		write(cfd, buf, n);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	if (ts.tv_nsec < capt0.tv_nsec) {
+		ts.tv_sec--;
+		ts.tv_nsec += 1000000000;
+	}
+	rec.sec = ts.tv_sec - capt0.tv_sec;
+	rec.nsec = ts.tv_nsec - capt0.tv_nsec;
+	rec.len = n;
+
+	head = caphead;
+	need = sizeof(rec) + n;
+	if ((CAP_RING_SIZE - (head - captail)) < need) {
+		capdropped += n;
+		return;
+	}
+	capring_in(head, &rec, sizeof(rec));
+	capring_in(head + sizeof(rec), buf, n);
+	__sync_synchronize();
+	caphead = head + need;
+}
+
+/*
+ *	Writer side. Full blocks are written at block aligned offsets, a
+ *	partial block is (re)written in place on idle and at the end.
+ */
+static void capture_flush(int full)
+{
+	if (capfill == 0)
+		return;
+	if (pwrite(cfd, capblk, capfill, capoff) < 0)
+		fprintf(stderr, "ERROR: capture write failed, errno=%d\n",
+			errno);
+	if (full) {
+		capoff += capfill;
+		capfill = 0;
+	}
+}
+
+static void capture_emit(void *buf, unsigned int n)
+{
+	unsigned int	n1;
+
+	capbytes += n;
+	while (n > 0) {
+		n1 = CAP_BLOCK_SIZE - capfill;
+		if (n1 > n)
+			n1 = n;
+		memcpy(capblk + capfill, buf, n1);
+		capfill += n1;
+		buf = (unsigned char *) buf + n1;
+		n -= n1;
+		if (capfill == CAP_BLOCK_SIZE)
+			capture_flush(1);
+	}
+}
+
+void *capture_writer(void *arg)
+{
+	struct caprec	rec;
+	unsigned char	data[sizeof(ibuf) > sizeof(obuf) ?
+			     sizeof(ibuf) : sizeof(obuf)];
+	char		stamp[32];
+	int		linestart = 1;
+	int		idle_ms = 0;
+	unsigned int	tail, i, j;
+
+	(void) arg;
+
+	if (capformat == CAP_FMT_BIN)
+		capture_emit(CAP_MAGIC, 8);
+
+	for (;;) {
+		tail = captail;
+		if (tail == caphead) {
+			if (capstop)
+				break;
+			if (idle_ms >= CAP_FLUSH_MS) {
+				capture_flush(0);
+				idle_ms = 0;
+			}
+			usleep(1000);
+			idle_ms++;
+			continue;
+		}
+		__sync_synchronize();
+
+		capring_out(tail, &rec, sizeof(rec));
+		if (rec.len > sizeof(data))
+			rec.len = sizeof(data);
+		capring_out(tail + sizeof(rec), data, rec.len);
+		__sync_synchronize();
+		captail = tail + sizeof(rec) + rec.len;
+
+		switch (capformat) {
+		case CAP_FMT_BIN:
+			capture_emit(&rec, sizeof(rec));
+			capture_emit(data, rec.len);
+			break;
+		case CAP_FMT_TEXT:
+			for (i = 0; i < rec.len; i = j) {
+				if (linestart) {
+					sprintf(stamp, "[%u.%06u] ", rec.sec,
+						rec.nsec / 1000);
+					capture_emit(stamp, strlen(stamp));
+					linestart = 0;
+				}
+				for (j = i; j < rec.len; j++) {
+					if (data[j] == '\n') {
+						j++;
+						linestart = 1;
+						break;
+					}
+				}
+				capture_emit(data + i, j - i);
+			}
+			break;
+		default:
+			capture_emit(data, rec.len);
+			break;
+		}
+	}
+
+	capture_flush(0);
+	ftruncate(cfd, capoff + capfill);
+	return NULL;
+}
+
+void capture_start(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &capt0);
+	if (posix_memalign((void **) &capblk, 4096, CAP_BLOCK_SIZE) != 0) {
+		fprintf(stderr, "ERROR: no memory for capture buffer, "
+			"using direct writes\n");
+		return;
+	}
+	if (pthread_create(&capthread, NULL, capture_writer, NULL) != 0) {
+		fprintf(stderr, "ERROR: failed to start capture thread, "
+			"using direct writes\n");
+		return;
+	}
+	capthread_ok = 1;
+}
+
+void capture_stop(void)
+{
+	if (!capthread_ok)
+		return;
+	capthread_ok = 0;
+	capstop = 1;
+	pthread_join(capthread, NULL);
+	if (verbose)
+		fprintf(stderr, "capture: %llu bytes written, %lu bytes "
+			"dropped\n", capbytes, capdropped);
+}
+
+/*****************************************************************************/
+
 void sighandler(int signal)
 {
 	if (tcpport) {
@@ -307,6 +543,7 @@ void sighandler(int signal)
 		restoreremotetermios();
 		printf("Done\n");
 	}
+	capture_stop();
 	close(rfd);
 	exit(1);
 }
@@ -485,7 +722,7 @@ int loopit()
 				exit(1);
 			}
 			if (cfd > 0)
-				write(cfd, bp, n);
+				capture_put(bp, n);
 		}
 
 		if (FD_ISSET(ifd, &infds)) {
@@ -581,7 +818,7 @@ int opensoc(void)
 
 void usage(FILE *fp, int rc)
 {
-	fprintf(fp, "Usage: tip [-?heonxrwcqt125678] [-s speed] [-w file] "
+	fprintf(fp, "Usage: tip [-?heonxrwcqt125678TB] [-s speed] [-w file] "
 		"[-p tcpport] [-l device] [device]\n\n"
 		"\t-h?\tthis help\n"
 		"\t-q\tquiet mode (no helpful messages)\n"
@@ -601,6 +838,8 @@ void usage(FILE *fp, int rc)
 		"\t-f\tpass xon/xoff flow control to remote\n"
 		"\t-s\tbaud rate (default 9600)\n"
 		"\t-w\tcapture remote output to local file\n"
+		"\t-T\ttimestamp each captured line\n"
+		"\t-B\tbinary timestamped capture log\n"
 		"\t-p\tbind to tcpport instead of using stdin/stdout\n"
 		"\t-l\tdevice to use\n"
 		"\t-d\tdownload file name\n");
@@ -620,7 +859,7 @@ int main(int argc, char *argv[])
 	ofd = 1;
 	gotdevice = 0;
 
-	while ((c = getopt(argc, argv, "?heonxrcqtf125678w:s:p:l:d:")) > 0) {
+	while ((c = getopt(argc, argv, "?heonxrcqtf125678TBw:s:p:l:d:")) > 0) {
 		switch (c) {
 		case 'v':
 			printf("%s: version %s\n", argv[0], version);
@@ -682,6 +921,12 @@ int main(int argc, char *argv[])
 		case 'w':
 			capfile = optarg;
 			break;
+		case 'T':
+			capformat = CAP_FMT_TEXT;
+			break;
+		case 'B':
+			capformat = CAP_FMT_BIN;
+			break;
 		case 'l':
 			gotdevice++;
 			devname = optarg;
@@ -777,6 +1022,7 @@ int main(int argc, char *argv[])
 				capfile, errno);
 			exit(0);
 		}
+		capture_start();
 	}
 
 	if (tcpport) {
@@ -819,8 +1065,10 @@ int main(int argc, char *argv[])
 		    restoreremotetermios();
 		restorelocaltermios();
 	}
-	if (cfd > 0)
+	if (cfd > 0) {
+		capture_stop();
 		close(cfd);
+	}
 	close(rfd);
 	exit(0);
 }